@@ -11,12 +11,14 @@
 
 #pragma once
 
-#include <dxcapi.h>
-#include <vector>
+#include <chrono>
+#include <memory>
 
 #include "DXSample.h"
-#include "nv_helpers_dx12/TopLevelASGenerator.h"
-#include "nv_helpers_dx12/ShaderBindingTableGenerator.h"
+#include "rhi/D3D12RenderDevice.h"
+#include "rhi/SampleScene.h"
+#include "tools/InputLog.h"
+#include "tools/Profiler.h"
 
 using namespace DirectX;
 
@@ -37,135 +39,62 @@ public:
 	virtual void OnRender();
 	virtual void OnDestroy();
 
+	// Also parses the input recording and replay options:
+	// -record <file>      record the camera inputs of the session to a log
+	// -replay <file>      replay a log with its recorded timing, then exit
+	// -replayfast         replay the log at maximum speed instead
+	// -frametimes <file>  write the frame times of the replay to a CSV file
+	// -trace <file>       write a Chrome trace of the frames when the sample closes
+	// -mesh <file>        import an OBJ or PLY mesh replacing the sponge
+	// -scene <file>       load a scene description replacing the sponge and the plane
+	// -instances <n>      stress scene of n scattered sponges
+	// -cache <file>       load the scene from a cache file, created if missing
+	virtual void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
+
 private:
-	static const UINT FrameCount = 2;
-
-	struct Vertex
-	{
-		XMFLOAT3 position;
-		XMFLOAT4 color;
-
-		// #DXR Extra: Indexed Geometry
-		Vertex(XMFLOAT4 pos, XMFLOAT4 /*n*/, XMFLOAT4 col)
-			:position(pos.x, pos.y, pos.z), color(col)
-		{}
-		Vertex(XMFLOAT3 pos, XMFLOAT4 col)
-			:position(pos), color(col)
-		{}
-	};
+	static const UINT FrameCount = rhi::D3D12RenderDevice::FrameCount;
 
 	// Pipeline objects.
-	CD3DX12_VIEWPORT m_viewport;
-	CD3DX12_RECT m_scissorRect;
 	ComPtr<IDXGISwapChain3> m_swapChain;
 	ComPtr<ID3D12Device5> m_device;
-	ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
-	ComPtr<ID3D12CommandAllocator> m_commandAllocator;
 	ComPtr<ID3D12CommandQueue> m_commandQueue;
-	ComPtr<ID3D12RootSignature> m_rootSignature;
-	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
-	ComPtr<ID3D12PipelineState> m_pipelineState;
-	ComPtr<ID3D12GraphicsCommandList4> m_commandList;
-	UINT m_rtvDescriptorSize;
-
-	// App resources.
-	ComPtr<ID3D12Resource> m_vertexBuffer;
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
-
-	// Synchronization objects.
-	UINT m_frameIndex;
-	HANDLE m_fenceEvent;
-	ComPtr<ID3D12Fence> m_fence;
-	UINT64 m_fenceValue;
+
+	// All the rendering goes through the rendering hardware interface, on which
+	// the scene is set up the same way as for the CPU backend
+	std::unique_ptr<rhi::D3D12RenderDevice> m_renderDevice;
+	rhi::SampleScene m_scene;
+	rhi::Camera m_camera;
 
 	void LoadPipeline();
-	void LoadAssets();
-	void PopulateCommandList();
-	void WaitForPreviousFrame();
 	void CheckRaytracingSupport();
 	void OnKeyUp(UINT8 key);
 
-	
 	bool m_raster = true;
 
-	// #DXR
-	struct AccelerationStructureBuffers {
-		ComPtr<ID3D12Resource> pScratch;
-		ComPtr<ID3D12Resource> pResult;
-		ComPtr<ID3D12Resource> pInstanceDesc;
-	};
-
-	ComPtr<ID3D12Resource> m_bottomLevelAS;
-	nv_helpers_dx12::TopLevelASGenerator m_topLevelASGenerator;
-	AccelerationStructureBuffers m_topLevelASBuffers;
-	std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> m_instances;
-
-	//AccelerationStructureBuffers CreateBottomLevelAS(std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers);
-	AccelerationStructureBuffers CreateBottomLevelAS(std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers, std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vIndexBuffers = {});
-	void CreateTopLevelAS(const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances);
-	void CreateAccelerationStructure();
-
-	ComPtr<ID3D12RootSignature> CreateRayGenSignature();
-	ComPtr<ID3D12RootSignature> CreateMissSignature();
-	ComPtr<ID3D12RootSignature> CreateHitSignature();
-	void CreateRaytracingPipeline();
-	ComPtr<IDxcBlob> m_rayGenLibrary;
-	ComPtr<IDxcBlob> m_hitLibrary;
-	ComPtr<IDxcBlob> m_missLibrary;
-	ComPtr<ID3D12RootSignature> m_rayGenSignature;
-	ComPtr<ID3D12RootSignature> m_hitSignature;
-	ComPtr<ID3D12RootSignature> m_missSignature;
-	// Ray tracing pipeline state
-	ComPtr<ID3D12StateObject> m_rtStateObject;
-	// Ray tracing pipeline state properties, retaining the shader identifiers
-	// to use in the Shader Binding Table
-	ComPtr<ID3D12StateObjectProperties> m_rtStateObjectProps;
-
-	void CreateRaytracingOutputBuffer();
-	void CreateShaderResourceHeap();
-	ComPtr<ID3D12Resource> m_outputResource;
-	ComPtr<ID3D12DescriptorHeap> m_srvUavHeap;
-
-	void CreateShaderBindingTable();
-	nv_helpers_dx12::ShaderBindingTableGenerator m_sbtHelper;
-	ComPtr<ID3D12Resource> m_sbtStorage;
-
-	//Perspective Camera to see plane
-	void CreateCameraBuffer();
-	void UpdateCameraBuffer();
-	ComPtr<ID3D12Resource> m_cameraBuffer;
-	ComPtr<ID3D12DescriptorHeap> m_constHeap;
-	uint32_t m_cameraBufferSize = 0;
-
-	//Per instance data - add plane
-	ComPtr<ID3D12Resource> m_planeBuffer;
-	D3D12_VERTEX_BUFFER_VIEW m_planeBufferView;
-	void CreatePlaneVB();
-
-	void D3D12HelloTriangle::CreateGlobalConstantBuffer();
-	ComPtr<ID3D12Resource> m_globalConstantBuffer;
-
-	void CreatePerInstanceConstantBuffers();
-	std::vector<ComPtr<ID3D12Resource>> m_perInstanceConstantBuffers;
-
-	// #DXR Extra - Another ray type
-	ComPtr<IDxcBlob> m_shadowLibrary;
-	ComPtr<ID3D12RootSignature> m_shadowSignature;
-
-	//Indexed Geometry
-	ComPtr<ID3D12Resource> m_indexBuffer;
-	D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
-
-	void CreateMengerSpongeVB();
-	ComPtr<ID3D12Resource> m_mengerVB;
-	ComPtr<ID3D12Resource> m_mengerIB;
-	D3D12_VERTEX_BUFFER_VIEW m_mengerVBView;
-	D3D12_INDEX_BUFFER_VIEW m_mengerIBView;
-
-	UINT m_mengerIndexCount;
-	UINT m_mengerVertexCount;
-
 	// #DXR Extra: Perspective Camera++
 	void OnButtonDown(UINT32 lParam);
 	void OnMouseMove(UINT8 wParam, UINT32 lParam);
+
+	// Input recording and replay, for reproducible camera flythroughs
+	void FinishReplay();
+
+	std::wstring m_recordFile;
+	std::wstring m_replayFile;
+	std::wstring m_frameTimesFile;
+	bool m_replayFast = false;
+	std::unique_ptr<tools::InputRecorder> m_inputRecorder;
+	tools::InputLog m_replayLog;
+	std::unique_ptr<tools::InputPlayer> m_inputPlayer;
+	std::chrono::steady_clock::time_point m_lastFrameTime;
+	std::vector<double> m_frameTimes;
+
+	// Imported mesh, scene description, stress scene and scene cache, see rhi/SampleScene.h
+	std::wstring m_meshFile;
+	std::wstring m_sceneFile;
+	uint32_t m_stressInstanceCount = 0;
+	std::wstring m_cacheFile;
+
+	// Profiling of the frames, see tools/Profiler.h
+	std::wstring m_traceFile;
+	uint64_t m_frameIndex = 0;
 };
@@ -34,7 +34,7 @@ public:
 	UINT GetHeight() const          { return m_height; }
 	const WCHAR* GetTitle() const   { return m_title.c_str(); }
 
-	void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
+	virtual void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
 
 	virtual void OnButtonDown(UINT32) {}
 	virtual void OnMouseMove(UINT8, UINT32) {}
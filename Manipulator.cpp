@@ -1,8 +1,6 @@
 /******************************************************************************
  * Copyright 1986, 2017 NVIDIA Corporation. All rights reserved.
  ******************************************************************************/
-#include "stdafx.h"
-
 #include "Manipulator.h"
 
 #include <glm/glm.hpp>
@@ -0,0 +1,232 @@
+#include "BottomLevelASBatcher.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+const UINT64 kCompactedSizeStride =
+    sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+
+void TransitionBuffer(ID3D12GraphicsCommandList4* commandList, ID3D12Resource* resource,
+                      D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+  D3D12_RESOURCE_BARRIER barrier = {};
+  barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+  barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  barrier.Transition.pResource = resource;
+  barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+  barrier.Transition.StateBefore = before;
+  barrier.Transition.StateAfter = after;
+  commandList->ResourceBarrier(1, &barrier);
+}
+
+// Wait for all the pending UAV accesses, including acceleration structure builds and copies
+void UAVBarrier(ID3D12GraphicsCommandList4* commandList)
+{
+  D3D12_RESOURCE_BARRIER barrier = {};
+  barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+  barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  barrier.UAV.pResource = nullptr;
+  commandList->ResourceBarrier(1, &barrier);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void BottomLevelASBatcher::Init(ID3D12Device5* device, GpuMemoryAllocator* allocator,
+                                UINT64 scratchBudget /*= 32 * 1024 * 1024*/)
+{
+  m_device = device;
+  m_allocator = allocator;
+  m_scratchBudget = scratchBudget;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t BottomLevelASBatcher::Add(const BottomLevelASGenerator& generator,
+                                   bool allowCompaction /*= true*/)
+{
+  Blas blas;
+  blas.generator = generator;
+  blas.allowCompaction = allowCompaction;
+  m_blases.push_back(blas);
+  return static_cast<uint32_t>(m_blases.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Size all the new BLASes, schedule them in batches sharing one scratch allocation, and record
+// the builds with a UAV barrier between batches. The compacted sizes are emitted by the builds,
+// and copied to a readback buffer at the end of the command list
+void BottomLevelASBatcher::Build(ID3D12GraphicsCommandList4* commandList)
+{
+  if (m_device == nullptr)
+  {
+    throw std::logic_error("BottomLevelASBatcher::Init needs to be called before building");
+  }
+  if (!m_pendingCompaction.empty())
+  {
+    throw std::logic_error("The previous BLAS builds need to be compacted before building more");
+  }
+
+  std::vector<uint32_t> blasIndices;
+  std::vector<uint64_t> scratchSizes;
+  for (uint32_t i = 0; i < static_cast<uint32_t>(m_blases.size()); i++)
+  {
+    Blas& blas = m_blases[i];
+    if (blas.built)
+    {
+      continue;
+    }
+    blas.generator.ComputeASBufferSizes(m_device, false, &blas.scratchSize, &blas.resultSize,
+                                        blas.allowCompaction);
+    blasIndices.push_back(i);
+    scratchSizes.push_back(blas.scratchSize);
+  }
+  if (blasIndices.empty())
+  {
+    return;
+  }
+
+  BottomLevelASSchedule schedule = ScheduleBottomLevelASBuilds(
+      scratchSizes, m_scratchBudget, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+  m_scratchSize = schedule.scratchSize;
+  m_scratch = m_allocator->Allocate(BufferUsage::UnorderedAccess, schedule.scratchSize);
+  m_compactedSizes = m_allocator->Allocate(BufferUsage::UnorderedAccess,
+                                           kCompactedSizeStride * blasIndices.size());
+  m_compactedSizesReadback = m_allocator->Allocate(BufferUsage::Readback,
+                                                   kCompactedSizeStride * blasIndices.size());
+
+  for (size_t b = 0; b < schedule.batches.size(); b++)
+  {
+    // The previous batch has to be done with the scratch space before it is reused
+    if (b > 0)
+    {
+      UAVBarrier(commandList);
+    }
+    for (uint32_t slot : schedule.batches[b])
+    {
+      Blas& blas = m_blases[blasIndices[slot]];
+      blas.result = m_allocator->Allocate(BufferUsage::AccelerationStructure, blas.resultSize);
+
+      D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildInfo = {};
+      postbuildInfo.DestBuffer = m_compactedSizes.gpuAddress + slot * kCompactedSizeStride;
+      postbuildInfo.InfoType =
+          D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+
+      // No barrier per build, so that the builds of the batch can overlap
+      blas.generator.Generate(commandList, m_scratch.gpuAddress + schedule.scratchOffsets[slot],
+                              blas.result.gpuAddress, nullptr, false, 0,
+                              blas.allowCompaction ? &postbuildInfo : nullptr);
+      blas.built = true;
+    }
+  }
+  UAVBarrier(commandList);
+
+  // The compacted sizes are in a UAV pool buffer, which is temporarily made a
+  // copy source to fetch them
+  TransitionBuffer(commandList, m_compactedSizes.resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                   D3D12_RESOURCE_STATE_COPY_SOURCE);
+  commandList->CopyBufferRegion(m_compactedSizesReadback.resource,
+                                m_compactedSizesReadback.offset, m_compactedSizes.resource,
+                                m_compactedSizes.offset, m_compactedSizes.size);
+  TransitionBuffer(commandList, m_compactedSizes.resource, D3D12_RESOURCE_STATE_COPY_SOURCE,
+                   D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+  m_pendingCompaction = blasIndices;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Copy each BLAS built with compaction enabled into a buffer of its compacted size. The builds
+// are complete, so the scratch space and the size buffers are released
+void BottomLevelASBatcher::Compact(ID3D12GraphicsCommandList4* commandList)
+{
+  if (m_pendingCompaction.empty())
+  {
+    return;
+  }
+
+  const auto* compactedSizes =
+      reinterpret_cast<const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*>(
+          m_compactedSizesReadback.cpuAddress);
+  bool copied = false;
+  for (size_t slot = 0; slot < m_pendingCompaction.size(); slot++)
+  {
+    Blas& blas = m_blases[m_pendingCompaction[slot]];
+    if (!blas.allowCompaction)
+    {
+      blas.compaction = ComputeBottomLevelASCompaction(blas.resultSize, blas.resultSize);
+      continue;
+    }
+
+    blas.compaction = ComputeBottomLevelASCompaction(
+        blas.resultSize, compactedSizes[slot].CompactedSizeInBytes,
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+    blas.uncompacted = blas.result;
+    blas.result =
+        m_allocator->Allocate(BufferUsage::AccelerationStructure, blas.compaction.compactedSize);
+    commandList->CopyRaytracingAccelerationStructure(
+        blas.result.gpuAddress, blas.uncompacted.gpuAddress,
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+    copied = true;
+  }
+  if (copied)
+  {
+    // Subsequent TLAS builds read the compacted structures
+    UAVBarrier(commandList);
+  }
+
+  m_allocator->Free(m_scratch);
+  m_allocator->Free(m_compactedSizes);
+  m_allocator->Free(m_compactedSizesReadback);
+  m_pendingCompaction.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void BottomLevelASBatcher::FinishCompaction()
+{
+  for (auto& blas : m_blases)
+  {
+    m_allocator->Free(blas.uncompacted);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::vector<BottomLevelASCompaction> BottomLevelASBatcher::GetCompactionReport() const
+{
+  std::vector<BottomLevelASCompaction> report;
+  report.reserve(m_blases.size());
+  for (const auto& blas : m_blases)
+  {
+    report.push_back(blas.compaction);
+  }
+  return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void BottomLevelASBatcher::Release()
+{
+  for (auto& blas : m_blases)
+  {
+    m_allocator->Free(blas.result);
+    m_allocator->Free(blas.uncompacted);
+  }
+  m_blases.clear();
+  m_allocator->Free(m_scratch);
+  m_allocator->Free(m_compactedSizes);
+  m_allocator->Free(m_compactedSizesReadback);
+  m_pendingCompaction.clear();
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,111 @@
+/*
+The BLAS batcher builds a set of bottom-level acceleration structures in one
+submission, sharing a single scratch allocation scheduled by
+ScheduleBottomLevelASBuilds, and compacts them afterwards.
+
+The geometry of each BLAS is described with a BottomLevelASGenerator, then
+handed to the batcher with Add. The work is split in three steps, each
+recorded on a command list that has to complete on the GPU before the next
+step is called:
+- Build: allocate the shared scratch space and the results, record the builds
+  batch by batch, and emit the compacted sizes into a readback buffer
+- Compact: read the compacted sizes, allocate the compacted results and record
+  the compaction copies. The scratch space is released
+- FinishCompaction: release the original results
+
+Until Compact has been called, GetResult returns the uncompacted structures,
+which can already be used. Compaction typically saves about half of the
+memory of static geometry.
+
+Example:
+
+BottomLevelASBatcher batcher;
+batcher.Init(device, &allocator);
+uint32_t index = batcher.Add(bottomLevelAS);
+batcher.Build(commandList);
+// Execute and wait
+batcher.Compact(commandList);
+topLevelAS.AddInstance(batcher.GetResult(index).gpuAddress, transform, 0, 0);
+// Build the TLAS, execute and wait
+batcher.FinishCompaction();
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <vector>
+
+#include "BottomLevelASGenerator.h"
+#include "BottomLevelASSchedule.h"
+#include "GpuMemoryAllocator.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Batched builder and compactor of bottom-level acceleration structures
+class BottomLevelASBatcher
+{
+public:
+  /// Prepare the batcher. The scratch budget bounds the scratch space shared by
+  /// the builds of a batch
+  void Init(ID3D12Device5* device, GpuMemoryAllocator* allocator,
+            UINT64 scratchBudget = 32 * 1024 * 1024);
+
+  /// Add a BLAS whose geometry has been described in generator. Returns the
+  /// index of the BLAS in the batcher
+  uint32_t Add(const BottomLevelASGenerator& generator, bool allowCompaction = true);
+
+  /// Record the builds of all the BLASes added since the previous call
+  void Build(ID3D12GraphicsCommandList4* commandList);
+
+  /// Record the compaction copies. The command list recorded by Build must
+  /// have completed
+  void Compact(ID3D12GraphicsCommandList4* commandList);
+
+  /// Release the uncompacted structures. The command list recorded by Compact
+  /// must have completed
+  void FinishCompaction();
+
+  /// Storage of the BLAS
+  const BufferAllocation& GetResult(uint32_t index) const { return m_blases[index].result; }
+
+  /// Memory figures of each BLAS, available after Compact. BLASes built
+  /// without compaction report no savings
+  std::vector<BottomLevelASCompaction> GetCompactionReport() const;
+
+  /// Size of the scratch space shared by the last builds
+  UINT64 GetScratchSize() const { return m_scratchSize; }
+
+  /// Release the storage of all the BLASes
+  void Release();
+
+private:
+  struct Blas
+  {
+    BottomLevelASGenerator generator;
+    bool allowCompaction = true;
+    bool built = false;
+    UINT64 scratchSize = 0;
+    UINT64 resultSize = 0;
+    BufferAllocation result;
+    /// Uncompacted result, kept until the compaction copy completes
+    BufferAllocation uncompacted;
+    BottomLevelASCompaction compaction;
+  };
+
+  ID3D12Device5* m_device = nullptr;
+  GpuMemoryAllocator* m_allocator = nullptr;
+  UINT64 m_scratchBudget = 0;
+  UINT64 m_scratchSize = 0;
+  std::vector<Blas> m_blases;
+
+  /// BLASes built by the last Build call, awaiting compaction
+  std::vector<uint32_t> m_pendingCompaction;
+  BufferAllocation m_scratch;
+  /// Compacted sizes written by the builds, and their CPU-readable copy
+  BufferAllocation m_compactedSizes;
+  BufferAllocation m_compactedSizesReadback;
+};
+} // namespace nv_helpers_dx12
@@ -127,8 +127,10 @@ void BottomLevelASGenerator::ComputeASBufferSizes(
                           // allow iterative updates
     UINT64 *scratchSizeInBytes, // Required scratch memory on the GPU to build
                                 // the acceleration structure
-    UINT64 *resultSizeInBytes   // Required GPU memory to store the acceleration
+    UINT64 *resultSizeInBytes,  // Required GPU memory to store the acceleration
                                 // structure
+    bool allowCompaction /* = false */ // If true, the compacted size can be
+                                       // queried after the build
 ) {
   // The generated AS can support iterative updates. This may change the final
   // size of the AS as well as the temporary memory requirements, and hence has
@@ -137,6 +139,10 @@ void BottomLevelASGenerator::ComputeASBufferSizes(
       allowUpdate
           ? D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE
           : D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+  // Compaction similarly needs to be known by the builder beforehand
+  if (allowCompaction) {
+    m_flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+  }
 
   // Describe the work being requested, in this case the construction of a
   // (possibly dynamic) bottom-level hierarchy, with the given vertex buffers
@@ -188,25 +194,47 @@ void BottomLevelASGenerator::Generate(
                                    // structure, used if an iterative update
                                    // is requested
 ) {
+  Generate(commandList, scratchBuffer->GetGPUVirtualAddress(),
+           resultBuffer->GetGPUVirtualAddress(), resultBuffer, updateOnly,
+           previousResult ? previousResult->GetGPUVirtualAddress() : 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Enqueue the construction of the acceleration structure in buffers
+// suballocated from larger resources. The result resource is only used for the
+// UAV barrier, and covers at least the result range
+void BottomLevelASGenerator::Generate(
+    ID3D12GraphicsCommandList4
+        *commandList, // Command list on which the build will be enqueued
+    D3D12_GPU_VIRTUAL_ADDRESS scratchAddress, // Address of the scratch space
+    D3D12_GPU_VIRTUAL_ADDRESS resultAddress,  // Address where the AS is stored
+    ID3D12Resource *resultResource, // Resource containing the result range
+    bool updateOnly,                // If true, simply refit the existing
+                                    // acceleration structure
+    D3D12_GPU_VIRTUAL_ADDRESS previousResult, // Optional address of the
+                                              // previous acceleration
+                                              // structure
+    const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC
+        *postbuildInfo // Optional information emitted after the build
+) {
 
+  const bool allowsUpdate =
+      (m_flags &
+       D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0;
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = m_flags;
   // The stored flags represent whether the AS has been built for updates or
   // not. If yes and an update is requested, the builder is told to only update
   // the AS instead of fully rebuilding it
-  if (flags ==
-          D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE &&
-      updateOnly) {
-    flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+  if (allowsUpdate && updateOnly) {
+    flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
   }
 
   // Sanity checks
-  if (m_flags !=
-          D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE &&
-      updateOnly) {
+  if (!allowsUpdate && updateOnly) {
     throw std::logic_error(
         "Cannot update a bottom-level AS not originally built for updates");
   }
-  if (updateOnly && previousResult == nullptr) {
+  if (updateOnly && previousResult == 0) {
     throw std::logic_error(
         "Bottom-level hierarchy update requires the previous hierarchy");
   }
@@ -223,16 +251,19 @@ void BottomLevelASGenerator::Generate(
   buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
   buildDesc.Inputs.NumDescs = static_cast<UINT>(m_vertexBuffers.size());
   buildDesc.Inputs.pGeometryDescs = m_vertexBuffers.data();
-  buildDesc.DestAccelerationStructureData = {
-      resultBuffer->GetGPUVirtualAddress()};
-  buildDesc.ScratchAccelerationStructureData = {
-      scratchBuffer->GetGPUVirtualAddress()};
-  buildDesc.SourceAccelerationStructureData =
-      previousResult ? previousResult->GetGPUVirtualAddress() : 0;
+  buildDesc.DestAccelerationStructureData = resultAddress;
+  buildDesc.ScratchAccelerationStructureData = scratchAddress;
+  buildDesc.SourceAccelerationStructureData = previousResult;
   buildDesc.Inputs.Flags = flags;
 
   // Build the AS
-  commandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+  commandList->BuildRaytracingAccelerationStructure(
+      &buildDesc, postbuildInfo ? 1 : 0, postbuildInfo);
+
+  // Batched builds are synchronized by the caller
+  if (resultResource == nullptr) {
+    return;
+  }
 
   // Wait for the builder to complete by setting a barrier on the resulting
   // buffer. This is particularly important as the construction of the top-level
@@ -240,7 +271,7 @@ void BottomLevelASGenerator::Generate(
   // list.
   D3D12_RESOURCE_BARRIER uavBarrier;
   uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-  uavBarrier.UAV.pResource = resultBuffer;
+  uavBarrier.UAV.pResource = resultResource;
   uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
   commandList->ResourceBarrier(1, &uavBarrier);
 }
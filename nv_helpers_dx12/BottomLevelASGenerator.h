@@ -136,8 +136,11 @@ public:
                                   /// allow iterative updates
       UINT64* scratchSizeInBytes, /// Required scratch memory on the GPU to
                                   /// build the acceleration structure
-      UINT64* resultSizeInBytes   /// Required GPU memory to store the
+      UINT64* resultSizeInBytes,  /// Required GPU memory to store the
                                   /// acceleration structure
+      bool allowCompaction = false /// If true, the compacted size of the acceleration
+                                   /// structure can be queried after the build, to copy it
+                                   /// into a smaller buffer
   );
 
   /// Enqueue the construction of the acceleration structure on a command list, using
@@ -154,6 +157,23 @@ public:
                                                /// if an iterative update is requested
   );
 
+  /// Same as above, for buffers suballocated from larger resources: the scratch, result and
+  /// previous result are given by their GPU addresses, and the resource containing the result is
+  /// only used to place the UAV barrier waiting for the build. If that resource is nullptr, no
+  /// barrier is placed, so that several builds can be batched before a single barrier
+  void Generate(
+      ID3D12GraphicsCommandList4* commandList, /// Command list on which the build will be enqueued
+      D3D12_GPU_VIRTUAL_ADDRESS scratchAddress, /// Address of the scratch space
+      D3D12_GPU_VIRTUAL_ADDRESS resultAddress,  /// Address where the AS is stored
+      ID3D12Resource* resultResource,           /// Resource containing the result range
+      bool updateOnly = false, /// If true, simply refit the existing acceleration structure
+      D3D12_GPU_VIRTUAL_ADDRESS previousResult = 0, /// Optional address of the previous
+                                                    /// acceleration structure
+      const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC* postbuildInfo =
+          nullptr /// Optional information to emit once the build is done, such as the
+                  /// compacted size
+  );
+
 private:
   /// Vertex buffer descriptors used to generate the AS
   std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> m_vertexBuffers = {};
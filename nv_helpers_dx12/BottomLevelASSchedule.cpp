@@ -0,0 +1,77 @@
+#include "BottomLevelASSchedule.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+uint64_t AlignUp(uint64_t v, uint64_t alignment)
+{
+  return (v + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// First-fit decreasing packing of the scratch sizes in bins of scratchBudget bytes. Packing the
+// largest builds first keeps the number of batches, and hence of barriers, low
+BottomLevelASSchedule ScheduleBottomLevelASBuilds(const std::vector<uint64_t>& scratchSizes,
+                                                  uint64_t scratchBudget,
+                                                  uint64_t alignment /*= 256*/)
+{
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+  {
+    throw std::logic_error("BLAS scratch alignment must be a power of two");
+  }
+
+  BottomLevelASSchedule schedule;
+  schedule.scratchOffsets.resize(scratchSizes.size(), 0);
+
+  std::vector<uint32_t> order(scratchSizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&scratchSizes](uint32_t a, uint32_t b) {
+    return scratchSizes[a] > scratchSizes[b];
+  });
+
+  // Bytes used in each batch so far
+  std::vector<uint64_t> batchSizes;
+  for (uint32_t blas : order)
+  {
+    uint64_t size = AlignUp(scratchSizes[blas], alignment);
+    size_t batch = 0;
+    while (batch < batchSizes.size() && batchSizes[batch] + size > scratchBudget)
+    {
+      batch++;
+    }
+    if (batch == batchSizes.size())
+    {
+      batchSizes.push_back(0);
+      schedule.batches.emplace_back();
+    }
+
+    schedule.scratchOffsets[blas] = batchSizes[batch];
+    schedule.batches[batch].push_back(blas);
+    batchSizes[batch] += size;
+    schedule.scratchSize = std::max(schedule.scratchSize, batchSizes[batch]);
+  }
+
+  return schedule;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+BottomLevelASCompaction ComputeBottomLevelASCompaction(uint64_t originalSize,
+                                                       uint64_t reportedSize,
+                                                       uint64_t alignment /*= 256*/)
+{
+  BottomLevelASCompaction compaction;
+  compaction.originalSize = originalSize;
+  compaction.compactedSize = AlignUp(reportedSize, alignment);
+  return compaction;
+}
+} // namespace nv_helpers_dx12
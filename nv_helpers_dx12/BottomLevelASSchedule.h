@@ -0,0 +1,79 @@
+/*
+Scheduling of batched bottom-level acceleration structure builds.
+
+Building several BLASes one after the other, each with its own scratch buffer,
+both wastes memory and serializes the builds. Instead, the builds are grouped
+in batches sharing one scratch region: the builds of a batch use disjoint
+slices of the region and can run concurrently, and a UAV barrier between two
+batches allows the next one to reuse the region. The region is sized for the
+largest batch, and the batches are filled first-fit by decreasing scratch size
+within a scratch budget. A BLAS whose scratch needs exceed the budget is
+built alone.
+
+The compaction helpers compute the memory saved by copying each BLAS into a
+buffer of its compacted size once the builds are done.
+
+This part only deals with sizes and offsets, and does not depend on any
+device.
+
+Example:
+
+BottomLevelASSchedule schedule =
+    ScheduleBottomLevelASBuilds({scratchSize0, scratchSize1}, 32 * 1024 * 1024);
+scratch = Allocate(schedule.scratchSize);
+for (const auto& batch : schedule.batches)
+{
+  for (uint32_t blas : batch)
+  {
+    Build(blas, scratch + schedule.scratchOffsets[blas]);
+  }
+  UAVBarrier();
+}
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Build order and scratch placement of a set of BLASes
+struct BottomLevelASSchedule
+{
+  /// Offset of the scratch space of each BLAS in the shared scratch region
+  std::vector<uint64_t> scratchOffsets;
+  /// Indices of the BLASes built by each batch
+  std::vector<std::vector<uint32_t>> batches;
+  /// Size of the shared scratch region, fitting the largest batch
+  uint64_t scratchSize = 0;
+};
+
+/// Group the builds in batches whose aligned scratch sizes add up to at most
+/// scratchBudget. The alignment must be a power of two
+BottomLevelASSchedule ScheduleBottomLevelASBuilds(const std::vector<uint64_t>& scratchSizes,
+                                                  uint64_t scratchBudget,
+                                                  uint64_t alignment = 256);
+
+/// Memory figures of a compacted BLAS
+struct BottomLevelASCompaction
+{
+  /// Size of the buffer the BLAS was built in
+  uint64_t originalSize = 0;
+  /// Size of the buffer holding the compacted BLAS
+  uint64_t compactedSize = 0;
+
+  uint64_t SavedBytes() const
+  {
+    return originalSize > compactedSize ? originalSize - compactedSize : 0;
+  }
+};
+
+/// Figures of a BLAS built in originalSize bytes, whose compacted size
+/// reported by the builder is reportedSize, once aligned for storage
+BottomLevelASCompaction ComputeBottomLevelASCompaction(uint64_t originalSize,
+                                                       uint64_t reportedSize,
+                                                       uint64_t alignment = 256);
+} // namespace nv_helpers_dx12
@@ -0,0 +1,163 @@
+#include "BuddyAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+bool IsPowerOf2(uint64_t v)
+{
+  return v != 0 && (v & (v - 1)) == 0;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create an allocator for [0, capacity), initially made of a single free block
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize /*= 256*/)
+    : m_capacity(capacity), m_minBlockSize(minBlockSize), m_maxOrder(0)
+{
+  if (!IsPowerOf2(capacity) || !IsPowerOf2(minBlockSize) || minBlockSize > capacity)
+  {
+    throw std::logic_error("Buddy allocator sizes must be powers of two, with the minimum block "
+                           "size not exceeding the capacity");
+  }
+
+  while (BlockSize(m_maxOrder) < m_capacity)
+  {
+    m_maxOrder++;
+  }
+  m_freeBlocks.resize(m_maxOrder + 1);
+  m_freeBlocks[m_maxOrder].insert(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Smallest order whose blocks can hold size bytes
+uint32_t BuddyAllocator::OrderForSize(uint64_t size) const
+{
+  uint32_t order = 0;
+  while (order <= m_maxOrder && BlockSize(order) < size)
+  {
+    order++;
+  }
+  return order <= m_maxOrder ? order : UINT32_MAX;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Find the smallest free block fitting the request, and split it down to the required order. The
+// upper halves of the split blocks are returned to the free lists
+bool BuddyAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+  if (alignment != 0 && !IsPowerOf2(alignment))
+  {
+    throw std::logic_error("Buddy allocator alignments must be powers of two");
+  }
+
+  // Blocks are aligned on their own size, so an alignment requirement is
+  // simply a lower bound on the block size
+  uint64_t blockBytes = size > alignment ? size : alignment;
+  uint32_t order = OrderForSize(blockBytes == 0 ? 1 : blockBytes);
+  if (order == UINT32_MAX)
+  {
+    return false;
+  }
+
+  uint32_t freeOrder = order;
+  while (freeOrder <= m_maxOrder && m_freeBlocks[freeOrder].empty())
+  {
+    freeOrder++;
+  }
+  if (freeOrder > m_maxOrder)
+  {
+    return false;
+  }
+
+  uint64_t blockOffset = *m_freeBlocks[freeOrder].begin();
+  m_freeBlocks[freeOrder].erase(m_freeBlocks[freeOrder].begin());
+
+  while (freeOrder > order)
+  {
+    freeOrder--;
+    m_freeBlocks[freeOrder].insert(blockOffset + BlockSize(freeOrder));
+  }
+
+  m_allocated[blockOffset] = {order, size};
+  m_allocatedBytes += BlockSize(order);
+  m_requestedBytes += size;
+
+  *offset = blockOffset;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return a block to the free lists, merging it with its buddy for as long as the buddy is free
+void BuddyAllocator::Free(uint64_t offset)
+{
+  auto it = m_allocated.find(offset);
+  if (it == m_allocated.end())
+  {
+    throw std::logic_error("Freeing an offset not allocated by this buddy allocator");
+  }
+
+  uint32_t order = it->second.order;
+  m_allocatedBytes -= BlockSize(order);
+  m_requestedBytes -= it->second.requestedSize;
+  m_allocated.erase(it);
+
+  uint64_t blockOffset = offset;
+  while (order < m_maxOrder)
+  {
+    uint64_t buddy = blockOffset ^ BlockSize(order);
+    auto buddyIt = m_freeBlocks[order].find(buddy);
+    if (buddyIt == m_freeBlocks[order].end())
+    {
+      break;
+    }
+    m_freeBlocks[order].erase(buddyIt);
+    blockOffset = blockOffset < buddy ? blockOffset : buddy;
+    order++;
+  }
+  m_freeBlocks[order].insert(blockOffset);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release all the allocations at once
+void BuddyAllocator::Reset()
+{
+  for (auto& freeList : m_freeBlocks)
+  {
+    freeList.clear();
+  }
+  m_freeBlocks[m_maxOrder].insert(0);
+  m_allocated.clear();
+  m_allocatedBytes = 0;
+  m_requestedBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+BuddyAllocator::Statistics BuddyAllocator::GetStatistics() const
+{
+  Statistics stats;
+  stats.capacity = m_capacity;
+  stats.allocatedBytes = m_allocatedBytes;
+  stats.requestedBytes = m_requestedBytes;
+  stats.allocationCount = m_allocated.size();
+  for (uint32_t order = 0; order <= m_maxOrder; order++)
+  {
+    stats.freeBlockCount += m_freeBlocks[order].size();
+    if (!m_freeBlocks[order].empty())
+    {
+      stats.largestFreeBlock = BlockSize(order);
+    }
+  }
+  return stats;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,114 @@
+/*
+The buddy allocator manages a range of offsets [0, capacity) without touching
+any memory itself, so it can back GPU heaps, descriptor ranges, or be exercised
+on its own without a device.
+
+The range is recursively split into power-of-two blocks. An allocation is
+served by the smallest free block that fits the request, splitting larger
+blocks as needed. Since a block of size 2^n always starts on a multiple of
+2^n, alignments up to the block size come for free. On release, a block is
+merged with its buddy as long as the buddy is free as well.
+
+Example:
+
+BuddyAllocator allocator(16 * 1024 * 1024, 256);
+uint64_t offset;
+if (allocator.Allocate(1000, 256, &offset))
+{
+  ...
+  allocator.Free(offset);
+}
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Power-of-two block allocator working on offsets only
+class BuddyAllocator
+{
+public:
+  /// Usage and fragmentation figures of the allocator
+  struct Statistics
+  {
+    /// Size of the managed range
+    uint64_t capacity = 0;
+    /// Sum of the sizes of the blocks currently handed out
+    uint64_t allocatedBytes = 0;
+    /// Sum of the sizes actually requested by the callers
+    uint64_t requestedBytes = 0;
+    /// Number of live allocations
+    uint64_t allocationCount = 0;
+    /// Number of free blocks, all sizes included
+    uint64_t freeBlockCount = 0;
+    /// Size of the largest allocation that can currently succeed
+    uint64_t largestFreeBlock = 0;
+
+    /// Bytes lost to power-of-two rounding
+    uint64_t InternalWaste() const { return allocatedBytes - requestedBytes; }
+    /// 0 when all the free memory is a single block, close to 1 when it is
+    /// scattered in small blocks
+    double Fragmentation() const
+    {
+      uint64_t freeBytes = capacity - allocatedBytes;
+      return freeBytes == 0 ? 0.0 : 1.0 - double(largestFreeBlock) / double(freeBytes);
+    }
+  };
+
+  /// Create an allocator for [0, capacity). Both the capacity and the minimum
+  /// block size must be powers of two
+  BuddyAllocator(uint64_t capacity, uint64_t minBlockSize = 256);
+
+  /// Allocate size bytes aligned on alignment (power of two, or 0 for the
+  /// minimum block size). Returns false if no block large enough is free
+  bool Allocate(uint64_t size, uint64_t alignment, uint64_t* offset);
+
+  /// Release a block previously returned by Allocate
+  void Free(uint64_t offset);
+
+  /// Release all the allocations at once
+  void Reset();
+
+  /// True if no allocation is live
+  bool IsEmpty() const { return m_allocated.empty(); }
+
+  uint64_t GetCapacity() const { return m_capacity; }
+  uint64_t GetMinBlockSize() const { return m_minBlockSize; }
+
+  Statistics GetStatistics() const;
+
+private:
+  /// Bookkeeping of a live allocation
+  struct Block
+  {
+    uint32_t order;
+    uint64_t requestedSize;
+  };
+
+  /// Size of a block of the given order
+  uint64_t BlockSize(uint32_t order) const { return m_minBlockSize << order; }
+
+  /// Smallest order whose blocks can hold size bytes, or UINT32_MAX if none
+  uint32_t OrderForSize(uint64_t size) const;
+
+  uint64_t m_capacity;
+  uint64_t m_minBlockSize;
+  uint32_t m_maxOrder;
+
+  /// For each order, the offsets of the free blocks. Sets keep the lowest
+  /// offsets first, which packs the allocations at the start of the range
+  std::vector<std::set<uint64_t>> m_freeBlocks;
+  /// Live allocations, indexed by offset
+  std::unordered_map<uint64_t, Block> m_allocated;
+
+  uint64_t m_allocatedBytes = 0;
+  uint64_t m_requestedBytes = 0;
+};
+} // namespace nv_helpers_dx12
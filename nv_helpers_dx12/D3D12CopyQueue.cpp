@@ -0,0 +1,153 @@
+#include "D3D12CopyQueue.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+D3D12CopyQueue::~D3D12CopyQueue()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the copy queue, its command list and its fence
+void D3D12CopyQueue::Init(ID3D12Device* device)
+{
+  m_device = device;
+
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+  queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  if (FAILED(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue))))
+  {
+    throw std::logic_error("Could not create the copy queue");
+  }
+
+  if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    throw std::logic_error("Could not create the copy queue fence");
+  }
+  m_fenceValue = 0;
+
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr)
+  {
+    throw std::logic_error("Could not create the copy queue fence event");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12CopyQueue::Release()
+{
+  if (m_queue)
+  {
+    WaitForValue(m_fenceValue);
+  }
+  m_allocators.clear();
+  m_recordingAllocator = SIZE_MAX;
+  m_commandList.Reset();
+  m_fence.Reset();
+  m_queue.Reset();
+  if (m_fenceEvent != nullptr)
+  {
+    CloseHandle(m_fenceEvent);
+    m_fenceEvent = nullptr;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start recording on the first copy after a submission, using an allocator the GPU is done with
+void D3D12CopyQueue::CopyBufferRegion(ID3D12Resource* dest, UINT64 destOffset,
+                                      ID3D12Resource* source, UINT64 sourceOffset, UINT64 size)
+{
+  if (m_recordingAllocator == SIZE_MAX)
+  {
+    UINT64 completed = m_fence->GetCompletedValue();
+    for (size_t i = 0; i < m_allocators.size(); i++)
+    {
+      if (m_allocators[i].fenceValue <= completed)
+      {
+        m_recordingAllocator = i;
+        break;
+      }
+    }
+    if (m_recordingAllocator == SIZE_MAX)
+    {
+      Allocator allocator;
+      if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+                                                  IID_PPV_ARGS(&allocator.allocator))))
+      {
+        throw std::logic_error("Could not create a copy command allocator");
+      }
+      m_allocators.push_back(allocator);
+      m_recordingAllocator = m_allocators.size() - 1;
+    }
+
+    ID3D12CommandAllocator* allocator = m_allocators[m_recordingAllocator].allocator.Get();
+    allocator->Reset();
+    if (!m_commandList)
+    {
+      if (FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocator, nullptr,
+                                             IID_PPV_ARGS(&m_commandList))))
+      {
+        throw std::logic_error("Could not create the copy command list");
+      }
+    }
+    else
+    {
+      m_commandList->Reset(allocator, nullptr);
+    }
+  }
+
+  m_commandList->CopyBufferRegion(dest, destOffset, source, sourceOffset, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+UINT64 D3D12CopyQueue::Submit()
+{
+  if (m_recordingAllocator == SIZE_MAX)
+  {
+    return m_fenceValue;
+  }
+
+  m_commandList->Close();
+  ID3D12CommandList* commandLists[] = {m_commandList.Get()};
+  m_queue->ExecuteCommandLists(1, commandLists);
+  m_fenceValue++;
+  m_queue->Signal(m_fence.Get(), m_fenceValue);
+
+  m_allocators[m_recordingAllocator].fenceValue = m_fenceValue;
+  m_recordingAllocator = SIZE_MAX;
+  return m_fenceValue;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+UINT64 D3D12CopyQueue::GetCompletedValue()
+{
+  return m_fence->GetCompletedValue();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12CopyQueue::WaitForValue(UINT64 fenceValue)
+{
+  if (m_fence->GetCompletedValue() < fenceValue)
+  {
+    m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent);
+    WaitForSingleObject(m_fenceEvent, INFINITE);
+  }
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,69 @@
+/*
+Copy queue of the staging uploader backed by a D3D12 command queue of type
+COPY. The copies are recorded in a command list, and each submission signals a
+fence the consumer queues wait on. Command allocators are recycled once the
+fence passes their last submission.
+
+Example:
+
+D3D12CopyQueue copyQueue;
+copyQueue.Init(device);
+StagingUploader uploader;
+uploader.Init(&copyQueue, ring);
+...
+commandQueue->Wait(copyQueue.GetFence(), uploader.Flush());
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <wrl/client.h>
+
+#include <vector>
+
+#include "StagingUploader.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Copy queue backed by a D3D12 command queue of type COPY
+class D3D12CopyQueue : public CopyQueue
+{
+public:
+  ~D3D12CopyQueue() override;
+
+  void Init(ID3D12Device* device);
+  /// Wait for all the submissions to complete and release the queue
+  void Release();
+
+  void CopyBufferRegion(ID3D12Resource* dest, UINT64 destOffset, ID3D12Resource* source,
+                        UINT64 sourceOffset, UINT64 size) override;
+  UINT64 Submit() override;
+  UINT64 GetCompletedValue() override;
+  void WaitForValue(UINT64 fenceValue) override;
+
+  ID3D12CommandQueue* GetQueue() const { return m_queue.Get(); }
+  /// Fence signaled by the submissions, for other queues to wait on
+  ID3D12Fence* GetFence() const { return m_fence.Get(); }
+
+private:
+  /// Command allocator, reusable once the fence reaches the value of its last submission
+  struct Allocator
+  {
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+    UINT64 fenceValue = 0;
+  };
+
+  ID3D12Device* m_device = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_commandList;
+  Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+  HANDLE m_fenceEvent = nullptr;
+  UINT64 m_fenceValue = 0;
+  std::vector<Allocator> m_allocators;
+  /// Index of the allocator the command list is recording into, if any
+  size_t m_recordingAllocator = SIZE_MAX;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,107 @@
+#include "DescriptorHeapAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the heap covering the persistent region followed by one region per frame in flight
+void DescriptorHeapAllocator::Init(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                   UINT persistentCount, UINT frameCount, UINT perFrameCount)
+{
+  if (type != D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV && type != D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER)
+  {
+    throw std::logic_error("Only CBV/SRV/UAV and sampler heaps can be shader visible");
+  }
+
+  D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+  desc.NumDescriptors = persistentCount + frameCount * perFrameCount;
+  desc.Type = type;
+  desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+  if (FAILED(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_heap))))
+  {
+    throw std::logic_error("Could not create the descriptor heap");
+  }
+
+  m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+  m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+  m_increment = device->GetDescriptorHandleIncrementSize(type);
+  m_slots = DescriptorSlotAllocator(persistentCount, frameCount, perFrameCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+DescriptorRange DescriptorHeapAllocator::MakeRange(UINT start, UINT count, bool transient) const
+{
+  DescriptorRange range;
+  range.start = start;
+  range.count = count;
+  range.increment = m_increment;
+  range.cpuHandle = {m_cpuStart.ptr + static_cast<SIZE_T>(start) * m_increment};
+  range.gpuHandle = {m_gpuStart.ptr + static_cast<UINT64>(start) * m_increment};
+  range.transient = transient;
+  return range;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+DescriptorRange DescriptorHeapAllocator::AllocatePersistent(UINT count)
+{
+  uint64_t start = 0;
+  if (!m_slots.AllocatePersistent(count, &start))
+  {
+    throw std::logic_error("Out of persistent descriptors");
+  }
+  return MakeRange(static_cast<UINT>(start), count, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorHeapAllocator::Free(DescriptorRange& range)
+{
+  if (!range.IsValid())
+  {
+    return;
+  }
+  if (!range.transient)
+  {
+    m_slots.FreePersistent(range.start, range.count);
+  }
+  range = DescriptorRange();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorHeapAllocator::BeginFrame(UINT frameIndex)
+{
+  m_slots.BeginFrame(frameIndex);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Per-frame ranges are taken from the slice of the current frame
+DescriptorRange DescriptorHeapAllocator::AllocateTransient(UINT count)
+{
+  uint64_t start = 0;
+  if (!m_slots.AllocateTransient(count, &start))
+  {
+    throw std::logic_error("Out of per-frame descriptors");
+  }
+  return MakeRange(static_cast<UINT>(start), count, true);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorHeapAllocator::Release()
+{
+  m_heap.Reset();
+  m_slots = DescriptorSlotAllocator(0, 0, 0);
+}
+} // namespace nv_helpers_dx12
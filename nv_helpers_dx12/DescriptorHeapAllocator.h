@@ -0,0 +1,111 @@
+/*
+The descriptor heap allocator manages a single shader-visible descriptor heap,
+so that all the descriptors used by the shaders are reachable without ever
+switching heaps, which is costly on some hardware.
+
+The heap is split in two regions:
+- Persistent ranges, for descriptors living across frames (output UAV, TLAS,
+  camera, per-instance resources). They are allocated and freed in any order
+  with a first-fit range allocator
+- Per-frame ranges, for descriptors written every frame. Each frame in flight
+  owns a slice of the heap, handed out linearly and reset in BeginFrame
+The slot bookkeeping is done by DescriptorSlotAllocator, which does not depend
+on the device.
+
+A range is a set of consecutive descriptors, which can be bound at once as a
+descriptor table: the offsets of the root signature heap ranges are relative
+to the start of the range.
+
+Example:
+
+DescriptorHeapAllocator descriptors;
+descriptors.Init(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096, FrameCount, 1024);
+DescriptorRange range = descriptors.AllocatePersistent(3);
+device->CreateUnorderedAccessView(output, nullptr, &uavDesc, range.CpuHandle(0));
+...
+descriptors.BeginFrame(frameIndex);
+commandList->SetDescriptorHeaps(1, descriptors.GetHeapAddress());
+commandList->SetGraphicsRootDescriptorTable(0, range.GpuHandle(0));
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <wrl/client.h>
+
+#include <vector>
+
+#include "DescriptorSlotAllocator.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Consecutive descriptors of a heap
+struct DescriptorRange
+{
+  /// Index of the first descriptor in the heap
+  UINT start = 0;
+  UINT count = 0;
+  D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = {};
+  /// Size of a descriptor in the heap
+  UINT increment = 0;
+  bool transient = false;
+
+  bool IsValid() const { return count != 0; }
+
+  D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index) const
+  {
+    return {cpuHandle.ptr + static_cast<SIZE_T>(index) * increment};
+  }
+  D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index) const
+  {
+    return {gpuHandle.ptr + static_cast<UINT64>(index) * increment};
+  }
+};
+
+/// Allocator of persistent and per-frame ranges in one shader-visible heap
+class DescriptorHeapAllocator
+{
+public:
+  /// Create the heap, with persistentCount descriptors for persistent ranges,
+  /// and perFrameCount descriptors for each of the frameCount frames in flight
+  void Init(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT persistentCount,
+            UINT frameCount, UINT perFrameCount);
+
+  /// Allocate a range living until it is freed
+  DescriptorRange AllocatePersistent(UINT count);
+
+  /// Release a persistent range. Per-frame ranges are ignored, as they are
+  /// reclaimed by BeginFrame. The range is reset on return
+  void Free(DescriptorRange& range);
+
+  /// Start recording a frame: the per-frame ranges of that frame are reset,
+  /// hence the GPU must be done with the previous use of frameIndex
+  void BeginFrame(UINT frameIndex);
+
+  /// Allocate a range valid until the current frame index comes back in
+  /// BeginFrame
+  DescriptorRange AllocateTransient(UINT count);
+
+  ID3D12DescriptorHeap* GetHeap() const { return m_heap.Get(); }
+  /// Address of the heap pointer, for SetDescriptorHeaps
+  ID3D12DescriptorHeap* const* GetHeapAddress() const { return m_heap.GetAddressOf(); }
+
+  /// Number of persistent descriptors in use
+  UINT GetPersistentUsage() const { return static_cast<UINT>(m_slots.GetPersistentUsage()); }
+
+  void Release();
+
+private:
+  DescriptorRange MakeRange(UINT start, UINT count, bool transient) const;
+
+  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap;
+  D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart = {};
+  UINT m_increment = 0;
+  DescriptorSlotAllocator m_slots{0, 0, 0};
+};
+} // namespace nv_helpers_dx12
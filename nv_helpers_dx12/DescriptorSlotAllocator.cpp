@@ -0,0 +1,86 @@
+#include "DescriptorSlotAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+DescriptorSlotAllocator::DescriptorSlotAllocator(uint64_t persistentCount, uint32_t frameCount,
+                                                 uint64_t perFrameCount)
+    : m_persistentCount(persistentCount), m_perFrameCount(perFrameCount),
+      m_persistent(persistentCount), m_frames(frameCount, LinearAllocator(perFrameCount))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool DescriptorSlotAllocator::AllocatePersistent(uint64_t count, uint64_t* start)
+{
+  return m_persistent.Allocate(count, start);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorSlotAllocator::FreePersistent(uint64_t start, uint64_t count)
+{
+  m_persistent.Free(start, count);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorSlotAllocator::BeginFrame(uint32_t frameIndex)
+{
+  if (frameIndex >= m_frames.size())
+  {
+    throw std::logic_error("Frame index exceeds the number of frames in flight");
+  }
+  m_frameIndex = frameIndex;
+  m_frames[frameIndex].Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Per-frame ranges are taken from the slice of the current frame, located after the persistent
+// region and the slices of the previous frames
+bool DescriptorSlotAllocator::AllocateTransient(uint64_t count, uint64_t* start)
+{
+  if (m_frames.empty())
+  {
+    throw std::logic_error("No frame in flight to allocate per-frame slots from");
+  }
+  uint64_t offset = 0;
+  if (!m_frames[m_frameIndex].Allocate(count, 0, &offset))
+  {
+    return false;
+  }
+  *start = m_persistentCount + m_frameIndex * m_perFrameCount + offset;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorSlotAllocator::Reset()
+{
+  m_persistent.Reset();
+  for (LinearAllocator& frame : m_frames)
+  {
+    frame.Reset();
+  }
+  m_frameIndex = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t DescriptorSlotAllocator::GetSlotCount() const
+{
+  return m_persistentCount + m_frames.size() * m_perFrameCount;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,67 @@
+/*
+Slot bookkeeping of the descriptor heap allocator (see
+DescriptorHeapAllocator.h), which only deals with descriptor indices and does
+not depend on any device.
+
+The slots [0, persistentCount) hold the persistent ranges, allocated first-fit
+and freed in any order. They are followed by one slice of perFrameCount slots
+per frame in flight, from which the per-frame ranges of the current frame are
+handed out linearly. BeginFrame resets the slice of the frame it starts.
+
+Example:
+
+DescriptorSlotAllocator slots(4096, FrameCount, 1024);
+uint64_t start;
+slots.AllocatePersistent(3, &start);
+...
+slots.BeginFrame(frameIndex);
+slots.AllocateTransient(8, &start);
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "LinearAllocator.h"
+#include "RangeAllocator.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Allocator of persistent and per-frame ranges of descriptor indices
+class DescriptorSlotAllocator
+{
+public:
+  DescriptorSlotAllocator(uint64_t persistentCount, uint32_t frameCount, uint64_t perFrameCount);
+
+  /// Allocate count persistent slots. Returns false if no free range is large
+  /// enough
+  bool AllocatePersistent(uint64_t count, uint64_t* start);
+  /// Release a range returned by AllocatePersistent
+  void FreePersistent(uint64_t start, uint64_t count);
+
+  /// Start a frame, resetting the slice of frameIndex
+  void BeginFrame(uint32_t frameIndex);
+  /// Allocate count slots valid until the current frame index comes back in
+  /// BeginFrame. Returns false if the slice of the frame is full
+  bool AllocateTransient(uint64_t count, uint64_t* start);
+
+  /// Release all the ranges, persistent and per-frame
+  void Reset();
+
+  /// Total number of slots, persistent and per-frame
+  uint64_t GetSlotCount() const;
+  /// Number of persistent slots in use
+  uint64_t GetPersistentUsage() const { return m_persistent.GetAllocatedCount(); }
+
+private:
+  uint64_t m_persistentCount;
+  uint64_t m_perFrameCount;
+  uint32_t m_frameIndex = 0;
+  RangeAllocator m_persistent;
+  /// Slots of each frame in flight, placed after the persistent region
+  std::vector<LinearAllocator> m_frames;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,327 @@
+#include "GpuMemoryAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+// Smallest allocation granularity, matching the placement alignment of
+// constant buffers and acceleration structures
+const UINT64 kMinAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+UINT64 NextPowerOf2(UINT64 v)
+{
+  UINT64 p = 1;
+  while (p < v)
+  {
+    p <<= 1;
+  }
+  return p;
+}
+
+UINT64 ClampAlignment(UINT64 alignment)
+{
+  return alignment < kMinAlignment ? kMinAlignment : alignment;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Prepare the allocator. No memory is reserved until the first allocation of each pool
+void GpuMemoryAllocator::Init(ID3D12Device* device, UINT frameCount,
+                              UINT64 blockSize /*= 16 * 1024 * 1024*/,
+                              UINT64 arenaSize /*= 4 * 1024 * 1024*/)
+{
+  m_device = device;
+  // Heaps are created with the default 64KB placement alignment, which also
+  // has to be a divisor of their size
+  m_blockSize = NextPowerOf2(blockSize < D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+                                 ? D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+                                 : blockSize);
+  m_arenaSize = NextPowerOf2(arenaSize < D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+                                 ? D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+                                 : arenaSize);
+  m_frameIndex = 0;
+  for (auto& pool : m_pools)
+  {
+    pool.arenas.resize(frameCount);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create a heap and a placed buffer covering it. The heap type, resource flags and initial state
+// all derive from the usage
+void GpuMemoryAllocator::CreateHeapBuffer(BufferUsage usage, UINT64 size,
+                                          Microsoft::WRL::ComPtr<ID3D12Heap>& heap,
+                                          Microsoft::WRL::ComPtr<ID3D12Resource>& buffer,
+                                          uint8_t** cpuAddress)
+{
+  D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT;
+  D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+  D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+  switch (usage)
+  {
+  case BufferUsage::Upload:
+    heapType = D3D12_HEAP_TYPE_UPLOAD;
+    state = D3D12_RESOURCE_STATE_GENERIC_READ;
+    break;
+  case BufferUsage::Default:
+    // Buffers are implicitly promoted from the common state to the copy
+    // destination or any read state, and decay back to it once a command list
+    // has been executed, so no explicit transition is needed on any queue
+    state = D3D12_RESOURCE_STATE_COMMON;
+    break;
+  case BufferUsage::UnorderedAccess:
+    flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    break;
+  case BufferUsage::AccelerationStructure:
+    flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    state = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
+    break;
+  case BufferUsage::Readback:
+    heapType = D3D12_HEAP_TYPE_READBACK;
+    state = D3D12_RESOURCE_STATE_COPY_DEST;
+    break;
+  default:
+    throw std::logic_error("Unknown buffer usage");
+  }
+
+  D3D12_HEAP_DESC heapDesc = {};
+  heapDesc.SizeInBytes = size;
+  heapDesc.Properties.Type = heapType;
+  heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+  heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+  heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+  heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+  if (FAILED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap))))
+  {
+    throw std::logic_error("Could not create a buffer heap");
+  }
+
+  D3D12_RESOURCE_DESC bufDesc = {};
+  bufDesc.Alignment = 0;
+  bufDesc.DepthOrArraySize = 1;
+  bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  bufDesc.Flags = flags;
+  bufDesc.Format = DXGI_FORMAT_UNKNOWN;
+  bufDesc.Height = 1;
+  bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  bufDesc.MipLevels = 1;
+  bufDesc.SampleDesc.Count = 1;
+  bufDesc.SampleDesc.Quality = 0;
+  bufDesc.Width = size;
+  if (FAILED(m_device->CreatePlacedResource(heap.Get(), 0, &bufDesc, state, nullptr,
+                                            IID_PPV_ARGS(&buffer))))
+  {
+    throw std::logic_error("Could not create a placed buffer");
+  }
+
+  *cpuAddress = nullptr;
+  if (usage == BufferUsage::Upload || usage == BufferUsage::Readback)
+  {
+    // Upload and readback heaps stay mapped for their whole lifetime. Only
+    // readback heaps are read by the CPU
+    D3D12_RANGE readRange = {0, 0};
+    if (FAILED(buffer->Map(0, usage == BufferUsage::Readback ? nullptr : &readRange,
+                           reinterpret_cast<void**>(cpuAddress))))
+    {
+      throw std::logic_error("Could not map a CPU-visible heap");
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Find a block with enough free space for the request, or create a new one. Requests larger than
+// the block size get a dedicated block
+BufferAllocation GpuMemoryAllocator::Allocate(BufferUsage usage, UINT64 size,
+                                              UINT64 alignment /*= 0*/)
+{
+  if (m_device == nullptr)
+  {
+    throw std::logic_error("GpuMemoryAllocator::Init needs to be called before allocating");
+  }
+  alignment = ClampAlignment(alignment);
+  Pool& pool = GetPool(usage);
+
+  uint64_t offset = 0;
+  uint32_t blockIndex = UINT32_MAX;
+  for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()); i++)
+  {
+    if (pool.blocks[i].allocator->Allocate(size, alignment, &offset))
+    {
+      blockIndex = i;
+      break;
+    }
+  }
+
+  if (blockIndex == UINT32_MAX)
+  {
+    UINT64 blockSize = size > m_blockSize ? NextPowerOf2(size) : m_blockSize;
+    Block block;
+    CreateHeapBuffer(usage, blockSize, block.heap, block.buffer, &block.cpuAddress);
+    block.allocator = std::make_unique<BuddyAllocator>(blockSize, kMinAlignment);
+    if (!block.allocator->Allocate(size, alignment, &offset))
+    {
+      throw std::logic_error("Allocation does not fit in a fresh heap block");
+    }
+    blockIndex = static_cast<uint32_t>(pool.blocks.size());
+    pool.blocks.push_back(std::move(block));
+  }
+
+  const Block& block = pool.blocks[blockIndex];
+  BufferAllocation allocation;
+  allocation.resource = block.buffer.Get();
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.gpuAddress = block.buffer->GetGPUVirtualAddress() + offset;
+  allocation.cpuAddress = block.cpuAddress ? block.cpuAddress + offset : nullptr;
+  allocation.usage = usage;
+  allocation.blockIndex = blockIndex;
+  allocation.transient = false;
+  return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return a long-lived range to its block. Empty blocks are kept, as they are likely to be reused
+void GpuMemoryAllocator::Free(BufferAllocation& allocation)
+{
+  if (!allocation.IsValid())
+  {
+    return;
+  }
+  if (!allocation.transient)
+  {
+    Pool& pool = GetPool(allocation.usage);
+    if (allocation.blockIndex >= pool.blocks.size())
+    {
+      throw std::logic_error("Freeing an allocation not owned by this allocator");
+    }
+    pool.blocks[allocation.blockIndex].allocator->Free(allocation.offset);
+  }
+  allocation = BufferAllocation();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Reset the arenas of the frame about to be recorded
+void GpuMemoryAllocator::BeginFrame(UINT frameIndex)
+{
+  m_frameIndex = frameIndex;
+  for (auto& pool : m_pools)
+  {
+    if (frameIndex >= pool.arenas.size())
+    {
+      throw std::logic_error("Frame index exceeds the number of frames in flight");
+    }
+    for (auto& chunk : pool.arenas[frameIndex])
+    {
+      chunk.allocator.Reset();
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Bump-allocate from the arena of the current frame, adding a chunk if the arena is full
+BufferAllocation GpuMemoryAllocator::AllocateTransient(BufferUsage usage, UINT64 size,
+                                                       UINT64 alignment /*= 0*/)
+{
+  if (m_device == nullptr)
+  {
+    throw std::logic_error("GpuMemoryAllocator::Init needs to be called before allocating");
+  }
+  alignment = ClampAlignment(alignment);
+  std::vector<ArenaChunk>& arena = GetPool(usage).arenas[m_frameIndex];
+
+  uint64_t offset = 0;
+  ArenaChunk* chunk = nullptr;
+  for (auto& c : arena)
+  {
+    if (c.allocator.Allocate(size, alignment, &offset))
+    {
+      chunk = &c;
+      break;
+    }
+  }
+
+  if (chunk == nullptr)
+  {
+    UINT64 chunkSize = size > m_arenaSize ? NextPowerOf2(size) : m_arenaSize;
+    ArenaChunk newChunk{nullptr, nullptr, nullptr, LinearAllocator(chunkSize)};
+    CreateHeapBuffer(usage, chunkSize, newChunk.heap, newChunk.buffer, &newChunk.cpuAddress);
+    newChunk.allocator.Allocate(size, alignment, &offset);
+    arena.push_back(std::move(newChunk));
+    chunk = &arena.back();
+  }
+
+  BufferAllocation allocation;
+  allocation.resource = chunk->buffer.Get();
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.gpuAddress = chunk->buffer->GetGPUVirtualAddress() + offset;
+  allocation.cpuAddress = chunk->cpuAddress ? chunk->cpuAddress + offset : nullptr;
+  allocation.usage = usage;
+  allocation.transient = true;
+  return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Aggregate the block and arena figures of each pool
+GpuMemoryAllocator::Statistics GpuMemoryAllocator::GetStatistics() const
+{
+  Statistics stats;
+  for (uint32_t p = 0; p < static_cast<uint32_t>(BufferUsage::Count); p++)
+  {
+    PoolStatistics& poolStats = stats.pools[p];
+    const Pool& pool = m_pools[p];
+    poolStats.blockCount = static_cast<uint32_t>(pool.blocks.size());
+    for (const auto& block : pool.blocks)
+    {
+      BuddyAllocator::Statistics blockStats = block.allocator->GetStatistics();
+      poolStats.blocks.capacity += blockStats.capacity;
+      poolStats.blocks.allocatedBytes += blockStats.allocatedBytes;
+      poolStats.blocks.requestedBytes += blockStats.requestedBytes;
+      poolStats.blocks.allocationCount += blockStats.allocationCount;
+      poolStats.blocks.freeBlockCount += blockStats.freeBlockCount;
+      if (blockStats.largestFreeBlock > poolStats.blocks.largestFreeBlock)
+      {
+        poolStats.blocks.largestFreeBlock = blockStats.largestFreeBlock;
+      }
+    }
+    for (const auto& arena : pool.arenas)
+    {
+      uint64_t framePeak = 0;
+      for (const auto& chunk : arena)
+      {
+        poolStats.transientCapacity += chunk.allocator.GetCapacity();
+        framePeak += chunk.allocator.GetPeakBytes();
+      }
+      poolStats.transientPeak = framePeak > poolStats.transientPeak ? framePeak
+                                                                     : poolStats.transientPeak;
+    }
+  }
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void GpuMemoryAllocator::Release()
+{
+  for (auto& pool : m_pools)
+  {
+    pool.blocks.clear();
+    for (auto& arena : pool.arenas)
+    {
+      arena.clear();
+    }
+  }
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,181 @@
+/*
+The GPU memory allocator replaces the one-committed-resource-per-buffer scheme
+of CreateBuffer by suballocating buffers from a few large heaps.
+
+Buffers are grouped in pools by usage, as the usage determines the heap type,
+the resource flags and the resource state, which are shared by everything
+living in a heap:
+- Upload: CPU-writable, persistently mapped (constants, SBT, staging data)
+- Default: GPU-only, read-only after initialization (static geometry)
+- UnorderedAccess: GPU-only scratch space for acceleration structure builds
+- AccelerationStructure: storage of the built acceleration structures
+- Readback: CPU-readable, persistently mapped destination of GPU copies
+
+Each pool is a list of blocks, each block being an ID3D12Heap covered by a
+single placed buffer resource. Long-lived allocations are carved out of the
+blocks by a buddy allocator. Transient allocations are served by per-frame
+linear arenas, which are reset when the frame comes back around, and never
+need to be freed individually.
+
+An allocation is identified by the buffer resource of its block, an offset in
+that resource, and the corresponding GPU (and for upload buffers, CPU)
+addresses. The helpers of this library accept either a resource with an
+offset (AddVertexBuffer) or GPU addresses, so allocations can be used directly.
+
+All allocations are aligned on at least 256 bytes, which satisfies the
+constant buffer, acceleration structure, shader table and instance descriptor
+placement rules.
+
+Example:
+
+GpuMemoryAllocator allocator;
+allocator.Init(device, FrameCount);
+
+BufferAllocation cb = allocator.Allocate(BufferUsage::Upload, sizeof(Constants));
+memcpy(cb.cpuAddress, &constants, sizeof(Constants));
+...
+allocator.BeginFrame(frameIndex);
+BufferAllocation scratch = allocator.AllocateTransient(BufferUsage::UnorderedAccess, scratchSize);
+...
+allocator.Free(cb);
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <wrl/client.h>
+
+#include <memory>
+#include <vector>
+
+#include "BuddyAllocator.h"
+#include "LinearAllocator.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Usage of a buffer, determining the pool it is allocated from
+enum class BufferUsage : uint32_t
+{
+  Upload = 0,
+  Default,
+  UnorderedAccess,
+  AccelerationStructure,
+  Readback,
+  Count
+};
+
+/// Suballocated range of a pool buffer
+struct BufferAllocation
+{
+  /// Buffer resource of the block the range belongs to
+  ID3D12Resource* resource = nullptr;
+  /// Offset of the range in the resource
+  UINT64 offset = 0;
+  /// Requested size of the range
+  UINT64 size = 0;
+  /// GPU address of the start of the range
+  D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+  /// CPU address of the start of the range, for upload and readback buffers only
+  uint8_t* cpuAddress = nullptr;
+
+  /// Internal bookkeeping, used to return the range to its block
+  BufferUsage usage = BufferUsage::Upload;
+  uint32_t blockIndex = UINT32_MAX;
+  bool transient = false;
+
+  bool IsValid() const { return resource != nullptr; }
+};
+
+/// Heap suballocator built on placed resources
+class GpuMemoryAllocator
+{
+public:
+  /// Usage figures of one pool
+  struct PoolStatistics
+  {
+    /// Number of heaps in the pool
+    uint32_t blockCount = 0;
+    /// Aggregated buddy allocator statistics of the long-lived blocks
+    BuddyAllocator::Statistics blocks;
+    /// Capacity of the per-frame arenas of the pool, all frames included
+    uint64_t transientCapacity = 0;
+    /// Highest usage of a single frame arena
+    uint64_t transientPeak = 0;
+  };
+
+  struct Statistics
+  {
+    PoolStatistics pools[static_cast<uint32_t>(BufferUsage::Count)];
+  };
+
+  /// Prepare the allocator. Blocks are blockSize bytes unless a larger
+  /// allocation is requested, and each frame in flight gets arenaSize bytes of
+  /// transient memory per usage, growing on demand. Both sizes are rounded up
+  /// to powers of two
+  void Init(ID3D12Device* device, UINT frameCount, UINT64 blockSize = 16 * 1024 * 1024,
+            UINT64 arenaSize = 4 * 1024 * 1024);
+
+  /// Allocate a long-lived buffer range, to be released with Free. The
+  /// alignment defaults to 256 bytes
+  BufferAllocation Allocate(BufferUsage usage, UINT64 size, UINT64 alignment = 0);
+
+  /// Release a range obtained from Allocate. Transient ranges are ignored, as
+  /// they are reclaimed by BeginFrame. The allocation is reset on return
+  void Free(BufferAllocation& allocation);
+
+  /// Start recording a frame: the transient arenas of that frame are reset,
+  /// hence the GPU must be done with the previous use of frameIndex
+  void BeginFrame(UINT frameIndex);
+
+  /// Allocate a buffer range valid until the current frame index comes back
+  /// in BeginFrame
+  BufferAllocation AllocateTransient(BufferUsage usage, UINT64 size, UINT64 alignment = 0);
+
+  Statistics GetStatistics() const;
+
+  /// Release all the heaps. The GPU must not reference any allocation anymore
+  void Release();
+
+private:
+  /// Heap covered by a single placed buffer
+  struct Block
+  {
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    uint8_t* cpuAddress = nullptr;
+    std::unique_ptr<BuddyAllocator> allocator;
+  };
+
+  /// Chunk of a per-frame arena
+  struct ArenaChunk
+  {
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    uint8_t* cpuAddress = nullptr;
+    LinearAllocator allocator;
+  };
+
+  struct Pool
+  {
+    std::vector<Block> blocks;
+    /// Arena chunks for each frame in flight
+    std::vector<std::vector<ArenaChunk>> arenas;
+  };
+
+  /// Create a heap of the given size and a buffer covering it, in the heap
+  /// type, flags and state of the usage
+  void CreateHeapBuffer(BufferUsage usage, UINT64 size, Microsoft::WRL::ComPtr<ID3D12Heap>& heap,
+                        Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, uint8_t** cpuAddress);
+
+  Pool& GetPool(BufferUsage usage) { return m_pools[static_cast<uint32_t>(usage)]; }
+
+  ID3D12Device* m_device = nullptr;
+  UINT64 m_blockSize = 0;
+  UINT64 m_arenaSize = 0;
+  UINT m_frameIndex = 0;
+  Pool m_pools[static_cast<uint32_t>(BufferUsage::Count)];
+};
+} // namespace nv_helpers_dx12
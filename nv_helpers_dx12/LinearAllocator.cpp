@@ -0,0 +1,42 @@
+#include "LinearAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+LinearAllocator::LinearAllocator(uint64_t capacity) : m_capacity(capacity) {}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Align the head of the arena and move it past the requested size
+bool LinearAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+  if (alignment != 0 && (alignment & (alignment - 1)) != 0)
+  {
+    throw std::logic_error("Linear allocator alignments must be powers of two");
+  }
+
+  uint64_t start = alignment == 0 ? m_head : ((m_head + alignment - 1) & ~(alignment - 1));
+  if (start > m_capacity || size > m_capacity - start)
+  {
+    return false;
+  }
+
+  m_head = start + size;
+  m_peak = m_head > m_peak ? m_head : m_peak;
+  *offset = start;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void LinearAllocator::Reset()
+{
+  m_head = 0;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,53 @@
+/*
+The linear allocator hands out offsets in [0, capacity) by bumping a pointer,
+and releases everything at once on Reset. It is meant for transient data whose
+lifetime is a single frame, such as per-frame constants, instance descriptors
+or acceleration structure build scratch space: one allocator is kept per frame
+in flight, and reset when the GPU is known to be done with that frame.
+
+Like the buddy allocator it only manages offsets, and does not depend on any
+device.
+
+Example:
+
+LinearAllocator arena(4 * 1024 * 1024);
+uint64_t offset;
+arena.Allocate(sizeof(Constants), 256, &offset);
+...
+arena.Reset(); // Once the frame has been consumed by the GPU
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace nv_helpers_dx12
+{
+
+/// Bump allocator working on offsets only
+class LinearAllocator
+{
+public:
+  explicit LinearAllocator(uint64_t capacity);
+
+  /// Allocate size bytes aligned on alignment (power of two, or 0 for no
+  /// alignment). Returns false if the remaining space is too small
+  bool Allocate(uint64_t size, uint64_t alignment, uint64_t* offset);
+
+  /// Release all the allocations at once
+  void Reset();
+
+  uint64_t GetCapacity() const { return m_capacity; }
+  /// Bytes consumed since the last reset, alignment padding included
+  uint64_t GetUsedBytes() const { return m_head; }
+  /// Highest usage seen since the creation of the allocator, useful to size
+  /// the arenas
+  uint64_t GetPeakBytes() const { return m_peak; }
+
+private:
+  uint64_t m_capacity;
+  uint64_t m_head = 0;
+  uint64_t m_peak = 0;
+};
+} // namespace nv_helpers_dx12
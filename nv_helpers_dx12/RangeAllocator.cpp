@@ -0,0 +1,95 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RangeAllocator::RangeAllocator(uint64_t capacity) : m_capacity(capacity)
+{
+  Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Take the slots from the beginning of the first free range large enough
+bool RangeAllocator::Allocate(uint64_t count, uint64_t* start)
+{
+  if (count == 0)
+  {
+    throw std::logic_error("Cannot allocate an empty range");
+  }
+
+  for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+  {
+    if (it->second < count)
+    {
+      continue;
+    }
+
+    *start = it->first;
+    uint64_t remaining = it->second - count;
+    m_freeRanges.erase(it);
+    if (remaining > 0)
+    {
+      m_freeRanges[*start + count] = remaining;
+    }
+    m_allocated += count;
+    return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Insert the range in the free list, merging it with the free ranges directly before and after
+void RangeAllocator::Free(uint64_t start, uint64_t count)
+{
+  if (count == 0 || start > m_capacity || count > m_capacity - start || count > m_allocated)
+  {
+    throw std::logic_error("Freeing a range not allocated by this range allocator");
+  }
+
+  auto next = m_freeRanges.lower_bound(start);
+  if (next != m_freeRanges.end() && next->first < start + count)
+  {
+    throw std::logic_error("Freeing a range overlapping free slots");
+  }
+  auto previous = next == m_freeRanges.begin() ? m_freeRanges.end() : std::prev(next);
+  if (previous != m_freeRanges.end() && previous->first + previous->second > start)
+  {
+    throw std::logic_error("Freeing a range overlapping free slots");
+  }
+  m_allocated -= count;
+
+  if (previous != m_freeRanges.end() && previous->first + previous->second == start)
+  {
+    start = previous->first;
+    count += previous->second;
+    m_freeRanges.erase(previous);
+  }
+  if (next != m_freeRanges.end() && next->first == start + count)
+  {
+    count += next->second;
+    m_freeRanges.erase(next);
+  }
+  m_freeRanges[start] = count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RangeAllocator::Reset()
+{
+  m_freeRanges.clear();
+  if (m_capacity > 0)
+  {
+    m_freeRanges[0] = m_capacity;
+  }
+  m_allocated = 0;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,58 @@
+/*
+The range allocator hands out ranges of consecutive slots in [0, capacity),
+which can be freed in any order. It keeps the free space as a list of ranges
+sorted by start, allocates first-fit, and merges freed ranges with their free
+neighbors. It suits allocations with arbitrary sizes and long lifetimes, such
+as the persistent descriptors of a heap, where the power-of-two rounding of the
+buddy allocator would waste slots.
+
+Like the other offset allocators it does not depend on any device.
+
+Example:
+
+RangeAllocator ranges(4096);
+uint64_t start;
+if (ranges.Allocate(3, &start))
+{
+  ...
+  ranges.Free(start, 3);
+}
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+namespace nv_helpers_dx12
+{
+
+/// First-fit allocator of slot ranges
+class RangeAllocator
+{
+public:
+  explicit RangeAllocator(uint64_t capacity);
+
+  /// Allocate count consecutive slots. Returns false if no free range is large
+  /// enough
+  bool Allocate(uint64_t count, uint64_t* start);
+
+  /// Release a range previously returned by Allocate
+  void Free(uint64_t start, uint64_t count);
+
+  /// Release all the ranges at once
+  void Reset();
+
+  uint64_t GetCapacity() const { return m_capacity; }
+  uint64_t GetAllocatedCount() const { return m_allocated; }
+  /// Number of disjoint free ranges, as a measure of fragmentation
+  uint64_t GetFreeRangeCount() const { return m_freeRanges.size(); }
+
+private:
+  uint64_t m_capacity;
+  uint64_t m_allocated = 0;
+  /// Free ranges, mapping their start to their size
+  std::map<uint64_t, uint64_t> m_freeRanges;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,385 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+const ResourceState ReadOnlyStates =
+    ResourceState::VertexBuffer | ResourceState::IndexBuffer | ResourceState::DepthRead |
+    ResourceState::NonPixelShaderResource | ResourceState::PixelShaderResource |
+    ResourceState::CopySource | ResourceState::AccelerationStructure;
+
+uint32_t Bits(ResourceState state)
+{
+  return static_cast<uint32_t>(state);
+}
+
+/// States in which successive accesses are only ordered by UAV barriers
+bool IsUAVState(ResourceState state)
+{
+  return state == ResourceState::UnorderedAccess || state == ResourceState::AccelerationStructure;
+}
+
+/// The acceleration structure state cannot be combined with any other state
+bool CanMergeReadStates(ResourceState a, ResourceState b)
+{
+  return a != ResourceState::AccelerationStructure && b != ResourceState::AccelerationStructure;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+  return alignment == 0 ? value : ((value + alignment - 1) / alignment) * alignment;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool IsReadOnlyState(ResourceState state)
+{
+  return state != ResourceState::Common && (Bits(state) & ~Bits(ReadOnlyStates)) == 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RenderGraphHandle RenderGraph::ImportResource(const std::string& name, ResourceState initialState,
+                                              ResourceState finalState)
+{
+  m_resources.push_back({name, false, initialState, finalState, 0, 0});
+  return static_cast<RenderGraphHandle>(m_resources.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RenderGraphHandle RenderGraph::CreateTransient(const std::string& name, uint64_t size,
+                                               uint64_t alignment /*= 65536*/)
+{
+  if (size == 0)
+  {
+    throw std::logic_error("Transient render graph resources cannot be empty");
+  }
+  m_resources.push_back(
+      {name, true, ResourceState::Common, ResourceState::Common, size, alignment});
+  return static_cast<RenderGraphHandle>(m_resources.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t RenderGraph::AddPass(const std::string& name, const std::vector<ResourceUse>& uses,
+                              std::function<void()> execute)
+{
+  for (size_t i = 0; i < uses.size(); i++)
+  {
+    if (uses[i].resource >= m_resources.size())
+    {
+      throw std::logic_error("Render graph pass " + name + " uses an unknown resource");
+    }
+    for (size_t j = 0; j < i; j++)
+    {
+      if (uses[j].resource == uses[i].resource)
+      {
+        throw std::logic_error("Render graph pass " + name + " uses " +
+                               m_resources[uses[i].resource].name + " more than once");
+      }
+    }
+  }
+  m_passes.push_back({name, uses, std::move(execute)});
+  return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Walk the uses of each resource in pass order, tracking its current state, and emit the barriers
+// required by each state change in the batch of the pass triggering it
+CompiledRenderGraph RenderGraph::Compile() const
+{
+  const uint32_t resourceCount = GetResourceCount();
+  const uint32_t passCount = GetPassCount();
+
+  CompiledRenderGraph compiled;
+  compiled.passBarriers.resize(passCount);
+
+  // Gather the uses of each resource, in pass order
+  struct PassUse
+  {
+    uint32_t pass;
+    ResourceState state;
+    bool write;
+  };
+  std::vector<std::vector<PassUse>> resourceUses(resourceCount);
+  for (uint32_t p = 0; p < passCount; p++)
+  {
+    for (const ResourceUse& use : m_passes[p].uses)
+    {
+      bool write = use.write || !IsReadOnlyState(use.state);
+      resourceUses[use.resource].push_back({p, use.state, write});
+    }
+  }
+
+  // Lifetimes of the transient resources, and their placement in the heap
+  std::vector<uint32_t> firstUse(resourceCount, UINT32_MAX);
+  std::vector<uint32_t> lastUse(resourceCount, 0);
+  for (uint32_t r = 0; r < resourceCount; r++)
+  {
+    if (!resourceUses[r].empty())
+    {
+      firstUse[r] = resourceUses[r].front().pass;
+      lastUse[r] = resourceUses[r].back().pass;
+    }
+  }
+  PlaceTransients(firstUse, lastUse, compiled);
+
+  // A transient resource taking over memory used earlier in the frame needs an aliasing barrier
+  // before its first use. The previous user is the overlapping resource which died last
+  for (uint32_t r = 0; r < resourceCount; r++)
+  {
+    if (compiled.heapOffsets[r] == UINT64_MAX)
+    {
+      continue;
+    }
+    uint64_t begin = compiled.heapOffsets[r];
+    uint64_t end = begin + m_resources[r].size;
+    RenderGraphHandle previous = InvalidRenderGraphHandle;
+    for (uint32_t other = 0; other < resourceCount; other++)
+    {
+      if (other == r || compiled.heapOffsets[other] == UINT64_MAX ||
+          lastUse[other] >= firstUse[r])
+      {
+        continue;
+      }
+      uint64_t otherBegin = compiled.heapOffsets[other];
+      uint64_t otherEnd = otherBegin + m_resources[other].size;
+      if (otherBegin < end && begin < otherEnd &&
+          (previous == InvalidRenderGraphHandle || lastUse[other] > lastUse[previous]))
+      {
+        previous = other;
+      }
+    }
+    if (previous != InvalidRenderGraphHandle)
+    {
+      RenderGraphBarrier barrier;
+      barrier.type = RenderGraphBarrier::Type::Aliasing;
+      barrier.resource = r;
+      barrier.aliasedResource = previous;
+      compiled.passBarriers[firstUse[r]].push_back(barrier);
+      compiled.aliasingBarrierCount++;
+    }
+  }
+
+  // State tracking
+  for (uint32_t r = 0; r < resourceCount; r++)
+  {
+    const std::vector<PassUse>& uses = resourceUses[r];
+    ResourceState state = m_resources[r].initialState;
+    bool lastWrite = false;
+
+    for (size_t u = 0; u < uses.size(); u++)
+    {
+      const PassUse& use = uses[u];
+      std::vector<RenderGraphBarrier>& barriers = compiled.passBarriers[use.pass];
+
+      bool stateMatches =
+          use.write ? state == use.state
+                    : (IsReadOnlyState(state) && (Bits(state) & Bits(use.state)) == Bits(use.state) &&
+                       CanMergeReadStates(state, use.state)) ||
+                          state == use.state;
+      if (stateMatches)
+      {
+        // Same state: only accesses through UAVs need ordering, if either of them writes. The
+        // first use of the frame is ordered by the previous command lists
+        if (IsUAVState(state) && u > 0 && (use.write || lastWrite))
+        {
+          RenderGraphBarrier barrier;
+          barrier.type = RenderGraphBarrier::Type::UAV;
+          barrier.resource = r;
+          barriers.push_back(barrier);
+          compiled.uavBarrierCount++;
+        }
+      }
+      else
+      {
+        // Read-only uses are merged with the following reads, so that the resource stays in a
+        // combined state until it is written again
+        ResourceState target = use.state;
+        if (!use.write)
+        {
+          for (size_t next = u + 1; next < uses.size() && !uses[next].write; next++)
+          {
+            if (!CanMergeReadStates(target, uses[next].state))
+            {
+              break;
+            }
+            target = target | uses[next].state;
+          }
+        }
+
+        RenderGraphBarrier barrier;
+        barrier.type = RenderGraphBarrier::Type::Transition;
+        barrier.resource = r;
+        barrier.before = state;
+        barrier.after = target;
+        barriers.push_back(barrier);
+        compiled.transitionCount++;
+        state = target;
+      }
+      lastWrite = use.write;
+    }
+
+    // Imported resources are left in their final state, transient ones in the common state they
+    // are assumed to be in at the beginning of each frame
+    if (state != m_resources[r].finalState)
+    {
+      RenderGraphBarrier barrier;
+      barrier.type = RenderGraphBarrier::Type::Transition;
+      barrier.resource = r;
+      barrier.before = state;
+      barrier.after = m_resources[r].finalState;
+      compiled.finalBarriers.push_back(barrier);
+      compiled.transitionCount++;
+    }
+  }
+
+  return compiled;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Greedy placement, largest resources first: each resource goes to the lowest aligned offset
+// which does not overlap the memory of an already placed resource alive at the same time
+void RenderGraph::PlaceTransients(const std::vector<uint32_t>& firstUse,
+                                  const std::vector<uint32_t>& lastUse,
+                                  CompiledRenderGraph& compiled) const
+{
+  compiled.heapOffsets.assign(m_resources.size(), UINT64_MAX);
+
+  std::vector<uint32_t> order;
+  for (uint32_t r = 0; r < GetResourceCount(); r++)
+  {
+    if (m_resources[r].transient && firstUse[r] != UINT32_MAX)
+    {
+      order.push_back(r);
+      compiled.unaliasedSize += m_resources[r].size;
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return m_resources[a].size > m_resources[b].size;
+  });
+
+  struct Range
+  {
+    uint64_t begin;
+    uint64_t end;
+  };
+  std::vector<uint32_t> placed;
+  std::vector<Range> conflicts;
+  for (uint32_t r : order)
+  {
+    conflicts.clear();
+    for (uint32_t other : placed)
+    {
+      bool disjointLifetimes = lastUse[other] < firstUse[r] || lastUse[r] < firstUse[other];
+      if (!disjointLifetimes)
+      {
+        conflicts.push_back({compiled.heapOffsets[other],
+                             compiled.heapOffsets[other] + m_resources[other].size});
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(),
+              [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+    uint64_t offset = 0;
+    for (const Range& range : conflicts)
+    {
+      uint64_t aligned = AlignUp(offset, m_resources[r].alignment);
+      if (aligned + m_resources[r].size <= range.begin)
+      {
+        break;
+      }
+      offset = range.end > offset ? range.end : offset;
+    }
+    offset = AlignUp(offset, m_resources[r].alignment);
+
+    compiled.heapOffsets[r] = offset;
+    uint64_t end = offset + m_resources[r].size;
+    compiled.heapSize = end > compiled.heapSize ? end : compiled.heapSize;
+    placed.push_back(r);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraph::Execute(
+    const CompiledRenderGraph& compiled,
+    const std::function<void(const std::vector<RenderGraphBarrier>&)>& recordBarriers) const
+{
+  if (compiled.passBarriers.size() != m_passes.size())
+  {
+    throw std::logic_error("The compiled render graph does not match the graph being executed");
+  }
+
+  for (size_t p = 0; p < m_passes.size(); p++)
+  {
+    if (!compiled.passBarriers[p].empty())
+    {
+      recordBarriers(compiled.passBarriers[p]);
+    }
+    if (m_passes[p].execute)
+    {
+      m_passes[p].execute();
+    }
+  }
+  if (!compiled.finalBarriers.empty())
+  {
+    recordBarriers(compiled.finalBarriers);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraph::Reset()
+{
+  m_resources.clear();
+  m_passes.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+const std::string& RenderGraph::GetResourceName(RenderGraphHandle resource) const
+{
+  return m_resources.at(resource).name;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool RenderGraph::IsTransient(RenderGraphHandle resource) const
+{
+  return m_resources.at(resource).transient;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t RenderGraph::GetTransientSize(RenderGraphHandle resource) const
+{
+  return m_resources.at(resource).size;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+const std::string& RenderGraph::GetPassName(uint32_t pass) const
+{
+  return m_passes.at(pass).name;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,192 @@
+/*
+The render graph describes a frame as an ordered list of passes, each pass
+declaring the resources it uses and the state it needs them in. Compiling the
+graph derives all the synchronization of the frame from those declarations:
+- one batch of barriers per pass, recorded right before the pass
+- transitions only where the state actually changes. Consecutive read-only
+  uses of a resource are merged into a single combined state, so that a
+  resource read by several passes in a row is transitioned once
+- UAV barriers between dependent accesses of resources staying in the
+  unordered access or acceleration structure states
+- transitions back to the final state of the imported resources at the end of
+  the frame
+
+Resources are either imported, such as the back buffer or the raytracing
+output, with their state at the beginning and at the end of the frame, or
+transient. Transient resources only live between their first and last uses in
+the frame, and are placed in a single heap where resources with disjoint
+lifetimes share memory. The compile step computes their offsets and the heap
+size, and inserts aliasing barriers when a resource takes over memory used
+earlier in the frame.
+
+The graph only manipulates handles and abstract states, and does not depend on
+any device: RenderGraphD3D12 maps the handles to resources and records the
+barriers on a command list.
+
+Example:
+
+RenderGraph graph;
+RenderGraphHandle output = graph.ImportResource("Output", ResourceState::CopySource,
+                                                ResourceState::CopySource);
+RenderGraphHandle backBuffer = graph.ImportResource("BackBuffer", ResourceState::Present,
+                                                    ResourceState::Present);
+graph.AddPass("DispatchRays", {{output, ResourceState::UnorderedAccess}}, [&]() { ... });
+graph.AddPass("Copy", {{output, ResourceState::CopySource}, {backBuffer, ResourceState::CopyDest}},
+              [&]() { ... });
+CompiledRenderGraph compiled = graph.Compile();
+graph.Execute(compiled, [&](const std::vector<RenderGraphBarrier>& barriers) { ... });
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Abstract resource states. Read-only states are flags which can be combined, and map one to one
+/// to the D3D12 resource states
+enum class ResourceState : uint32_t
+{
+  Common = 0,
+  Present = 0,
+  VertexBuffer = 1 << 0,
+  IndexBuffer = 1 << 1,
+  RenderTarget = 1 << 2,
+  UnorderedAccess = 1 << 3,
+  DepthWrite = 1 << 4,
+  DepthRead = 1 << 5,
+  NonPixelShaderResource = 1 << 6,
+  PixelShaderResource = 1 << 7,
+  CopyDest = 1 << 8,
+  CopySource = 1 << 9,
+  AccelerationStructure = 1 << 10
+};
+
+inline ResourceState operator|(ResourceState a, ResourceState b)
+{
+  return static_cast<ResourceState>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
+/// True if the state only allows reading the resource, in which case it can be combined with
+/// other read-only states
+bool IsReadOnlyState(ResourceState state);
+
+/// Index of a resource in the graph
+using RenderGraphHandle = uint32_t;
+static const RenderGraphHandle InvalidRenderGraphHandle = UINT32_MAX;
+
+/// Declaration of the use of a resource by a pass
+struct ResourceUse
+{
+  RenderGraphHandle resource;
+  ResourceState state;
+  /// Write access in a state which does not imply it, typically an acceleration structure build
+  bool write = false;
+};
+
+/// Barrier computed by the compile step
+struct RenderGraphBarrier
+{
+  enum class Type
+  {
+    Transition,
+    UAV,
+    Aliasing
+  };
+
+  Type type = Type::Transition;
+  RenderGraphHandle resource = InvalidRenderGraphHandle;
+  /// States of the resource before and after a transition
+  ResourceState before = ResourceState::Common;
+  ResourceState after = ResourceState::Common;
+  /// For aliasing barriers, transient resource previously using the memory of resource
+  RenderGraphHandle aliasedResource = InvalidRenderGraphHandle;
+};
+
+/// Result of the compile step
+struct CompiledRenderGraph
+{
+  /// Barriers to record before each pass, in pass order
+  std::vector<std::vector<RenderGraphBarrier>> passBarriers;
+  /// Barriers to record after the last pass
+  std::vector<RenderGraphBarrier> finalBarriers;
+  /// Offset of each resource in the transient heap, UINT64_MAX for imported and unused resources
+  std::vector<uint64_t> heapOffsets;
+  /// Size of the heap holding all the transient resources
+  uint64_t heapSize = 0;
+  /// Sum of the sizes of the transient resources, that is the heap size without aliasing
+  uint64_t unaliasedSize = 0;
+  /// Number of barriers of each type, for statistics
+  uint32_t transitionCount = 0;
+  uint32_t uavBarrierCount = 0;
+  uint32_t aliasingBarrierCount = 0;
+};
+
+/// Frame description as an ordered list of passes using resources
+class RenderGraph
+{
+public:
+  /// Add a resource created outside of the graph, in initialState at the beginning of the frame
+  /// and to be left in finalState at the end
+  RenderGraphHandle ImportResource(const std::string& name, ResourceState initialState,
+                                   ResourceState finalState);
+
+  /// Add a resource living only within the frame, placed by the graph in the transient heap. Its
+  /// content is undefined on first use
+  RenderGraphHandle CreateTransient(const std::string& name, uint64_t size,
+                                    uint64_t alignment = 65536);
+
+  /// Add a pass, executed in declaration order. Each resource may appear once per pass
+  uint32_t AddPass(const std::string& name, const std::vector<ResourceUse>& uses,
+                   std::function<void()> execute);
+
+  /// Compute the barriers of each pass and the placement of the transient resources
+  CompiledRenderGraph Compile() const;
+
+  /// Record the frame: for each pass, recordBarriers is called with the pending barrier batch if
+  /// not empty, then the pass is executed
+  void Execute(const CompiledRenderGraph& compiled,
+               const std::function<void(const std::vector<RenderGraphBarrier>&)>& recordBarriers) const;
+
+  /// Remove all resources and passes, to describe a new frame
+  void Reset();
+
+  uint32_t GetResourceCount() const { return static_cast<uint32_t>(m_resources.size()); }
+  uint32_t GetPassCount() const { return static_cast<uint32_t>(m_passes.size()); }
+  const std::string& GetResourceName(RenderGraphHandle resource) const;
+  bool IsTransient(RenderGraphHandle resource) const;
+  uint64_t GetTransientSize(RenderGraphHandle resource) const;
+  const std::string& GetPassName(uint32_t pass) const;
+
+private:
+  struct Resource
+  {
+    std::string name;
+    bool transient;
+    ResourceState initialState;
+    ResourceState finalState;
+    uint64_t size;
+    uint64_t alignment;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    std::vector<ResourceUse> uses;
+    std::function<void()> execute;
+  };
+
+  /// Assign heap offsets to the transient resources, sharing memory between resources whose
+  /// lifetimes do not overlap
+  void PlaceTransients(const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse,
+                       CompiledRenderGraph& compiled) const;
+
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+};
+} // namespace nv_helpers_dx12
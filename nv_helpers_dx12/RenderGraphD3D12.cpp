@@ -0,0 +1,215 @@
+#include "RenderGraphD3D12.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// The read-only states are flags on both sides, so combined states are converted bit by bit
+D3D12_RESOURCE_STATES ToD3D12ResourceState(ResourceState state)
+{
+  static const struct
+  {
+    ResourceState state;
+    D3D12_RESOURCE_STATES d3d12State;
+  } mapping[] = {
+      {ResourceState::VertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER},
+      {ResourceState::IndexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER},
+      {ResourceState::RenderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET},
+      {ResourceState::UnorderedAccess, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+      {ResourceState::DepthWrite, D3D12_RESOURCE_STATE_DEPTH_WRITE},
+      {ResourceState::DepthRead, D3D12_RESOURCE_STATE_DEPTH_READ},
+      {ResourceState::NonPixelShaderResource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE},
+      {ResourceState::PixelShaderResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE},
+      {ResourceState::CopyDest, D3D12_RESOURCE_STATE_COPY_DEST},
+      {ResourceState::CopySource, D3D12_RESOURCE_STATE_COPY_SOURCE},
+      {ResourceState::AccelerationStructure,
+       D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE}};
+
+  UINT d3d12State = D3D12_RESOURCE_STATE_COMMON;
+  for (const auto& entry : mapping)
+  {
+    if ((static_cast<uint32_t>(state) & static_cast<uint32_t>(entry.state)) != 0)
+    {
+      d3d12State |= entry.d3d12State;
+    }
+  }
+  return static_cast<D3D12_RESOURCE_STATES>(d3d12State);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraphD3D12::Init(ID3D12Device* device)
+{
+  m_device = device;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraphD3D12::BeginFrame(const RenderGraph& graph)
+{
+  m_bindings.assign(graph.GetResourceCount(), nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraphD3D12::Bind(RenderGraphHandle handle, ID3D12Resource* resource)
+{
+  if (handle >= m_bindings.size())
+  {
+    throw std::logic_error("Binding a resource to an unknown render graph handle");
+  }
+  m_bindings[handle] = resource;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Make sure the heap is large enough, then look up or create the placed buffer of each transient
+// resource at its compiled offset
+void RenderGraphD3D12::AllocateTransients(const RenderGraph& graph,
+                                          const CompiledRenderGraph& compiled)
+{
+  if (compiled.heapSize == 0)
+  {
+    return;
+  }
+
+  if (compiled.heapSize > m_heapSize)
+  {
+    m_placedBuffers.clear();
+    m_heap.Reset();
+
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = compiled.heapSize;
+    heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    if (FAILED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heap))))
+    {
+      throw std::logic_error("Could not create the render graph transient heap");
+    }
+    m_heapSize = compiled.heapSize;
+  }
+
+  for (RenderGraphHandle handle = 0; handle < graph.GetResourceCount(); handle++)
+  {
+    UINT64 offset = compiled.heapOffsets[handle];
+    if (offset == UINT64_MAX)
+    {
+      continue;
+    }
+    UINT64 size = graph.GetTransientSize(handle);
+
+    ID3D12Resource* resource = nullptr;
+    for (const PlacedBuffer& placed : m_placedBuffers)
+    {
+      if (placed.offset == offset && placed.size == size)
+      {
+        resource = placed.resource.Get();
+        break;
+      }
+    }
+
+    if (resource == nullptr)
+    {
+      D3D12_RESOURCE_DESC bufDesc = {};
+      bufDesc.Alignment = 0;
+      bufDesc.DepthOrArraySize = 1;
+      bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+      bufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+      bufDesc.Format = DXGI_FORMAT_UNKNOWN;
+      bufDesc.Height = 1;
+      bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+      bufDesc.MipLevels = 1;
+      bufDesc.SampleDesc.Count = 1;
+      bufDesc.SampleDesc.Quality = 0;
+      bufDesc.Width = size;
+
+      // The graph assumes transient resources are in the common state at the beginning of the
+      // frame, and returns them to it at the end
+      PlacedBuffer placed = {offset, size, nullptr};
+      if (FAILED(m_device->CreatePlacedResource(m_heap.Get(), offset, &bufDesc,
+                                                D3D12_RESOURCE_STATE_COMMON, nullptr,
+                                                IID_PPV_ARGS(&placed.resource))))
+      {
+        throw std::logic_error("Could not create a render graph transient buffer");
+      }
+      resource = placed.resource.Get();
+      m_placedBuffers.push_back(placed);
+    }
+
+    Bind(handle, resource);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ID3D12Resource* RenderGraphD3D12::GetResource(RenderGraphHandle handle) const
+{
+  return handle < m_bindings.size() ? m_bindings[handle] : nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Translate the graph barriers and submit them all at once
+void RenderGraphD3D12::RecordBarriers(ID3D12GraphicsCommandList* commandList,
+                                      const std::vector<RenderGraphBarrier>& barriers)
+{
+  m_barriers.clear();
+  for (const RenderGraphBarrier& barrier : barriers)
+  {
+    ID3D12Resource* resource = GetResource(barrier.resource);
+    if (resource == nullptr)
+    {
+      throw std::logic_error("Render graph resource used without being bound");
+    }
+
+    D3D12_RESOURCE_BARRIER d3d12Barrier = {};
+    d3d12Barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    switch (barrier.type)
+    {
+    case RenderGraphBarrier::Type::Transition:
+      d3d12Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+      d3d12Barrier.Transition.pResource = resource;
+      d3d12Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+      d3d12Barrier.Transition.StateBefore = ToD3D12ResourceState(barrier.before);
+      d3d12Barrier.Transition.StateAfter = ToD3D12ResourceState(barrier.after);
+      break;
+    case RenderGraphBarrier::Type::UAV:
+      d3d12Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+      d3d12Barrier.UAV.pResource = resource;
+      break;
+    case RenderGraphBarrier::Type::Aliasing:
+      d3d12Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+      d3d12Barrier.Aliasing.pResourceBefore = GetResource(barrier.aliasedResource);
+      d3d12Barrier.Aliasing.pResourceAfter = resource;
+      break;
+    }
+    m_barriers.push_back(d3d12Barrier);
+  }
+
+  if (!m_barriers.empty())
+  {
+    commandList->ResourceBarrier(static_cast<UINT>(m_barriers.size()), m_barriers.data());
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RenderGraphD3D12::Release()
+{
+  m_placedBuffers.clear();
+  m_heap.Reset();
+  m_heapSize = 0;
+  m_bindings.clear();
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,87 @@
+/*
+D3D12 backend of the render graph: it maps the graph handles to actual
+resources, creates the transient resources in an aliased heap, and records the
+barrier batches computed by the compile step, with a single ResourceBarrier
+call per batch.
+
+Imported resources are bound every frame, as the graph is rebuilt each frame
+and its handles are only valid for that graph. Transient resources are buffers
+allowing unordered access, placed in a heap sized after the compiled graph.
+Placed resources are cached across frames by offset and size, so a graph with
+the same layout does not recreate anything.
+
+Example:
+
+RenderGraphD3D12 graphResources;
+graphResources.Init(device);
+...
+graphResources.BeginFrame(graph);
+graphResources.Bind(backBufferHandle, backBuffer);
+CompiledRenderGraph compiled = graph.Compile();
+graphResources.AllocateTransients(graph, compiled);
+graph.Execute(compiled, [&](const std::vector<RenderGraphBarrier>& barriers) {
+  graphResources.RecordBarriers(commandList, barriers);
+});
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <wrl/client.h>
+
+#include <vector>
+
+#include "RenderGraph.h"
+
+namespace nv_helpers_dx12
+{
+
+/// D3D12 equivalent of a render graph state
+D3D12_RESOURCE_STATES ToD3D12ResourceState(ResourceState state);
+
+/// Resources and barrier recording of a render graph
+class RenderGraphD3D12
+{
+public:
+  void Init(ID3D12Device* device);
+
+  /// Clear the bindings of the previous frame, and size them for the resources of graph
+  void BeginFrame(const RenderGraph& graph);
+
+  /// Associate an imported resource of the graph with its D3D12 resource
+  void Bind(RenderGraphHandle handle, ID3D12Resource* resource);
+
+  /// Create or reuse the placed buffers of the transient resources. The heap is recreated if the
+  /// compiled graph needs more memory, hence the GPU must be done with the previous frames
+  void AllocateTransients(const RenderGraph& graph, const CompiledRenderGraph& compiled);
+
+  /// D3D12 resource associated with a handle
+  ID3D12Resource* GetResource(RenderGraphHandle handle) const;
+
+  /// Record a batch of barriers in a single call
+  void RecordBarriers(ID3D12GraphicsCommandList* commandList,
+                      const std::vector<RenderGraphBarrier>& barriers);
+
+  /// Release the transient heap and resources
+  void Release();
+
+private:
+  /// Placed buffer, reused as long as a transient resource has the same offset and size
+  struct PlacedBuffer
+  {
+    UINT64 offset;
+    UINT64 size;
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+  };
+
+  ID3D12Device* m_device = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12Heap> m_heap;
+  UINT64 m_heapSize = 0;
+  std::vector<PlacedBuffer> m_placedBuffers;
+  std::vector<ID3D12Resource*> m_bindings;
+  /// Storage of the barrier batches, kept to avoid reallocations
+  std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+};
+} // namespace nv_helpers_dx12
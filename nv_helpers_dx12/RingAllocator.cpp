@@ -0,0 +1,113 @@
+#include "RingAllocator.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RingAllocator::RingAllocator(uint64_t capacity) : m_capacity(capacity) {}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The live range spans [tail, head), possibly wrapping around the end of the ring. A request
+// is placed after the head if it fits before the end, otherwise at the start of the ring if it
+// fits before the tail, the end of the ring being counted as used until the batch retires
+bool RingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+  if (alignment != 0 && (alignment & (alignment - 1)) != 0)
+  {
+    throw std::logic_error("Ring allocator alignments must be powers of two");
+  }
+  if (size > m_capacity)
+  {
+    return false;
+  }
+
+  // Restart from the beginning when everything has been retired, to avoid
+  // needless wrapping
+  if (m_used == 0)
+  {
+    m_head = 0;
+    m_tail = 0;
+  }
+
+  uint64_t start = alignment == 0 ? m_head : ((m_head + alignment - 1) & ~(alignment - 1));
+  uint64_t consumed = 0;
+  if (m_used == 0 || m_head > m_tail)
+  {
+    if (start <= m_capacity && size <= m_capacity - start)
+    {
+      consumed = start + size - m_head;
+    }
+    else if (size <= m_tail)
+    {
+      consumed = m_capacity - m_head + size;
+      start = 0;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  else
+  {
+    // Wrapped, or full when head and tail meet
+    if (m_head == m_tail || start > m_tail || size > m_tail - start)
+    {
+      return false;
+    }
+    consumed = start + size - m_head;
+  }
+
+  m_head = start + size;
+  if (m_head == m_capacity)
+  {
+    m_head = 0;
+  }
+  m_used += consumed;
+  m_openBytes += consumed;
+  *offset = start;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RingAllocator::CloseBatch(uint64_t fenceValue)
+{
+  if (m_openBytes == 0)
+  {
+    return;
+  }
+  m_batches.push_back({fenceValue, m_head, m_openBytes});
+  m_openBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Batches complete in submission order, so retiring only ever moves the tail forward
+void RingAllocator::Retire(uint64_t completedValue)
+{
+  while (!m_batches.empty() && m_batches.front().fenceValue <= completedValue)
+  {
+    m_tail = m_batches.front().end;
+    m_used -= m_batches.front().bytes;
+    m_batches.pop_front();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t RingAllocator::GetOldestFenceValue() const
+{
+  if (m_batches.empty())
+  {
+    throw std::logic_error("No batch in flight in the ring allocator");
+  }
+  return m_batches.front().fenceValue;
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,79 @@
+/*
+The ring allocator hands out offsets in [0, capacity) in a circular fashion, and
+releases them in the order they were allocated. It is meant for staging memory
+consumed by a queue: the allocations made between two submissions form a batch,
+tagged with the fence value signaled when the submission completes, and the
+batches are retired as the fence progresses.
+
+Like the other offset allocators it does not depend on any device, so the
+batching can be driven by a fake queue.
+
+Example:
+
+RingAllocator ring(8 * 1024 * 1024);
+uint64_t offset;
+if (!ring.Allocate(size, 16, &offset))
+{
+  // Wait for ring.GetOldestFenceValue(), then call ring.Retire
+}
+...
+ring.CloseBatch(fenceValue);
+...
+ring.Retire(fence->GetCompletedValue());
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace nv_helpers_dx12
+{
+
+/// Circular allocator retiring its allocations by fence value
+class RingAllocator
+{
+public:
+  explicit RingAllocator(uint64_t capacity);
+
+  /// Allocate size bytes aligned on alignment (power of two, or 0 for no
+  /// alignment). Allocations never wrap around the end of the ring. Returns
+  /// false if the free space is too small
+  bool Allocate(uint64_t size, uint64_t alignment, uint64_t* offset);
+
+  /// Tag all the allocations made since the previous call with the fence value
+  /// signaled once their consumer is done with them
+  void CloseBatch(uint64_t fenceValue);
+
+  /// Release the batches whose fence value is at most completedValue
+  void Retire(uint64_t completedValue);
+
+  /// True if some closed batches are still in flight
+  bool HasPendingBatches() const { return !m_batches.empty(); }
+  /// Fence value of the oldest batch in flight, to wait on when the ring is full
+  uint64_t GetOldestFenceValue() const;
+
+  uint64_t GetCapacity() const { return m_capacity; }
+  /// Bytes in use, including the padding skipped when wrapping around
+  uint64_t GetUsedBytes() const { return m_used; }
+
+private:
+  struct Batch
+  {
+    uint64_t fenceValue;
+    /// Head of the ring when the batch was closed
+    uint64_t end;
+    /// Bytes consumed by the batch, padding included
+    uint64_t bytes;
+  };
+
+  uint64_t m_capacity;
+  uint64_t m_head = 0;
+  uint64_t m_tail = 0;
+  uint64_t m_used = 0;
+  /// Bytes consumed since the last CloseBatch
+  uint64_t m_openBytes = 0;
+  std::deque<Batch> m_batches;
+};
+} // namespace nv_helpers_dx12
@@ -112,6 +112,19 @@ void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
   {
     throw std::logic_error("Could not map the shader binding table");
   }
+
+  Generate(pData, raytracingPipeline);
+
+  // Unmap the SBT
+  sbtBuffer->Unmap(0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Build the SBT in an already mapped upload range
+void ShaderBindingTableGenerator::Generate(uint8_t* pData,
+                                           ID3D12StateObjectProperties* raytracingPipeline)
+{
   // Copy the shader identifiers followed by their resource pointers or root constants: first the
   // ray generation, then the miss shaders, and finally the set of hit groups
   uint32_t offset = 0;
@@ -123,9 +136,6 @@ void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
   pData += offset;
 
   offset = CopyShaderData(raytracingPipeline, pData, m_hitGroup, m_hitGroupEntrySize);
-
-  // Unmap the SBT
-  sbtBuffer->Unmap(0, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -139,6 +139,10 @@ public:
   void Generate(ID3D12Resource* sbtBuffer,
                 ID3D12StateObjectProperties* raytracingPipeline);
 
+  /// Same as above, writing the SBT to sbtData, the CPU address of an already mapped upload range
+  /// of at least ComputeSBTSize() bytes
+  void Generate(uint8_t* sbtData, ID3D12StateObjectProperties* raytracingPipeline);
+
   /// Reset the sets of programs and hit groups
   void Reset();
 
@@ -0,0 +1,135 @@
+#include "StagingUploader.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+// Buffer copies have no alignment requirement, the staging data is only aligned
+// to keep the memcpy into the mapped ring efficient
+const UINT64 kStagingAlignment = 16;
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void StagingUploader::Init(CopyQueue* queue, const BufferAllocation& ring)
+{
+  if (ring.cpuAddress == nullptr)
+  {
+    throw std::logic_error("The staging ring needs to be a mapped upload buffer");
+  }
+  m_queue = queue;
+  m_ring = ring;
+  m_ringAllocator = RingAllocator(ring.size);
+  m_pending.clear();
+  m_lastFenceValue = 0;
+  m_stats = {};
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Reclaim the ring space of completed submissions, and if this is not enough submit the pending
+// copies and wait for the oldest submissions until the request fits
+UINT64 StagingUploader::AllocateStaging(UINT64 size)
+{
+  UINT64 offset = 0;
+  m_ringAllocator.Retire(m_queue->GetCompletedValue());
+  while (!m_ringAllocator.Allocate(size, kStagingAlignment, &offset))
+  {
+    if (!m_pending.empty())
+    {
+      Flush();
+    }
+    else if (m_ringAllocator.HasPendingBatches())
+    {
+      UINT64 fenceValue = m_ringAllocator.GetOldestFenceValue();
+      m_queue->WaitForValue(fenceValue);
+      m_ringAllocator.Retire(fenceValue);
+    }
+    else
+    {
+      throw std::logic_error("Staging request larger than the ring");
+    }
+  }
+  return offset;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Stage the data in chunks fitting in the ring. Each chunk extends the previous pending copy when
+// both its source and destination ranges follow it directly
+void StagingUploader::Upload(ID3D12Resource* dest, UINT64 destOffset, const void* data,
+                             UINT64 size)
+{
+  if (m_queue == nullptr)
+  {
+    throw std::logic_error("StagingUploader::Init needs to be called before uploading");
+  }
+
+  m_stats.uploadCount++;
+  const uint8_t* source = static_cast<const uint8_t*>(data);
+  while (size > 0)
+  {
+    // Chunks are kept to half the ring, so that one can be filled while the
+    // previous one is being copied
+    UINT64 maxChunkSize = m_ringAllocator.GetCapacity() > 1 ? m_ringAllocator.GetCapacity() / 2 : 1;
+    UINT64 chunkSize = size < maxChunkSize ? size : maxChunkSize;
+    UINT64 ringOffset = AllocateStaging(chunkSize);
+    memcpy(m_ring.cpuAddress + ringOffset, source, chunkSize);
+
+    PendingCopy* last = m_pending.empty() ? nullptr : &m_pending.back();
+    if (last != nullptr && last->dest == dest && last->destOffset + last->size == destOffset &&
+        last->ringOffset + last->size == ringOffset)
+    {
+      last->size += chunkSize;
+    }
+    else
+    {
+      m_pending.push_back({dest, destOffset, ringOffset, chunkSize});
+    }
+
+    m_stats.uploadedBytes += chunkSize;
+    source += chunkSize;
+    destOffset += chunkSize;
+    size -= chunkSize;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+UINT64 StagingUploader::Flush()
+{
+  if (m_pending.empty())
+  {
+    return m_lastFenceValue;
+  }
+
+  for (const PendingCopy& copy : m_pending)
+  {
+    m_queue->CopyBufferRegion(copy.dest, copy.destOffset, m_ring.resource,
+                              m_ring.offset + copy.ringOffset, copy.size);
+  }
+  m_stats.copyCount += m_pending.size();
+  m_pending.clear();
+
+  m_lastFenceValue = m_queue->Submit();
+  m_ringAllocator.CloseBatch(m_lastFenceValue);
+  m_stats.submissionCount++;
+  return m_lastFenceValue;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void StagingUploader::WaitIdle()
+{
+  UINT64 fenceValue = Flush();
+  m_queue->WaitForValue(fenceValue);
+  m_ringAllocator.Retire(fenceValue);
+}
+} // namespace nv_helpers_dx12
@@ -0,0 +1,127 @@
+/*
+The staging uploader moves static data (vertex and index buffers, constants)
+into default-heap buffers, which the GPU reads at full speed, unlike upload
+heaps whose contents are fetched across the bus on every access.
+
+Uploads are first copied into a ring of upload memory, and recorded as pending
+copies. Consecutive uploads to contiguous ranges of the same destination are
+merged, so suballocated geometry coalesced in a few large default buffers is
+transferred with a handful of CopyBufferRegion calls. Flush submits all the
+pending copies at once on a copy queue, and returns the fence value signaled
+on completion, on which the consumer queue waits before using the data. Ring
+space is reclaimed as the copy fence progresses, and uploads larger than the
+ring are split in chunks.
+
+The copies are issued through the CopyQueue interface. D3D12CopyQueue (see
+D3D12CopyQueue.h) implements it with a copy command queue; a recording fake
+can be substituted to exercise the batching and the ring management without a
+device, as done by tests/StagingUploaderTest.cpp.
+
+Destination buffers are expected in the common state: buffers are implicitly
+promoted to the copy destination state on the copy queue, and decay back to
+the common state when the copies complete.
+
+Example:
+
+D3D12CopyQueue copyQueue;
+copyQueue.Init(device);
+StagingUploader uploader;
+uploader.Init(&copyQueue, allocator.Allocate(BufferUsage::Upload, 8 * 1024 * 1024));
+
+BufferAllocation vb = allocator.Allocate(BufferUsage::Default, vbSize);
+uploader.Upload(vb, vertices, vbSize);
+...
+UINT64 fenceValue = uploader.Flush();
+commandQueue->Wait(copyQueue.GetFence(), fenceValue);
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <vector>
+
+#include "GpuMemoryAllocator.h"
+#include "RingAllocator.h"
+
+namespace nv_helpers_dx12
+{
+
+/// Queue executing the buffer copies of the staging uploader
+class CopyQueue
+{
+public:
+  virtual ~CopyQueue() = default;
+
+  /// Record a copy, to be executed by the next Submit
+  virtual void CopyBufferRegion(ID3D12Resource* dest, UINT64 destOffset, ID3D12Resource* source,
+                                UINT64 sourceOffset, UINT64 size) = 0;
+  /// Execute the copies recorded since the previous submission, and return the
+  /// fence value signaled once they complete
+  virtual UINT64 Submit() = 0;
+  /// Latest fence value reached by the queue
+  virtual UINT64 GetCompletedValue() = 0;
+  /// Block the calling thread until the queue reaches fenceValue
+  virtual void WaitForValue(UINT64 fenceValue) = 0;
+};
+
+/// Batches uploads to default-heap buffers through a ring of staging memory
+class StagingUploader
+{
+public:
+  struct Statistics
+  {
+    /// Bytes copied through the ring
+    UINT64 uploadedBytes = 0;
+    /// Number of Upload calls
+    UINT64 uploadCount = 0;
+    /// Number of copy commands issued, after merging
+    UINT64 copyCount = 0;
+    /// Number of queue submissions
+    UINT64 submissionCount = 0;
+  };
+
+  /// Use the given upload-heap range as the staging ring, and issue the copies
+  /// on queue. Both must outlive the uploader
+  void Init(CopyQueue* queue, const BufferAllocation& ring);
+
+  /// Copy size bytes of data to dest at destOffset. The copy only happens on
+  /// the GPU after the next Flush
+  void Upload(ID3D12Resource* dest, UINT64 destOffset, const void* data, UINT64 size);
+  void Upload(const BufferAllocation& dest, const void* data, UINT64 size)
+  {
+    Upload(dest.resource, dest.offset, data, size);
+  }
+
+  /// Submit the pending copies, and return the fence value signaled once they
+  /// are done. Returns the value of the previous submission if nothing is
+  /// pending
+  UINT64 Flush();
+
+  /// Submit the pending copies and wait for all of them to complete
+  void WaitIdle();
+
+  const Statistics& GetStatistics() const { return m_stats; }
+
+private:
+  struct PendingCopy
+  {
+    ID3D12Resource* dest;
+    UINT64 destOffset;
+    UINT64 ringOffset;
+    UINT64 size;
+  };
+
+  /// Make room for size bytes in the ring, flushing and waiting for earlier
+  /// batches as needed
+  UINT64 AllocateStaging(UINT64 size);
+
+  CopyQueue* m_queue = nullptr;
+  BufferAllocation m_ring;
+  RingAllocator m_ringAllocator{0};
+  std::vector<PendingCopy> m_pending;
+  UINT64 m_lastFenceValue = 0;
+  Statistics m_stats;
+};
+} // namespace nv_helpers_dx12
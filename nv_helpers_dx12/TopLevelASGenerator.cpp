@@ -75,7 +75,52 @@ void TopLevelASGenerator::AddInstance(
                                         // invocated upon hitting the geometry
 )
 {
-  m_instances.emplace_back(Instance(bottomLevelAS, transform, instanceID, hitGroupIndex));
+  AddInstance(bottomLevelAS->GetGPUVirtualAddress(), transform, instanceID, hitGroupIndex);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add an instance whose bottom-level AS is given by its GPU address
+void TopLevelASGenerator::AddInstance(D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAS,
+                                      const DirectX::XMMATRIX& transform, UINT instanceID,
+                                      UINT hitGroupIndex)
+{
+  D3D12_RAYTRACING_INSTANCE_DESC& desc = *AddInstances(1);
+  // Instance ID visible in the shader in InstanceID()
+  desc.InstanceID = instanceID;
+  // Index of the hit group invoked upon intersection
+  desc.InstanceContributionToHitGroupIndex = hitGroupIndex;
+  // Instance flags, including backface culling, winding, etc - TODO: should
+  // be accessible from outside
+  desc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+  // Instance transform matrix. It is copied here, the matrix given by the caller
+  // often being a temporary
+  DirectX::XMMATRIX m =
+      XMMatrixTranspose(transform); // GLM is column major, the INSTANCE_DESC is row major
+  memcpy(desc.Transform, &m, sizeof(desc.Transform));
+  // Get access to the bottom level
+  desc.AccelerationStructure = bottomLevelAS;
+  // Visibility mask, always visible here - TODO: should be accessible from
+  // outside
+  desc.InstanceMask = 0xFF;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add zeroed descriptors at the end of the list, for the caller to fill
+D3D12_RAYTRACING_INSTANCE_DESC* TopLevelASGenerator::AddInstances(UINT count)
+{
+  size_t first = m_instanceDescs.size();
+  m_instanceDescs.resize(first + count, D3D12_RAYTRACING_INSTANCE_DESC{});
+  return m_instanceDescs.data() + first;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Remove all the instances, so that the generator can be filled again
+void TopLevelASGenerator::Reset()
+{
+  m_instanceDescs.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -108,7 +153,7 @@ void TopLevelASGenerator::ComputeASBufferSizes(
   prebuildDesc = {};
   prebuildDesc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
   prebuildDesc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-  prebuildDesc.NumDescs = static_cast<UINT>(m_instances.size());
+  prebuildDesc.NumDescs = static_cast<UINT>(m_instanceDescs.size());
   prebuildDesc.Flags = m_flags;
 
   // This structure is used to hold the sizes of the required scratch memory and
@@ -132,7 +177,7 @@ void TopLevelASGenerator::ComputeASBufferSizes(
   // The instance descriptors are stored as-is in GPU memory, so we can deduce
   // the required size from the instance count
   m_instanceDescsSizeInBytes =
-      ROUND_UP(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<UINT64>(m_instances.size()),
+      ROUND_UP(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<UINT64>(m_instanceDescs.size()),
                D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 
   *scratchSizeInBytes = m_scratchSizeInBytes;
@@ -161,7 +206,7 @@ void TopLevelASGenerator::Generate(
 )
 {
   // Copy the descriptors in the target descriptor buffer
-  D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs;
+  D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs = nullptr;
   descriptorsBuffer->Map(0, nullptr, reinterpret_cast<void**>(&instanceDescs));
   if (!instanceDescs)
   {
@@ -169,39 +214,42 @@ void TopLevelASGenerator::Generate(
                            "in the upload heap?");
   }
 
-  auto instanceCount = static_cast<UINT>(m_instances.size());
+  Generate(commandList, scratchBuffer->GetGPUVirtualAddress(), resultBuffer->GetGPUVirtualAddress(),
+           resultBuffer, instanceDescs, descriptorsBuffer->GetGPUVirtualAddress(), updateOnly,
+           previousResult ? previousResult->GetGPUVirtualAddress() : 0);
 
-  // Initialize the memory to zero on the first time only
-  if (!updateOnly)
-  {
-    ZeroMemory(instanceDescs, m_instanceDescsSizeInBytes);
-  }
+  descriptorsBuffer->Unmap(0, nullptr);
+}
 
-  // Create the description for each instance
-  for (uint32_t i = 0; i < instanceCount; i++)
-  {
-    // Instance ID visible in the shader in InstanceID()
-    instanceDescs[i].InstanceID = m_instances[i].instanceID;
-    // Index of the hit group invoked upon intersection
-    instanceDescs[i].InstanceContributionToHitGroupIndex = m_instances[i].hitGroupIndex;
-    // Instance flags, including backface culling, winding, etc - TODO: should
-    // be accessible from outside
-    instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-    // Instance transform matrix
-    DirectX::XMMATRIX m = XMMatrixTranspose(
-        m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
-    memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
-    // Get access to the bottom level
-    instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
-    // Visibility mask, always visible here - TODO: should be accessible from
-    // outside
-    instanceDescs[i].InstanceMask = 0xFF;
-  }
+//--------------------------------------------------------------------------------------------------
+//
+// Enqueue the construction of the acceleration structure in buffers suballocated from larger
+// resources, writing the instance descriptors to an already mapped upload range
+void TopLevelASGenerator::Generate(
+    ID3D12GraphicsCommandList4* commandList,     // Command list on which the build will be enqueued
+    D3D12_GPU_VIRTUAL_ADDRESS scratchAddress,     // Address of the scratch space
+    D3D12_GPU_VIRTUAL_ADDRESS resultAddress,      // Address where the AS is stored
+    ID3D12Resource* resultResource,               // Resource containing the result range
+    void* descriptorsData,                        // Mapped instance descriptor range
+    D3D12_GPU_VIRTUAL_ADDRESS descriptorsAddress, // GPU address of the same range
+    bool updateOnly /*= false*/,                  // If true, simply refit the existing
+                                                  // acceleration structure
+    D3D12_GPU_VIRTUAL_ADDRESS previousResult /*= 0*/ // Optional address of the previous
+                                                     // acceleration structure
+)
+{
+  auto instanceDescs = static_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(descriptorsData);
 
-  descriptorsBuffer->Unmap(0, nullptr);
+  auto instanceCount = static_cast<UINT>(m_instanceDescs.size());
+
+  // The descriptors are complete, only the padding of the buffer is cleared
+  size_t descsSize = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<size_t>(instanceCount);
+  memcpy(instanceDescs, m_instanceDescs.data(), descsSize);
+  ZeroMemory(reinterpret_cast<uint8_t*>(instanceDescs) + descsSize,
+             static_cast<size_t>(m_instanceDescsSizeInBytes) - descsSize);
 
   // If this in an update operation we need to provide the source buffer
-  D3D12_GPU_VIRTUAL_ADDRESS pSourceAS = updateOnly ? previousResult->GetGPUVirtualAddress() : 0;
+  D3D12_GPU_VIRTUAL_ADDRESS pSourceAS = updateOnly ? previousResult : 0;
 
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = m_flags;
   // The stored flags represent whether the AS has been built for updates or
@@ -217,7 +265,7 @@ void TopLevelASGenerator::Generate(
   {
     throw std::logic_error("Cannot update a top-level AS not originally built for updates");
   }
-  if (updateOnly && previousResult == nullptr)
+  if (updateOnly && previousResult == 0)
   {
     throw std::logic_error("Top-level hierarchy update requires the previous hierarchy");
   }
@@ -227,34 +275,30 @@ void TopLevelASGenerator::Generate(
   D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
   buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
   buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-  buildDesc.Inputs.InstanceDescs = descriptorsBuffer->GetGPUVirtualAddress();
+  buildDesc.Inputs.InstanceDescs = descriptorsAddress;
   buildDesc.Inputs.NumDescs = instanceCount;
-  buildDesc.DestAccelerationStructureData = {resultBuffer->GetGPUVirtualAddress()
-                                             };
-  buildDesc.ScratchAccelerationStructureData = {scratchBuffer->GetGPUVirtualAddress()
-                                                };
+  buildDesc.DestAccelerationStructureData = resultAddress;
+  buildDesc.ScratchAccelerationStructureData = scratchAddress;
   buildDesc.SourceAccelerationStructureData = pSourceAS;
   buildDesc.Inputs.Flags = flags;
 
   // Build the top-level AS
   commandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
 
+  // Builds recorded by a render graph are synchronized by the graph
+  if (resultResource == nullptr)
+  {
+    return;
+  }
+
   // Wait for the builder to complete by setting a barrier on the resulting
   // buffer. This can be important in case the rendering is triggered
   // immediately afterwards, without executing the command list
   D3D12_RESOURCE_BARRIER uavBarrier;
   uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-  uavBarrier.UAV.pResource = resultBuffer;
+  uavBarrier.UAV.pResource = resultResource;
   uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
   commandList->ResourceBarrier(1, &uavBarrier);
 }
 
-//--------------------------------------------------------------------------------------------------
-//
-//
-TopLevelASGenerator::Instance::Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID,
-                                        UINT hgId)
-    : bottomLevelAS(blAS), transform(tr), instanceID(iID), hitGroupIndex(hgId)
-{
-}
 } // namespace nv_helpers_dx12
@@ -43,7 +43,10 @@ acceleration structure and store it in the result buffer.
 Note that the build is enqueued in the command list, meaning that the scratch
 buffer needs to be kept until the command list execution is finished.
 
-
+The instances are stored as the final instance descriptors, which Generate
+copies to the descriptor buffer as-is. Large instance counts can be filled in
+bulk with AddInstances, which returns a range of zeroed descriptors that may be
+written by several threads, the transform being stored row by row.
 
 Example:
 
@@ -98,6 +101,18 @@ public:
                                  /// invocated upon hitting the geometry
   );
 
+  /// Same as above, with the bottom-level AS given by its GPU address, for
+  /// acceleration structures suballocated from larger resources
+  void AddInstance(D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAS, const DirectX::XMMATRIX& transform,
+                   UINT instanceID, UINT hitGroupIndex);
+
+  /// Add count instances whose descriptors are filled by the caller, returning the first of them.
+  /// The descriptors are zeroed, and remain valid until the next instance is added
+  D3D12_RAYTRACING_INSTANCE_DESC* AddInstances(UINT count);
+
+  /// Remove all the instances, so that the generator can be filled again
+  void Reset();
+
   /// Compute the size of the scratch space required to build the acceleration
   /// structure, as well as the size of the resulting structure. The allocation
   /// of the buffers is then left to the application
@@ -131,25 +146,27 @@ public:
                                                /// if an iterative update is requested
   );
 
-private:
-  /// Helper struct storing the instance data
-  struct Instance
-  {
-    Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID, UINT hgId);
-    /// Bottom-level AS
-    ID3D12Resource* bottomLevelAS;
-    /// Transform matrix
-    const DirectX::XMMATRIX& transform;
-    /// Instance ID visible in the shader
-    UINT instanceID;
-    /// Hit group index used to fetch the shaders from the SBT
-    UINT hitGroupIndex;
-  };
+  /// Same as above, for buffers suballocated from larger resources. The instance descriptors are
+  /// written to descriptorsData, the CPU address of an upload range located at descriptorsAddress
+  /// on the GPU. The resource containing the result is only used to place the UAV barrier waiting
+  /// for the build. If that resource is nullptr, no barrier is recorded
+  void Generate(
+      ID3D12GraphicsCommandList4* commandList, /// Command list on which the build will be enqueued
+      D3D12_GPU_VIRTUAL_ADDRESS scratchAddress, /// Address of the scratch space
+      D3D12_GPU_VIRTUAL_ADDRESS resultAddress,  /// Address where the AS is stored
+      ID3D12Resource* resultResource,           /// Resource containing the result range
+      void* descriptorsData,                    /// Mapped instance descriptor range
+      D3D12_GPU_VIRTUAL_ADDRESS descriptorsAddress, /// GPU address of the same range
+      bool updateOnly = false, /// If true, simply refit the existing acceleration structure
+      D3D12_GPU_VIRTUAL_ADDRESS previousResult = 0 /// Optional address of the previous
+                                                   /// acceleration structure
+  );
 
+private:
   /// Construction flags, indicating whether the AS supports iterative updates
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_flags;
-  /// Instances contained in the top-level AS
-  std::vector<Instance> m_instances;
+  /// Descriptors of the instances contained in the top-level AS
+  std::vector<D3D12_RAYTRACING_INSTANCE_DESC> m_instanceDescs;
 
   /// Size of the temporary memory used by the TLAS builder
   UINT64 m_scratchSizeInBytes;
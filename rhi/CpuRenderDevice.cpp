@@ -0,0 +1,788 @@
+#include "CpuRenderDevice.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "../tools/Profiler.h"
+
+namespace rhi
+{
+
+namespace
+{
+
+inline uint8_t ToUnorm8(float value)
+{
+  value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+  return static_cast<uint8_t>(value * 255.f + 0.5f);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+CpuRenderDevice::CpuRenderDevice(uint32_t width, uint32_t height, uint32_t threadCount /*= 0*/)
+    : m_pool(threadCount)
+{
+  m_output.width = width;
+  m_output.height = height;
+  m_output.pixels.resize(4 * static_cast<size_t>(width) * height);
+  m_shadowBatches.resize(m_pool.GetThreadCount());
+  m_pathTracers.resize(m_pool.GetThreadCount());
+  cpu::RegisterSampleShaders(m_shaders);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Persistent data is referenced in place
+BufferHandle CpuRenderDevice::CreateBuffer(const BufferDesc& desc)
+{
+  const uint8_t* data = static_cast<const uint8_t*>(desc.data);
+  if (desc.persistent)
+  {
+    m_buffers.emplace_back();
+    m_bufferData.push_back(data);
+  }
+  else
+  {
+    m_buffers.emplace_back(data, data + desc.size);
+    m_bufferData.push_back(m_buffers.back().data());
+  }
+  return static_cast<BufferHandle>(m_buffers.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+AccelerationStructureHandle
+CpuRenderDevice::CreateBottomLevelAS(const std::vector<GeometryDesc>& geometry)
+{
+  m_bottomLevels.emplace_back(new BottomLevel());
+  m_bottomLevels.back()->geometry = geometry;
+  return static_cast<AccelerationStructureHandle>(m_bottomLevels.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::BuildBottomLevelAS()
+{
+  for (std::unique_ptr<BottomLevel>& bottomLevel : m_bottomLevels)
+  {
+    if (bottomLevel->built)
+    {
+      continue;
+    }
+    std::vector<cpu::TriangleGeometry> geometry;
+    for (const GeometryDesc& desc : bottomLevel->geometry)
+    {
+      geometry.push_back({GetVertices(desc.vertexBuffer), desc.vertexCount,
+                          GetIndices(desc.indexBuffer), desc.indexCount});
+    }
+    bottomLevel->as.Build(geometry);
+    bottomLevel->built = true;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::vector<uint8_t> CpuRenderDevice::SerializeBottomLevelAS(AccelerationStructureHandle blas) const
+{
+  if (blas >= m_bottomLevels.size() || !m_bottomLevels[blas]->built)
+  {
+    throw std::logic_error("Only built bottom-level acceleration structures can be serialized");
+  }
+  return m_bottomLevels[blas]->as.Serialize();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The structure is attached to the data, and hence never built
+AccelerationStructureHandle
+CpuRenderDevice::CreatePrebuiltBottomLevelAS(const std::vector<GeometryDesc>& geometry,
+                                             const void* data, uint64_t size)
+{
+  std::unique_ptr<BottomLevel> bottomLevel(new BottomLevel());
+  bottomLevel->geometry = geometry;
+  bottomLevel->as.Attach(data, size);
+  bottomLevel->built = true;
+  m_bottomLevels.push_back(std::move(bottomLevel));
+  return static_cast<AccelerationStructureHandle>(m_bottomLevels.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pixels of the previous frames may show instances which moved, and the visibility cache is
+// only kept if the instances are the same
+void CpuRenderDevice::SetInstances(const std::vector<InstanceDesc>& instances)
+{
+  bool same = instances.size() == m_instances.size();
+  for (size_t i = 0; same && i < instances.size(); i++)
+  {
+    same = instances[i].blas == m_instances[i].blas &&
+           instances[i].transform == m_instances[i].transform &&
+           instances[i].hitGroupIndex == m_instances[i].hitGroupIndex;
+  }
+  if (!same && m_visibilityCache != nullptr)
+  {
+    m_visibilityCache->Clear();
+  }
+  m_instances = instances;
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Look up the C++ equivalents of all the shaders of the pipeline, so that a missing one is reported
+// at creation rather than when tracing
+void CpuRenderDevice::CreateRayTracingPipeline(const RayTracingPipelineDesc& desc)
+{
+  m_shaders.FindRayGen(desc.rayGen);
+  for (const std::wstring& miss : desc.missShaders)
+  {
+    m_shaders.FindMiss(miss);
+  }
+  m_hitGroups.clear();
+  for (const HitGroupDesc& hitGroup : desc.hitGroups)
+  {
+    m_hitGroups[hitGroup.name] = m_shaders.FindClosestHit(hitGroup.closestHit);
+  }
+  m_dispatch.maxRecursionDepth = desc.maxRecursionDepth;
+  m_hasPipeline = true;
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The records keep the CPU addresses of the buffers. The scene is available to all the shaders
+// through the dispatch state, hence bindScene has no effect
+void CpuRenderDevice::CreateShaderTable(const ShaderTableDesc& desc)
+{
+  if (!m_hasPipeline)
+  {
+    throw std::logic_error("The shader table requires a raytracing pipeline");
+  }
+
+  m_dispatch.rayGen = m_shaders.FindRayGen(desc.rayGen);
+  m_dispatch.missShaders.clear();
+  for (const ShaderRecordDesc& miss : desc.missShaders)
+  {
+    m_dispatch.missShaders.push_back(m_shaders.FindMiss(miss.shader));
+  }
+
+  m_dispatch.hitGroups.clear();
+  for (const ShaderRecordDesc& hitGroup : desc.hitGroups)
+  {
+    auto it = m_hitGroups.find(hitGroup.shader);
+    if (it == m_hitGroups.end())
+    {
+      throw std::logic_error("Hit group not found in the raytracing pipeline");
+    }
+    cpu::HitGroupRecord record;
+    record.closestHit = it->second;
+    for (BufferHandle buffer : hitGroup.buffers)
+    {
+      record.buffers.push_back(buffer != InvalidHandle ? m_bufferData.at(buffer) : nullptr);
+    }
+    m_dispatch.hitGroups.push_back(record);
+  }
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::BeginFrame(const Camera& camera)
+{
+  m_camera = camera;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The instances are converted in parallel chunks. Exceptions are not propagated by the pool, so the
+// chunks only flag the instances of unbuilt structures, reported once they are all done
+void CpuRenderDevice::BuildTopLevelAS()
+{
+  const uint32_t ChunkSize = 4096;
+  uint32_t instanceCount = static_cast<uint32_t>(m_instances.size());
+  uint32_t chunkCount = (instanceCount + ChunkSize - 1) / ChunkSize;
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    tools::ProfileZone zone("TLAS fill");
+    m_topLevelInstances.resize(instanceCount);
+    std::vector<uint8_t> chunkErrors(chunkCount, 0);
+    m_pool.ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t /*thread*/) {
+      uint32_t end = (chunk + 1) * ChunkSize < instanceCount ? (chunk + 1) * ChunkSize
+                                                             : instanceCount;
+      for (uint32_t i = chunk * ChunkSize; i < end; i++)
+      {
+        const InstanceDesc& instance = m_instances[i];
+        const BottomLevel* bottomLevel =
+            instance.blas < m_bottomLevels.size() ? m_bottomLevels[instance.blas].get() : nullptr;
+        if (bottomLevel == nullptr || !bottomLevel->built)
+        {
+          chunkErrors[chunk] = 1;
+          continue;
+        }
+        m_topLevelInstances[i] = {&bottomLevel->as, instance.transform, instance.hitGroupIndex};
+      }
+    });
+    for (uint8_t error : chunkErrors)
+    {
+      if (error != 0)
+      {
+        throw std::logic_error("Instance of a bottom-level AS which has not been built");
+      }
+    }
+  }
+  m_topLevelTimings.fillMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  m_topLevel.Build(m_topLevelInstances, &m_pool);
+  m_topLevelTimings.transformMs = m_topLevel.GetBuildTimings().transformMs;
+  m_topLevelTimings.bvhMs = m_topLevel.GetBuildTimings().bvhMs;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Rebuild the top-level structure, and invoke the ray generation shader for each pixel, or for the
+// pixels the reprojection cache cannot reuse. The cache keeps one pixel per pixel of the output
+// image, so smaller dispatches trace all their pixels. The denoiser needs the guides of all the
+// pixels, which the reused ones do not write, so it bypasses the cache
+void CpuRenderDevice::DispatchRays(uint32_t width, uint32_t height)
+{
+  tools::ProfileZone zone("DispatchRays");
+  BeginDispatch(width, height);
+  m_dispatch.primaryHits = nullptr;
+  if (m_reprojectionEnabled && m_dispatch.guides == nullptr && width == m_output.width &&
+      height == m_output.height)
+  {
+    DispatchReprojected();
+    return;
+  }
+  InvokeRayGen(width, height);
+  EndDispatch();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetDenoiser(bool enabled, const cpu::DenoiseSettings& settings /*= {}*/)
+{
+  m_denoiserEnabled = enabled;
+  m_denoiser.SetSettings(settings);
+  m_denoiser.Reset();
+  if (!enabled)
+  {
+    m_guides = {};
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetReprojection(bool enabled,
+                                      const cpu::ReprojectionSettings& settings /*= {}*/)
+{
+  m_reprojectionEnabled = enabled;
+  m_reprojection.SetSettings(settings);
+  m_reprojection.Invalidate();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetVisibilityCache(bool enabled,
+                                         const cpu::VisibilityCacheSettings& settings /*= {}*/)
+{
+  m_visibilityCache.reset(enabled ? new cpu::VisibilityCache(settings) : nullptr);
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+CpuRenderDevice::VisibilityCacheStats CpuRenderDevice::GetVisibilityCacheStats() const
+{
+  VisibilityCacheStats stats;
+  if (m_visibilityCache != nullptr)
+  {
+    stats.cells = m_visibilityCache->GetSize();
+    stats.shadowRays = m_visibilityCache->GetInsertCount() - m_visibilityInsertCount;
+  }
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool CpuRenderDevice::SetLights(const std::vector<LightDesc>& lights)
+{
+  m_lights = lights;
+  m_lightBvh.Build(m_lights);
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetLightSampling(uint32_t lightsPerPoint)
+{
+  m_lightsPerPoint = lightsPerPoint;
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t CpuRenderDevice::GetShadowBatchRayCount() const
+{
+  uint64_t count = 0;
+  for (const cpu::ShadowBatch& batch : m_shadowBatches)
+  {
+    count += batch.GetTracedCount();
+  }
+  return count - m_shadowBatchRayCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetAmbientOcclusion(bool enabled,
+                                          const cpu::AmbientOcclusionSettings& settings /*= {}*/)
+{
+  if (enabled && settings.sampleCount == 0)
+  {
+    throw std::logic_error("Ambient occlusion requires at least one ray per point");
+  }
+  m_ambientOcclusionEnabled = enabled;
+  m_ambientOcclusion = settings;
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The shading time is the one of the ray generation shader, less the share of the batches
+CpuRenderDevice::RayThroughput CpuRenderDevice::GetRayThroughput() const
+{
+  RayThroughput throughput;
+  double seconds = 0.0;
+  for (const cpu::ShadowBatch& batch : m_shadowBatches)
+  {
+    seconds += batch.GetTracedSeconds();
+  }
+  throughput.primaryRays = m_primaryRayCount;
+  throughput.batchedRays = GetShadowBatchRayCount();
+  throughput.batchedMs = 1000.0 * (seconds - m_shadowBatchSeconds) / m_pool.GetThreadCount();
+  throughput.primaryMs = m_rayGenMs - throughput.batchedMs;
+  return throughput;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CpuRenderDevice::SetPathTracing(bool enabled,
+                                     const cpu::PathTracingSettings& settings /*= {}*/)
+{
+  m_pathTracingEnabled = enabled;
+  for (cpu::PathTracer& tracer : m_pathTracers)
+  {
+    tracer.SetSettings(settings);
+  }
+  m_reprojection.Invalidate();
+  m_denoiser.Reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t CpuRenderDevice::GetPathSegmentCount() const
+{
+  uint64_t count = 0;
+  for (const cpu::PathTracer& tracer : m_pathTracers)
+  {
+    count += tracer.GetSegmentCount();
+  }
+  return count - m_pathSegmentCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Reuse the pixels of the cache, trace the other ones recording their primary hits, and make the
+// frame the history of the next one. The traversal statistics are gathered per pixel, then summed
+// per tile
+void CpuRenderDevice::DispatchReprojected()
+{
+#if RHI_CPU_TRAVERSAL_STATS
+  uint32_t tilesX = (m_output.width + TileSize - 1) / TileSize;
+  uint32_t tilesY = (m_output.height + TileSize - 1) / TileSize;
+  m_pixelStats.assign(static_cast<size_t>(m_output.width) * m_output.height, {});
+  m_tileStats.assign(tilesX * tilesY, {});
+  m_tileColumns = tilesX;
+#endif
+
+  {
+    tools::ProfileZone zone("Reprojection");
+    m_reprojection.Reproject(m_camera.projection * m_camera.view, m_output, m_pool);
+  }
+  m_dispatch.primaryRecords = m_reprojection.GetRecords().data();
+  InvokeRayGen(m_reprojection.GetTracedPixels());
+  m_dispatch.primaryMiss = true;
+  InvokeRayGen(m_reprojection.GetMissPixels());
+  m_dispatch.primaryMiss = false;
+  m_dispatch.primaryRecords = nullptr;
+  {
+    tools::ProfileZone zone("Reprojection store");
+    m_reprojection.Store(m_output, glm::vec3(m_dispatch.viewInverse[3]), m_pool);
+  }
+
+#if RHI_CPU_TRAVERSAL_STATS
+  m_frameStats = {};
+  for (uint32_t y = 0; y < m_output.height; y++)
+  {
+    for (uint32_t x = 0; x < m_output.width; x++)
+    {
+      const cpu::TraversalStats& stats = m_pixelStats[static_cast<size_t>(y) * m_output.width + x];
+      m_tileStats[(y / TileSize) * tilesX + x / TileSize].Add(stats);
+      m_frameStats.Add(stats);
+    }
+  }
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Rasterize the G-buffer of the instances, complete it with the world-space positions, and invoke
+// the ray generation shader, whose rays read their hits from it
+bool CpuRenderDevice::DispatchRaysHybrid(uint32_t width, uint32_t height)
+{
+  tools::ProfileZone zone("DispatchRaysHybrid");
+  BeginDispatch(width, height);
+
+  {
+    tools::ProfileZone gbufferZone("G-buffer");
+    glm::mat4 viewProjection = m_camera.projection * m_camera.view;
+    m_rasterizer.BeginGBuffer(m_gbuffer, width, height);
+    for (uint32_t i = 0; i < m_instances.size(); i++)
+    {
+      const InstanceDesc& instance = m_instances[i];
+      const BottomLevel& bottomLevel = *m_bottomLevels[instance.blas];
+      cpu::Aabb bounds = bottomLevel.as.GetBounds();
+      glm::mat4 objectToClip = viewProjection * instance.transform;
+      for (uint32_t g = 0; g < bottomLevel.geometry.size(); g++)
+      {
+        const GeometryDesc& geometry = bottomLevel.geometry[g];
+        m_rasterizer.DrawGBuffer(objectToClip,
+                                 {GetVertices(geometry.vertexBuffer), geometry.vertexCount,
+                                  GetIndices(geometry.indexBuffer), geometry.indexCount, i, g,
+                                  bounds},
+                                 m_pool);
+      }
+    }
+    m_rasterizer.EndGBuffer(m_pool);
+
+    // Position of the hit on the triangle, as the barycentrics define it in object space
+    m_pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t x = 0; x < width; x++)
+      {
+        cpu::GBufferSample& sample = m_gbuffer.samples[static_cast<size_t>(y) * width + x];
+        if (sample.instanceIndex == InvalidHandle)
+        {
+          continue;
+        }
+        const InstanceDesc& instance = m_instances[sample.instanceIndex];
+        const GeometryDesc& geometry =
+            m_bottomLevels[instance.blas]->geometry[sample.geometryIndex];
+        const Vertex* vertices = GetVertices(geometry.vertexBuffer);
+        const uint32_t* indices = GetIndices(geometry.indexBuffer);
+        uint32_t first = 3 * sample.primitiveIndex;
+        glm::vec3 v0 = vertices[indices != nullptr ? indices[first] : first].position;
+        glm::vec3 v1 = vertices[indices != nullptr ? indices[first + 1] : first + 1].position;
+        glm::vec3 v2 = vertices[indices != nullptr ? indices[first + 2] : first + 2].position;
+        glm::vec3 position =
+            v0 + sample.barycentrics.x * (v1 - v0) + sample.barycentrics.y * (v2 - v0);
+        sample.position = glm::vec3(instance.transform * glm::vec4(position, 1.f));
+      }
+    });
+  }
+
+  m_dispatch.primaryHits = &m_gbuffer;
+  InvokeRayGen(width, height);
+  m_dispatch.primaryHits = nullptr;
+  EndDispatch();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Checks and top-level build common to the dispatches
+void CpuRenderDevice::BeginDispatch(uint32_t width, uint32_t height)
+{
+  if (m_dispatch.rayGen == nullptr)
+  {
+    throw std::logic_error("DispatchRays requires a shader table");
+  }
+  if (width > m_output.width || height > m_output.height)
+  {
+    throw std::logic_error("DispatchRays dimensions exceed the output image");
+  }
+
+  {
+    tools::ProfileZone tlasZone("TLAS build");
+    BuildTopLevelAS();
+  }
+
+  // A cache filling up would need more and more probes, and then stop storing the cells
+  if (m_visibilityCache != nullptr &&
+      m_visibilityCache->GetSize() > m_visibilityCache->GetCapacity() / 4 * 3)
+  {
+    m_visibilityCache->Clear();
+  }
+  m_visibilityInsertCount = m_visibilityCache != nullptr ? m_visibilityCache->GetInsertCount() : 0;
+  m_dispatch.visibilityCache = m_visibilityCache.get();
+
+  m_dispatch.scene = &m_topLevel;
+  m_dispatch.viewInverse = glm::inverse(m_camera.view);
+  m_dispatch.projectionInverse = glm::inverse(m_camera.projection);
+  m_dispatch.dimensions = glm::uvec2(width, height);
+  m_dispatch.lights = m_lights.data();
+  m_dispatch.lightCount = static_cast<uint32_t>(m_lights.size());
+  m_dispatch.lightBvh = m_lightsPerPoint != 0 ? &m_lightBvh : nullptr;
+  m_dispatch.lightsPerPoint = m_lightsPerPoint;
+  m_dispatch.frameIndex++;
+  bool ambientOcclusion = m_ambientOcclusionEnabled && !m_pathTracingEnabled;
+  m_dispatch.ambientOcclusion = ambientOcclusion ? &m_ambientOcclusion : nullptr;
+  m_shadowBatchRayCount = 0;
+  m_shadowBatchSeconds = 0.0;
+  for (cpu::ShadowBatch& batch : m_shadowBatches)
+  {
+    m_shadowBatchRayCount += batch.GetTracedCount();
+    m_shadowBatchSeconds += batch.GetTracedSeconds();
+    batch.SetSortCellSize(ambientOcclusion ? m_ambientOcclusion.sortCellSize : 0.f);
+    batch.SetKernel(ambientOcclusion ? cpu::TraversalKernel::Scalar
+                                     : cpu::TraversalKernel::Packet);
+  }
+  m_pathSegmentCount = 0;
+  for (const cpu::PathTracer& tracer : m_pathTracers)
+  {
+    m_pathSegmentCount += tracer.GetSegmentCount();
+  }
+  m_primaryRayCount = 0;
+  m_rayGenMs = 0.0;
+
+  // The denoiser filters the whole output image
+  m_dispatch.guides = nullptr;
+  if (m_denoiserEnabled && width == m_output.width && height == m_output.height)
+  {
+    m_guides.resize(static_cast<size_t>(width) * height);
+    m_pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t i = y * width; i < (y + 1) * width; i++)
+      {
+        m_guides[i] = {glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f), InvalidHandle};
+      }
+    });
+    m_dispatch.guides = m_guides.data();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Post-processing common to the dispatches
+void CpuRenderDevice::EndDispatch()
+{
+  if (m_dispatch.guides != nullptr)
+  {
+    m_denoiser.Denoise(m_output, m_guides, m_camera.projection * m_camera.view, m_pool);
+    m_dispatch.guides = nullptr;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Invoke the ray generation shader for each pixel of the block. The shadow rays and the paths
+// queued by the shaders are traced once all the pixels are shaded, before converting their colors
+void CpuRenderDevice::ShadePixels(const uint32_t* pixels, uint32_t count, uint32_t thread,
+                                  [[maybe_unused]] cpu::TraversalStats* blockStats)
+{
+  cpu::ShaderInvocation invocation;
+  invocation.dispatch = &m_dispatch;
+  cpu::PathTracer* pathTracer = m_pathTracingEnabled ? &m_pathTracers[thread] : nullptr;
+  bool batched = m_dispatch.lightCount != 0 || m_dispatch.ambientOcclusion != nullptr ||
+                 pathTracer != nullptr;
+  cpu::ShadowBatch* batch = batched ? &m_shadowBatches[thread] : nullptr;
+  invocation.shadowBatch = batch;
+  cpu::HitSurface surface;
+  invocation.surface = pathTracer != nullptr ? &surface : nullptr;
+  glm::vec4 colors[BlockSize];
+  for (uint32_t i = 0; i < count; i++)
+  {
+    invocation.launchIndex = glm::uvec2(pixels[i] % m_output.width, pixels[i] / m_output.width);
+    if (batch != nullptr)
+    {
+      batch->SetPixel(i);
+    }
+    RHI_CPU_STAT(cpu::ThreadTraversalStats() = {});
+    surface.hit = false;
+    colors[i] = m_dispatch.rayGen(invocation);
+    if (pathTracer != nullptr)
+    {
+      pathTracer->AddPath(i, invocation.launchIndex, surface);
+    }
+#if RHI_CPU_TRAVERSAL_STATS
+    m_pixelStats[pixels[i]] = cpu::ThreadTraversalStats();
+    if (blockStats != nullptr)
+    {
+      blockStats->Add(cpu::ThreadTraversalStats());
+    }
+#endif
+  }
+  if (batch != nullptr)
+  {
+    // The shadow rays and the paths are only counted in the statistics of the block
+    RHI_CPU_STAT(cpu::ThreadTraversalStats() = {});
+    if (pathTracer != nullptr)
+    {
+      pathTracer->Trace(m_dispatch, *batch, colors);
+    }
+    batch->Flush(m_topLevel, colors);
+#if RHI_CPU_TRAVERSAL_STATS
+    if (blockStats != nullptr)
+    {
+      blockStats->Add(cpu::ThreadTraversalStats());
+    }
+#endif
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const glm::vec4& color = colors[i];
+    uint8_t* out = &m_output.pixels[4 * static_cast<size_t>(pixels[i])];
+    out[0] = ToUnorm8(color.r);
+    out[1] = ToUnorm8(color.g);
+    out[2] = ToUnorm8(color.b);
+    out[3] = ToUnorm8(color.a);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Invoke the ray generation shader for each pixel, tile by tile
+void CpuRenderDevice::InvokeRayGen(uint32_t width, uint32_t height)
+{
+  uint32_t tilesX = (width + TileSize - 1) / TileSize;
+  uint32_t tilesY = (height + TileSize - 1) / TileSize;
+#if RHI_CPU_TRAVERSAL_STATS
+  m_pixelStats.assign(static_cast<size_t>(m_output.width) * m_output.height, {});
+  m_tileStats.assign(tilesX * tilesY, {});
+  m_tileColumns = tilesX;
+#endif
+  auto start = std::chrono::steady_clock::now();
+  m_pool.ParallelFor(tilesX * tilesY, [&](uint32_t tile, uint32_t thread) {
+    tools::ProfileZone tileZone("Tile");
+    uint32_t x0 = (tile % tilesX) * TileSize;
+    uint32_t y0 = (tile / tilesX) * TileSize;
+    uint32_t x1 = x0 + TileSize < width ? x0 + TileSize : width;
+    uint32_t y1 = y0 + TileSize < height ? y0 + TileSize : height;
+    uint32_t pixels[BlockSize];
+    uint32_t count = 0;
+    for (uint32_t y = y0; y < y1; y++)
+    {
+      for (uint32_t x = x0; x < x1; x++)
+      {
+        pixels[count++] = y * m_output.width + x;
+      }
+    }
+#if RHI_CPU_TRAVERSAL_STATS
+    ShadePixels(pixels, count, thread, &m_tileStats[tile]);
+#else
+    ShadePixels(pixels, count, thread, nullptr);
+#endif
+  });
+  m_primaryRayCount += static_cast<uint64_t>(width) * height;
+  m_rayGenMs +=
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+#if RHI_CPU_TRAVERSAL_STATS
+  m_frameStats = {};
+  for (const cpu::TraversalStats& tileStats : m_tileStats)
+  {
+    m_frameStats.Add(tileStats);
+  }
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pixels are handed out to the threads in blocks
+void CpuRenderDevice::InvokeRayGen(const std::vector<uint32_t>& pixels)
+{
+  uint32_t pixelCount = static_cast<uint32_t>(pixels.size());
+  auto start = std::chrono::steady_clock::now();
+  uint32_t blockCount = (pixelCount + BlockSize - 1) / BlockSize;
+  m_pool.ParallelFor(blockCount, [&](uint32_t block, uint32_t thread) {
+    tools::ProfileZone blockZone("Pixels");
+    uint32_t first = block * BlockSize;
+    uint32_t count = first + BlockSize < pixelCount ? BlockSize : pixelCount - first;
+    ShadePixels(pixels.data() + first, count, thread, nullptr);
+  });
+  // The pixels known to miss trace no ray
+  m_primaryRayCount += m_dispatch.primaryMiss ? 0 : pixelCount;
+  m_rayGenMs +=
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same clear color as the D3D12 backend
+void CpuRenderDevice::DrawRaster(const std::vector<DrawDesc>& draws)
+{
+  tools::ProfileZone zone("DrawRaster");
+  m_rasterizer.Clear(m_output, glm::vec4(0.f, 0.2f, 0.4f, 1.f));
+  glm::mat4 viewProjection = m_camera.projection * m_camera.view;
+  for (const DrawDesc& draw : draws)
+  {
+    m_rasterizer.Draw(m_output, viewProjection, GetVertices(draw.vertexBuffer), draw.vertexCount,
+                      GetIndices(draw.indexBuffer), draw.indexCount, m_pool);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The work is done synchronously by the calls recording it, so the image is ready
+void CpuRenderDevice::EndFrame(Image* readback /*= nullptr*/)
+{
+  if (readback != nullptr)
+  {
+    tools::ProfileZone zone("Readback");
+    *readback = m_output;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+const Vertex* CpuRenderDevice::GetVertices(BufferHandle buffer) const
+{
+  return buffer != InvalidHandle ? reinterpret_cast<const Vertex*>(m_bufferData.at(buffer))
+                                 : nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+const uint32_t* CpuRenderDevice::GetIndices(BufferHandle buffer) const
+{
+  return buffer != InvalidHandle ? reinterpret_cast<const uint32_t*>(m_bufferData.at(buffer))
+                                 : nullptr;
+}
+} // namespace rhi
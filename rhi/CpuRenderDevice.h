@@ -0,0 +1,270 @@
+/*
+CPU backend of the rendering hardware interface: a multithreaded ray tracer
+and rasterizer writing to an image in memory, with no dependency on Windows or
+on a GPU.
+
+Buffers are copies of the data given at creation, or reference it if it is
+persistent. The bottom-level acceleration structures are BVHs built on the
+CPU, which can be serialized and recreated in place from the serialized data,
+and the top-level one is rebuilt at each DispatchRays from the current
+instances, on the threads of the pool, timing each stage of the build. The
+ray generation shader is invoked for each pixel, the image
+being split in tiles handed out to the threads of a pool. The shaders are the
+C++ functions registered under the export names of the pipeline, the sample
+ones being registered at construction.
+
+The hybrid dispatches rasterize the instances to a G-buffer with the
+rasterizer of the backend, complete it with the world-space positions of the
+visible surfaces, and run the ray generation shader as DispatchRays does, its
+rays reading their hits from the G-buffer: only the shadow rays of the sample
+traverse the acceleration structures.
+
+With the reprojection cache enabled (see cpu/ReprojectionCache.h), DispatchRays
+reuses the pixels of the previous frames while only the camera moves, and
+invokes the ray generation shader only for the pixels it cannot reuse. The
+cache is invalidated by the changes of the instances or of the shaders.
+
+With the denoiser enabled (see cpu/Denoiser.h), the hit shaders of the
+primary rays write the guides of the denoiser, which then filters the output
+image in place at the end of the dispatch.
+
+With lights set (see cpu/Lights.h), the hit shaders of the sample shade the
+plane with them instead of its point light, and each thread traces the shadow
+rays queued by the shaders of a tile in one batch (see cpu/ShadowBatch.h).
+With light sampling enabled, the shaders only sample a few lights per point,
+picked by a light hierarchy (see cpu/LightBvh.h) built by SetLights.
+
+With ambient occlusion enabled, the hit shaders of the sample render the
+occlusion of the primary hits instead of their shading, with rays traced in
+sorted batches. The throughput of the primary rays, with their shading, and of
+the batched rays is measured by each dispatch.
+
+With path tracing enabled, the hit shaders of the sample return the surfaces
+of the primary hits instead of shading them, and each thread extends the hits
+of a tile into multi-bounce paths with its path tracer (see cpu/PathTracer.h),
+whose light sample rays are traced in the shadow batch of the thread. Ambient
+occlusion is ignored while path tracing.
+
+With the visibility cache enabled (see cpu/VisibilityCache.h), the shadow rays
+of the plane are traced once per world-space cell and light, the visibility
+being reused by the next frames until the instances change.
+
+When the traversal statistics are compiled in (see cpu/TraversalStats.h), each
+DispatchRays records the statistics of each pixel, summed per tile and over
+the whole dispatch.
+
+Example:
+
+CpuRenderDevice device(1280, 720);
+SampleScene scene;
+scene.Create(device, {});
+Image image;
+scene.Render(device, camera, RenderMode::RayTraced, &image);
+
+*/
+
+#pragma once
+
+#include <map>
+#include <memory>
+
+#include "RenderDevice.h"
+#include "cpu/AccelerationStructure.h"
+#include "cpu/Denoiser.h"
+#include "cpu/PathTracer.h"
+#include "cpu/Rasterizer.h"
+#include "cpu/ReprojectionCache.h"
+#include "cpu/Shaders.h"
+#include "cpu/ThreadPool.h"
+#include "cpu/TraversalStats.h"
+#include "cpu/VisibilityCache.h"
+
+namespace rhi
+{
+
+class CpuRenderDevice : public RenderDevice
+{
+public:
+  /// Create a device rendering width x height images with threadCount threads, 0 using one thread
+  /// per hardware thread
+  CpuRenderDevice(uint32_t width, uint32_t height, uint32_t threadCount = 0);
+
+  BufferHandle CreateBuffer(const BufferDesc& desc) override;
+  AccelerationStructureHandle
+  CreateBottomLevelAS(const std::vector<GeometryDesc>& geometry) override;
+  void BuildBottomLevelAS() override;
+  std::vector<uint8_t> SerializeBottomLevelAS(AccelerationStructureHandle blas) const override;
+  AccelerationStructureHandle CreatePrebuiltBottomLevelAS(const std::vector<GeometryDesc>& geometry,
+                                                          const void* data, uint64_t size) override;
+  void SetInstances(const std::vector<InstanceDesc>& instances) override;
+  void CreateRayTracingPipeline(const RayTracingPipelineDesc& desc) override;
+  void CreateShaderTable(const ShaderTableDesc& desc) override;
+  void BeginFrame(const Camera& camera) override;
+  void DispatchRays(uint32_t width, uint32_t height) override;
+  bool DispatchRaysHybrid(uint32_t width, uint32_t height) override;
+  bool SetLights(const std::vector<LightDesc>& lights) override;
+  void DrawRaster(const std::vector<DrawDesc>& draws) override;
+  void EndFrame(Image* readback = nullptr) override;
+  void WaitIdle() override {}
+  uint32_t GetWidth() const override { return m_output.width; }
+  uint32_t GetHeight() const override { return m_output.height; }
+
+  /// Registry in which the C++ equivalents of additional shaders can be registered, before
+  /// creating the pipeline using them
+  cpu::ShaderRegistry& GetShaderRegistry() { return m_shaders; }
+
+  uint32_t GetThreadCount() const { return m_pool.GetThreadCount(); }
+
+  /// Size of the square tiles of pixels handed out to the threads
+  static const uint32_t TileSize = 16;
+  /// Largest number of pixels shaded at once by a thread, a tile or a chunk of a pixel list
+  static const uint32_t BlockSize = TileSize * TileSize;
+
+  /// Traversal statistics of the last DispatchRays, per pixel of the output image in rows of
+  /// GetWidth() pixels, per tile in rows of GetTileColumns() tiles, and in total. Empty unless
+  /// RHI_CPU_TRAVERSAL_STATS is enabled
+  const std::vector<cpu::TraversalStats>& GetPixelStats() const { return m_pixelStats; }
+  const std::vector<cpu::TraversalStats>& GetTileStats() const { return m_tileStats; }
+  uint32_t GetTileColumns() const { return m_tileColumns; }
+  const cpu::TraversalStats& GetFrameStats() const { return m_frameStats; }
+
+  /// Durations of the stages of the top-level build of the last DispatchRays, in milliseconds
+  struct TopLevelTimings
+  {
+    /// Conversion of the instances, referencing the built bottom-level structures
+    double fillMs = 0.0;
+    /// Stages of cpu::TopLevelAS::Build
+    double transformMs = 0.0;
+    double bvhMs = 0.0;
+  };
+  const TopLevelTimings& GetTopLevelTimings() const { return m_topLevelTimings; }
+
+  /// Enable the reprojection cache of DispatchRays, or disable it and forget its history
+  void SetReprojection(bool enabled, const cpu::ReprojectionSettings& settings = {});
+  /// Pixels of the last DispatchRays with the reprojection cache, by origin of their color
+  const cpu::ReprojectionStats& GetReprojectionStats() const { return m_reprojection.GetStats(); }
+
+  /// Enable the light visibility cache of the shadow rays, or disable it and free its memory
+  void SetVisibilityCache(bool enabled, const cpu::VisibilityCacheSettings& settings = {});
+  struct VisibilityCacheStats
+  {
+    /// Cells stored in the cache
+    uint32_t cells = 0;
+    /// Shadow rays traced to fill the cache by the last dispatch
+    uint64_t shadowRays = 0;
+  };
+  VisibilityCacheStats GetVisibilityCacheStats() const;
+
+  /// Sample lightsPerPoint lights per shaded point with the light hierarchy, or all the lights if
+  /// 0
+  void SetLightSampling(uint32_t lightsPerPoint);
+  /// Shadow rays traced in batches by the last dispatch
+  uint64_t GetShadowBatchRayCount() const;
+
+  /// Replace the shading of the sample hit shaders by ambient occlusion, or restore it
+  void SetAmbientOcclusion(bool enabled, const cpu::AmbientOcclusionSettings& settings = {});
+
+  /// Rays of the last dispatch and the time spent on them, in milliseconds: the primary rays, or
+  /// the G-buffer reads of the hybrid mode, with their shading, and the rays traced in batches.
+  /// The batch times are summed over the threads and divided by their number
+  struct RayThroughput
+  {
+    uint64_t primaryRays = 0;
+    double primaryMs = 0.0;
+    uint64_t batchedRays = 0;
+    double batchedMs = 0.0;
+  };
+  RayThroughput GetRayThroughput() const;
+
+  /// Replace the shading of the sample hit shaders by multi-bounce paths, or restore it
+  void SetPathTracing(bool enabled, const cpu::PathTracingSettings& settings = {});
+  /// Path segments traced after the primary hits by the last dispatch
+  uint64_t GetPathSegmentCount() const;
+
+  /// Enable the denoising of the dispatches, or disable it and free its memory
+  void SetDenoiser(bool enabled, const cpu::DenoiseSettings& settings = {});
+  /// Durations of the stages of the denoiser in the last dispatch
+  const cpu::DenoiseTimings& GetDenoiseTimings() const { return m_denoiser.GetTimings(); }
+
+private:
+  struct BottomLevel
+  {
+    std::vector<GeometryDesc> geometry;
+    cpu::BottomLevelAS as;
+    bool built = false;
+  };
+
+  /// Vertex data of a buffer, or null
+  const Vertex* GetVertices(BufferHandle buffer) const;
+  const uint32_t* GetIndices(BufferHandle buffer) const;
+
+  /// Build the top-level structure from the current instances
+  void BuildTopLevelAS();
+  void BeginDispatch(uint32_t width, uint32_t height);
+  void EndDispatch();
+  /// Shade count pixels of the output image given by their indices on the given thread, at most
+  /// BlockSize, adding their traversal statistics to blockStats if not null
+  void ShadePixels(const uint32_t* pixels, uint32_t count, uint32_t thread,
+                   cpu::TraversalStats* blockStats);
+  void InvokeRayGen(uint32_t width, uint32_t height);
+  /// Invoke the ray generation shader for a list of pixel indices of the output image
+  void InvokeRayGen(const std::vector<uint32_t>& pixels);
+  void DispatchReprojected();
+
+  /// Copies of the buffer data, empty for persistent buffers. Moving the vectors when the array
+  /// grows keeps their storage in place
+  std::vector<std::vector<uint8_t>> m_buffers;
+  /// Data of each buffer, either its copy or the persistent data
+  std::vector<const uint8_t*> m_bufferData;
+  /// The top-level structure references the bottom-level ones, which hence never move
+  std::vector<std::unique_ptr<BottomLevel>> m_bottomLevels;
+  std::vector<InstanceDesc> m_instances;
+  /// Instances of the last top-level build, kept to reuse their storage
+  std::vector<cpu::TopLevelAS::Instance> m_topLevelInstances;
+  cpu::TopLevelAS m_topLevel;
+  TopLevelTimings m_topLevelTimings;
+
+  cpu::ShaderRegistry m_shaders;
+  /// Closest hit shader of each hit group of the pipeline
+  std::map<std::wstring, cpu::ClosestHitShader> m_hitGroups;
+  bool m_hasPipeline = false;
+  cpu::DispatchState m_dispatch;
+
+  cpu::ThreadPool m_pool;
+  cpu::Rasterizer m_rasterizer;
+  /// Primary visibility of the hybrid dispatches
+  cpu::GBuffer m_gbuffer;
+  cpu::ReprojectionCache m_reprojection;
+  bool m_reprojectionEnabled = false;
+  std::unique_ptr<cpu::VisibilityCache> m_visibilityCache;
+  /// Insertions into the visibility cache before the last dispatch
+  uint64_t m_visibilityInsertCount = 0;
+  cpu::Denoiser m_denoiser;
+  bool m_denoiserEnabled = false;
+  std::vector<cpu::DenoiseGuide> m_guides;
+  std::vector<LightDesc> m_lights;
+  cpu::LightBvh m_lightBvh;
+  uint32_t m_lightsPerPoint = 0;
+  /// Shadow batch of each thread of the pool, and the rays they traced and the time they spent
+  /// before the last dispatch
+  std::vector<cpu::ShadowBatch> m_shadowBatches;
+  uint64_t m_shadowBatchRayCount = 0;
+  double m_shadowBatchSeconds = 0.0;
+  cpu::AmbientOcclusionSettings m_ambientOcclusion;
+  bool m_ambientOcclusionEnabled = false;
+  /// Path tracer of each thread of the pool, and the segments they traced before the last dispatch
+  std::vector<cpu::PathTracer> m_pathTracers;
+  uint64_t m_pathSegmentCount = 0;
+  bool m_pathTracingEnabled = false;
+  /// Pixels shaded by the ray generation shader in the last dispatch, and its duration
+  uint64_t m_primaryRayCount = 0;
+  double m_rayGenMs = 0.0;
+  Camera m_camera = {};
+  Image m_output;
+
+  std::vector<cpu::TraversalStats> m_pixelStats;
+  std::vector<cpu::TraversalStats> m_tileStats;
+  uint32_t m_tileColumns = 0;
+  cpu::TraversalStats m_frameStats;
+};
+} // namespace rhi
@@ -0,0 +1,928 @@
+#include "../stdafx.h"
+
+#include "D3D12RenderDevice.h"
+
+#include <cstring>
+#include <stdexcept>
+
+// DXRHelper.h expects the DirectXMath types in the global namespace
+using namespace DirectX;
+#include "../DXRHelper.h"
+#include "../nv_helpers_dx12/BottomLevelASGenerator.h"
+#include "../nv_helpers_dx12/RaytracingPipelineGenerator.h"
+#include "../nv_helpers_dx12/RootSignatureGenerator.h"
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "../tools/Profiler.h"
+#include "cpu/Simd.h"
+
+namespace rhi
+{
+
+using Microsoft::WRL::ComPtr;
+using nv_helpers_dx12::ResourceState;
+
+namespace
+{
+/// Clear color of the raster frames
+const float ClearColor[] = {0.0f, 0.2f, 0.4f, 1.0f};
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+D3D12RenderDevice::D3D12RenderDevice(ID3D12Device5* device, ID3D12CommandQueue* commandQueue,
+                                     IDXGISwapChain3* swapChain, uint32_t width, uint32_t height)
+    : m_device(device), m_commandQueue(commandQueue), m_swapChain(swapChain), m_width(width),
+      m_height(height)
+{
+  CreateTargets();
+
+  ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+                                                 IID_PPV_ARGS(&m_commandAllocator)));
+
+  // Buffers are suballocated from shared heaps rather than being created as individual committed
+  // resources
+  m_gpuAllocator.Init(m_device.Get(), FrameCount);
+
+  // Static data is staged through a ring of upload memory and copied to the default heap on a
+  // dedicated copy queue
+  m_copyQueue.Init(m_device.Get());
+  m_stagingRing = m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Upload, 4 * 1024 * 1024);
+  m_uploader.Init(&m_copyQueue, m_stagingRing);
+
+  // All the descriptors used by the shaders live in a single shader-visible heap, split in
+  // persistent and per-frame ranges
+  m_descriptorAllocator.Init(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096,
+                             FrameCount, 1024);
+
+  // The barriers of each frame are derived from a render graph
+  m_renderGraphResources.Init(m_device.Get());
+
+  CreateRasterPipeline();
+
+  // Command lists are created in the recording state, but there is nothing to record yet
+  ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+                                            m_commandAllocator.Get(), m_pipelineState.Get(),
+                                            IID_PPV_ARGS(&m_commandList)));
+  ThrowIfFailed(m_commandList->Close());
+
+  ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr)
+  {
+    ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+  }
+
+  m_blasBatcher.Init(m_device.Get(), &m_gpuAllocator);
+
+  CreateRaytracingOutputBuffer();
+  CreateCameraBuffer();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Ensure that the GPU is no longer referencing resources that are about to be released
+D3D12RenderDevice::~D3D12RenderDevice()
+{
+  WaitIdle();
+
+  m_copyQueue.Release();
+  m_blasBatcher.Release();
+  m_gpuAllocator.Release();
+  m_descriptorAllocator.Release();
+  m_renderGraphResources.Release();
+
+  CloseHandle(m_fenceEvent);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Render target views of the back buffers, or of offscreen textures created in the present state
+// so that both kinds of targets go through the same barriers, and the depth buffer
+void D3D12RenderDevice::CreateTargets()
+{
+  D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+  rtvHeapDesc.NumDescriptors = FrameCount;
+  rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+  rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+  ThrowIfFailed(m_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
+  m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+  D3D12_CLEAR_VALUE colorClearValue = {};
+  colorClearValue.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+  memcpy(colorClearValue.Color, ClearColor, sizeof(ClearColor));
+
+  CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+  for (UINT n = 0; n < FrameCount; n++)
+  {
+    if (m_swapChain)
+    {
+      ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+    }
+    else
+    {
+      CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(
+          DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height, 1, 1, 1, 0,
+          D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+      ThrowIfFailed(m_device->CreateCommittedResource(
+          &nv_helpers_dx12::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &desc,
+          D3D12_RESOURCE_STATE_PRESENT, &colorClearValue, IID_PPV_ARGS(&m_renderTargets[n])));
+    }
+    m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
+    rtvHandle.Offset(1, m_rtvDescriptorSize);
+  }
+  m_frameIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex() : 0;
+
+  // #DXR Extra: Depth Buffering
+  // The raster pipeline tests against a 32-bit floating-point depth buffer
+  D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+  dsvHeapDesc.NumDescriptors = 1;
+  dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+  dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+  ThrowIfFailed(m_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
+
+  D3D12_CLEAR_VALUE depthClearValue = {};
+  depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+  depthClearValue.DepthStencil.Depth = 1.0f;
+  CD3DX12_RESOURCE_DESC depthDesc =
+      CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, m_width, m_height, 1, 1, 1, 0,
+                                   D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+  ThrowIfFailed(m_device->CreateCommittedResource(
+      &nv_helpers_dx12::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &depthDesc,
+      D3D12_RESOURCE_STATE_DEPTH_WRITE, &depthClearValue, IID_PPV_ARGS(&m_depthBuffer)));
+  m_device->CreateDepthStencilView(m_depthBuffer.Get(), nullptr,
+                                   m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Pipeline of DrawRaster, transforming the vertices by the camera matrices
+void D3D12RenderDevice::CreateRasterPipeline()
+{
+  // #DXR Extra: Perspective Camera
+  // The camera matrices are held in a constant buffer, referenced through a range in the heap
+  // which is the sole parameter of the shader. The camera buffer is associated in the index 0,
+  // making it accessible in the shader in the b0 register.
+  CD3DX12_ROOT_PARAMETER constantParameter;
+  CD3DX12_DESCRIPTOR_RANGE range;
+  range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
+  constantParameter.InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_ALL);
+
+  CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+  rootSignatureDesc.Init(1, &constantParameter, 0, nullptr,
+                         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+  ComPtr<ID3DBlob> signature;
+  ComPtr<ID3DBlob> error;
+  ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+                                            &signature, &error));
+  ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(),
+                                              signature->GetBufferSize(),
+                                              IID_PPV_ARGS(&m_rootSignature)));
+
+  ComPtr<ID3DBlob> vertexShader;
+  ComPtr<ID3DBlob> pixelShader;
+
+#if defined(_DEBUG)
+  // Enable better shader debugging with the graphics debugging tools.
+  UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+  UINT compileFlags = 0;
+#endif
+
+  WCHAR assetsPath[512];
+  GetAssetsPath(assetsPath, _countof(assetsPath));
+  std::wstring shaderFile = std::wstring(assetsPath) + L"shaders.hlsl";
+  ThrowIfFailed(D3DCompileFromFile(shaderFile.c_str(), nullptr, nullptr, "VSMain", "vs_5_0",
+                                   compileFlags, 0, &vertexShader, nullptr));
+  ThrowIfFailed(D3DCompileFromFile(shaderFile.c_str(), nullptr, nullptr, "PSMain", "ps_5_0",
+                                   compileFlags, 0, &pixelShader, nullptr));
+
+  // Vertex input layout, matching rhi::Vertex
+  D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
+      {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+       0},
+      {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12,
+       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
+
+  D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+  psoDesc.InputLayout = {inputElementDescs, _countof(inputElementDescs)};
+  psoDesc.pRootSignature = m_rootSignature.Get();
+  psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+  psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+  psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+  // #DXR Extra - Refitting
+  psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+  psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+  // #DXR Extra: Depth Buffering
+  psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+  psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+  psoDesc.SampleMask = UINT_MAX;
+  psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+  psoDesc.NumRenderTargets = 1;
+  psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+  psoDesc.SampleDesc.Count = 1;
+  ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The raytracing output has the dimensions of the render targets, to which it is copied
+void D3D12RenderDevice::CreateRaytracingOutputBuffer()
+{
+  D3D12_RESOURCE_DESC resDesc = {};
+  resDesc.DepthOrArraySize = 1;
+  resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+  resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+  resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+  resDesc.Width = m_width;
+  resDesc.Height = m_height;
+  resDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+  resDesc.MipLevels = 1;
+  resDesc.SampleDesc.Count = 1;
+  ThrowIfFailed(m_device->CreateCommittedResource(
+      &nv_helpers_dx12::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc,
+      D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr, IID_PPV_ARGS(&m_outputResource)));
+
+  // The ray generation table holds the output UAV, the TLAS SRV and the camera CBV, in consecutive
+  // descriptors. The TLAS SRV is written once the instances are known
+  m_rayGenDescriptors = m_descriptorAllocator.AllocatePersistent(3);
+  D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+  uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+  m_device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc,
+                                      m_rayGenDescriptors.CpuHandle(0));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// #DXR Extra: Perspective Camera
+// View, projection, and their inverses used by the ray generation shader to compute the rays
+void D3D12RenderDevice::CreateCameraBuffer()
+{
+  m_cameraBufferSize = 4 * sizeof(glm::mat4);
+  m_cameraBuffer =
+      m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Upload, m_cameraBufferSize,
+                              D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+  D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+  cbvDesc.BufferLocation = m_cameraBuffer.gpuAddress;
+  cbvDesc.SizeInBytes = m_cameraBufferSize;
+
+  // The rasterization shaders reference the camera in a table of their own
+  m_rasterDescriptors = m_descriptorAllocator.AllocatePersistent(1);
+  m_device->CreateConstantBufferView(&cbvDesc, m_rasterDescriptors.CpuHandle(0));
+  m_device->CreateConstantBufferView(&cbvDesc, m_rayGenDescriptors.CpuHandle(2));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Geometry is uploaded to the default heap, constants are written directly to the upload heap
+BufferHandle D3D12RenderDevice::CreateBuffer(const BufferDesc& desc)
+{
+  nv_helpers_dx12::BufferAllocation buffer;
+  if (desc.type == BufferType::Constant)
+  {
+    buffer = m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Upload, desc.size,
+                                     D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+    memcpy(buffer.cpuAddress, desc.data, desc.size);
+  }
+  else
+  {
+    buffer = m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Default, desc.size);
+    m_uploader.Upload(buffer, desc.data, desc.size);
+    m_uploadsPending = true;
+  }
+  if (!buffer.IsValid())
+  {
+    throw std::logic_error("Could not allocate the buffer");
+  }
+  m_buffers.push_back(buffer);
+  return static_cast<BufferHandle>(m_buffers.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Submit the copies of all the geometry created since the last flush at once. The graphics queue
+// waits for them on the GPU before executing anything touching the buffers
+void D3D12RenderDevice::FlushUploads()
+{
+  if (m_uploadsPending)
+  {
+    ThrowIfFailed(m_commandQueue->Wait(m_copyQueue.GetFence(), m_uploader.Flush()));
+    m_uploadsPending = false;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Flush the command list and wait for it to finish, leaving it closed
+void D3D12RenderDevice::ExecuteAndWait()
+{
+  ThrowIfFailed(m_commandList->Close());
+  ID3D12CommandList* ppCommandLists[] = {m_commandList.Get()};
+  m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
+  WaitIdle();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12RenderDevice::WaitIdle()
+{
+  m_fenceValue++;
+  ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValue));
+  if (m_fence->GetCompletedValue() < m_fenceValue)
+  {
+    ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent));
+    WaitForSingleObject(m_fenceEvent, INFINITE);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The build itself is deferred to BuildBottomLevelAS
+AccelerationStructureHandle
+D3D12RenderDevice::CreateBottomLevelAS(const std::vector<GeometryDesc>& geometry)
+{
+  m_bottomLevelGeometry.push_back(geometry);
+  return static_cast<AccelerationStructureHandle>(m_bottomLevelGeometry.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Build all the pending BLASes together with a shared scratch space, and compact them
+void D3D12RenderDevice::BuildBottomLevelAS()
+{
+  if (m_builtBottomLevelCount == m_bottomLevelGeometry.size())
+  {
+    return;
+  }
+
+  for (size_t i = m_builtBottomLevelCount; i < m_bottomLevelGeometry.size(); i++)
+  {
+    nv_helpers_dx12::BottomLevelASGenerator bottomLevelAS;
+    for (const GeometryDesc& geometry : m_bottomLevelGeometry[i])
+    {
+      const nv_helpers_dx12::BufferAllocation& vertexBuffer = m_buffers.at(geometry.vertexBuffer);
+      if (geometry.indexBuffer != InvalidHandle && geometry.indexCount > 0)
+      {
+        const nv_helpers_dx12::BufferAllocation& indexBuffer = m_buffers.at(geometry.indexBuffer);
+        bottomLevelAS.AddVertexBuffer(vertexBuffer.resource, vertexBuffer.offset,
+                                      geometry.vertexCount, sizeof(Vertex), indexBuffer.resource,
+                                      indexBuffer.offset, geometry.indexCount, nullptr, 0, true);
+      }
+      else
+      {
+        bottomLevelAS.AddVertexBuffer(vertexBuffer.resource, vertexBuffer.offset,
+                                      geometry.vertexCount, sizeof(Vertex), 0, 0);
+      }
+    }
+    m_bottomLevelIndices.push_back(m_blasBatcher.Add(bottomLevelAS));
+  }
+  m_builtBottomLevelCount = static_cast<uint32_t>(m_bottomLevelGeometry.size());
+
+  FlushUploads();
+  ThrowIfFailed(m_commandAllocator->Reset());
+  ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+
+  // Build all the BLASes in one go, and wait for their compacted sizes
+  m_blasBatcher.Build(m_commandList.Get());
+  ExecuteAndWait();
+
+  // Copy the BLASes to buffers of their compacted size
+  ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+  m_blasBatcher.Compact(m_commandList.Get());
+  ExecuteAndWait();
+
+  // The copies are done, the original BLASes can be released
+  m_blasBatcher.FinishCompaction();
+
+  std::vector<nv_helpers_dx12::BottomLevelASCompaction> compaction =
+      m_blasBatcher.GetCompactionReport();
+  for (size_t i = 0; i < compaction.size(); i++)
+  {
+    char message[256];
+    sprintf_s(message, "BLAS %zu: %llu bytes compacted to %llu bytes, %llu bytes saved\n", i,
+              compaction[i].originalSize, compaction[i].compactedSize, compaction[i].SavedBytes());
+    OutputDebugStringA(message);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The TLAS storage is sized for the instances here, so that it does not move during the frames.
+// When it has to grow, the descriptor referencing it is rewritten
+void D3D12RenderDevice::SetInstances(const std::vector<InstanceDesc>& instances)
+{
+  m_instances = instances;
+
+  FillInstanceDescs();
+
+  UINT64 scratchSize, resultSize, instanceDescsSize;
+  m_topLevelASGenerator.ComputeASBufferSizes(m_device.Get(), true, &scratchSize, &resultSize,
+                                             &instanceDescsSize);
+  if (m_topLevelAS.IsValid() && m_topLevelAS.size >= resultSize)
+  {
+    return;
+  }
+
+  if (m_topLevelAS.IsValid())
+  {
+    WaitIdle();
+    m_gpuAllocator.Free(m_topLevelAS);
+  }
+  m_topLevelAS =
+      m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::AccelerationStructure, resultSize);
+  if (!m_topLevelAS.IsValid())
+  {
+    throw std::logic_error("Could not allocate the top-level AS");
+  }
+
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
+  srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+  srvDesc.RaytracingAccelerationStructure.Location = m_topLevelAS.gpuAddress;
+  m_device->CreateShaderResourceView(nullptr, &srvDesc, m_rayGenDescriptors.CpuHandle(1));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The descriptors are written directly in the generator, in parallel chunks. The column-major glm
+// transforms are transposed 4 floats at a time to the 3 rows of the descriptors. Exceptions are not
+// propagated by the pool, so the chunks only flag the instances of unknown structures
+void D3D12RenderDevice::FillInstanceDescs()
+{
+  tools::ProfileZone zone("TLAS instance descs");
+  const uint32_t ChunkSize = 4096;
+  uint32_t instanceCount = static_cast<uint32_t>(m_instances.size());
+  uint32_t chunkCount = (instanceCount + ChunkSize - 1) / ChunkSize;
+
+  m_topLevelASGenerator.Reset();
+  D3D12_RAYTRACING_INSTANCE_DESC* descs = m_topLevelASGenerator.AddInstances(instanceCount);
+  std::vector<uint8_t> chunkErrors(chunkCount, 0);
+  m_pool.ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t /*thread*/) {
+    uint32_t end =
+        (chunk + 1) * ChunkSize < instanceCount ? (chunk + 1) * ChunkSize : instanceCount;
+    for (uint32_t i = chunk * ChunkSize; i < end; i++)
+    {
+      const InstanceDesc& instance = m_instances[i];
+      if (instance.blas >= m_bottomLevelIndices.size())
+      {
+        chunkErrors[chunk] = 1;
+        continue;
+      }
+      const float* columns = glm::value_ptr(instance.transform);
+      cpu::Float4 row0 = cpu::Float4::Load(columns);
+      cpu::Float4 row1 = cpu::Float4::Load(columns + 4);
+      cpu::Float4 row2 = cpu::Float4::Load(columns + 8);
+      cpu::Float4 row3 = cpu::Float4::Load(columns + 12);
+      cpu::Transpose(row0, row1, row2, row3);
+      row0.Store(descs[i].Transform[0]);
+      row1.Store(descs[i].Transform[1]);
+      row2.Store(descs[i].Transform[2]);
+
+      descs[i].InstanceID = i;
+      descs[i].InstanceMask = 0xFF;
+      descs[i].InstanceContributionToHitGroupIndex = instance.hitGroupIndex;
+      descs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+      descs[i].AccelerationStructure =
+          m_blasBatcher.GetResult(m_bottomLevelIndices[instance.blas]).gpuAddress;
+    }
+  });
+  for (uint8_t error : chunkErrors)
+  {
+    if (error != 0)
+    {
+      throw std::logic_error("Instance of an unknown bottom-level AS");
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Record the build of the TLAS with the instances of the generator. The scratch space and the
+// instance descriptors are only needed while the build executes, and come from the transient arenas
+// of the frame. The render graph places the barrier after the build
+void D3D12RenderDevice::BuildTopLevelAS()
+{
+  UINT64 scratchSize, resultSize, instanceDescsSize;
+  m_topLevelASGenerator.ComputeASBufferSizes(m_device.Get(), true, &scratchSize, &resultSize,
+                                             &instanceDescsSize);
+  nv_helpers_dx12::BufferAllocation scratch = m_gpuAllocator.AllocateTransient(
+      nv_helpers_dx12::BufferUsage::UnorderedAccess, scratchSize);
+  nv_helpers_dx12::BufferAllocation instanceDescs =
+      m_gpuAllocator.AllocateTransient(nv_helpers_dx12::BufferUsage::Upload, instanceDescsSize);
+
+  m_topLevelASGenerator.Generate(m_commandList.Get(), scratch.gpuAddress, m_topLevelAS.gpuAddress,
+                                 nullptr, instanceDescs.cpuAddress, instanceDescs.gpuAddress);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ComPtr<ID3D12RootSignature> D3D12RenderDevice::CreateRayGenSignature()
+{
+  nv_helpers_dx12::RootSignatureGenerator rsc;
+  rsc.AddHeapRangesParameter(
+      {{0 /*u0*/, 1 /*1 descriptor */, 0 /*use the implicit register space 0*/,
+        D3D12_DESCRIPTOR_RANGE_TYPE_UAV /* UAV representing the output buffer*/,
+        0 /*heap slot where the UAV is defined*/},
+       {0 /*t0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/, 1},
+       {0 /*b0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_CBV /*Camera parameters*/, 2}});
+
+  return rsc.Generate(m_device.Get(), true);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ComPtr<ID3D12RootSignature> D3D12RenderDevice::CreateMissSignature()
+{
+  nv_helpers_dx12::RootSignatureGenerator rsc;
+  return rsc.Generate(m_device.Get(), true);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// #DXR Extra: Per-Instance Data
+// The vertices, indices and constants of each hit group are root parameters, defined directly by a
+// pointer in the shader binding table. The TLAS used to trace secondary rays is in a table of its
+// own
+ComPtr<ID3D12RootSignature> D3D12RenderDevice::CreateHitSignature()
+{
+  nv_helpers_dx12::RootSignatureGenerator rsc;
+  rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0);
+  rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1);
+  rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0);
+  rsc.AddHeapRangesParameter({
+      {2 /*t2*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0 /*the table starts at the TLAS*/},
+  });
+  return rsc.Generate(m_device.Get(), true);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compile the libraries, and associate the shaders to the fixed root signatures
+void D3D12RenderDevice::CreateRaytracingPipeline(const RayTracingPipelineDesc& desc)
+{
+  nv_helpers_dx12::RayTracingPipelineGenerator pipeline(m_device.Get());
+
+  m_libraries.clear();
+  for (const ShaderLibraryDesc& library : desc.libraries)
+  {
+    m_libraries.emplace_back(nv_helpers_dx12::CompileShaderLibrary(library.file.c_str()));
+    pipeline.AddLibrary(m_libraries.back().Get(), library.exports);
+  }
+
+  m_rayGenSignature = CreateRayGenSignature();
+  m_missSignature = CreateMissSignature();
+  m_hitSignature = CreateHitSignature();
+
+  std::vector<std::wstring> hitGroups;
+  for (const HitGroupDesc& hitGroup : desc.hitGroups)
+  {
+    pipeline.AddHitGroup(hitGroup.name, hitGroup.closestHit);
+    hitGroups.push_back(hitGroup.name);
+  }
+
+  pipeline.AddRootSignatureAssociation(m_rayGenSignature.Get(), {desc.rayGen});
+  pipeline.AddRootSignatureAssociation(m_missSignature.Get(), desc.missShaders);
+  pipeline.AddRootSignatureAssociation(m_hitSignature.Get(), hitGroups);
+
+  pipeline.SetMaxPayloadSize(desc.maxPayloadSize);
+  pipeline.SetMaxAttributeSize(desc.maxAttributeSize);
+  pipeline.SetMaxRecursionDepth(desc.maxRecursionDepth);
+
+  m_rtStateObject = pipeline.Generate();
+  ThrowIfFailed(m_rtStateObject->QueryInterface(IID_PPV_ARGS(&m_rtStateObjectProps)));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// GPU address of a buffer, or 0 for an unbound root parameter
+D3D12_GPU_VIRTUAL_ADDRESS D3D12RenderDevice::GetBufferAddress(BufferHandle buffer) const
+{
+  return buffer != InvalidHandle ? m_buffers.at(buffer).gpuAddress : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Root parameters of a shader record: the buffer addresses, then the table starting at the TLAS
+std::vector<void*> D3D12RenderDevice::GetRecordData(const ShaderRecordDesc& record) const
+{
+  std::vector<void*> data;
+  for (BufferHandle buffer : record.buffers)
+  {
+    data.push_back(reinterpret_cast<void*>(GetBufferAddress(buffer)));
+  }
+  if (record.bindScene)
+  {
+    data.push_back(reinterpret_cast<void*>(m_rayGenDescriptors.GpuHandle(1).ptr));
+  }
+  return data;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12RenderDevice::CreateShaderTable(const ShaderTableDesc& desc)
+{
+  if (!m_rtStateObjectProps)
+  {
+    throw std::logic_error("The shader table requires a raytracing pipeline");
+  }
+
+  m_sbtHelper.Reset();
+  auto heapPointer = reinterpret_cast<uint64_t*>(m_rayGenDescriptors.GpuHandle(0).ptr);
+  m_sbtHelper.AddRayGenerationProgram(desc.rayGen, {heapPointer});
+  for (const ShaderRecordDesc& miss : desc.missShaders)
+  {
+    m_sbtHelper.AddMissProgram(miss.shader, GetRecordData(miss));
+  }
+  for (const ShaderRecordDesc& hitGroup : desc.hitGroups)
+  {
+    m_sbtHelper.AddHitGroup(hitGroup.shader, GetRecordData(hitGroup));
+  }
+
+  const uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
+  if (!m_sbtStorage.IsValid() || m_sbtStorage.size < sbtSize)
+  {
+    if (m_sbtStorage.IsValid())
+    {
+      WaitIdle();
+      m_gpuAllocator.Free(m_sbtStorage);
+    }
+    m_sbtStorage = m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Upload, sbtSize,
+                                           D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+    if (!m_sbtStorage.IsValid())
+    {
+      throw std::logic_error("Could not allocate the shader binding table");
+    }
+  }
+
+  m_sbtHelper.Generate(m_sbtStorage.cpuAddress, m_rtStateObjectProps.Get());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Update the camera, reset the command list and start describing the frame. The previous frame has
+// completed, so its transient buffers can be reused
+void D3D12RenderDevice::BeginFrame(const Camera& camera)
+{
+  if (m_frameOpen)
+  {
+    throw std::logic_error("BeginFrame called before the end of the previous frame");
+  }
+  m_frameOpen = true;
+
+  {
+    tools::ProfileZone zone("UpdateCameraBuffer");
+    // Raytracing has to do the contrary of rasterization: rays are defined in camera space, and
+    // are transformed into world space. To do this, the inverse matrices are stored as well
+    glm::mat4 matrices[4] = {camera.view, camera.projection, glm::inverse(camera.view),
+                             glm::inverse(camera.projection)};
+    memcpy(m_cameraBuffer.cpuAddress, matrices, m_cameraBufferSize);
+  }
+
+  FlushUploads();
+
+  ThrowIfFailed(m_commandAllocator->Reset());
+  ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+
+  m_gpuAllocator.BeginFrame(m_frameIndex);
+  m_descriptorAllocator.BeginFrame(m_frameIndex);
+
+  CD3DX12_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(m_width), static_cast<float>(m_height));
+  CD3DX12_RECT scissorRect(0, 0, static_cast<LONG>(m_width), static_cast<LONG>(m_height));
+  m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+  m_commandList->RSSetViewports(1, &viewport);
+  m_commandList->RSSetScissorRects(1, &scissorRect);
+
+  // Rasterization and raytracing share the same descriptor heap
+  m_commandList->SetDescriptorHeaps(1, m_descriptorAllocator.GetHeapAddress());
+
+  // #DXR Extra: Render Graph
+  // The frame is described as a list of passes declaring the resources they use and in which
+  // state. Compiling the graph in EndFrame yields the barriers between the passes, and the
+  // transitions back to the presentable state at the end of the frame
+  m_renderGraph.Reset();
+  m_frameBindings.clear();
+  m_backBufferHandle =
+      m_renderGraph.ImportResource("BackBuffer", ResourceState::Present, ResourceState::Present);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12RenderDevice::DispatchRays(uint32_t width, uint32_t height)
+{
+  if (!m_sbtStorage.IsValid() || !m_topLevelAS.IsValid())
+  {
+    throw std::logic_error("DispatchRays requires instances and a shader table");
+  }
+
+  // The TLAS is only ever in the acceleration structure state, so the graph orders its update and
+  // the rays tracing through it with a UAV barrier
+  nv_helpers_dx12::RenderGraphHandle tlas = m_renderGraph.ImportResource(
+      "TLAS", ResourceState::AccelerationStructure, ResourceState::AccelerationStructure);
+  nv_helpers_dx12::RenderGraphHandle output = m_renderGraph.ImportResource(
+      "RaytracingOutput", ResourceState::CopySource, ResourceState::CopySource);
+  m_frameBindings.push_back({tlas, m_topLevelAS.resource});
+  m_frameBindings.push_back({output, m_outputResource.Get()});
+
+  m_renderGraph.AddPass("TLAS update", {{tlas, ResourceState::AccelerationStructure, true}},
+                        [this]() {
+                          tools::ProfileZone zone("TLAS update");
+                          BuildTopLevelAS();
+                        });
+
+  m_renderGraph.AddPass(
+      "DispatchRays",
+      {{tlas, ResourceState::AccelerationStructure}, {output, ResourceState::UnorderedAccess}},
+      [this, width, height]() {
+        tools::ProfileZone zone("DispatchRays");
+        D3D12_DISPATCH_RAYS_DESC desc = {};
+
+        desc.RayGenerationShaderRecord.StartAddress = m_sbtStorage.gpuAddress;
+        uint32_t rayGenerationSectionSizeInBytes = m_sbtHelper.GetRayGenSectionSize();
+        desc.RayGenerationShaderRecord.SizeInBytes = rayGenerationSectionSizeInBytes;
+
+        uint32_t missSectionSizeInBytes = m_sbtHelper.GetMissSectionSize();
+        desc.MissShaderTable.StartAddress =
+            m_sbtStorage.gpuAddress + rayGenerationSectionSizeInBytes;
+        desc.MissShaderTable.SizeInBytes = missSectionSizeInBytes;
+        desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
+
+        uint32_t hitGroupsSectionSize = m_sbtHelper.GetHitGroupSectionSize();
+        desc.HitGroupTable.StartAddress =
+            m_sbtStorage.gpuAddress + rayGenerationSectionSizeInBytes + missSectionSizeInBytes;
+        desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
+        desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
+
+        desc.Width = width;
+        desc.Height = height;
+        desc.Depth = 1;
+
+        m_commandList->SetPipelineState1(m_rtStateObject.Get());
+        m_commandList->DispatchRays(&desc);
+      });
+
+  m_renderGraph.AddPass(
+      "CopyToBackBuffer",
+      {{output, ResourceState::CopySource}, {m_backBufferHandle, ResourceState::CopyDest}},
+      [this]() {
+        tools::ProfileZone zone("CopyToBackBuffer");
+        m_commandList->CopyResource(m_renderTargets[m_frameIndex].Get(), m_outputResource.Get());
+      });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void D3D12RenderDevice::DrawRaster(const std::vector<DrawDesc>& draws)
+{
+  nv_helpers_dx12::RenderGraphHandle depth = m_renderGraph.ImportResource(
+      "Depth", ResourceState::DepthWrite, ResourceState::DepthWrite);
+  m_frameBindings.push_back({depth, m_depthBuffer.Get()});
+
+  m_renderGraph.AddPass(
+      "Raster",
+      {{m_backBufferHandle, ResourceState::RenderTarget}, {depth, ResourceState::DepthWrite, true}},
+      [this, draws]() {
+        tools::ProfileZone zone("Raster");
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(),
+                                                m_frameIndex, m_rtvDescriptorSize);
+        D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
+        m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+        m_commandList->SetGraphicsRootDescriptorTable(0, m_rasterDescriptors.GpuHandle(0));
+
+        m_commandList->ClearRenderTargetView(rtvHandle, ClearColor, 0, nullptr);
+        m_commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0,
+                                             nullptr);
+        m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        for (const DrawDesc& draw : draws)
+        {
+          const nv_helpers_dx12::BufferAllocation& vertexBuffer = m_buffers.at(draw.vertexBuffer);
+          D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+          vertexBufferView.BufferLocation = vertexBuffer.gpuAddress;
+          vertexBufferView.StrideInBytes = sizeof(Vertex);
+          vertexBufferView.SizeInBytes = static_cast<UINT>(vertexBuffer.size);
+          m_commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+
+          if (draw.indexBuffer != InvalidHandle)
+          {
+            const nv_helpers_dx12::BufferAllocation& indexBuffer = m_buffers.at(draw.indexBuffer);
+            D3D12_INDEX_BUFFER_VIEW indexBufferView;
+            indexBufferView.BufferLocation = indexBuffer.gpuAddress;
+            indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+            indexBufferView.SizeInBytes = static_cast<UINT>(indexBuffer.size);
+            m_commandList->IASetIndexBuffer(&indexBufferView);
+            m_commandList->DrawIndexedInstanced(draw.indexCount, 1, 0, 0, 0);
+          }
+          else
+          {
+            m_commandList->DrawInstanced(draw.vertexCount, 1, 0, 0);
+          }
+        }
+      });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compile and record the frame, execute it, present it, and wait for its completion. The readback
+// is a copy of the target to a readback buffer, whose rows are aligned by D3D12
+void D3D12RenderDevice::EndFrame(Image* readback /*= nullptr*/)
+{
+  if (!m_frameOpen)
+  {
+    throw std::logic_error("EndFrame called without BeginFrame");
+  }
+  m_frameOpen = false;
+
+  if (readback != nullptr)
+  {
+    if (!m_readbackBuffer.IsValid())
+    {
+      D3D12_RESOURCE_DESC targetDesc = m_renderTargets[0]->GetDesc();
+      UINT64 readbackSize = 0;
+      m_device->GetCopyableFootprints(&targetDesc, 0, 1, 0, &m_readbackFootprint, nullptr,
+                                      nullptr, &readbackSize);
+      m_readbackBuffer =
+          m_gpuAllocator.Allocate(nv_helpers_dx12::BufferUsage::Readback, readbackSize,
+                                  D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+      if (!m_readbackBuffer.IsValid())
+      {
+        throw std::logic_error("Could not allocate the readback buffer");
+      }
+    }
+
+    m_renderGraph.AddPass("Readback", {{m_backBufferHandle, ResourceState::CopySource}}, [this]() {
+      tools::ProfileZone zone("Readback");
+      D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = m_readbackFootprint;
+      footprint.Offset += m_readbackBuffer.offset;
+      CD3DX12_TEXTURE_COPY_LOCATION destination(m_readbackBuffer.resource, footprint);
+      CD3DX12_TEXTURE_COPY_LOCATION source(m_renderTargets[m_frameIndex].Get(), 0);
+      m_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    });
+  }
+
+  // The passes are recorded by the execution of the graph
+  {
+    tools::ProfileZone zone("Record frame");
+    nv_helpers_dx12::CompiledRenderGraph compiledGraph = m_renderGraph.Compile();
+    m_renderGraphResources.BeginFrame(m_renderGraph);
+    m_renderGraphResources.Bind(m_backBufferHandle, m_renderTargets[m_frameIndex].Get());
+    for (const auto& binding : m_frameBindings)
+    {
+      m_renderGraphResources.Bind(binding.first, binding.second);
+    }
+    m_renderGraphResources.AllocateTransients(m_renderGraph, compiledGraph);
+    m_renderGraph.Execute(compiledGraph,
+                          [&](const std::vector<nv_helpers_dx12::RenderGraphBarrier>& barriers) {
+                            m_renderGraphResources.RecordBarriers(m_commandList.Get(), barriers);
+                          });
+
+    ThrowIfFailed(m_commandList->Close());
+  }
+
+  {
+    tools::ProfileZone zone("ExecuteCommandLists");
+    ID3D12CommandList* ppCommandLists[] = {m_commandList.Get()};
+    m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+  }
+
+  if (m_swapChain)
+  {
+    tools::ProfileZone zone("Present");
+    ThrowIfFailed(m_swapChain->Present(1, 0));
+  }
+
+  // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
+  // This is code implemented as such for simplicity.
+  {
+    tools::ProfileZone zone("Wait for GPU");
+    WaitIdle();
+  }
+
+  if (readback != nullptr)
+  {
+    readback->width = m_width;
+    readback->height = m_height;
+    readback->pixels.resize(4 * static_cast<size_t>(m_width) * m_height);
+    for (uint32_t y = 0; y < m_height; y++)
+    {
+      memcpy(&readback->pixels[4 * static_cast<size_t>(y) * m_width],
+             m_readbackBuffer.cpuAddress + m_readbackFootprint.Offset +
+                 static_cast<size_t>(y) * m_readbackFootprint.Footprint.RowPitch,
+             4 * static_cast<size_t>(m_width));
+    }
+  }
+
+  m_frameIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex()
+                             : (m_frameIndex + 1) % FrameCount;
+}
+} // namespace rhi
@@ -0,0 +1,179 @@
+/*
+D3D12 backend of the rendering hardware interface, driving DXR on the GPU.
+
+Buffers are suballocated from the heaps of a GpuMemoryAllocator: geometry is
+uploaded to the default heap through the staging uploader, constants live in
+the upload heap. The bottom-level acceleration structures are built and
+compacted in one batch by BuildBottomLevelAS. The top-level acceleration
+structure is rebuilt at each DispatchRays, in a pass of the render graph from
+which the barriers of the frame are derived. Its instance descriptors are
+filled once by SetInstances, in parallel for scenes of many instances.
+
+The raytracing pipeline uses fixed root signatures: the ray generation shader
+receives a table with the output UAV, the top-level acceleration structure and
+the camera constant buffer, the miss shaders have no parameters, and the hit
+groups take two shader resource views, a constant buffer view and a table
+containing the top-level acceleration structure.
+
+The frames are rendered to the back buffers of the swap chain and presented,
+or, without a swap chain, to offscreen targets of the same format, which can
+be read back to memory.
+
+Example:
+
+D3D12RenderDevice device(d3dDevice, commandQueue, swapChain, width, height);
+SampleScene scene;
+scene.Create(device, {});
+...
+scene.Render(device, camera, RenderMode::Raster);
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <dxcapi.h>
+#include <dxgi1_4.h>
+#include <wrl/client.h>
+
+#include <utility>
+
+#include "RenderDevice.h"
+#include "../nv_helpers_dx12/BottomLevelASBatcher.h"
+#include "../nv_helpers_dx12/D3D12CopyQueue.h"
+#include "../nv_helpers_dx12/DescriptorHeapAllocator.h"
+#include "../nv_helpers_dx12/GpuMemoryAllocator.h"
+#include "../nv_helpers_dx12/RenderGraphD3D12.h"
+#include "../nv_helpers_dx12/ShaderBindingTableGenerator.h"
+#include "../nv_helpers_dx12/StagingUploader.h"
+#include "../nv_helpers_dx12/TopLevelASGenerator.h"
+#include "cpu/ThreadPool.h"
+
+namespace rhi
+{
+
+class D3D12RenderDevice : public RenderDevice
+{
+public:
+  /// Number of frames in flight, and of back buffers expected in the swap chain
+  static const UINT FrameCount = 2;
+
+  /// Create a device rendering to the back buffers of swapChain, or to offscreen targets of
+  /// width x height if swapChain is null. The queue is the one the swap chain presents on
+  D3D12RenderDevice(ID3D12Device5* device, ID3D12CommandQueue* commandQueue,
+                    IDXGISwapChain3* swapChain, uint32_t width, uint32_t height);
+  ~D3D12RenderDevice() override;
+
+  BufferHandle CreateBuffer(const BufferDesc& desc) override;
+  AccelerationStructureHandle
+  CreateBottomLevelAS(const std::vector<GeometryDesc>& geometry) override;
+  void BuildBottomLevelAS() override;
+  void SetInstances(const std::vector<InstanceDesc>& instances) override;
+  void CreateRayTracingPipeline(const RayTracingPipelineDesc& desc) override;
+  void CreateShaderTable(const ShaderTableDesc& desc) override;
+  void BeginFrame(const Camera& camera) override;
+  void DispatchRays(uint32_t width, uint32_t height) override;
+  void DrawRaster(const std::vector<DrawDesc>& draws) override;
+  void EndFrame(Image* readback = nullptr) override;
+  void WaitIdle() override;
+  uint32_t GetWidth() const override { return m_width; }
+  uint32_t GetHeight() const override { return m_height; }
+
+private:
+  void CreateTargets();
+  void CreateRasterPipeline();
+  void CreateRaytracingOutputBuffer();
+  void CreateCameraBuffer();
+  void FlushUploads();
+  void ExecuteAndWait();
+  void FillInstanceDescs();
+  void BuildTopLevelAS();
+  D3D12_GPU_VIRTUAL_ADDRESS GetBufferAddress(BufferHandle buffer) const;
+  std::vector<void*> GetRecordData(const ShaderRecordDesc& record) const;
+
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRayGenSignature();
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateMissSignature();
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateHitSignature();
+
+  Microsoft::WRL::ComPtr<ID3D12Device5> m_device;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_commandQueue;
+  Microsoft::WRL::ComPtr<IDXGISwapChain3> m_swapChain;
+  uint32_t m_width;
+  uint32_t m_height;
+
+  // Render targets, either the back buffers or offscreen textures, and the depth buffer
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
+  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
+  UINT m_rtvDescriptorSize = 0;
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_depthBuffer;
+  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
+  UINT m_frameIndex = 0;
+
+  Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_commandAllocator;
+  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> m_commandList;
+  Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+  UINT64 m_fenceValue = 0;
+  HANDLE m_fenceEvent = nullptr;
+
+  // All the buffers are suballocated from a few large heaps
+  nv_helpers_dx12::GpuMemoryAllocator m_gpuAllocator;
+  // Static data is uploaded to the default heap through a copy queue
+  nv_helpers_dx12::D3D12CopyQueue m_copyQueue;
+  nv_helpers_dx12::StagingUploader m_uploader;
+  nv_helpers_dx12::BufferAllocation m_stagingRing;
+  bool m_uploadsPending = false;
+  // Single shader-visible heap holding all the CBV/SRV/UAV descriptors
+  nv_helpers_dx12::DescriptorHeapAllocator m_descriptorAllocator;
+  // Frame description, from which the resource barriers are computed
+  nv_helpers_dx12::RenderGraph m_renderGraph;
+  nv_helpers_dx12::RenderGraphD3D12 m_renderGraphResources;
+  nv_helpers_dx12::RenderGraphHandle m_backBufferHandle =
+      nv_helpers_dx12::InvalidRenderGraphHandle;
+  /// Imported resources of the current frame, bound once the graph is compiled
+  std::vector<std::pair<nv_helpers_dx12::RenderGraphHandle, ID3D12Resource*>> m_frameBindings;
+  bool m_frameOpen = false;
+
+  std::vector<nv_helpers_dx12::BufferAllocation> m_buffers;
+
+  // Raster pipeline
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
+  Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState;
+
+  // The BLASes are built in batches sharing their scratch space, and compacted
+  nv_helpers_dx12::BottomLevelASBatcher m_blasBatcher;
+  std::vector<std::vector<GeometryDesc>> m_bottomLevelGeometry;
+  std::vector<uint32_t> m_bottomLevelIndices;
+  uint32_t m_builtBottomLevelCount = 0;
+
+  nv_helpers_dx12::TopLevelASGenerator m_topLevelASGenerator;
+  nv_helpers_dx12::BufferAllocation m_topLevelAS;
+  std::vector<InstanceDesc> m_instances;
+  // Workers filling the instance descriptors of large scenes
+  cpu::ThreadPool m_pool;
+
+  // Raytracing pipeline, and the shader libraries it references
+  std::vector<Microsoft::WRL::ComPtr<IDxcBlob>> m_libraries;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rayGenSignature;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_missSignature;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_hitSignature;
+  Microsoft::WRL::ComPtr<ID3D12StateObject> m_rtStateObject;
+  Microsoft::WRL::ComPtr<ID3D12StateObjectProperties> m_rtStateObjectProps;
+
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_outputResource;
+  // Output UAV, TLAS SRV and camera CBV used by the ray generation shader
+  nv_helpers_dx12::DescriptorRange m_rayGenDescriptors;
+
+  nv_helpers_dx12::ShaderBindingTableGenerator m_sbtHelper;
+  nv_helpers_dx12::BufferAllocation m_sbtStorage;
+
+  // View, projection and their inverses, shared by the raster and raytracing shaders
+  nv_helpers_dx12::BufferAllocation m_cameraBuffer;
+  nv_helpers_dx12::DescriptorRange m_rasterDescriptors;
+  uint32_t m_cameraBufferSize = 0;
+
+  // Copy of the render target read back by EndFrame
+  nv_helpers_dx12::BufferAllocation m_readbackBuffer;
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_readbackFootprint = {};
+};
+} // namespace rhi
@@ -0,0 +1,270 @@
+/*
+Rendering hardware interface (RHI) of the sample. It exposes the few objects the
+sample needs to render a frame, independently of the API executing the work:
+- buffers holding geometry and constants
+- bottom-level acceleration structures built from geometry, and a list of
+  instances forming the top-level acceleration structure
+- a raytracing pipeline made of named shaders, and a shader binding table
+  associating shaders and resources to the ray types and instances
+- raytraced (DispatchRays) and rasterized (DrawRaster) frames, presented to a
+  window and optionally read back to memory
+- hybrid frames (DispatchRaysHybrid) on the backends supporting them, whose
+  primary visibility is rasterized and only the secondary rays traced
+- lights with an extent (SetLights) on the backends supporting them,
+  replacing the point light of the shaders of the sample
+
+Two backends implement the interface: D3D12RenderDevice drives DXR on a GPU,
+and CpuRenderDevice is a multithreaded CPU ray tracer and rasterizer with no
+dependency on Windows, which runs the same scene setup and frame loop on
+machines without a GPU. Shaders are referred to by their export names: the
+D3D12 backend looks them up in the HLSL libraries listed in the pipeline
+description, the CPU backend in its registry of C++ equivalents.
+
+Matrices use the glm conventions of the camera manipulator (column vectors).
+Their memory layout is also the one expected by the HLSL constant buffers.
+
+Example:
+
+BufferHandle vb = device.CreateBuffer({BufferType::Vertex, size, vertices});
+AccelerationStructureHandle blas = device.CreateBottomLevelAS({{vb, vertexCount}});
+device.BuildBottomLevelAS();
+device.SetInstances({{blas, glm::mat4(1.f), 0}});
+device.CreateRayTracingPipeline(pipelineDesc);
+device.CreateShaderTable(shaderTableDesc);
+...
+device.BeginFrame(camera);
+device.DispatchRays(width, height);
+device.EndFrame(&image);
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rhi
+{
+
+/// Vertex layout shared by all the geometry of the sample
+struct Vertex
+{
+  glm::vec3 position;
+  glm::vec4 color;
+};
+
+using BufferHandle = uint32_t;
+using AccelerationStructureHandle = uint32_t;
+static const uint32_t InvalidHandle = UINT32_MAX;
+
+enum class BufferType
+{
+  Vertex,
+  Index,
+  Constant
+};
+
+/// Immutable buffer, initialized with data at creation
+struct BufferDesc
+{
+  BufferType type;
+  uint64_t size;
+  const void* data;
+  /// The data stays valid and unchanged as long as the device, for instance in a mapped file.
+  /// Backends reading the buffers from memory may then use it in place rather than copy it
+  bool persistent = false;
+};
+
+/// Triangle geometry of a bottom-level acceleration structure. Vertices are of type Vertex, and
+/// indices are 32-bit
+struct GeometryDesc
+{
+  BufferHandle vertexBuffer;
+  uint32_t vertexCount;
+  BufferHandle indexBuffer = InvalidHandle;
+  uint32_t indexCount = 0;
+};
+
+/// Instance of a bottom-level acceleration structure in the top-level one
+struct InstanceDesc
+{
+  AccelerationStructureHandle blas;
+  glm::mat4 transform;
+  /// Index of the first hit group record of the instance in the shader binding table
+  uint32_t hitGroupIndex;
+};
+
+/// HLSL library, and the shaders it exports
+struct ShaderLibraryDesc
+{
+  std::wstring file;
+  std::vector<std::wstring> exports;
+};
+
+struct HitGroupDesc
+{
+  std::wstring name;
+  std::wstring closestHit;
+};
+
+/// Raytracing pipeline. The hit group root signatures are fixed: two shader resource views
+/// (vertices and indices), one constant buffer view, and a table containing the top-level
+/// acceleration structure
+struct RayTracingPipelineDesc
+{
+  std::vector<ShaderLibraryDesc> libraries;
+  std::wstring rayGen;
+  std::vector<std::wstring> missShaders;
+  std::vector<HitGroupDesc> hitGroups;
+  uint32_t maxPayloadSize = 4 * sizeof(float);
+  uint32_t maxAttributeSize = 2 * sizeof(float);
+  uint32_t maxRecursionDepth = 2;
+};
+
+/// Entry of the shader binding table: a shader or hit group, and the buffers bound to its root
+/// parameters in order. InvalidHandle leaves a parameter unbound
+struct ShaderRecordDesc
+{
+  std::wstring shader;
+  std::vector<BufferHandle> buffers;
+  /// Bind the top-level acceleration structure after the buffers
+  bool bindScene = false;
+};
+
+/// The ray generation shader implicitly receives the output image, the scene and the camera
+struct ShaderTableDesc
+{
+  std::wstring rayGen;
+  std::vector<ShaderRecordDesc> missShaders;
+  std::vector<ShaderRecordDesc> hitGroups;
+};
+
+/// Geometry drawn by the rasterizer, with the vertex colors
+struct DrawDesc
+{
+  BufferHandle vertexBuffer;
+  uint32_t vertexCount;
+  BufferHandle indexBuffer = InvalidHandle;
+  uint32_t indexCount = 0;
+};
+
+enum class LightShape : uint32_t
+{
+  Point,
+  Sphere,
+  Rectangle
+};
+
+/// Light of the scene, whose visible fraction from a point is estimated by shadow rays towards
+/// points of the light
+struct LightDesc
+{
+  LightShape shape = LightShape::Point;
+  /// Position of a point light, or center of a sphere or of a rectangle
+  glm::vec3 position = glm::vec3(0.f);
+  /// Radius of a sphere
+  float radius = 0.f;
+  /// Edges of a rectangle
+  glm::vec3 edge1 = glm::vec3(0.f);
+  glm::vec3 edge2 = glm::vec3(0.f);
+  /// Contribution of the light to the points seeing all of it, at unit distance with falloff
+  glm::vec3 color = glm::vec3(1.f);
+  /// Shadow rays per shaded point, stratified over the light. Point lights use one
+  uint32_t sampleCount = 1;
+  /// Whether the contribution follows the cosine at the surface and the inverse square of the
+  /// distance. The point light of the sample has no falloff
+  bool falloff = false;
+};
+
+/// Camera matrices, the projection mapping depth to [0,1]
+struct Camera
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+};
+
+/// 8-bit RGBA image, rows stored top to bottom without padding
+struct Image
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+/// Rendering backend
+class RenderDevice
+{
+public:
+  virtual ~RenderDevice() = default;
+
+  virtual BufferHandle CreateBuffer(const BufferDesc& desc) = 0;
+
+  /// Declare a bottom-level acceleration structure, built by the next BuildBottomLevelAS
+  virtual AccelerationStructureHandle
+  CreateBottomLevelAS(const std::vector<GeometryDesc>& geometry) = 0;
+
+  /// Build all the declared bottom-level acceleration structures
+  virtual void BuildBottomLevelAS() = 0;
+
+  /// Backend-specific data of a built bottom-level acceleration structure, from which
+  /// CreatePrebuiltBottomLevelAS recreates it without building it. Empty if the backend does not
+  /// support it
+  virtual std::vector<uint8_t> SerializeBottomLevelAS(AccelerationStructureHandle /*blas*/) const
+  {
+    return {};
+  }
+
+  /// Declare an already built bottom-level acceleration structure, from the data serialized by the
+  /// same backend of the same build. The data is used in place, and must stay valid as long as the
+  /// device. Returns InvalidHandle if the backend does not support it, the caller then declaring
+  /// the structure with CreateBottomLevelAS
+  virtual AccelerationStructureHandle
+  CreatePrebuiltBottomLevelAS(const std::vector<GeometryDesc>& /*geometry*/, const void* /*data*/,
+                              uint64_t /*size*/)
+  {
+    return InvalidHandle;
+  }
+
+  /// Set the instances of the top-level acceleration structure, rebuilt by each DispatchRays
+  virtual void SetInstances(const std::vector<InstanceDesc>& instances) = 0;
+
+  virtual void CreateRayTracingPipeline(const RayTracingPipelineDesc& desc) = 0;
+
+  /// Fill the shader binding table. Requires the pipeline, and the instances for the scene
+  /// bindings
+  virtual void CreateShaderTable(const ShaderTableDesc& desc) = 0;
+
+  /// Start recording a frame seen from camera
+  virtual void BeginFrame(const Camera& camera) = 0;
+
+  /// Trace one ray generation shader invocation per pixel of the output
+  virtual void DispatchRays(uint32_t width, uint32_t height) = 0;
+
+  /// Same as DispatchRays, except that the surfaces seen from the camera are rasterized: the rays
+  /// traced by the ray generation shader take the rasterized surface of their pixel instead of
+  /// traversing the scene, and only the rays traced by the hit and miss shaders are. The ray
+  /// generation shader has to trace the camera ray through the pixel center. Returns false
+  /// without rendering if the backend does not support it
+  virtual bool DispatchRaysHybrid(uint32_t /*width*/, uint32_t /*height*/) { return false; }
+
+  /// Replace the point light of the shaders of the sample by a list of lights, none restoring it.
+  /// Returns false if the backend does not support it
+  virtual bool SetLights(const std::vector<LightDesc>& /*lights*/) { return false; }
+
+  /// Clear the output and rasterize the geometry with a depth test
+  virtual void DrawRaster(const std::vector<DrawDesc>& draws) = 0;
+
+  /// Submit the frame and present it if the device has a window. If readback is not null, the
+  /// function waits for the frame and copies it to the image
+  virtual void EndFrame(Image* readback = nullptr) = 0;
+
+  /// Wait for all the submitted work
+  virtual void WaitIdle() = 0;
+
+  virtual uint32_t GetWidth() const = 0;
+  virtual uint32_t GetHeight() const = 0;
+};
+} // namespace rhi
@@ -0,0 +1,513 @@
+#include "SampleScene.h"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+#include "../tools/MappedFile.h"
+#include "../tools/MeshImporter.h"
+
+namespace rhi
+{
+
+namespace
+{
+struct Cube
+{
+  glm::vec3 corner;
+  float size;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a quad made of two triangles, the vertices being bottomLeft, bottomLeft+dx, bottomLeft+dy and
+// bottomLeft+dx+dy. Flipping changes the winding
+void EnqueueQuad(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                 const glm::vec3& bottomLeft, const glm::vec3& dx, const glm::vec3& dy, bool flip)
+{
+  uint32_t currentIndex = static_cast<uint32_t>(vertices.size());
+  if (flip)
+  {
+    indices.insert(indices.end(), {currentIndex + 0, currentIndex + 2, currentIndex + 1,
+                                   currentIndex + 3, currentIndex + 1, currentIndex + 2});
+  }
+  else
+  {
+    indices.insert(indices.end(), {currentIndex + 0, currentIndex + 1, currentIndex + 2,
+                                   currentIndex + 2, currentIndex + 1, currentIndex + 3});
+  }
+
+  vertices.push_back({bottomLeft, {1.f, 0.f, 0.f, 1.f}});
+  vertices.push_back({bottomLeft + dx, {0.5f, 1.f, 0.f, 1.f}});
+  vertices.push_back({bottomLeft + dy, {0.5f, 0.f, 1.f, 1.f}});
+  vertices.push_back({bottomLeft + dx + dy, {0.f, 1.f, 0.f, 1.f}});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The 6 faces of a cube, 3 of them sharing the minimum corner and 3 the maximum one
+void EnqueueCube(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const Cube& cube)
+{
+  float s = cube.size;
+  glm::vec3 current = cube.corner;
+  EnqueueQuad(vertices, indices, current, {s, 0, 0}, {0, s, 0}, false);
+  EnqueueQuad(vertices, indices, current, {s, 0, 0}, {0, 0, s}, true);
+  EnqueueQuad(vertices, indices, current, {0, s, 0}, {0, 0, s}, false);
+
+  current += glm::vec3(s);
+  EnqueueQuad(vertices, indices, current, {-s, 0, 0}, {0, -s, 0}, true);
+  EnqueueQuad(vertices, indices, current, {-s, 0, 0}, {0, 0, -s}, false);
+  EnqueueQuad(vertices, indices, current, {0, -s, 0}, {0, 0, -s}, true);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Scale and center the vertices into [-0.5, 0.5]^3, keeping their proportions
+void FitToUnitCube(std::vector<Vertex>& vertices)
+{
+  if (vertices.empty())
+  {
+    return;
+  }
+  glm::vec3 boundsMin = vertices[0].position;
+  glm::vec3 boundsMax = vertices[0].position;
+  for (const Vertex& vertex : vertices)
+  {
+    boundsMin = glm::min(boundsMin, vertex.position);
+    boundsMax = glm::max(boundsMax, vertex.position);
+  }
+  glm::vec3 extent = boundsMax - boundsMin;
+  float size = glm::max(glm::max(extent.x, extent.y), extent.z);
+  float scale = size > 0.f ? 1.f / size : 1.f;
+  glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+  for (Vertex& vertex : vertices)
+  {
+    vertex.position = (vertex.position - center) * scale;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Geometry of a mesh of the description. The plane is indexed like the other meshes, so that all
+// the hit groups can read the indices
+void GenerateMesh(const SceneMesh& mesh, std::vector<Vertex>& vertices,
+                  std::vector<uint32_t>& indices)
+{
+  switch (mesh.source)
+  {
+  case SceneMeshSource::MengerSponge:
+    GenerateMengerSponge(mesh.mengerLevel, mesh.mengerProbability, vertices, indices);
+    break;
+  case SceneMeshSource::Plane:
+    vertices = {{{-1.5f, -.8f, 1.5f}, {1.f, 1.f, 1.f, 1.f}},
+                {{-1.5f, -.8f, -1.5f}, {1.f, 1.f, 1.f, 1.f}},
+                {{1.5f, -.8f, 1.5f}, {1.f, 1.f, 1.f, 1.f}},
+                {{1.5f, -.8f, 1.5f}, {1.f, 1.f, 1.f, 1.f}},
+                {{-1.5f, -.8f, -1.5f}, {1.f, 1.f, 1.f, 1.f}},
+                {{1.5f, -.8f, -1.5f}, {1.f, 1.f, 1.f, 1.f}}};
+    indices = {0, 1, 2, 3, 4, 5};
+    break;
+  case SceneMeshSource::File:
+    tools::ImportMesh(mesh.file, vertices, indices);
+    FitToUnitCube(vertices);
+    break;
+  }
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Split the cubes level times, keeping the 20 sub-cubes having at most one coordinate in the
+// middle third. The random numbers come from the standard Mersenne twister, whose sequence is the
+// same on all platforms, unlike the standard distributions
+void GenerateMengerSponge(int32_t level, float probability, std::vector<Vertex>& outputVertices,
+                          std::vector<uint32_t>& outputIndices)
+{
+  std::mt19937 generator(0);
+  std::vector<Cube> cubes = {{glm::vec3(-0.5f), 1.f}};
+  std::vector<Cube> nextCubes;
+
+  for (int32_t i = 0; i < level; i++)
+  {
+    nextCubes.clear();
+    for (const Cube& cube : cubes)
+    {
+      float draw = static_cast<float>(generator() >> 8) * (1.f / 16777216.f);
+      if (draw >= probability)
+      {
+        nextCubes.push_back(cube);
+        continue;
+      }
+
+      float subSize = cube.size / 3.f;
+      for (int x = 0; x < 3; x++)
+      {
+        for (int y = 0; y < 3; y++)
+        {
+          for (int z = 0; z < 3; z++)
+          {
+            int centerCount = (x == 1) + (y == 1) + (z == 1);
+            if (centerCount < 2)
+            {
+              nextCubes.push_back(
+                  {cube.corner + subSize * glm::vec3(float(x), float(y), float(z)), subSize});
+            }
+          }
+        }
+      }
+    }
+    cubes.swap(nextCubes);
+  }
+
+  outputVertices.reserve(outputVertices.size() + 24 * cubes.size());
+  outputIndices.reserve(outputIndices.size() + 36 * cubes.size());
+  for (const Cube& cube : cubes)
+  {
+    EnqueueCube(outputVertices, outputIndices, cube);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The sponge is mesh 0 and the plane mesh 1, each instanced once with the identity transform. The
+// stress scene keeps about one instance per unit of volume, whatever the count. Its second sponge
+// uses the material of the plane, which traces shadow rays. The stress lights share the intensity
+// of the point light of the sample, seen from about 1 unit away
+SceneDescription MakeSceneDescription(const SceneParameters& parameters)
+{
+  if (!parameters.sceneFile.empty())
+  {
+    return LoadSceneDescription(parameters.sceneFile);
+  }
+
+  SceneMaterial colored;
+  colored.name = "colored";
+  colored.hitGroup = L"HitGroup";
+  SceneMaterial shadowed;
+  shadowed.name = "shadowed";
+  shadowed.hitGroup = L"PlaneHitGroup";
+
+  SceneDescription description;
+  description.materials = {colored, shadowed};
+  if (parameters.stressLightCount > 0)
+  {
+    ScatterLights(description, parameters.stressLightCount, glm::vec3(1.5f, 0.7f, 1.5f), 0.02f,
+                  1.f, 1, 0);
+  }
+  if (parameters.stressInstanceCount > 0)
+  {
+    float extent = 0.5f * std::cbrt(static_cast<float>(parameters.stressInstanceCount));
+    extent = extent > 1.5f ? extent : 1.5f;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+      SceneMesh sponge;
+      sponge.name = "sponge" + std::to_string(i + 1);
+      sponge.mengerLevel = static_cast<int32_t>(i + 1);
+      sponge.mengerProbability = parameters.mengerProbability;
+      description.meshes.push_back(sponge);
+      uint32_t count = (parameters.stressInstanceCount + 2 - i) / 3;
+      ScatterInstances(description, i, i % 2, count, glm::vec3(extent), 0.2f, 0.5f,
+                       static_cast<uint32_t>(description.instances.size()));
+    }
+    return description;
+  }
+
+  SceneMesh sponge;
+  sponge.name = "sponge";
+  sponge.mengerLevel = parameters.mengerLevel;
+  sponge.mengerProbability = parameters.mengerProbability;
+  if (!parameters.meshFile.empty())
+  {
+    sponge.source = SceneMeshSource::File;
+    sponge.file = parameters.meshFile;
+  }
+  SceneMesh plane;
+  plane.name = "plane";
+  plane.source = SceneMeshSource::Plane;
+  description.meshes = {sponge, plane};
+  description.instances = {{0, 0, glm::mat4(1.f)}, {1, 1, glm::mat4(1.f)}};
+  return description;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The generator version is part of the hash, so that changing the generated geometry invalidates
+// the existing caches. Only the parameters of its source identify a mesh, not its name. Imported
+// meshes are identified by the size and content of their file rather than by its path, so that
+// editing the file invalidates the cache, and relative and absolute paths to it share the cache
+uint64_t HashSceneMeshes(const std::vector<SceneMesh>& meshes)
+{
+  const uint32_t GeneratorVersion = 3;
+  uint64_t hash = HashBytes(&GeneratorVersion, sizeof(GeneratorVersion));
+  for (const SceneMesh& mesh : meshes)
+  {
+    hash = HashBytes(&mesh.source, sizeof(mesh.source), hash);
+    if (mesh.source == SceneMeshSource::MengerSponge)
+    {
+      hash = HashBytes(&mesh.mengerLevel, sizeof(mesh.mengerLevel), hash);
+      hash = HashBytes(&mesh.mengerProbability, sizeof(mesh.mengerProbability), hash);
+    }
+    else if (mesh.source == SceneMeshSource::File)
+    {
+      tools::MappedFile file;
+      if (!file.Open(mesh.file))
+      {
+        throw std::logic_error("Cannot open mesh " + mesh.file);
+      }
+      uint64_t size = file.GetSize();
+      hash = HashBytes(&size, sizeof(size), hash);
+      hash = HashBytes(file.GetData(), size, hash);
+    }
+  }
+  return hash;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void SampleScene::Create(RenderDevice& device, const SceneParameters& parameters)
+{
+  SceneDescription description = MakeSceneDescription(parameters);
+
+  // Tetrahedron, only drawn by the rasterizer
+  float a = std::sqrt(8.f / 9.f);
+  float b = std::sqrt(2.f / 9.f);
+  float c = std::sqrt(2.f / 3.f);
+  Vertex tetrahedronVertices[] = {{{a, 0.f, -1.f / 3.f}, {1.f, 0.f, 0.f, 1.f}},
+                                  {{-b, c, -1.f / 3.f}, {0.f, 1.f, 0.f, 1.f}},
+                                  {{-b, -c, -1.f / 3.f}, {0.f, 0.f, 1.f, 1.f}},
+                                  {{0.f, 0.f, 1.f}, {1.f, 0.f, 1.f, 1.f}}};
+  uint32_t tetrahedronIndices[] = {0, 1, 2, 0, 3, 1, 0, 2, 3, 1, 3, 2};
+  m_tetrahedronVB =
+      device.CreateBuffer({BufferType::Vertex, sizeof(tetrahedronVertices), tetrahedronVertices});
+  m_tetrahedronIB =
+      device.CreateBuffer({BufferType::Index, sizeof(tetrahedronIndices), tetrahedronIndices});
+
+  // The meshes are read in place from the cache if it holds them, and generated or imported
+  // otherwise, with their lighting baked if asked
+  size_t meshCount = description.meshes.size();
+  std::vector<const void*> vertexData(meshCount, nullptr);
+  std::vector<const void*> indexData(meshCount, nullptr);
+  std::vector<uint64_t> vertexSize(meshCount, 0);
+  std::vector<uint64_t> indexSize(meshCount, 0);
+  // Only needed to match the cache, while hashing reads the imported mesh files
+  uint64_t parameterHash =
+      parameters.cacheFile.empty() ? 0 : HashSceneMeshes(description.meshes);
+  if (!parameters.cacheFile.empty() && parameters.bakeLighting)
+  {
+    parameterHash = tools::HashLightBake(description, parameters.bakeSettings, parameterHash);
+  }
+  m_cache.Close();
+  m_fromCache =
+      !parameters.cacheFile.empty() && m_cache.Open(parameters.cacheFile, parameterHash);
+  for (uint32_t i = 0; m_fromCache && i < meshCount; i++)
+  {
+    vertexData[i] = m_cache.GetSection(SceneCacheSection::Vertices, i, vertexSize[i]);
+    indexData[i] = m_cache.GetSection(SceneCacheSection::Indices, i, indexSize[i]);
+    m_fromCache = vertexData[i] != nullptr && indexData[i] != nullptr;
+  }
+
+  std::vector<std::vector<Vertex>> vertices(meshCount);
+  std::vector<std::vector<uint32_t>> indices(meshCount);
+  m_bakeStats = {};
+  for (uint32_t i = 0; i < meshCount && !m_fromCache; i++)
+  {
+    GenerateMesh(description.meshes[i], vertices[i], indices[i]);
+  }
+  if (parameters.bakeLighting && !m_fromCache)
+  {
+    m_bakeStats = tools::BakeVertexLighting(description, vertices, indices,
+                                            parameters.bakeSettings);
+  }
+  m_meshes.clear();
+  for (uint32_t i = 0; i < meshCount; i++)
+  {
+    if (!m_fromCache)
+    {
+      vertexData[i] = vertices[i].data();
+      indexData[i] = indices[i].data();
+      vertexSize[i] = vertices[i].size() * sizeof(Vertex);
+      indexSize[i] = indices[i].size() * sizeof(uint32_t);
+    }
+    Mesh mesh;
+    mesh.vertexBuffer =
+        device.CreateBuffer({BufferType::Vertex, vertexSize[i], vertexData[i], m_fromCache});
+    mesh.indexBuffer =
+        device.CreateBuffer({BufferType::Index, indexSize[i], indexData[i], m_fromCache});
+    mesh.vertexCount = static_cast<uint32_t>(vertexSize[i] / sizeof(Vertex));
+    mesh.indexCount = static_cast<uint32_t>(indexSize[i] / sizeof(uint32_t));
+    m_meshes.push_back(mesh);
+  }
+
+  // A cached structure serialized by another backend is not recognized by the device, and the
+  // structure is then built
+  std::vector<AccelerationStructureHandle> meshBLAS;
+  for (uint32_t i = 0; i < meshCount; i++)
+  {
+    const Mesh& mesh = m_meshes[i];
+    std::vector<GeometryDesc> geometry = {
+        {mesh.vertexBuffer, mesh.vertexCount, mesh.indexBuffer, mesh.indexCount}};
+    AccelerationStructureHandle blas = InvalidHandle;
+    uint64_t blasSize = 0;
+    const void* blasData = m_cache.GetSection(SceneCacheSection::BottomLevelAS, i, blasSize);
+    if (m_fromCache && blasData != nullptr)
+    {
+      blas = device.CreatePrebuiltBottomLevelAS(geometry, blasData, blasSize);
+    }
+    if (blas == InvalidHandle)
+    {
+      blas = device.CreateBottomLevelAS(geometry);
+    }
+    meshBLAS.push_back(blas);
+  }
+  device.BuildBottomLevelAS();
+
+  if (!parameters.cacheFile.empty() && !m_fromCache)
+  {
+    std::vector<std::vector<uint8_t>> blasData(meshCount);
+    SceneCacheWriter writer;
+    for (uint32_t i = 0; i < meshCount; i++)
+    {
+      blasData[i] = device.SerializeBottomLevelAS(meshBLAS[i]);
+      writer.AddSection(SceneCacheSection::Vertices, i, vertexData[i], vertexSize[i]);
+      writer.AddSection(SceneCacheSection::Indices, i, indexData[i], indexSize[i]);
+      if (!blasData[i].empty())
+      {
+        writer.AddSection(SceneCacheSection::BottomLevelAS, i, blasData[i].data(),
+                          blasData[i].size());
+      }
+    }
+    writer.Save(parameters.cacheFile, parameterHash);
+  }
+
+  RayTracingPipelineDesc pipeline;
+  pipeline.libraries = {{L"RayGen.hlsl", {L"RayGen"}},
+                        {L"Miss.hlsl", {L"Miss"}},
+                        {L"Hit.hlsl", {L"ClosestHit", L"PlaneClosestHit"}},
+                        {L"ShadowRay.hlsl", {L"ShadowClosestHit", L"ShadowMiss"}}};
+  pipeline.rayGen = L"RayGen";
+  pipeline.missShaders = {L"Miss", L"ShadowMiss"};
+  pipeline.hitGroups = {{L"HitGroup", L"ClosestHit"},
+                        {L"PlaneHitGroup", L"PlaneClosestHit"},
+                        {L"ShadowHitGroup", L"ShadowClosestHit"}};
+
+  // Colors A, B and C of the hit shaders, padded to float4 by the HLSL packing rules
+  m_materialConstants.clear();
+  for (const SceneMaterial& material : description.materials)
+  {
+    bool found = false;
+    for (const HitGroupDesc& hitGroup : pipeline.hitGroups)
+    {
+      found = found || (hitGroup.name == material.hitGroup && hitGroup.name != L"ShadowHitGroup");
+    }
+    if (!found)
+    {
+      throw std::logic_error("Unknown hit group in material " + material.name);
+    }
+    glm::vec4 colors[3];
+    for (int i = 0; i < 3; i++)
+    {
+      colors[i] = glm::vec4(material.colors[i], 1.f);
+    }
+    m_materialConstants.push_back(
+        device.CreateBuffer({BufferType::Constant, sizeof(colors), colors}));
+  }
+
+  // Each distinct pair of mesh and material gets two consecutive hit group records, one per ray
+  // type, on first use. All the hit shaders receive the vertices, the indices (the plane has its
+  // own) and the material constants, and may trace shadow rays in the scene; the shadow hit group
+  // only sets a visibility flag in the payload, and does not require external data
+  ShaderTableDesc shaderTable;
+  shaderTable.rayGen = L"RayGen";
+  shaderTable.missShaders = {{L"Miss", {}}, {L"ShadowMiss", {}}};
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> hitGroupIndices;
+  std::vector<InstanceDesc> instances;
+  instances.reserve(description.instances.size());
+  for (const SceneInstance& instance : description.instances)
+  {
+    auto inserted = hitGroupIndices.insert(
+        {{instance.mesh, instance.material}, static_cast<uint32_t>(shaderTable.hitGroups.size())});
+    if (inserted.second)
+    {
+      const Mesh& mesh = m_meshes[instance.mesh];
+      shaderTable.hitGroups.push_back({description.materials[instance.material].hitGroup,
+                                       {mesh.vertexBuffer, mesh.indexBuffer,
+                                        m_materialConstants[instance.material]},
+                                       true});
+      shaderTable.hitGroups.push_back({L"ShadowHitGroup", {}});
+    }
+    instances.push_back({meshBLAS[instance.mesh], instance.transform, inserted.first->second});
+  }
+  m_instanceCount = static_cast<uint32_t>(instances.size());
+  device.SetInstances(instances);
+  if (!description.lights.empty())
+  {
+    device.SetLights(description.lights);
+  }
+
+  device.CreateRayTracingPipeline(pipeline);
+  device.CreateShaderTable(shaderTable);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t SampleScene::GetTriangleCount() const
+{
+  uint32_t triangleCount = 0;
+  for (const Mesh& mesh : m_meshes)
+  {
+    triangleCount += mesh.indexCount / 3;
+  }
+  return triangleCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void SampleScene::Render(RenderDevice& device, const Camera& camera, RenderMode mode,
+                         Image* readback /*= nullptr*/) const
+{
+  device.BeginFrame(camera);
+  if (mode == RenderMode::Raster)
+  {
+    std::vector<DrawDesc> draws = {{m_tetrahedronVB, 4, m_tetrahedronIB, 12}};
+    for (const Mesh& mesh : m_meshes)
+    {
+      draws.push_back({mesh.vertexBuffer, mesh.vertexCount, mesh.indexBuffer, mesh.indexCount});
+    }
+    device.DrawRaster(draws);
+  }
+  else if (mode == RenderMode::RayTraced ||
+           !device.DispatchRaysHybrid(device.GetWidth(), device.GetHeight()))
+  {
+    device.DispatchRays(device.GetWidth(), device.GetHeight());
+  }
+  device.EndFrame(readback);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same matrix as XMMatrixPerspectiveFovRH, whose row-major storage matches the column-major storage
+// of glm
+Camera SampleScene::MakeCamera(const glm::mat4& view, float aspectRatio)
+{
+  const float fovAngleY = 45.f * 3.14159265f / 180.f;
+  const float nearZ = 0.1f;
+  const float farZ = 1000.f;
+
+  float height = 1.f / std::tan(0.5f * fovAngleY);
+  float range = farZ / (nearZ - farZ);
+
+  Camera camera;
+  camera.view = view;
+  camera.projection = glm::mat4(0.f);
+  camera.projection[0][0] = height / aspectRatio;
+  camera.projection[1][1] = height;
+  camera.projection[2][2] = range;
+  camera.projection[2][3] = -1.f;
+  camera.projection[3][2] = range * nearZ;
+  return camera;
+}
+} // namespace rhi
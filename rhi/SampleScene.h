@@ -0,0 +1,143 @@
+/*
+Scene of the sample, set up through the rendering hardware interface so that
+it renders identically on all backends. The raytraced part of the scene is
+given by a scene description (see SceneDescription.h), by default a Menger
+sponge and a shadow-receiving plane; a tetrahedron is only visible when
+rasterizing.
+
+The sponge is generated by recursively splitting a unit cube into 27 and
+keeping the 20 sub-cubes which are not on the center lines. At each level a
+cube is split with the given probability, using a fixed pseudo-random
+sequence so that all runs produce the same geometry. The sponge can also be
+replaced by a mesh imported from a file (see tools/MeshImporter.h), scaled and
+centered to fit the same bounds.
+
+Each mesh of the description gets a bottom-level structure, and each material
+a constant buffer. The shader binding table has two consecutive hit group
+records, for the primary and the shadow rays, per distinct pair of mesh and
+material, shared by all the instances of the pair: large instanced scenes then
+keep a small table. The rasterizer, which has no instancing, draws each mesh
+once without transform. The hybrid mode renders the raytraced image with its
+primary visibility rasterized, on the backends supporting it, and falls back
+to raytracing on the others.
+
+Generating a deep sponge and building its acceleration structure takes
+seconds, so the meshes can be loaded from a cache file (see SceneCache.h)
+holding their geometry and their bottom-level structures if the device can
+serialize them. A missing or outdated cache, whose hash of the mesh sources
+differs, is regenerated and saved. The scene keeps the cache mapped, and must
+outlive the device using its structures.
+
+The lighting of the static meshes can be baked into their vertex colors when
+they are generated (see tools/LightBaker.h), whatever the backend. The cache
+then holds the baked colors, the bake settings, instances, materials and
+lights being part of its hash, so that the bake runs once offline.
+
+Example:
+
+SampleScene scene;
+scene.Create(device, {3, 0.75f});
+...
+scene.Render(device, SampleScene::MakeCamera(CameraManip.getMatrix(), aspectRatio),
+             RenderMode::RayTraced);
+
+*/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "SceneCache.h"
+#include "SceneDescription.h"
+#include "../tools/LightBaker.h"
+
+namespace rhi
+{
+
+enum class RenderMode
+{
+  RayTraced,
+  Raster,
+  /// Raytraced image whose camera rays are replaced by a rasterized G-buffer, see
+  /// RenderDevice::DispatchRaysHybrid
+  Hybrid
+};
+
+/// Generate the triangles of a Menger sponge fitting in [-0.5, 0.5]^3
+void GenerateMengerSponge(int32_t level, float probability, std::vector<Vertex>& outputVertices,
+                          std::vector<uint32_t>& outputIndices);
+
+struct SceneParameters
+{
+  /// Recursion level of the sponge, 0 being a plain cube
+  int32_t mengerLevel = 3;
+  /// Probability of a cube to be split at each level
+  float mengerProbability = 0.75f;
+  /// OBJ or PLY mesh replacing the sponge, none if empty
+  std::string meshFile;
+  /// Scene description file replacing the sponge and the plane, and the parameters above, none
+  /// if empty
+  std::string sceneFile;
+  /// Instance count of the stress scene replacing the sponge and the plane if not 0, unless there
+  /// is a scene file: sponges of levels 1 to 3, scattered in a box growing with the count
+  uint32_t stressInstanceCount = 0;
+  /// Number of small spheres with falloff replacing the point light of the plane if not 0, unless
+  /// there is a scene file, to stress the light sampling of the backends supporting them
+  uint32_t stressLightCount = 0;
+  /// Scene cache file, none if empty. The cache is rebuilt when the content of the mesh files
+  /// changes
+  std::string cacheFile;
+  /// Whether to bake the lighting of the meshes into their vertex colors, with bakeSettings
+  bool bakeLighting = false;
+  tools::LightBakeSettings bakeSettings;
+};
+
+/// Description of the scene of the parameters: the one of the scene file if any, the stress scene,
+/// or otherwise the sponge, or the imported mesh, and the plane, with the stress lights if any
+SceneDescription MakeSceneDescription(const SceneParameters& parameters);
+
+/// Hash of the sources of the meshes, identifying the caches holding their geometry. The mesh
+/// files are read to hash their content
+uint64_t HashSceneMeshes(const std::vector<SceneMesh>& meshes);
+
+class SampleScene
+{
+public:
+  /// Create the geometry, acceleration structures, pipeline and shader table of the scene
+  void Create(RenderDevice& device, const SceneParameters& parameters);
+
+  /// Render and present one frame. If readback is not null, the frame is copied to it
+  void Render(RenderDevice& device, const Camera& camera, RenderMode mode,
+              Image* readback = nullptr) const;
+
+  /// Camera with the projection of the sample: 45 degrees vertical field of view, depth range
+  /// [0.1, 1000] mapped to [0, 1]
+  static Camera MakeCamera(const glm::mat4& view, float aspectRatio);
+
+  /// Triangles of all the meshes, each counted once however many instances it has
+  uint32_t GetTriangleCount() const;
+  uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+  uint32_t GetInstanceCount() const { return m_instanceCount; }
+  /// Whether the meshes were loaded from the cache file rather than generated
+  bool IsFromCache() const { return m_fromCache; }
+  /// Statistics of the light bake of the last Create, empty if it did not bake
+  const tools::LightBakeStats& GetBakeStats() const { return m_bakeStats; }
+
+private:
+  struct Mesh
+  {
+    BufferHandle vertexBuffer;
+    BufferHandle indexBuffer;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+  };
+
+  BufferHandle m_tetrahedronVB = InvalidHandle;
+  BufferHandle m_tetrahedronIB = InvalidHandle;
+  std::vector<Mesh> m_meshes;
+  std::vector<BufferHandle> m_materialConstants;
+  uint32_t m_instanceCount = 0;
+  SceneCache m_cache;
+  bool m_fromCache = false;
+  tools::LightBakeStats m_bakeStats;
+};
+} // namespace rhi
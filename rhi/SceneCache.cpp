@@ -0,0 +1,175 @@
+#include "SceneCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace rhi
+{
+
+namespace
+{
+/// Header of the file, followed by the section table
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t parameterHash;
+  uint64_t fileSize;
+  uint32_t sectionCount;
+  uint32_t padding;
+};
+
+struct SectionEntry
+{
+  SceneCacheSection type;
+  uint32_t index;
+  uint64_t offset;
+  uint64_t size;
+};
+
+const char Magic[4] = {'R', 'T', 'S', 'C'};
+const uint64_t SectionAlignment = 64;
+
+uint64_t AlignOffset(uint64_t offset)
+{
+  return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The checks cover everything GetSection relies on, so that a damaged file is rejected rather
+// than read out of bounds
+bool SceneCache::Open(const std::string& fileName, uint64_t parameterHash)
+{
+  if (!m_file.Open(fileName))
+  {
+    return false;
+  }
+
+  FileHeader header;
+  bool valid = m_file.GetSize() >= sizeof(header);
+  if (valid)
+  {
+    std::memcpy(&header, m_file.GetData(), sizeof(header));
+    valid = std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.version == Version &&
+            header.parameterHash == parameterHash && header.fileSize == m_file.GetSize() &&
+            sizeof(header) + header.sectionCount * sizeof(SectionEntry) <= m_file.GetSize();
+  }
+  for (uint32_t i = 0; valid && i < header.sectionCount; i++)
+  {
+    SectionEntry entry;
+    std::memcpy(&entry, m_file.GetData() + sizeof(header) + i * sizeof(SectionEntry),
+                sizeof(entry));
+    valid = entry.offset % SectionAlignment == 0 && entry.offset <= m_file.GetSize() &&
+            entry.size <= m_file.GetSize() - entry.offset;
+  }
+
+  if (!valid)
+  {
+    m_file.Close();
+  }
+  return valid;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+const void* SceneCache::GetSection(SceneCacheSection type, uint32_t index, uint64_t& size) const
+{
+  size = 0;
+  if (!m_file.IsOpen())
+  {
+    return nullptr;
+  }
+
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(m_file.GetData());
+  const SectionEntry* entries = reinterpret_cast<const SectionEntry*>(header + 1);
+  for (uint32_t i = 0; i < header->sectionCount; i++)
+  {
+    if (entries[i].type == type && entries[i].index == index)
+    {
+      size = entries[i].size;
+      return m_file.GetData() + entries[i].offset;
+    }
+  }
+  return nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void SceneCacheWriter::AddSection(SceneCacheSection type, uint32_t index, const void* data,
+                                  uint64_t size)
+{
+  m_sections.push_back({type, index, data, size});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The sections follow the table in the order they were added, each one padded to the alignment
+void SceneCacheWriter::Save(const std::string& fileName, uint64_t parameterHash) const
+{
+  FileHeader header = {};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = SceneCache::Version;
+  header.parameterHash = parameterHash;
+  header.sectionCount = static_cast<uint32_t>(m_sections.size());
+
+  std::vector<SectionEntry> entries(m_sections.size());
+  uint64_t offset = AlignOffset(sizeof(header) + entries.size() * sizeof(SectionEntry));
+  for (size_t i = 0; i < m_sections.size(); i++)
+  {
+    entries[i] = {m_sections[i].type, m_sections[i].index, offset, m_sections[i].size};
+    offset = AlignOffset(offset + m_sections[i].size);
+  }
+  header.fileSize = offset;
+
+  std::string temporaryName = fileName + ".tmp";
+  FILE* file = std::fopen(temporaryName.c_str(), "wb");
+  if (file == nullptr)
+  {
+    throw std::logic_error("Cannot create scene cache " + temporaryName);
+  }
+  static const uint8_t Padding[SectionAlignment] = {};
+  bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 (entries.empty() ||
+                  std::fwrite(entries.data(), sizeof(SectionEntry), entries.size(), file) ==
+                      entries.size());
+  uint64_t position = sizeof(header) + entries.size() * sizeof(SectionEntry);
+  for (size_t i = 0; written && i < m_sections.size(); i++)
+  {
+    written = std::fwrite(Padding, 1, entries[i].offset - position, file) ==
+                  entries[i].offset - position &&
+              std::fwrite(m_sections[i].data, 1, m_sections[i].size, file) == m_sections[i].size;
+    position = entries[i].offset + m_sections[i].size;
+  }
+  written = written && std::fwrite(Padding, 1, offset - position, file) == offset - position;
+  if (std::fclose(file) != 0 || !written)
+  {
+    std::remove(temporaryName.c_str());
+    throw std::logic_error("Cannot write scene cache " + temporaryName);
+  }
+
+  // Renaming does not replace an existing file on all platforms
+  std::remove(fileName.c_str());
+  if (std::rename(temporaryName.c_str(), fileName.c_str()) != 0)
+  {
+    throw std::logic_error("Cannot rename scene cache " + temporaryName + " to " + fileName);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t HashBytes(const void* data, uint64_t size, uint64_t hash /*= 0xcbf29ce484222325ull*/)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (uint64_t i = 0; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+} // namespace rhi
@@ -0,0 +1,99 @@
+/*
+Binary cache of generated scene data, so that the geometry and acceleration
+structures of a scene are not regenerated at each launch.
+
+The file is a container of sections, each identified by a type and an index,
+for instance the vertices of the second mesh. It starts with a header and a
+table giving the offset and size of each section, the offsets being relative
+to the start of the file so that it can be mapped at any address. The
+sections are aligned to 64 bytes. Opening a cache maps the file in memory and
+only checks the header and the table: the sections are then used in place,
+without parsing nor copying.
+
+A cache is only valid for the format version and the hash of the generator
+parameters it was saved with, the data being stored in the memory layout of
+the build which saved it. Open rejects files whose version or hash differ, or
+whose table does not fit the file, and the caller then regenerates the data
+and saves a new cache. Saving writes a temporary file, renamed once
+complete, so that an interrupted save never leaves a truncated cache.
+
+Example:
+
+SceneCache cache;
+if (!cache.Open("sponge.cache", hash))
+{
+  Generate(vertices, indices);
+  SceneCacheWriter writer;
+  writer.AddSection(SceneCacheSection::Vertices, 0, vertices.data(), vertexSize);
+  writer.AddSection(SceneCacheSection::Indices, 0, indices.data(), indexSize);
+  writer.Save("sponge.cache", hash);
+}
+uint64_t size;
+const void* vertices = cache.GetSection(SceneCacheSection::Vertices, 0, size);
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../tools/MappedFile.h"
+
+namespace rhi
+{
+
+enum class SceneCacheSection : uint32_t
+{
+  /// Vertex array of a mesh
+  Vertices,
+  /// 32-bit index array of a mesh
+  Indices,
+  /// Bottom-level acceleration structure of a mesh, as serialized by the render device
+  BottomLevelAS
+};
+
+class SceneCache
+{
+public:
+  /// Version of the file format, increased when the layout of the header or of the data of any
+  /// section changes
+  static const uint32_t Version = 2;
+
+  /// Map the cache file. Returns false if the file does not exist, or is not a valid cache for
+  /// the version and the parameter hash
+  bool Open(const std::string& fileName, uint64_t parameterHash);
+  void Close() { m_file.Close(); }
+  bool IsOpen() const { return m_file.IsOpen(); }
+
+  /// Data of a section, aligned to 64 bytes, or null if the cache has no such section
+  const void* GetSection(SceneCacheSection type, uint32_t index, uint64_t& size) const;
+
+private:
+  tools::MappedFile m_file;
+};
+
+class SceneCacheWriter
+{
+public:
+  /// Add a section to the cache. The data is not copied, and must stay valid until Save
+  void AddSection(SceneCacheSection type, uint32_t index, const void* data, uint64_t size);
+
+  /// Write the sections to a cache file. Throws if the file cannot be written
+  void Save(const std::string& fileName, uint64_t parameterHash) const;
+
+private:
+  struct Section
+  {
+    SceneCacheSection type;
+    uint32_t index;
+    const void* data;
+    uint64_t size;
+  };
+  std::vector<Section> m_sections;
+};
+
+/// 64-bit FNV-1a hash of a block of memory, which can be chained by passing the previous hash
+uint64_t HashBytes(const void* data, uint64_t size, uint64_t hash = 0xcbf29ce484222325ull);
+} // namespace rhi
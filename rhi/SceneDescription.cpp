@@ -0,0 +1,440 @@
+#include "SceneDescription.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace rhi
+{
+
+namespace
+{
+/// Highest level of the Menger sponges, whose cube count grows 20 times with each level
+const int32_t MaxMengerLevel = 8;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Index of the named entry, or the size of the list if there is none
+template <typename Entry>
+uint32_t FindByName(const std::vector<Entry>& entries, const std::string& name)
+{
+  uint32_t index = 0;
+  while (index < entries.size() && entries[index].name != name)
+  {
+    index++;
+  }
+  return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Whether only blanks remain on the line. Skipping the blanks of a stream already at its end would
+// set its fail bit
+bool IsAtEnd(std::istringstream& stream)
+{
+  return stream.eof() || (stream >> std::ws).eof();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Relative paths of the description are relative to the directory of its file
+std::string ResolvePath(const std::string& descriptionFile, const std::string& path)
+{
+  bool absolute = (!path.empty() && (path[0] == '/' || path[0] == '\\')) ||
+                  (path.size() > 1 && path[1] == ':');
+  size_t separator = descriptionFile.find_last_of("/\\");
+  if (absolute || separator == std::string::npos)
+  {
+    return path;
+  }
+  return descriptionFile.substr(0, separator + 1) + path;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Transforms of the copies of an instance, each step of the line applying to all the copies made
+// by the arrays before it
+bool ParseInstanceTransforms(std::istringstream& stream, std::vector<glm::mat4>& transforms)
+{
+  transforms = {glm::mat4(1.f)};
+  std::string step;
+  while (stream >> step)
+  {
+    glm::vec3 v;
+    if (step == "translate" && stream >> v.x >> v.y >> v.z)
+    {
+      for (glm::mat4& transform : transforms)
+      {
+        transform = glm::translate(glm::mat4(1.f), v) * transform;
+      }
+    }
+    else if (step == "rotate" && stream >> v.x >> v.y >> v.z)
+    {
+      float degrees;
+      if (!(stream >> degrees) || glm::length(v) == 0.f)
+      {
+        return false;
+      }
+      glm::mat4 rotation = glm::rotate(glm::mat4(1.f), glm::radians(degrees), glm::normalize(v));
+      for (glm::mat4& transform : transforms)
+      {
+        transform = rotation * transform;
+      }
+    }
+    else if (step == "scale" && stream >> v.x >> v.y >> v.z)
+    {
+      for (glm::mat4& transform : transforms)
+      {
+        transform = glm::scale(glm::mat4(1.f), v) * transform;
+      }
+    }
+    else if (step == "array")
+    {
+      int32_t count[3];
+      glm::vec3 spacing;
+      if (!(stream >> count[0] >> count[1] >> count[2] >> spacing.x >> spacing.y >> spacing.z) ||
+          count[0] < 1 || count[1] < 1 || count[2] < 1)
+      {
+        return false;
+      }
+      std::vector<glm::mat4> copies;
+      copies.reserve(transforms.size() * count[0] * count[1] * count[2]);
+      for (int32_t x = 0; x < count[0]; x++)
+      {
+        for (int32_t y = 0; y < count[1]; y++)
+        {
+          for (int32_t z = 0; z < count[2]; z++)
+          {
+            glm::vec3 offset = spacing * glm::vec3(float(x), float(y), float(z));
+            for (const glm::mat4& transform : transforms)
+            {
+              copies.push_back(glm::translate(glm::mat4(1.f), offset) * transform);
+            }
+          }
+        }
+      }
+      transforms.swap(copies);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parameters of a light following its shape
+bool ParseLight(std::istringstream& stream, const std::string& shape, LightDesc& light)
+{
+  stream >> light.position.x >> light.position.y >> light.position.z >> light.color.r >>
+      light.color.g >> light.color.b;
+  if (shape == "point")
+  {
+    light.shape = LightShape::Point;
+  }
+  else if (shape == "sphere")
+  {
+    light.shape = LightShape::Sphere;
+    stream >> light.sampleCount >> light.radius;
+  }
+  else if (shape == "rectangle")
+  {
+    light.shape = LightShape::Rectangle;
+    stream >> light.sampleCount >> light.edge1.x >> light.edge1.y >> light.edge1.z >>
+        light.edge2.x >> light.edge2.y >> light.edge2.z;
+  }
+  else
+  {
+    return false;
+  }
+  std::string option;
+  if (!stream.fail() && !IsAtEnd(stream))
+  {
+    stream >> option;
+    light.falloff = option == "falloff";
+  }
+  return !stream.fail() && IsAtEnd(stream) && (option.empty() || light.falloff) &&
+         light.sampleCount > 0 && light.radius >= 0.f;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+SceneDescription LoadSceneDescription(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file)
+  {
+    throw std::logic_error("Cannot open scene description file " + fileName);
+  }
+
+  SceneDescription description;
+  std::string line;
+  uint32_t lineNumber = 0;
+  while (std::getline(file, line))
+  {
+    lineNumber++;
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+    {
+      continue;
+    }
+
+    std::istringstream stream(line);
+    std::string keyword;
+    std::string name;
+    stream >> keyword >> name;
+    std::string error;
+    if (keyword == "mesh")
+    {
+      SceneMesh mesh;
+      mesh.name = name;
+      std::string source;
+      stream >> source;
+      if (source == "menger")
+      {
+        mesh.source = SceneMeshSource::MengerSponge;
+        stream >> mesh.mengerLevel >> mesh.mengerProbability;
+        if (mesh.mengerLevel < 0)
+        {
+          stream.setstate(std::ios::failbit);
+        }
+        else if (mesh.mengerLevel > MaxMengerLevel)
+        {
+          error = "Menger sponge level above " + std::to_string(MaxMengerLevel);
+        }
+      }
+      else if (source == "plane")
+      {
+        mesh.source = SceneMeshSource::Plane;
+      }
+      else if (source == "file")
+      {
+        mesh.source = SceneMeshSource::File;
+        stream >> mesh.file;
+        mesh.file = ResolvePath(fileName, mesh.file);
+      }
+      else
+      {
+        error = "Invalid mesh source";
+      }
+      if (error.empty() && (stream.fail() || !IsAtEnd(stream)))
+      {
+        error = "Invalid mesh parameters";
+      }
+      if (error.empty() && FindByName(description.meshes, name) < description.meshes.size())
+      {
+        error = "Duplicate mesh " + name;
+      }
+      description.meshes.push_back(mesh);
+    }
+    else if (keyword == "material")
+    {
+      SceneMaterial material;
+      material.name = name;
+      std::string hitGroup;
+      stream >> hitGroup;
+      material.hitGroup.assign(hitGroup.begin(), hitGroup.end());
+      if (!IsAtEnd(stream))
+      {
+        for (glm::vec3& color : material.colors)
+        {
+          stream >> color.r >> color.g >> color.b;
+        }
+      }
+      if (hitGroup.empty() || stream.fail() || !IsAtEnd(stream))
+      {
+        error = "Invalid material parameters";
+      }
+      else if (FindByName(description.materials, name) < description.materials.size())
+      {
+        error = "Duplicate material " + name;
+      }
+      description.materials.push_back(material);
+    }
+    else if (keyword == "scatter")
+    {
+      std::string materialName;
+      uint32_t count = 0;
+      glm::vec3 extent;
+      float minScale = 0.f;
+      float maxScale = 0.f;
+      stream >> materialName >> count >> extent.x >> extent.y >> extent.z >> minScale >> maxScale;
+      uint32_t mesh = FindByName(description.meshes, name);
+      uint32_t material = FindByName(description.materials, materialName);
+      if (mesh == description.meshes.size())
+      {
+        error = "Unknown mesh " + name;
+      }
+      else if (material == description.materials.size())
+      {
+        error = "Unknown material " + materialName;
+      }
+      else if (stream.fail() || !IsAtEnd(stream) || minScale > maxScale)
+      {
+        error = "Invalid scatter parameters";
+      }
+      else
+      {
+        ScatterInstances(description, mesh, material, count, extent, minScale, maxScale,
+                         static_cast<uint32_t>(description.instances.size()));
+      }
+    }
+    else if (keyword == "light")
+    {
+      LightDesc light;
+      if (!ParseLight(stream, name, light))
+      {
+        error = "Invalid light parameters";
+      }
+      description.lights.push_back(light);
+    }
+    else if (keyword == "lights")
+    {
+      // The count takes the place of the name
+      char* end = nullptr;
+      unsigned long count = std::strtoul(name.c_str(), &end, 10);
+      glm::vec3 extent;
+      float radius = 0.f;
+      float intensity = 0.f;
+      uint32_t sampleCount = 0;
+      stream >> extent.x >> extent.y >> extent.z >> radius >> intensity >> sampleCount;
+      if (*end != '\0' || count > UINT32_MAX || stream.fail() || !IsAtEnd(stream) ||
+          radius < 0.f || sampleCount == 0)
+      {
+        error = "Invalid lights parameters";
+      }
+      else
+      {
+        ScatterLights(description, static_cast<uint32_t>(count), extent, radius, intensity,
+                      sampleCount, static_cast<uint32_t>(description.lights.size()));
+      }
+    }
+    else if (keyword == "instance")
+    {
+      std::string materialName;
+      stream >> materialName;
+      SceneInstance instance;
+      instance.mesh = FindByName(description.meshes, name);
+      instance.material = FindByName(description.materials, materialName);
+      std::vector<glm::mat4> transforms;
+      if (instance.mesh == description.meshes.size())
+      {
+        error = "Unknown mesh " + name;
+      }
+      else if (instance.material == description.materials.size())
+      {
+        error = "Unknown material " + materialName;
+      }
+      else if (!ParseInstanceTransforms(stream, transforms))
+      {
+        error = "Invalid instance transforms";
+      }
+      for (const glm::mat4& transform : transforms)
+      {
+        instance.transform = transform;
+        description.instances.push_back(instance);
+      }
+    }
+    else
+    {
+      error = "Unknown entry " + keyword;
+    }
+
+    if (!error.empty() || name.empty())
+    {
+      throw std::logic_error((error.empty() ? "Missing name" : error) + " in scene description " +
+                             fileName + " line " + std::to_string(lineNumber));
+    }
+  }
+
+  if (description.instances.empty())
+  {
+    throw std::logic_error("Scene description " + fileName + " has no instances");
+  }
+  return description;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The orientations are uniformly distributed unit quaternions (Shoemake's method). The random
+// numbers come from the standard Mersenne twister, whose sequence is the same on all platforms,
+// unlike the standard distributions
+void ScatterInstances(SceneDescription& description, uint32_t mesh, uint32_t material,
+                      uint32_t count, const glm::vec3& extent, float minScale, float maxScale,
+                      uint32_t seed)
+{
+  std::mt19937 generator(seed);
+  auto uniform = [&generator]() {
+    return static_cast<float>(generator() >> 8) * (1.f / 16777216.f);
+  };
+
+  description.instances.reserve(description.instances.size() + count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    // The draws are sequenced, the evaluation order of function arguments being unspecified
+    glm::vec3 position;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      position[axis] = extent[axis] * (2.f * uniform() - 1.f);
+    }
+    float u = uniform();
+    float angle1 = 6.2831853f * uniform();
+    float angle2 = 6.2831853f * uniform();
+    float r1 = std::sqrt(1.f - u);
+    float r2 = std::sqrt(u);
+    glm::quat orientation(r2 * std::cos(angle2), r1 * std::sin(angle1), r1 * std::cos(angle1),
+                          r2 * std::sin(angle2));
+    float scale = minScale + (maxScale - minScale) * uniform();
+
+    SceneInstance instance;
+    instance.mesh = mesh;
+    instance.material = material;
+    instance.transform = glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(orientation) *
+                         glm::scale(glm::mat4(1.f), glm::vec3(scale));
+    description.instances.push_back(instance);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The hues go around the color wheel, and the colors are scaled to the same luminance
+void ScatterLights(SceneDescription& description, uint32_t count, const glm::vec3& extent,
+                   float radius, float intensity, uint32_t sampleCount, uint32_t seed)
+{
+  std::mt19937 generator(seed);
+  auto uniform = [&generator]() {
+    return static_cast<float>(generator() >> 8) * (1.f / 16777216.f);
+  };
+
+  description.lights.reserve(description.lights.size() + count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    LightDesc light;
+    light.shape = LightShape::Sphere;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      light.position[axis] = extent[axis] * (2.f * uniform() - 1.f);
+    }
+    float hue = 6.2831853f * uniform();
+    glm::vec3 color = 0.5f + 0.5f * glm::vec3(std::cos(hue), std::cos(hue - 2.0943951f),
+                                              std::cos(hue + 2.0943951f));
+    float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    light.color = color * (intensity / (static_cast<float>(count) * luminance));
+    light.radius = radius;
+    light.sampleCount = sampleCount;
+    light.falloff = true;
+    description.lights.push_back(light);
+  }
+}
+} // namespace rhi
@@ -0,0 +1,148 @@
+/*
+Declarative description of a raytraced scene: the meshes, the materials, the
+instances placing the meshes with a material, and the lights. SampleScene turns
+it into the bottom-level structures (one per mesh), the instances of the
+top-level structure, and a shader binding table consistent with them, so that
+scenes can be changed without editing code.
+
+Descriptions are loaded from text files with one entry per line, blank lines
+and lines starting with # being ignored. Names are single words, referenced by
+the entries following them:
+
+# Meshes: name, then the source of the geometry
+#   menger <level> <probability>   Menger sponge in [-0.5, 0.5]^3, of level 0 to 8
+#   plane                          Shadow-receiving plane of the sample
+#   file <path>                    OBJ or PLY file fitted to [-0.5, 0.5]^3, the path being
+#                                  relative to the description file
+mesh sponge menger 3 0.75
+mesh ground plane
+
+# Materials: name, hit group of the primary rays (HitGroup for the vertex colors,
+# PlaneHitGroup for the shadowed plane), and optionally the 3 colors of the Colors
+# constant buffer of the hit shaders
+material colored HitGroup
+material shadowed PlaneHitGroup 0.7 0.7 0.3 0 0 0 0 0 0
+
+# Instances: mesh, material, then transforms applied to the mesh in the order listed
+#   translate <x> <y> <z>
+#   rotate <axis x> <axis y> <axis z> <degrees>
+#   scale <x> <y> <z>
+#   array <nx> <ny> <nz> <dx> <dy> <dz>   Copies on a grid, offset by multiples of d
+instance ground shadowed
+instance sponge colored scale 0.5 0.5 0.5 translate -1 0 -1 array 3 1 3 1 0 1
+
+# Scattered instances: mesh, material, count, half extent of the box centered on
+# the origin holding their positions, then the range of their uniform scales
+scatter sponge colored 10000 20 5 20 0.1 0.4
+
+# Lights replacing the point light of the shadowed plane, on the backends
+# supporting them: shape, position, color, and for the sphere and the rectangle
+# the shadow rays per shaded point and the size. A trailing falloff makes the
+# light follow the inverse square of the distance, the color being the one at
+# unit distance
+#   point <x> <y> <z> <r> <g> <b>
+#   sphere <x> <y> <z> <r> <g> <b> <samples> <radius>
+#   rectangle <x> <y> <z> <r> <g> <b> <samples> <edge1 x y z> <edge2 x y z>
+light sphere 2 2 -2 1 1 1 16 0.3
+light point 0 1 0 0.2 0.2 0.2 falloff
+
+# Scattered spheres with falloff: count, half extent of the box centered on the
+# origin holding their positions, radius, total intensity shared by the
+# spheres, and shadow rays per shaded point
+lights 1000 1.5 0.7 1.5 0.02 0.5 1
+
+An array replicates the instance, and applies after the transforms listed
+before it: the copies are offset by (i*dx, j*dy, k*dz) for i < nx, j < ny and
+k < nz, and the following transforms apply to all the copies. Scattered
+instances, meant to stress the top-level structure with up to millions of
+instances of a few meshes, have random positions, orientations and scales.
+Their pseudo-random sequence is seeded with the number of instances before
+them, so that a description always produces the same instances. Scattered
+lights, meant to stress the light sampling, have random positions and hues,
+and are seeded with the number of lights before them.
+
+Errors, such as unknown names or invalid values, are reported by throwing
+std::logic_error with the line number.
+
+Example:
+
+SceneDescription description = LoadSceneDescription("grid.txt");
+
+SceneParameters parameters;
+parameters.sceneFile = "grid.txt";
+SampleScene scene;
+scene.Create(device, parameters);
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderDevice.h"
+
+namespace rhi
+{
+
+enum class SceneMeshSource
+{
+  MengerSponge,
+  Plane,
+  File
+};
+
+struct SceneMesh
+{
+  std::string name;
+  SceneMeshSource source = SceneMeshSource::MengerSponge;
+  /// Recursion level and split probability of a Menger sponge
+  int32_t mengerLevel = 3;
+  float mengerProbability = 0.75f;
+  /// OBJ or PLY file of an imported mesh
+  std::string file;
+};
+
+struct SceneMaterial
+{
+  std::string name;
+  /// Hit group of the primary rays. The shadow rays always use the shadow hit group
+  std::wstring hitGroup;
+  /// Colors A, B and C of the constant buffer bound to the hit group
+  glm::vec3 colors[3] = {{1.f, 0.f, 0.f}, {1.f, 0.4f, 0.f}, {1.f, 0.7f, 0.f}};
+};
+
+struct SceneInstance
+{
+  /// Indices of the mesh and of the material in the description
+  uint32_t mesh;
+  uint32_t material;
+  glm::mat4 transform;
+};
+
+struct SceneDescription
+{
+  std::vector<SceneMesh> meshes;
+  std::vector<SceneMaterial> materials;
+  std::vector<SceneInstance> instances;
+  /// Lights replacing the point light of the sample, if any
+  std::vector<LightDesc> lights;
+};
+
+/// Read a scene description file
+SceneDescription LoadSceneDescription(const std::string& fileName);
+
+/// Add count instances of a mesh with a material, with random positions in [-extent, extent],
+/// orientations, and uniform scales in [minScale, maxScale]. A seed gives the same instances on all
+/// platforms
+void ScatterInstances(SceneDescription& description, uint32_t mesh, uint32_t material,
+                      uint32_t count, const glm::vec3& extent, float minScale, float maxScale,
+                      uint32_t seed);
+
+/// Add count spheres with falloff, with random positions in [-extent, extent] and hues, sharing a
+/// total intensity. A seed gives the same lights on all platforms
+void ScatterLights(SceneDescription& description, uint32_t count, const glm::vec3& extent,
+                   float radius, float intensity, uint32_t sampleCount, uint32_t seed);
+} // namespace rhi
@@ -0,0 +1,1029 @@
+#include "AccelerationStructure.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "Simd.h"
+#include "TraversalStats.h"
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// Node waiting on the traversal stack, with its entry distance
+struct StackEntry
+{
+  uint32_t node;
+  float entry;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Moller-Trumbore intersection, accepting both windings
+inline bool IntersectTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& edge1,
+                              const glm::vec3& edge2, float tMax, float& t, glm::vec2& bary)
+{
+  glm::vec3 p = glm::cross(ray.direction, edge2);
+  float det = glm::dot(edge1, p);
+  if (std::fabs(det) < 1e-12f)
+  {
+    return false;
+  }
+  float inverseDet = 1.f / det;
+  glm::vec3 toOrigin = ray.origin - v0;
+  float u = glm::dot(toOrigin, p) * inverseDet;
+  if (u < 0.f || u > 1.f)
+  {
+    return false;
+  }
+  glm::vec3 q = glm::cross(toOrigin, edge1);
+  float v = glm::dot(ray.direction, q) * inverseDet;
+  if (v < 0.f || u + v > 1.f)
+  {
+    return false;
+  }
+  t = glm::dot(edge2, q) * inverseDet;
+  if (t < ray.tMin || t >= tMax)
+  {
+    return false;
+  }
+  bary = glm::vec2(u, v);
+  return true;
+}
+
+/// Header of a serialized bottom-level structure, followed by its nodes and triangles
+struct SerializedHeader
+{
+  uint32_t magic;
+  uint32_t nodeCount;
+  uint32_t triangleCount;
+  uint32_t padding;
+};
+
+static const uint32_t SerializedMagic = 0x53414c42; // "BLAS"
+
+/// Result of the intersection of rays with triangles, one per lane
+struct Hit4
+{
+  Float4 mask;
+  Float4 t;
+  Float4 u;
+  Float4 v;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same test as IntersectTriangle on four lanes, which hold either one ray against four triangles
+// or four rays against one triangle. Lanes with a null determinant are rejected, which includes
+// the unused lanes of the triangle blocks
+inline Hit4 IntersectTriangle4(const Float4 origin[3], const Float4 direction[3],
+                               const Float4 v0[3], const Float4 edge1[3], const Float4 edge2[3],
+                               Float4 tMin, Float4 tMax)
+{
+  Float4 p[3] = {direction[1] * edge2[2] - edge2[1] * direction[2],
+                 direction[2] * edge2[0] - edge2[2] * direction[0],
+                 direction[0] * edge2[1] - edge2[0] * direction[1]};
+  Float4 det = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+  Float4 inverseDet = Float4(1.f) / det;
+  Float4 toOrigin[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+  Float4 u = (toOrigin[0] * p[0] + toOrigin[1] * p[1] + toOrigin[2] * p[2]) * inverseDet;
+  Float4 q[3] = {toOrigin[1] * edge1[2] - edge1[1] * toOrigin[2],
+                 toOrigin[2] * edge1[0] - edge1[2] * toOrigin[0],
+                 toOrigin[0] * edge1[1] - edge1[0] * toOrigin[1]};
+  Float4 v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverseDet;
+  Float4 t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverseDet;
+
+  Hit4 hit;
+  hit.mask = (Abs(det) >= Float4(1e-12f)) & (u >= Float4(0.f)) & (u <= Float4(1.f)) &
+             (v >= Float4(0.f)) & (u + v <= Float4(1.f)) & (t >= tMin) & (t < tMax);
+  hit.t = t;
+  hit.u = u;
+  hit.v = v;
+  return hit;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Depth-first traversal visiting the nearest child first. Nodes farther than the closest hit are
+// culled when popped. visitLeaf(node, tMax) returns true if the leaf produced a hit, after
+// updating tMax
+template <bool AnyHit, typename LeafVisitor>
+bool TraverseBvh(const BvhNode* nodes, uint32_t nodeCount, const Ray& ray, float& tMax,
+                 LeafVisitor visitLeaf)
+{
+  if (nodeCount == 0)
+  {
+    return false;
+  }
+
+  SlabRay slab(ray);
+  RHI_CPU_STAT(ThreadTraversalStats().boxTests++);
+  if (IntersectNode(slab, nodes[0], ray.tMin, tMax) < 0.f)
+  {
+    return false;
+  }
+
+  StackEntry stack[Bvh::MaxDepth];
+  uint32_t stackSize = 0;
+  uint32_t current = 0;
+  bool found = false;
+  for (;;)
+  {
+    const BvhNode& node = nodes[current];
+    RHI_CPU_STAT(ThreadTraversalStats().nodesVisited++);
+    if (node.IsLeaf())
+    {
+      if (visitLeaf(node, tMax))
+      {
+        found = true;
+        if (AnyHit)
+        {
+          return true;
+        }
+      }
+    }
+    else
+    {
+      RHI_CPU_STAT(ThreadTraversalStats().boxTests += 2);
+      float leftEntry = IntersectNode(slab, nodes[node.index], ray.tMin, tMax);
+      float rightEntry = IntersectNode(slab, nodes[node.index + 1], ray.tMin, tMax);
+      if (leftEntry >= 0.f && rightEntry >= 0.f)
+      {
+        bool leftFirst = leftEntry <= rightEntry;
+        stack[stackSize++] = {leftFirst ? node.index + 1 : node.index,
+                              leftFirst ? rightEntry : leftEntry};
+        RHI_CPU_STAT(ThreadTraversalStats().UpdateStackDepth(stackSize));
+        current = leftFirst ? node.index : node.index + 1;
+        continue;
+      }
+      if (leftEntry >= 0.f || rightEntry >= 0.f)
+      {
+        current = leftEntry >= 0.f ? node.index : node.index + 1;
+        continue;
+      }
+    }
+
+    // Pop the next node still in front of the closest hit
+    for (;;)
+    {
+      if (stackSize == 0)
+      {
+        return found;
+      }
+      stackSize--;
+      if (stack[stackSize].entry < tMax)
+      {
+        current = stack[stackSize].node;
+        break;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// World-space bounds of the object-space bounds of an instance, by Arvo's method: the translation,
+// plus for each axis the smaller and larger products of the transform column with the minimum and
+// maximum coordinates, the three coordinates of a column being computed at once. Empty instances
+// get a degenerate box which no ray enters
+Aabb TransformBounds(const Aabb& objectBounds, const glm::mat4& transform)
+{
+  Aabb bounds;
+  if (objectBounds.IsEmpty())
+  {
+    bounds.Grow(glm::vec3(transform[3]));
+    return bounds;
+  }
+
+  Float4 boundsMin = Float4::Load(&transform[3][0]);
+  Float4 boundsMax = boundsMin;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    Float4 column = Float4::Load(&transform[axis][0]);
+    Float4 a = column * Float4(objectBounds.min[axis]);
+    Float4 b = column * Float4(objectBounds.max[axis]);
+    boundsMin = boundsMin + Min(a, b);
+    boundsMax = boundsMax + Max(a, b);
+  }
+  float values[4];
+  boundsMin.Store(values);
+  bounds.min = glm::vec3(values[0], values[1], values[2]);
+  boundsMax.Store(values);
+  bounds.max = glm::vec3(values[0], values[1], values[2]);
+  return bounds;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Gather the triangle bounds of all the geometries, build the BVH, and store the triangles in leaf
+// order
+void BottomLevelAS::Build(const std::vector<TriangleGeometry>& geometry,
+                          BvhBuilder builder /*= BvhBuilder::BinnedSah*/)
+{
+  struct Source
+  {
+    uint32_t geometry;
+    uint32_t primitive;
+    glm::vec3 v[3];
+  };
+  std::vector<Source> sources;
+  std::vector<Aabb> bounds;
+
+  for (uint32_t g = 0; g < geometry.size(); g++)
+  {
+    const TriangleGeometry& desc = geometry[g];
+    uint32_t indexCount = desc.indices != nullptr ? desc.indexCount : desc.vertexCount;
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+    {
+      Source source;
+      source.geometry = g;
+      source.primitive = i / 3;
+      for (uint32_t k = 0; k < 3; k++)
+      {
+        uint32_t index = desc.indices != nullptr ? desc.indices[i + k] : i + k;
+        source.v[k] = index < desc.vertexCount ? desc.vertices[index].position : glm::vec3(0.f);
+      }
+      Aabb box;
+      box.Grow(source.v[0]);
+      box.Grow(source.v[1]);
+      box.Grow(source.v[2]);
+      sources.push_back(source);
+      bounds.push_back(box);
+    }
+  }
+
+  m_bvh.Build(bounds, 4, builder);
+  m_attachedNodes = nullptr;
+  m_attachedTriangles = nullptr;
+  m_wideBvh = Bvh4();
+  m_triangleBlocks.clear();
+  m_leafBlocks.clear();
+
+  const std::vector<uint32_t>& order = m_bvh.GetPrimitiveIndices();
+  m_triangles.resize(order.size());
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    const Source& source = sources[order[i]];
+    Triangle& triangle = m_triangles[i];
+    triangle.v0 = source.v[0];
+    triangle.edge1 = source.v[1] - source.v[0];
+    triangle.edge2 = source.v[2] - source.v[0];
+    triangle.primitiveIndex = source.primitive;
+    triangle.geometryIndex = source.geometry;
+    triangle.padding = 0;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::vector<uint8_t> BottomLevelAS::Serialize() const
+{
+  SerializedHeader header = {SerializedMagic, GetNodeCount(), GetTriangleCount(), 0};
+  size_t nodeSize = header.nodeCount * sizeof(BvhNode);
+  size_t triangleSize = header.triangleCount * sizeof(Triangle);
+  std::vector<uint8_t> data(sizeof(header) + nodeSize + triangleSize);
+  std::memcpy(data.data(), &header, sizeof(header));
+  if (nodeSize > 0)
+  {
+    std::memcpy(data.data() + sizeof(header), GetNodeData(), nodeSize);
+  }
+  if (triangleSize > 0)
+  {
+    std::memcpy(data.data() + sizeof(header) + nodeSize, GetTriangleData(), triangleSize);
+  }
+  return data;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The nodes and triangles are traversed in place. The built hierarchy, if any, is released
+void BottomLevelAS::Attach(const void* data, uint64_t size)
+{
+  SerializedHeader header;
+  if (size < sizeof(header) || reinterpret_cast<uintptr_t>(data) % 16 != 0)
+  {
+    throw std::logic_error("Invalid serialized bottom-level acceleration structure");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != SerializedMagic ||
+      size != sizeof(header) + static_cast<uint64_t>(header.nodeCount) * sizeof(BvhNode) +
+                  static_cast<uint64_t>(header.triangleCount) * sizeof(Triangle))
+  {
+    throw std::logic_error("Invalid serialized bottom-level acceleration structure");
+  }
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  m_bvh = Bvh();
+  m_triangles.clear();
+  m_triangles.shrink_to_fit();
+  m_attachedNodes = reinterpret_cast<const BvhNode*>(bytes + sizeof(header));
+  m_attachedNodeCount = header.nodeCount;
+  m_attachedTriangles = reinterpret_cast<const Triangle*>(bytes + sizeof(header) +
+                                                         header.nodeCount * sizeof(BvhNode));
+  m_attachedTriangleCount = header.triangleCount;
+  m_wideBvh = Bvh4();
+  m_triangleBlocks.clear();
+  m_leafBlocks.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Aabb BottomLevelAS::GetBounds() const
+{
+  Aabb bounds;
+  if (GetNodeCount() > 0)
+  {
+    bounds.min = GetNodeData()[0].boundsMin;
+    bounds.max = GetNodeData()[0].boundsMax;
+  }
+  return bounds;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Pack the triangles of each leaf of the 4-wide hierarchy in blocks of four
+void BottomLevelAS::BuildWide()
+{
+  m_wideBvh.Build(GetNodeData(), GetNodeCount());
+  const Triangle* triangles = GetTriangleData();
+  const std::vector<Bvh4::Leaf>& leaves = m_wideBvh.GetLeaves();
+  m_triangleBlocks.clear();
+  m_leafBlocks.resize(leaves.size());
+  for (size_t l = 0; l < leaves.size(); l++)
+  {
+    m_leafBlocks[l].first = static_cast<uint32_t>(m_triangleBlocks.size());
+    m_leafBlocks[l].count = (leaves[l].count + 3) / 4;
+    for (uint32_t b = 0; b < m_leafBlocks[l].count; b++)
+    {
+      Triangle4 block = {};
+      for (uint32_t lane = 0; lane < 4; lane++)
+      {
+        uint32_t i = 4 * b + lane;
+        if (i >= leaves[l].count)
+        {
+          continue;
+        }
+        const Triangle& triangle = triangles[leaves[l].first + i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+          block.v0[axis][lane] = triangle.v0[axis];
+          block.edge1[axis][lane] = triangle.edge1[axis];
+          block.edge2[axis][lane] = triangle.edge2[axis];
+        }
+        block.primitiveIndex[lane] = triangle.primitiveIndex;
+        block.geometryIndex[lane] = triangle.geometryIndex;
+      }
+      m_triangleBlocks.push_back(block);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <bool AnyHit>
+bool BottomLevelAS::Traverse(const Ray& ray, RayHit& hit) const
+{
+  const BvhNode* nodes = GetNodeData();
+  uint32_t nodeCount = GetNodeCount();
+  const Triangle* triangles = GetTriangleData();
+  return TraverseBvh<AnyHit>(nodes, nodeCount, ray, hit.t, [&](const BvhNode& leaf, float& tMax) {
+    bool leafHit = false;
+    for (uint32_t i = leaf.index; i < leaf.index + leaf.primitiveCount; i++)
+    {
+      const Triangle& triangle = triangles[i];
+      RHI_CPU_STAT(ThreadTraversalStats().triangleTests++);
+      float t;
+      glm::vec2 bary;
+      if (IntersectTriangle(ray, triangle.v0, triangle.edge1, triangle.edge2, tMax, t, bary))
+      {
+        tMax = t;
+        hit.barycentrics = bary;
+        hit.primitiveIndex = triangle.primitiveIndex;
+        hit.geometryIndex = triangle.geometryIndex;
+        leafHit = true;
+        if (AnyHit)
+        {
+          break;
+        }
+      }
+    }
+    return leafHit;
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool BottomLevelAS::Intersect(const Ray& ray, RayHit& hit) const
+{
+  return Traverse<false>(ray, hit);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool BottomLevelAS::Occluded(const Ray& ray) const
+{
+  RayHit hit;
+  hit.t = ray.tMax;
+  return Traverse<true>(ray, hit);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Test the ray against the triangle blocks of a leaf of the 4-wide hierarchy, keeping the closest
+// lane of each block
+template <bool AnyHit>
+bool BottomLevelAS::IntersectLeafBlocks(const Ray& ray, uint32_t leaf, float& tMax,
+                                        RayHit& hit) const
+{
+  Float4 origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  Float4 direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+  bool found = false;
+  const LeafBlocks& blocks = m_leafBlocks[leaf];
+  for (uint32_t b = blocks.first; b < blocks.first + blocks.count; b++)
+  {
+    const Triangle4& block = m_triangleBlocks[b];
+#if RHI_CPU_TRAVERSAL_STATS
+    uint32_t remaining = m_wideBvh.GetLeaves()[leaf].count - 4 * (b - blocks.first);
+    ThreadTraversalStats().triangleTests += remaining < 4 ? remaining : 4;
+#endif
+    Float4 v0[3] = {Float4::Load(block.v0[0]), Float4::Load(block.v0[1]),
+                    Float4::Load(block.v0[2])};
+    Float4 edge1[3] = {Float4::Load(block.edge1[0]), Float4::Load(block.edge1[1]),
+                       Float4::Load(block.edge1[2])};
+    Float4 edge2[3] = {Float4::Load(block.edge2[0]), Float4::Load(block.edge2[1]),
+                       Float4::Load(block.edge2[2])};
+    Hit4 hit4 = IntersectTriangle4(origin, direction, v0, edge1, edge2, ray.tMin, tMax);
+    int mask = Mask(hit4.mask);
+    if (mask == 0)
+    {
+      continue;
+    }
+    found = true;
+    float t[4], u[4], v[4];
+    hit4.t.Store(t);
+    hit4.u.Store(u);
+    hit4.v.Store(v);
+    int closest = FirstLane(mask);
+    for (int lane = closest + 1; lane < 4; lane++)
+    {
+      if ((mask & (1 << lane)) != 0 && t[lane] < t[closest])
+      {
+        closest = lane;
+      }
+    }
+    tMax = t[closest];
+    hit.barycentrics = glm::vec2(u[closest], v[closest]);
+    hit.primitiveIndex = block.primitiveIndex[closest];
+    hit.geometryIndex = block.geometryIndex[closest];
+    if (AnyHit)
+    {
+      return true;
+    }
+  }
+  return found;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Depth-first traversal of the 4-wide hierarchy. The children hit by the ray are pushed from the
+// farthest to the nearest, so the nearest is visited first
+template <bool AnyHit>
+bool BottomLevelAS::TraverseWide(const Ray& ray, RayHit& hit) const
+{
+  const std::vector<Bvh4Node>& nodes = m_wideBvh.GetNodes();
+  if (m_wideBvh.IsRootLeaf())
+  {
+    return IntersectLeafBlocks<AnyHit>(ray, 0, hit.t, hit);
+  }
+  if (nodes.empty())
+  {
+    return false;
+  }
+
+  Float4 origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  Float4 inverseDirection[3] = {1.f / ray.direction.x, 1.f / ray.direction.y,
+                                1.f / ray.direction.z};
+  Float4 tMin(ray.tMin);
+
+  // Each visited node pops one entry and pushes at most four
+  StackEntry stack[3 * Bvh::MaxDepth + 1];
+  uint32_t stackSize = 1;
+  stack[0] = {0, ray.tMin};
+  bool found = false;
+  while (stackSize > 0)
+  {
+    StackEntry entry = stack[--stackSize];
+    if (entry.entry >= hit.t)
+    {
+      continue;
+    }
+    RHI_CPU_STAT(ThreadTraversalStats().nodesVisited++);
+    if ((entry.node & Bvh4Node::LeafFlag) != 0)
+    {
+      if (IntersectLeafBlocks<AnyHit>(ray, entry.node & ~Bvh4Node::LeafFlag, hit.t, hit))
+      {
+        found = true;
+        if (AnyHit)
+        {
+          return true;
+        }
+      }
+      continue;
+    }
+
+    const Bvh4Node& node = nodes[entry.node];
+    RHI_CPU_STAT(ThreadTraversalStats().boxTests += 4);
+    Float4 tNear[3], tFar[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      Float4 t0 = (Float4::Load(node.boundsMin[axis]) - origin[axis]) * inverseDirection[axis];
+      Float4 t1 = (Float4::Load(node.boundsMax[axis]) - origin[axis]) * inverseDirection[axis];
+      tNear[axis] = Min(t0, t1);
+      tFar[axis] = Max(t0, t1);
+    }
+    Float4 childEntry = Max(Max(tNear[0], tNear[1]), Max(tNear[2], tMin));
+    Float4 childExit = Min(Min(tFar[0], tFar[1]), Min(tFar[2], Float4(hit.t)));
+    int mask = Mask(childEntry <= childExit);
+    if (mask == 0)
+    {
+      continue;
+    }
+
+    float entries[4];
+    childEntry.Store(entries);
+    StackEntry children[4];
+    uint32_t childCount = 0;
+    for (int k = 0; k < 4; k++)
+    {
+      if ((mask & (1 << k)) == 0)
+      {
+        continue;
+      }
+      // Insertion in decreasing entry distance
+      uint32_t position = childCount++;
+      while (position > 0 && children[position - 1].entry < entries[k])
+      {
+        children[position] = children[position - 1];
+        position--;
+      }
+      children[position] = {node.children[k], entries[k]};
+    }
+    for (uint32_t k = 0; k < childCount; k++)
+    {
+      stack[stackSize++] = children[k];
+    }
+    RHI_CPU_STAT(ThreadTraversalStats().UpdateStackDepth(stackSize));
+  }
+  return found;
+}
+
+/// Four rays in structure-of-arrays form, with the closest hit of each
+struct BottomLevelAS::RayPacket
+{
+  Float4 origin[3];
+  Float4 direction[3];
+  Float4 inverseDirection[3];
+  Float4 tMin;
+  Float4 tMax;
+  Float4 u;
+  Float4 v;
+  uint32_t primitiveIndex[4];
+  uint32_t geometryIndex[4];
+
+  /// Transpose laneCount rays, the other lanes being zeroed
+  RayPacket(const Ray* rays, uint32_t laneCount)
+  {
+    float values[11][4] = {};
+    for (uint32_t lane = 0; lane < laneCount; lane++)
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        values[axis][lane] = rays[lane].origin[axis];
+        values[3 + axis][lane] = rays[lane].direction[axis];
+        values[6 + axis][lane] = 1.f / rays[lane].direction[axis];
+      }
+      values[9][lane] = rays[lane].tMin;
+      values[10][lane] = rays[lane].tMax;
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+      origin[axis] = Float4::Load(values[axis]);
+      direction[axis] = Float4::Load(values[3 + axis]);
+      inverseDirection[axis] = Float4::Load(values[6 + axis]);
+    }
+    tMin = Float4::Load(values[9]);
+    tMax = Float4::Load(values[10]);
+    u = Float4(0.f);
+    v = Float4(0.f);
+  }
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Depth-first traversal of the binary hierarchy by all the active rays together. A node is visited
+// if any active ray enters it, and the rays which miss it are masked out of its subtree. The child
+// visited first is the one nearest along the direction of the first ray. Rays found occluded are
+// deactivated, and the traversal stops when none is left
+template <bool AnyHit>
+int BottomLevelAS::TraversePacket(RayPacket& packet, int activeMask) const
+{
+  const BvhNode* nodes = GetNodeData();
+  const Triangle* triangles = GetTriangleData();
+  if (GetNodeCount() == 0)
+  {
+    return 0;
+  }
+
+  struct PacketEntry
+  {
+    uint32_t node;
+    int mask;
+  };
+  // Each visited node pops one entry and pushes at most two
+  PacketEntry stack[Bvh::MaxDepth + 2];
+  uint32_t stackSize = 1;
+  stack[0] = {0, activeMask};
+  int hitMask = 0;
+  while (stackSize > 0)
+  {
+    PacketEntry entry = stack[--stackSize];
+    int mask = entry.mask & activeMask;
+    if (mask == 0)
+    {
+      continue;
+    }
+
+    const BvhNode& node = nodes[entry.node];
+    RHI_CPU_STAT(ThreadTraversalStats().nodesVisited++);
+    RHI_CPU_STAT(ThreadTraversalStats().boxTests += LaneCount(mask));
+    Float4 tNear[3], tFar[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      Float4 t0 = (Float4(node.boundsMin[axis]) - packet.origin[axis]) *
+                  packet.inverseDirection[axis];
+      Float4 t1 = (Float4(node.boundsMax[axis]) - packet.origin[axis]) *
+                  packet.inverseDirection[axis];
+      tNear[axis] = Min(t0, t1);
+      tFar[axis] = Max(t0, t1);
+    }
+    Float4 nodeEntry = Max(Max(tNear[0], tNear[1]), Max(tNear[2], packet.tMin));
+    Float4 nodeExit = Min(Min(tFar[0], tFar[1]), Min(tFar[2], packet.tMax));
+    mask &= Mask(nodeEntry <= nodeExit);
+    if (mask == 0)
+    {
+      continue;
+    }
+
+    if (!node.IsLeaf())
+    {
+      const BvhNode& left = nodes[node.index];
+      const BvhNode& right = nodes[node.index + 1];
+      glm::vec3 offset = (right.boundsMin + right.boundsMax) - (left.boundsMin + left.boundsMax);
+      int axis = std::fabs(offset.x) > std::fabs(offset.y) ? 0 : 1;
+      axis = std::fabs(offset[axis]) > std::fabs(offset.z) ? axis : 2;
+      bool leftFirst = offset[axis] * packet.direction[axis][FirstLane(mask)] >= 0.f;
+      stack[stackSize++] = {leftFirst ? node.index + 1 : node.index, mask};
+      stack[stackSize++] = {leftFirst ? node.index : node.index + 1, mask};
+      RHI_CPU_STAT(ThreadTraversalStats().UpdateStackDepth(stackSize));
+      continue;
+    }
+
+    Float4 laneMask = MaskFromBits(mask);
+    for (uint32_t i = node.index; i < node.index + node.primitiveCount; i++)
+    {
+      const Triangle& triangle = triangles[i];
+      RHI_CPU_STAT(ThreadTraversalStats().triangleTests += LaneCount(mask));
+      Float4 v0[3] = {triangle.v0.x, triangle.v0.y, triangle.v0.z};
+      Float4 edge1[3] = {triangle.edge1.x, triangle.edge1.y, triangle.edge1.z};
+      Float4 edge2[3] = {triangle.edge2.x, triangle.edge2.y, triangle.edge2.z};
+      Hit4 hit4 = IntersectTriangle4(packet.origin, packet.direction, v0, edge1, edge2,
+                                     packet.tMin, packet.tMax);
+      Float4 hitLanes = hit4.mask & laneMask;
+      int lanes = Mask(hitLanes);
+      if (lanes == 0)
+      {
+        continue;
+      }
+      hitMask |= lanes;
+      packet.tMax = Select(hitLanes, hit4.t, packet.tMax);
+      packet.u = Select(hitLanes, hit4.u, packet.u);
+      packet.v = Select(hitLanes, hit4.v, packet.v);
+      for (int lane = 0; lane < 4; lane++)
+      {
+        if ((lanes & (1 << lane)) != 0)
+        {
+          packet.primitiveIndex[lane] = triangle.primitiveIndex;
+          packet.geometryIndex[lane] = triangle.geometryIndex;
+        }
+      }
+      if (AnyHit)
+      {
+        activeMask &= ~lanes;
+        mask &= ~lanes;
+        if (activeMask == 0)
+        {
+          return hitMask;
+        }
+        laneMask = MaskFromBits(mask);
+      }
+    }
+  }
+  return hitMask;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Packets are made of four consecutive rays, the last one being completed with inactive lanes
+void BottomLevelAS::Intersect(const Ray* rays, RayHit* hits, uint32_t count,
+                              TraversalKernel kernel) const
+{
+  if (kernel == TraversalKernel::Simd && m_wideBvh.GetLeaves().empty() && GetTriangleCount() > 0)
+  {
+    throw std::logic_error("The SIMD kernel requires BuildWide");
+  }
+  RHI_CPU_STAT(ThreadTraversalStats().rays += count);
+
+  if (kernel != TraversalKernel::Packet)
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      hits[i].t = rays[i].tMax;
+      if (kernel == TraversalKernel::Simd)
+      {
+        TraverseWide<false>(rays[i], hits[i]);
+      }
+      else
+      {
+        Traverse<false>(rays[i], hits[i]);
+      }
+    }
+    return;
+  }
+
+  for (uint32_t first = 0; first < count; first += 4)
+  {
+    uint32_t laneCount = count - first < 4 ? count - first : 4;
+    RayPacket packet(rays + first, laneCount);
+
+    TraversePacket<false>(packet, (1 << laneCount) - 1);
+
+    float t[4], u[4], v[4];
+    packet.tMax.Store(t);
+    packet.u.Store(u);
+    packet.v.Store(v);
+    for (uint32_t lane = 0; lane < laneCount; lane++)
+    {
+      RayHit& hit = hits[first + lane];
+      hit.t = t[lane];
+      hit.barycentrics = glm::vec2(u[lane], v[lane]);
+      hit.primitiveIndex = packet.primitiveIndex[lane];
+      hit.geometryIndex = packet.geometryIndex[lane];
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void BottomLevelAS::Occluded(const Ray* rays, uint8_t* occluded, uint32_t count,
+                             TraversalKernel kernel) const
+{
+  if (kernel == TraversalKernel::Simd && m_wideBvh.GetLeaves().empty() && GetTriangleCount() > 0)
+  {
+    throw std::logic_error("The SIMD kernel requires BuildWide");
+  }
+  RHI_CPU_STAT(ThreadTraversalStats().rays += count);
+
+  if (kernel != TraversalKernel::Packet)
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      RayHit hit;
+      hit.t = rays[i].tMax;
+      bool found = kernel == TraversalKernel::Simd ? TraverseWide<true>(rays[i], hit)
+                                                   : Traverse<true>(rays[i], hit);
+      occluded[i] = found ? 1 : 0;
+      RHI_CPU_STAT(ThreadTraversalStats().shadowEarlyExits += occluded[i]);
+    }
+    return;
+  }
+
+  for (uint32_t first = 0; first < count; first += 4)
+  {
+    uint32_t laneCount = count - first < 4 ? count - first : 4;
+    RayPacket packet(rays + first, laneCount);
+
+    int hitMask = TraversePacket<true>(packet, (1 << laneCount) - 1);
+    for (uint32_t lane = 0; lane < laneCount; lane++)
+    {
+      occluded[first + lane] = (hitMask & (1 << lane)) != 0 ? 1 : 0;
+      RHI_CPU_STAT(ThreadTraversalStats().shadowEarlyExits += occluded[first + lane]);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t BottomLevelAS::GetMemorySize() const
+{
+  return GetNodeCount() * sizeof(BvhNode) + GetTriangleCount() * sizeof(Triangle) +
+         m_bvh.GetPrimitiveIndices().size() * sizeof(uint32_t) +
+         m_wideBvh.GetNodes().size() * sizeof(Bvh4Node) +
+         m_wideBvh.GetLeaves().size() * sizeof(Bvh4::Leaf) +
+         m_triangleBlocks.size() * sizeof(Triangle4) + m_leafBlocks.size() * sizeof(LeafBlocks);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Build the BVH on the world-space bounds of the instances. The instances are processed in chunks,
+// large enough for the thread pool overhead to be negligible
+void TopLevelAS::Build(const std::vector<Instance>& instances, ThreadPool* pool /*= nullptr*/)
+{
+  const uint32_t ChunkSize = 4096;
+  uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+  uint32_t chunkCount = (instanceCount + ChunkSize - 1) / ChunkSize;
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    tools::ProfileZone zone("TLAS transforms");
+    m_instances.resize(instanceCount);
+    m_worldToObject.resize(instanceCount);
+    m_instanceBounds.resize(instanceCount);
+    auto transformChunk = [&](uint32_t chunk, uint32_t /*thread*/) {
+      uint32_t end = (chunk + 1) * ChunkSize < instanceCount ? (chunk + 1) * ChunkSize
+                                                             : instanceCount;
+      for (uint32_t i = chunk * ChunkSize; i < end; i++)
+      {
+        m_instances[i] = instances[i];
+        m_worldToObject[i] = glm::inverse(instances[i].transform);
+        m_instanceBounds[i] = TransformBounds(instances[i].blas->GetBounds(),
+                                              instances[i].transform);
+      }
+    };
+    if (pool != nullptr)
+    {
+      pool->ParallelFor(chunkCount, transformChunk);
+    }
+    else
+    {
+      for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+      {
+        transformChunk(chunk, 0);
+      }
+    }
+  }
+  auto transformEnd = std::chrono::steady_clock::now();
+
+  {
+    tools::ProfileZone zone("TLAS BVH");
+    m_bvh.Build(m_instanceBounds, 1);
+  }
+  auto end = std::chrono::steady_clock::now();
+  m_buildTimings.transformMs =
+      std::chrono::duration<double, std::milli>(transformEnd - start).count();
+  m_buildTimings.bvhMs = std::chrono::duration<double, std::milli>(end - transformEnd).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <bool AnyHit>
+bool TopLevelAS::Traverse(const Ray& ray, RayHit& hit) const
+{
+  const std::vector<uint32_t>& instanceIndices = m_bvh.GetPrimitiveIndices();
+  const BvhNode* nodes = m_bvh.GetNodes().data();
+  uint32_t nodeCount = static_cast<uint32_t>(m_bvh.GetNodes().size());
+  return TraverseBvh<AnyHit>(nodes, nodeCount, ray, hit.t, [&](const BvhNode& leaf, float& tMax) {
+    bool leafHit = false;
+    for (uint32_t i = leaf.index; i < leaf.index + leaf.primitiveCount; i++)
+    {
+      uint32_t instanceIndex = instanceIndices[i];
+      const glm::mat4& worldToObject = m_worldToObject[instanceIndex];
+
+      Ray objectRay;
+      objectRay.origin = glm::vec3(worldToObject * glm::vec4(ray.origin, 1.f));
+      objectRay.direction = glm::vec3(worldToObject * glm::vec4(ray.direction, 0.f));
+      objectRay.tMin = ray.tMin;
+      objectRay.tMax = tMax;
+
+      const BottomLevelAS* blas = m_instances[instanceIndex].blas;
+      if (AnyHit)
+      {
+        if (blas->Occluded(objectRay))
+        {
+          hit.instanceIndex = instanceIndex;
+          return true;
+        }
+      }
+      else if (blas->Intersect(objectRay, hit))
+      {
+        tMax = hit.t;
+        hit.instanceIndex = instanceIndex;
+        leafHit = true;
+      }
+    }
+    return leafHit;
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool TopLevelAS::Intersect(const Ray& ray, RayHit& hit) const
+{
+  RHI_CPU_STAT(ThreadTraversalStats().rays++);
+  return Traverse<false>(ray, hit);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool TopLevelAS::Occluded(const Ray& ray) const
+{
+  RHI_CPU_STAT(ThreadTraversalStats().rays++);
+  RayHit hit;
+  hit.t = ray.tMax;
+  bool occluded = Traverse<true>(ray, hit);
+  RHI_CPU_STAT(ThreadTraversalStats().shadowEarlyExits += occluded ? 1 : 0);
+  return occluded;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pairs of instance and ray are sorted by instance, then by ray, so that the rays traced
+// together through an instance keep the order of the array, in which consecutive rays are meant to
+// be coherent. Rays already found occluded by an instance are not traced through the next ones
+void TopLevelAS::Occluded(const Ray* rays, uint8_t* occluded, uint32_t count,
+                          TraversalKernel kernel) const
+{
+  const std::vector<uint32_t>& instanceIndices = m_bvh.GetPrimitiveIndices();
+  const BvhNode* nodes = m_bvh.GetNodes().data();
+  uint32_t nodeCount = static_cast<uint32_t>(m_bvh.GetNodes().size());
+  std::vector<uint64_t> entries;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    occluded[i] = 0;
+    float tMax = rays[i].tMax;
+    TraverseBvh<false>(nodes, nodeCount, rays[i], tMax, [&](const BvhNode& leaf, float&) {
+      for (uint32_t j = leaf.index; j < leaf.index + leaf.primitiveCount; j++)
+      {
+        entries.push_back((static_cast<uint64_t>(instanceIndices[j]) << 32) | i);
+      }
+      return false;
+    });
+  }
+  std::sort(entries.begin(), entries.end());
+
+  std::vector<Ray> objectRays;
+  std::vector<uint32_t> rayIndices;
+  std::vector<uint8_t> objectOccluded;
+  size_t first = 0;
+  while (first < entries.size())
+  {
+    uint32_t instanceIndex = static_cast<uint32_t>(entries[first] >> 32);
+    const glm::mat4& worldToObject = m_worldToObject[instanceIndex];
+    objectRays.clear();
+    rayIndices.clear();
+    for (; first < entries.size() && (entries[first] >> 32) == instanceIndex; first++)
+    {
+      uint32_t rayIndex = static_cast<uint32_t>(entries[first]);
+      if (occluded[rayIndex] != 0)
+      {
+        continue;
+      }
+      const Ray& ray = rays[rayIndex];
+      Ray objectRay;
+      objectRay.origin = glm::vec3(worldToObject * glm::vec4(ray.origin, 1.f));
+      objectRay.direction = glm::vec3(worldToObject * glm::vec4(ray.direction, 0.f));
+      objectRay.tMin = ray.tMin;
+      objectRay.tMax = ray.tMax;
+      objectRays.push_back(objectRay);
+      rayIndices.push_back(rayIndex);
+    }
+
+    uint32_t objectCount = static_cast<uint32_t>(objectRays.size());
+    objectOccluded.resize(objectCount);
+    m_instances[instanceIndex].blas->Occluded(objectRays.data(), objectOccluded.data(),
+                                              objectCount, kernel);
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+      occluded[rayIndices[i]] |= objectOccluded[i];
+    }
+  }
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,284 @@
+/*
+CPU counterparts of the DXR acceleration structures.
+
+A bottom-level acceleration structure is a BVH over the triangles of one or
+more geometries. The triangles are copied in the order of the BVH leaves, in a
+form ready for intersection (one vertex and two edges), so that the source
+buffers are not needed during traversal.
+
+The top-level acceleration structure is a BVH over the world-space bounds of
+the instances. When a ray reaches an instance, it is transformed to the object
+space of the instance and traced through its bottom-level structure. The
+direction is not renormalized, so that hit distances are the same in both
+spaces, as in DXR. Scenes may have millions of instances, so the inverse
+transforms and world-space bounds are computed in parallel when a thread pool
+is given, the bounds with SIMD, and the duration of each stage of the build is
+kept for profiling.
+
+Barycentrics follow the DXR convention: the hit point is
+v0 + bary.x * (v1 - v0) + bary.y * (v2 - v0).
+
+Bottom-level structures also trace arrays of rays with one of three kernels:
+- Scalar: one ray at a time through the binary BVH, as Intersect and Occluded
+- Simd: one ray at a time through a 4-wide BVH, testing the four children of a
+  node and up to four triangles of a leaf at once. Requires BuildWide
+- Packet: groups of four consecutive rays through the binary BVH together,
+  each lane of the SIMD registers holding one ray. This pays off for coherent
+  rays, such as the primary rays of 2x2 pixel quads
+All kernels find the same hits, up to floating-point rounding.
+
+The top-level structure also finds the occlusion of arrays of rays, such as
+the shadow rays of a tile: the instances entered by each ray are listed first,
+then the rays entering each instance are traced together through its
+bottom-level structure with one of the kernels, in their order in the array.
+
+A built structure can be serialized, and later attached to serialized data
+without copying it, for instance from a memory-mapped scene cache.
+
+Example:
+
+BottomLevelAS blas;
+blas.Build({{vertices, vertexCount, indices, indexCount}});
+TopLevelAS tlas;
+tlas.Build({{&blas, transform, 0}});
+RayHit hit;
+if (tlas.Intersect(ray, hit)) { ... }
+blas.BuildWide();
+blas.Intersect(rays.data(), hits.data(), rayCount, TraversalKernel::Simd);
+std::vector<uint8_t> data = blas.Serialize();
+BottomLevelAS copy;
+copy.Attach(data.data(), data.size());
+
+*/
+
+#pragma once
+
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include "../RenderDevice.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct Ray
+{
+  glm::vec3 origin;
+  float tMin;
+  glm::vec3 direction;
+  float tMax;
+};
+
+/// Closest intersection found along a ray
+struct RayHit
+{
+  float t;
+  glm::vec2 barycentrics;
+  uint32_t primitiveIndex;
+  uint32_t geometryIndex;
+  uint32_t instanceIndex;
+};
+
+enum class TraversalKernel
+{
+  Scalar,
+  Simd,
+  Packet
+};
+
+/// Triangles read from vertex and optional index data
+struct TriangleGeometry
+{
+  const Vertex* vertices;
+  uint32_t vertexCount;
+  const uint32_t* indices;
+  uint32_t indexCount;
+};
+
+class BottomLevelAS
+{
+public:
+  void Build(const std::vector<TriangleGeometry>& geometry,
+             BvhBuilder builder = BvhBuilder::BinnedSah);
+
+  /// Build the 4-wide hierarchy and the triangle blocks of the SIMD kernel
+  void BuildWide();
+
+  /// Find the closest intersection with t in [ray.tMin, hit.t). The caller initializes hit.t,
+  /// typically to ray.tMax. Returns true and updates hit if an intersection is found. The instance
+  /// index of the hit is left untouched
+  bool Intersect(const Ray& ray, RayHit& hit) const;
+
+  /// Returns true as soon as any intersection is found in [ray.tMin, ray.tMax)
+  bool Occluded(const Ray& ray) const;
+
+  /// Find the closest intersection of each ray with the kernel. Rays without intersection get a
+  /// hit distance of ray.tMax, and their other hit members are undefined
+  void Intersect(const Ray* rays, RayHit* hits, uint32_t count, TraversalKernel kernel) const;
+
+  /// Set occluded[i] to 1 if rays[i] has any intersection, 0 otherwise
+  void Occluded(const Ray* rays, uint8_t* occluded, uint32_t count, TraversalKernel kernel) const;
+
+  /// Nodes and triangles of the structure, as a block of memory which Attach can use
+  std::vector<uint8_t> Serialize() const;
+
+  /// Use the nodes and triangles serialized by a structure of the same build, in place: the data
+  /// must be aligned to 16 bytes, and stay valid and unchanged as long as the structure is used.
+  /// Throws if the data is not a serialized structure. BuildWide rebuilds the structures of the
+  /// SIMD kernel, which are not serialized
+  void Attach(const void* data, uint64_t size);
+
+  Aabb GetBounds() const;
+  uint32_t GetTriangleCount() const
+  {
+    return m_attachedTriangles != nullptr ? m_attachedTriangleCount
+                                          : static_cast<uint32_t>(m_triangles.size());
+  }
+  /// Memory used by the nodes and triangles, attached or not, including the ones of the SIMD
+  /// kernel if built
+  uint64_t GetMemorySize() const;
+
+private:
+  /// Triangle ready for intersection, 48 bytes
+  struct Triangle
+  {
+    glm::vec3 v0;
+    uint32_t primitiveIndex;
+    glm::vec3 edge1;
+    uint32_t geometryIndex;
+    glm::vec3 edge2;
+    uint32_t padding;
+  };
+
+  /// Four triangles in structure-of-arrays form, 176 bytes. Unused lanes have null edges, which
+  /// the intersection test rejects
+  struct Triangle4
+  {
+    float v0[3][4];
+    float edge1[3][4];
+    float edge2[3][4];
+    uint32_t primitiveIndex[4];
+    uint32_t geometryIndex[4];
+  };
+
+  /// Blocks of triangles of a leaf of the 4-wide hierarchy
+  struct LeafBlocks
+  {
+    uint32_t first;
+    uint32_t count;
+  };
+
+  struct RayPacket;
+
+  template <bool AnyHit>
+  bool Traverse(const Ray& ray, RayHit& hit) const;
+  template <bool AnyHit>
+  bool TraverseWide(const Ray& ray, RayHit& hit) const;
+  template <bool AnyHit>
+  bool IntersectLeafBlocks(const Ray& ray, uint32_t leaf, float& tMax, RayHit& hit) const;
+  /// Traverse the rays of the lanes of activeMask together. Returns the lanes which found a hit
+  template <bool AnyHit>
+  int TraversePacket(RayPacket& packet, int activeMask) const;
+
+  /// Nodes and triangles of the built hierarchy, or the attached ones
+  const BvhNode* GetNodeData() const
+  {
+    return m_attachedNodes != nullptr ? m_attachedNodes : m_bvh.GetNodes().data();
+  }
+  uint32_t GetNodeCount() const
+  {
+    return m_attachedNodes != nullptr ? m_attachedNodeCount
+                                      : static_cast<uint32_t>(m_bvh.GetNodes().size());
+  }
+  const Triangle* GetTriangleData() const
+  {
+    return m_attachedTriangles != nullptr ? m_attachedTriangles : m_triangles.data();
+  }
+
+  Bvh m_bvh;
+  std::vector<Triangle> m_triangles;
+
+  /// Serialized data given to Attach, used instead of the built hierarchy when not null
+  const BvhNode* m_attachedNodes = nullptr;
+  uint32_t m_attachedNodeCount = 0;
+  const Triangle* m_attachedTriangles = nullptr;
+  uint32_t m_attachedTriangleCount = 0;
+
+  Bvh4 m_wideBvh;
+  std::vector<Triangle4> m_triangleBlocks;
+  std::vector<LeafBlocks> m_leafBlocks;
+};
+
+class TopLevelAS
+{
+public:
+  struct Instance
+  {
+    const BottomLevelAS* blas;
+    glm::mat4 transform;
+    uint32_t hitGroupIndex;
+  };
+
+  /// Durations of the stages of a build, in milliseconds
+  struct BuildTimings
+  {
+    /// Copy of the instances, inverse transforms and world-space bounds
+    double transformMs = 0.0;
+    /// Hierarchy over the bounds
+    double bvhMs = 0.0;
+  };
+
+  /// Build the structure over the instances, processing them on the threads of the pool if not
+  /// null
+  void Build(const std::vector<Instance>& instances, ThreadPool* pool = nullptr);
+
+  /// Same as BottomLevelAS::Intersect, also setting the instance index of the hit
+  bool Intersect(const Ray& ray, RayHit& hit) const;
+  bool Occluded(const Ray& ray) const;
+  /// Occlusion of each ray of an array, the traversal statistics counting each ray once per
+  /// instance it enters. The Simd kernel requires BuildWide on all the bottom-level structures
+  void Occluded(const Ray* rays, uint8_t* occluded, uint32_t count, TraversalKernel kernel) const;
+
+  const Instance& GetInstance(uint32_t index) const { return m_instances[index]; }
+  uint32_t GetInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+  const BuildTimings& GetBuildTimings() const { return m_buildTimings; }
+
+private:
+  template <bool AnyHit>
+  bool Traverse(const Ray& ray, RayHit& hit) const;
+
+  std::vector<Instance> m_instances;
+  std::vector<glm::mat4> m_worldToObject;
+  std::vector<Aabb> m_instanceBounds;
+  Bvh m_bvh;
+  BuildTimings m_buildTimings;
+};
+
+/// Ray with the reciprocal direction, for the slab tests
+struct SlabRay
+{
+  glm::vec3 origin;
+  glm::vec3 inverseDirection;
+
+  explicit SlabRay(const Ray& ray)
+      : origin(ray.origin), inverseDirection(1.f / ray.direction.x, 1.f / ray.direction.y,
+                                             1.f / ray.direction.z)
+  {
+  }
+};
+
+/// Entry distance of the ray in the node bounds, or a negative value if the interval [tMin, tMax]
+/// misses the node
+inline float IntersectNode(const SlabRay& ray, const BvhNode& node, float tMin, float tMax)
+{
+  glm::vec3 t0 = (node.boundsMin - ray.origin) * ray.inverseDirection;
+  glm::vec3 t1 = (node.boundsMax - ray.origin) * ray.inverseDirection;
+  glm::vec3 tNear = glm::min(t0, t1);
+  glm::vec3 tFar = glm::max(t0, t1);
+  float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, tMin));
+  float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tMax));
+  return entry <= exit ? entry : -1.f;
+}
+} // namespace cpu
+} // namespace rhi
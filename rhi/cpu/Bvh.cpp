@@ -0,0 +1,335 @@
+#include "Bvh.h"
+
+#include <algorithm>
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+const uint32_t BinCount = 16;
+/// Cost of traversing a node, relative to intersecting a primitive
+const float TraversalCost = 1.f;
+const float IntersectionCost = 1.f;
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Bvh::Build(const std::vector<Aabb>& primitiveBounds, uint32_t maxLeafSize /*= 4*/,
+                BvhBuilder builder /*= BvhBuilder::BinnedSah*/)
+{
+  m_nodes.clear();
+  m_primitiveIndices.resize(primitiveBounds.size());
+  m_maxLeafSize = maxLeafSize == 0 ? 1 : maxLeafSize;
+  m_builder = builder;
+  m_depth = 0;
+
+  if (primitiveBounds.empty())
+  {
+    return;
+  }
+
+  std::vector<glm::vec3> centroids(primitiveBounds.size());
+  for (uint32_t i = 0; i < primitiveBounds.size(); i++)
+  {
+    m_primitiveIndices[i] = i;
+    centroids[i] = primitiveBounds[i].Center();
+  }
+
+  // A binary tree with n leaves has 2n-1 nodes
+  m_nodes.reserve(2 * primitiveBounds.size());
+  m_nodes.push_back({});
+  BuildNode(0, 0, static_cast<uint32_t>(primitiveBounds.size()), 1, primitiveBounds, centroids);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Split the primitives [begin, end) of the index array with the builder. The children are
+// allocated together, then built recursively
+void Bvh::BuildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth,
+                    const std::vector<Aabb>& primitiveBounds,
+                    const std::vector<glm::vec3>& centroids)
+{
+  m_depth = depth > m_depth ? depth : m_depth;
+
+  Aabb bounds;
+  Aabb centroidBounds;
+  for (uint32_t i = begin; i < end; i++)
+  {
+    bounds.Grow(primitiveBounds[m_primitiveIndices[i]]);
+    centroidBounds.Grow(centroids[m_primitiveIndices[i]]);
+  }
+
+  const uint32_t count = end - begin;
+  auto makeLeaf = [&]() {
+    BvhNode& node = m_nodes[nodeIndex];
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+    node.index = begin;
+    node.primitiveCount = count;
+  };
+
+  if (count <= 1 || depth >= MaxDepth)
+  {
+    makeLeaf();
+    return;
+  }
+
+  // Split axis: largest extent of the centroids
+  glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+  int axis = 0;
+  if (extent.y > extent[axis])
+  {
+    axis = 1;
+  }
+  if (extent.z > extent[axis])
+  {
+    axis = 2;
+  }
+
+  uint32_t mid = m_builder == BvhBuilder::Median
+                     ? SplitMedian(begin, end, axis, centroids)
+                     : SplitBinnedSah(begin, end, bounds, centroidBounds, axis, primitiveBounds,
+                                      centroids);
+
+  if (mid == begin || mid == end)
+  {
+    // No useful split: small nodes become leaves, large ones with coincident centroids are
+    // split in the middle of the index range
+    if (count <= m_maxLeafSize)
+    {
+      makeLeaf();
+      return;
+    }
+    mid = begin + count / 2;
+  }
+
+  uint32_t children = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.push_back({});
+  m_nodes.push_back({});
+  {
+    BvhNode& node = m_nodes[nodeIndex];
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+    node.index = children;
+    node.primitiveCount = 0;
+  }
+
+  BuildNode(children, begin, mid, depth + 1, primitiveBounds, centroids);
+  BuildNode(children + 1, mid, end, depth + 1, primitiveBounds, centroids);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Bin the primitives by centroid, and evaluate the SAH at each bin boundary
+uint32_t Bvh::SplitBinnedSah(uint32_t begin, uint32_t end, const Aabb& bounds,
+                             const Aabb& centroidBounds, int axis,
+                             const std::vector<Aabb>& primitiveBounds,
+                             const std::vector<glm::vec3>& centroids)
+{
+  float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+  if (extent <= 0.f)
+  {
+    return begin;
+  }
+
+  struct Bin
+  {
+    Aabb bounds;
+    uint32_t count = 0;
+  } bins[BinCount];
+
+  float scale = static_cast<float>(BinCount) / extent;
+  auto binIndex = [&](uint32_t primitive) {
+    uint32_t b =
+        static_cast<uint32_t>((centroids[primitive][axis] - centroidBounds.min[axis]) * scale);
+    return b < BinCount ? b : BinCount - 1;
+  };
+  for (uint32_t i = begin; i < end; i++)
+  {
+    Bin& bin = bins[binIndex(m_primitiveIndices[i])];
+    bin.bounds.Grow(primitiveBounds[m_primitiveIndices[i]]);
+    bin.count++;
+  }
+
+  // Sweep from the right to get the right-hand side areas, then from the left
+  float rightArea[BinCount];
+  uint32_t rightCount[BinCount];
+  Aabb accumulated;
+  uint32_t accumulatedCount = 0;
+  for (uint32_t b = BinCount - 1; b > 0; b--)
+  {
+    accumulated.Grow(bins[b].bounds);
+    accumulatedCount += bins[b].count;
+    rightArea[b] = accumulated.HalfArea();
+    rightCount[b] = accumulatedCount;
+  }
+
+  float bestCost = 3.4e38f;
+  uint32_t bestSplit = 0;
+  accumulated = Aabb();
+  accumulatedCount = 0;
+  for (uint32_t b = 1; b < BinCount; b++)
+  {
+    accumulated.Grow(bins[b - 1].bounds);
+    accumulatedCount += bins[b - 1].count;
+    if (accumulatedCount == 0 || rightCount[b] == 0)
+    {
+      continue;
+    }
+    float cost = accumulated.HalfArea() * accumulatedCount + rightArea[b] * rightCount[b];
+    if (cost < bestCost)
+    {
+      bestCost = cost;
+      bestSplit = b;
+    }
+  }
+
+  const uint32_t count = end - begin;
+  float leafCost = IntersectionCost * count;
+  float splitCost = TraversalCost + IntersectionCost * bestCost / bounds.HalfArea();
+  if (bestSplit == 0 || (splitCost >= leafCost && count <= m_maxLeafSize))
+  {
+    return begin;
+  }
+  uint32_t* middle =
+      std::partition(m_primitiveIndices.data() + begin, m_primitiveIndices.data() + end,
+                     [&](uint32_t primitive) { return binIndex(primitive) < bestSplit; });
+  return static_cast<uint32_t>(middle - m_primitiveIndices.data());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Partial sort of the primitives around the median centroid
+uint32_t Bvh::SplitMedian(uint32_t begin, uint32_t end, int axis,
+                          const std::vector<glm::vec3>& centroids)
+{
+  if (end - begin <= m_maxLeafSize)
+  {
+    return begin;
+  }
+  uint32_t mid = begin + (end - begin) / 2;
+  std::nth_element(m_primitiveIndices.data() + begin, m_primitiveIndices.data() + mid,
+                   m_primitiveIndices.data() + end, [&](uint32_t a, uint32_t b) {
+                     return centroids[a][axis] < centroids[b][axis];
+                   });
+  return mid;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Aabb Bvh::GetBounds() const
+{
+  Aabb bounds;
+  if (!m_nodes.empty())
+  {
+    bounds.min = m_nodes[0].boundsMin;
+    bounds.max = m_nodes[0].boundsMax;
+  }
+  return bounds;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Bvh4::Build(const Bvh& bvh)
+{
+  Build(bvh.GetNodes().data(), static_cast<uint32_t>(bvh.GetNodes().size()));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Bvh4::Build(const BvhNode* nodes, uint32_t nodeCount)
+{
+  m_nodes.clear();
+  m_leaves.clear();
+  if (nodeCount == 0)
+  {
+    return;
+  }
+  if (nodes[0].IsLeaf())
+  {
+    m_leaves.push_back({nodes[0].index, nodes[0].primitiveCount});
+    return;
+  }
+  m_nodes.reserve(nodeCount / 2);
+  BuildNode(nodes, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Gather up to 4 descendants of the interior node by repeatedly replacing the interior one with
+// the largest surface area by its two children, then build the interior descendants recursively
+uint32_t Bvh4::BuildNode(const BvhNode* nodes, uint32_t binaryNode)
+{
+  auto halfArea = [&](uint32_t index) {
+    glm::vec3 extent = nodes[index].boundsMax - nodes[index].boundsMin;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+  };
+
+  uint32_t children[4] = {nodes[binaryNode].index, nodes[binaryNode].index + 1, 0, 0};
+  uint32_t childCount = 2;
+  while (childCount < 4)
+  {
+    int largest = -1;
+    for (uint32_t k = 0; k < childCount; k++)
+    {
+      if (!nodes[children[k]].IsLeaf() &&
+          (largest < 0 || halfArea(children[k]) > halfArea(children[largest])))
+      {
+        largest = static_cast<int>(k);
+      }
+    }
+    if (largest < 0)
+    {
+      break;
+    }
+    uint32_t opened = children[largest];
+    children[largest] = nodes[opened].index;
+    children[childCount++] = nodes[opened].index + 1;
+  }
+
+  uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.push_back({});
+  for (uint32_t k = 0; k < 4; k++)
+  {
+    Bvh4Node& node = m_nodes[nodeIndex];
+    node.padding[k] = 0;
+    if (k >= childCount)
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        node.boundsMin[axis][k] = 3.4e38f;
+        node.boundsMax[axis][k] = 3.4e38f;
+      }
+      node.children[k] = Bvh4Node::LeafFlag;
+      continue;
+    }
+
+    const BvhNode& child = nodes[children[k]];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      node.boundsMin[axis][k] = child.boundsMin[axis];
+      node.boundsMax[axis][k] = child.boundsMax[axis];
+    }
+    if (child.IsLeaf())
+    {
+      node.children[k] = Bvh4Node::LeafFlag | static_cast<uint32_t>(m_leaves.size());
+      m_leaves.push_back({child.index, child.primitiveCount});
+    }
+    else
+    {
+      // The recursion grows the node array, so the node is looked up again at each iteration
+      uint32_t childIndex = BuildNode(nodes, children[k]);
+      m_nodes[nodeIndex].children[k] = childIndex;
+    }
+  }
+  return nodeIndex;
+}
+} // namespace cpu
+} // namespace rhi
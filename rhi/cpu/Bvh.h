@@ -0,0 +1,170 @@
+/*
+Bounding volume hierarchy over abstract primitives, used both for the
+triangles of the bottom-level acceleration structures and for the instances of
+the top-level one.
+
+The builders work top-down on the primitive centroids, along the largest
+centroid axis. The binned SAH builder splits each node where the surface area
+heuristic is minimal, evaluated on a fixed number of bins; a node becomes a
+leaf when no split is cheaper than intersecting all its primitives. The median
+builder splits the primitives in two halves, which is faster to build but
+slower to trace. Nodes are stored depth-first in a flat array, the two
+children of an interior node being consecutive. Leaves reference a range of
+the primitive index array, which the owner of the BVH uses to reorder its
+primitives for locality.
+
+Bvh4 collapses a binary BVH into a 4-wide one for the SIMD traversal kernels,
+each node storing the bounds of its four children in structure-of-arrays form
+so that a ray is tested against all of them at once.
+
+Example:
+
+Bvh bvh;
+bvh.Build(primitiveBounds);
+for (uint32_t i : bvh.GetPrimitiveIndices()) { ... }
+Bvh4 wide;
+wide.Build(bvh);
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rhi
+{
+namespace cpu
+{
+
+/// Axis-aligned bounding box
+struct Aabb
+{
+  glm::vec3 min = glm::vec3(3.4e38f);
+  glm::vec3 max = glm::vec3(-3.4e38f);
+
+  void Grow(const glm::vec3& point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void Grow(const Aabb& box)
+  {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+  bool IsEmpty() const { return min.x > max.x; }
+  glm::vec3 Center() const { return 0.5f * (min + max); }
+  /// Half of the surface area, sufficient for the SAH ratios
+  float HalfArea() const
+  {
+    if (IsEmpty())
+    {
+      return 0.f;
+    }
+    glm::vec3 extent = max - min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+  }
+};
+
+/// Node of the hierarchy, 32 bytes. Interior nodes have a primitive count of 0, and their children
+/// at index and index + 1. Leaves reference primitiveCount entries of the primitive index array,
+/// starting at index
+struct BvhNode
+{
+  glm::vec3 boundsMin;
+  uint32_t index;
+  glm::vec3 boundsMax;
+  uint32_t primitiveCount;
+
+  bool IsLeaf() const { return primitiveCount != 0; }
+};
+
+enum class BvhBuilder
+{
+  BinnedSah,
+  Median
+};
+
+class Bvh
+{
+public:
+  /// Build the hierarchy over the primitives, whose bounds must not be empty. Leaves hold at most
+  /// maxLeafSize primitives
+  void Build(const std::vector<Aabb>& primitiveBounds, uint32_t maxLeafSize = 4,
+             BvhBuilder builder = BvhBuilder::BinnedSah);
+
+  const std::vector<BvhNode>& GetNodes() const { return m_nodes; }
+  /// Primitives in the order of the leaves
+  const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_primitiveIndices; }
+  /// Bounds of the whole hierarchy
+  Aabb GetBounds() const;
+  /// Longest root to leaf path, used to size traversal stacks
+  uint32_t GetDepth() const { return m_depth; }
+
+  /// Maximum depth of the hierarchies, and hence of the traversal stacks
+  static const uint32_t MaxDepth = 64;
+
+private:
+  void BuildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth,
+                 const std::vector<Aabb>& primitiveBounds, const std::vector<glm::vec3>& centroids);
+  /// Split point of the primitives [begin, end), which are partitioned around it. Returns begin
+  /// when the node should be a leaf
+  uint32_t SplitBinnedSah(uint32_t begin, uint32_t end, const Aabb& bounds,
+                          const Aabb& centroidBounds, int axis,
+                          const std::vector<Aabb>& primitiveBounds,
+                          const std::vector<glm::vec3>& centroids);
+  uint32_t SplitMedian(uint32_t begin, uint32_t end, int axis,
+                       const std::vector<glm::vec3>& centroids);
+
+  std::vector<BvhNode> m_nodes;
+  std::vector<uint32_t> m_primitiveIndices;
+  uint32_t m_maxLeafSize = 4;
+  BvhBuilder m_builder = BvhBuilder::BinnedSah;
+  uint32_t m_depth = 0;
+};
+
+/// Node of a 4-wide hierarchy, 128 bytes. Unused child slots are a point at the largest float
+/// coordinates, which no ray reaches within its distance range
+struct Bvh4Node
+{
+  /// Bounds of the children, per axis
+  float boundsMin[3][4];
+  float boundsMax[3][4];
+  /// Index of the child node, or of the leaf with LeafFlag set
+  uint32_t children[4];
+  uint32_t padding[4];
+
+  static const uint32_t LeafFlag = 0x80000000u;
+};
+
+class Bvh4
+{
+public:
+  /// Range of the primitive index array of the binary hierarchy
+  struct Leaf
+  {
+    uint32_t first;
+    uint32_t count;
+  };
+
+  /// Collapse the binary hierarchy, opening the children with the largest surface area first
+  void Build(const Bvh& bvh);
+  /// Same as Build, from the nodes of a binary hierarchy stored elsewhere
+  void Build(const BvhNode* nodes, uint32_t nodeCount);
+
+  const std::vector<Bvh4Node>& GetNodes() const { return m_nodes; }
+  const std::vector<Leaf>& GetLeaves() const { return m_leaves; }
+  /// A hierarchy made of a single leaf has no nodes
+  bool IsRootLeaf() const { return m_nodes.empty() && !m_leaves.empty(); }
+
+private:
+  uint32_t BuildNode(const BvhNode* nodes, uint32_t binaryNode);
+
+  std::vector<Bvh4Node> m_nodes;
+  std::vector<Leaf> m_leaves;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,317 @@
+#include "Denoiser.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "Simd.h"
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// History lengths after which the temporal moments give the variance, and at which the length
+/// saturates
+const float MinVarianceHistory = 4.f;
+const float MaxHistory = 64.f;
+
+float Luminance(const glm::vec3& color)
+{
+  return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+float Luminance(const float* color)
+{
+  return 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+}
+
+uint32_t IterationCount(DenoisePreset preset)
+{
+  switch (preset)
+  {
+  case DenoisePreset::Fast:
+    return 2;
+  case DenoisePreset::Quality:
+    return 5;
+  default:
+    return 4;
+  }
+}
+
+/// Whether two guides are on the same surface, their distance to the tangent plane of the first
+/// one being measured relative to tolerance
+bool SameSurface(const DenoiseGuide& a, const DenoiseGuide& b, float tolerance)
+{
+  return a.instanceIndex == b.instanceIndex && glm::dot(a.normal, b.normal) > 0.9f &&
+         glm::abs(glm::dot(a.normal, b.position - a.position)) < tolerance;
+}
+
+/// Albedo of a guide, the darkest channels being clamped so that the illumination stays bounded
+glm::vec3 Albedo(const DenoiseGuide& guide)
+{
+  const float minimum = 1.f / 64.f;
+  return glm::vec3(guide.albedo.r > minimum ? guide.albedo.r : minimum,
+                   guide.albedo.g > minimum ? guide.albedo.g : minimum,
+                   guide.albedo.b > minimum ? guide.albedo.b : minimum);
+}
+
+inline uint8_t ToUnorm8(float value)
+{
+  value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+  return static_cast<uint8_t>(value * 255.f + 0.5f);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Denoiser::Denoise(Image& image, const std::vector<DenoiseGuide>& guides,
+                       const glm::mat4& viewProjection, ThreadPool& pool)
+{
+  tools::ProfileZone zone("Denoise");
+  auto start = std::chrono::steady_clock::now();
+  {
+    tools::ProfileZone temporalZone("Temporal accumulation");
+    Accumulate(image, guides, viewProjection, pool);
+    EstimateVariance(guides, pool);
+  }
+  auto filterStart = std::chrono::steady_clock::now();
+
+  uint32_t source = 0;
+  {
+    tools::ProfileZone filterZone("A-trous filter");
+    uint32_t iterations = IterationCount(m_settings.preset);
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+      FilterIteration(guides, 1u << i, source, pool);
+      source = 1 - source;
+    }
+  }
+
+  const std::vector<float>& filtered = m_filtered[source];
+  pool.ParallelFor(m_height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (uint32_t i = y * m_width; i < (y + 1) * m_width; i++)
+    {
+      if (guides[i].instanceIndex == InvalidHandle)
+      {
+        continue;
+      }
+      glm::vec3 albedo = Albedo(guides[i]);
+      for (int c = 0; c < 3; c++)
+      {
+        image.pixels[4 * static_cast<size_t>(i) + c] =
+            ToUnorm8(filtered[4 * static_cast<size_t>(i) + c] * albedo[c]);
+      }
+    }
+  });
+
+  m_previousColor.swap(m_color);
+  m_previousMoments.swap(m_moments);
+  m_previousHistoryLength.swap(m_historyLength);
+  m_previousGuides = guides;
+  m_previousViewProjection = viewProjection;
+
+  auto end = std::chrono::steady_clock::now();
+  m_timings.temporalMs = std::chrono::duration<double, std::milli>(filterStart - start).count();
+  m_timings.filterMs = std::chrono::duration<double, std::milli>(end - filterStart).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The previous pixel is the one containing the projection of the surface, whose guide must be on
+// the same surface for the history to be kept
+void Denoiser::Accumulate(const Image& image, const std::vector<DenoiseGuide>& guides,
+                          const glm::mat4& viewProjection, ThreadPool& pool)
+{
+  m_width = image.width;
+  m_height = image.height;
+  size_t count = static_cast<size_t>(m_width) * m_height;
+  bool history = m_previousGuides.size() == count;
+  m_color.resize(count);
+  m_moments.resize(count);
+  m_historyLength.resize(count);
+  m_depth.resize(count);
+
+  pool.ParallelFor(m_height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (uint32_t i = y * m_width; i < (y + 1) * m_width; i++)
+    {
+      const uint8_t* pixel = &image.pixels[4 * static_cast<size_t>(i)];
+      glm::vec3 color = glm::vec3(pixel[0], pixel[1], pixel[2]) * (1.f / 255.f);
+      const DenoiseGuide& guide = guides[i];
+      float length = 0.f;
+      if (guide.instanceIndex != InvalidHandle)
+      {
+        color /= Albedo(guide);
+        m_depth[i] = (viewProjection * glm::vec4(guide.position, 1.f)).w;
+      }
+      float luminance = Luminance(color);
+      glm::vec2 moments(luminance, luminance * luminance);
+
+      glm::vec4 clip = m_previousViewProjection * glm::vec4(guide.position, 1.f);
+      if (history && guide.instanceIndex != InvalidHandle && clip.w > 0.f)
+      {
+        float px = (0.5f + 0.5f * clip.x / clip.w) * static_cast<float>(m_width);
+        float py = (0.5f - 0.5f * clip.y / clip.w) * static_cast<float>(m_height);
+        if (px >= 0.f && py >= 0.f && px < static_cast<float>(m_width) &&
+            py < static_cast<float>(m_height))
+        {
+          uint32_t j = static_cast<uint32_t>(py) * m_width + static_cast<uint32_t>(px);
+          if (SameSurface(guide, m_previousGuides[j], 2.f * m_settings.planeSigma * clip.w))
+          {
+            length = m_previousHistoryLength[j];
+            float alpha = 1.f / (length + 1.f);
+            alpha = alpha > m_settings.temporalAlpha ? alpha : m_settings.temporalAlpha;
+            color = glm::mix(m_previousColor[j], color, alpha);
+            moments = glm::mix(m_previousMoments[j], moments, alpha);
+          }
+        }
+      }
+
+      m_color[i] = color;
+      m_moments[i] = moments;
+      m_historyLength[i] = length + 1.f < MaxHistory ? length + 1.f : MaxHistory;
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The spatial estimate averages the moments of the 3x3 neighbors on the same surface
+void Denoiser::EstimateVariance(const std::vector<DenoiseGuide>& guides, ThreadPool& pool)
+{
+  std::vector<float>& output = m_filtered[0];
+  output.resize(4 * static_cast<size_t>(m_width) * m_height);
+  pool.ParallelFor(m_height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (uint32_t x = 0; x < m_width; x++)
+    {
+      uint32_t i = y * m_width + x;
+      glm::vec2 moments = m_moments[i];
+      const DenoiseGuide& guide = guides[i];
+      if (guide.instanceIndex != InvalidHandle && m_historyLength[i] < MinVarianceHistory)
+      {
+        float tolerance = 2.f * m_settings.planeSigma * m_depth[i];
+        glm::vec2 sum(0.f);
+        float weight = 0.f;
+        for (int32_t dy = -1; dy <= 1; dy++)
+        {
+          for (int32_t dx = -1; dx <= 1; dx++)
+          {
+            int32_t qx = static_cast<int32_t>(x) + dx;
+            int32_t qy = static_cast<int32_t>(y) + dy;
+            if (qx < 0 || qy < 0 || qx >= static_cast<int32_t>(m_width) ||
+                qy >= static_cast<int32_t>(m_height))
+            {
+              continue;
+            }
+            uint32_t q = static_cast<uint32_t>(qy) * m_width + qx;
+            if (SameSurface(guide, guides[q], tolerance))
+            {
+              sum += m_moments[q];
+              weight += 1.f;
+            }
+          }
+        }
+        moments = sum / weight;
+      }
+
+      float* out = &output[4 * static_cast<size_t>(i)];
+      out[0] = m_color[i].r;
+      out[1] = m_color[i].g;
+      out[2] = m_color[i].b;
+      float variance = moments.y - moments.x * moments.x;
+      out[3] = variance > 0.f ? variance : 0.f;
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The luminance is compared to the standard deviation of the 3x3 Gaussian-filtered variance of the
+// pixel. Each tap adds its color weighted by w and its variance by w^2 in a single Float4
+void Denoiser::FilterIteration(const std::vector<DenoiseGuide>& guides, uint32_t step,
+                               uint32_t source, ThreadPool& pool)
+{
+  const float kernel[3] = {3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+  const float gaussian[2] = {1.f / 2.f, 1.f / 4.f};
+  const std::vector<float>& input = m_filtered[source];
+  std::vector<float>& output = m_filtered[1 - source];
+  output.resize(input.size());
+  int32_t width = static_cast<int32_t>(m_width);
+  int32_t height = static_cast<int32_t>(m_height);
+
+  pool.ParallelFor(m_height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (int32_t x = 0; x < width; x++)
+    {
+      size_t i = static_cast<size_t>(y) * m_width + x;
+      const float* center = &input[4 * i];
+      const DenoiseGuide& guide = guides[i];
+      if (guide.instanceIndex == InvalidHandle)
+      {
+        Float4::Load(center).Store(&output[4 * i]);
+        continue;
+      }
+
+      float variance = 0.f;
+      for (int32_t dy = -1; dy <= 1; dy++)
+      {
+        for (int32_t dx = -1; dx <= 1; dx++)
+        {
+          int32_t qx = x + dx;
+          int32_t qy = static_cast<int32_t>(y) + dy;
+          qx = qx < 0 ? 0 : (qx >= width ? width - 1 : qx);
+          qy = qy < 0 ? 0 : (qy >= height ? height - 1 : qy);
+          variance += gaussian[dx != 0] * gaussian[dy != 0] *
+                      input[4 * (static_cast<size_t>(qy) * m_width + qx) + 3];
+        }
+      }
+      float luminance = Luminance(center);
+      float luminanceScale = 1.f / (m_settings.luminanceSigma * std::sqrt(variance) + 1e-4f);
+      float planeScale = 1.f / (m_settings.planeSigma * m_depth[i]);
+
+      float centerWeight = kernel[0] * kernel[0];
+      Float4 sum = Float4::Load(center) *
+                   Float4(centerWeight, centerWeight, centerWeight, centerWeight * centerWeight);
+      float weightSum = centerWeight;
+      for (int32_t dy = -2; dy <= 2; dy++)
+      {
+        int32_t qy = static_cast<int32_t>(y) + dy * static_cast<int32_t>(step);
+        if (qy < 0 || qy >= height)
+        {
+          continue;
+        }
+        for (int32_t dx = -2; dx <= 2; dx++)
+        {
+          int32_t qx = x + dx * static_cast<int32_t>(step);
+          if (qx < 0 || qx >= width || (dx == 0 && dy == 0))
+          {
+            continue;
+          }
+          size_t q = static_cast<size_t>(qy) * m_width + qx;
+          const DenoiseGuide& tapGuide = guides[q];
+          float cosine = glm::dot(guide.normal, tapGuide.normal);
+          if (tapGuide.instanceIndex != guide.instanceIndex || !(cosine > 0.f))
+          {
+            continue;
+          }
+          const float* tap = &input[4 * q];
+          float planeDistance =
+              glm::abs(glm::dot(guide.normal, tapGuide.position - guide.position));
+          // The edge-stopping functions multiply into a single exponential
+          float w = kernel[dx < 0 ? -dx : dx] * kernel[dy < 0 ? -dy : dy] *
+                    std::exp(m_settings.normalPower * std::log(cosine) -
+                             planeDistance * planeScale -
+                             glm::abs(Luminance(tap) - luminance) * luminanceScale);
+          sum = sum + Float4::Load(tap) * Float4(w, w, w, w * w);
+          weightSum += w;
+        }
+      }
+      float inverse = 1.f / weightSum;
+      (sum * Float4(inverse, inverse, inverse, inverse * inverse)).Store(&output[4 * i]);
+    }
+  });
+}
+} // namespace cpu
+} // namespace rhi
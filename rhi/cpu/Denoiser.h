@@ -0,0 +1,128 @@
+/*
+Edge-aware denoiser of the CPU backend, run after the ray generation shader to
+filter the noise of the images rendered with few samples per pixel. It follows
+the spatiotemporal variance-guided filter (SVGF) of Schied et al. 2017, on the
+illumination of the pixels, their color divided by the albedo of the surface,
+which is multiplied back at the end so that the filter keeps the texture:
+
+- Temporal accumulation: the surface of each pixel, given by the guides the
+  closest hit shaders write (see Shaders.h), is projected with the camera of
+  the previous frame. If the previous frame saw the same surface there (same
+  instance, similar normal and tangent plane), the color and the first two
+  moments of the luminance are blended with the history, the new frame
+  weighing 1/n over the first frames of the history, and temporalAlpha once
+  it is longer. Otherwise the history of the pixel restarts.
+- Variance: from the accumulated moments, or from the 3x3 neighborhood while
+  the history is shorter than 4 frames.
+- A-trous wavelet filter: iterations of a 5x5 B3-spline kernel with holes of
+  1, 2, 4... pixels, whose taps are weighted by edge-stopping functions of the
+  instances, of the normals, of the distance to the tangent plane and of the
+  luminance relative to its standard deviation. The variance is filtered
+  along, with the squared weights, so that the luminance stops the later
+  iterations less once the noise is smoothed out.
+
+The preset sets the number of iterations: 2 for Fast, 4 for Balanced and 5
+for Quality. The pixels of each pass are processed in parallel rows, the
+color and the variance of a pixel being the 4 lanes of a Float4, so that a tap
+accumulates both at once. Background pixels are left as they are.
+
+The history must be reset when the scene changes, the moved surfaces being
+otherwise accumulated with colors which no longer apply.
+
+Example:
+
+Denoiser denoiser;
+denoiser.SetSettings({DenoisePreset::Balanced});
+// Render the image, with the guides written by the hit shaders
+denoiser.Denoise(image, guides, camera.projection * camera.view, pool);
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "../RenderDevice.h"
+#include "Shaders.h"
+#include "ThreadPool.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+enum class DenoisePreset
+{
+  Fast,
+  Balanced,
+  Quality
+};
+
+struct DenoiseSettings
+{
+  DenoisePreset preset = DenoisePreset::Balanced;
+  /// Weight of the new frame in the temporal accumulation, once the history is long enough
+  float temporalAlpha = 0.2f;
+  /// Tolerance on the distance of a tap to the tangent plane of the pixel, relative to the
+  /// distance of the pixel to the eye
+  float planeSigma = 0.005f;
+  /// Exponent of the cosine of the angle between the normals
+  float normalPower = 128.f;
+  /// Tolerance on the luminance difference, in standard deviations
+  float luminanceSigma = 4.f;
+};
+
+/// Durations of the stages of the last Denoise, in milliseconds
+struct DenoiseTimings
+{
+  double temporalMs = 0.0;
+  double filterMs = 0.0;
+};
+
+class Denoiser
+{
+public:
+  void SetSettings(const DenoiseSettings& settings) { m_settings = settings; }
+  const DenoiseSettings& GetSettings() const { return m_settings; }
+
+  /// Forget the history
+  void Reset() { m_previousGuides.clear(); }
+
+  /// Filter an image in place, guides having one element per pixel, and viewProjection being the
+  /// matrix of the camera of the image
+  void Denoise(Image& image, const std::vector<DenoiseGuide>& guides,
+               const glm::mat4& viewProjection, ThreadPool& pool);
+
+  const DenoiseTimings& GetTimings() const { return m_timings; }
+
+private:
+  void Accumulate(const Image& image, const std::vector<DenoiseGuide>& guides,
+                  const glm::mat4& viewProjection, ThreadPool& pool);
+  void EstimateVariance(const std::vector<DenoiseGuide>& guides, ThreadPool& pool);
+  /// A-trous iteration with holes of step pixels, from m_filtered[source] to the other buffer
+  void FilterIteration(const std::vector<DenoiseGuide>& guides, uint32_t step, uint32_t source,
+                       ThreadPool& pool);
+
+  DenoiseSettings m_settings;
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+
+  /// View-space depth of the surface of each pixel
+  std::vector<float> m_depth;
+  /// Accumulated color, moments of the luminance, and history length of each pixel, for the
+  /// current and the previous frame
+  std::vector<glm::vec3> m_color;
+  std::vector<glm::vec2> m_moments;
+  std::vector<float> m_historyLength;
+  std::vector<glm::vec3> m_previousColor;
+  std::vector<glm::vec2> m_previousMoments;
+  std::vector<float> m_previousHistoryLength;
+  std::vector<DenoiseGuide> m_previousGuides;
+  glm::mat4 m_previousViewProjection = glm::mat4(1.f);
+
+  /// Color and variance of each pixel, 4 floats per pixel, ping-ponged by the iterations
+  std::vector<float> m_filtered[2];
+  DenoiseTimings m_timings;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,171 @@
+#include "LightBvh.h"
+
+#include <cmath>
+
+#include "Lights.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+//--------------------------------------------------------------------------------------------------
+//
+// Bound of the contribution of lights of bounds [boundsMin, boundsMax] to a point. The cosine of
+// the angle to the center minus the half angle is expanded to avoid the inverse trigonometric
+// functions
+float Importance(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float power,
+                 float constantPower, const glm::vec3& position, const glm::vec3& normal)
+{
+  if (!(power > 0.f))
+  {
+    return constantPower;
+  }
+  glm::vec3 offset = 0.5f * (boundsMin + boundsMax) - position;
+  glm::vec3 halfExtent = 0.5f * (boundsMax - boundsMin);
+  float distance2 = glm::dot(offset, offset);
+  float radius2 = glm::dot(halfExtent, halfExtent);
+  float cosine = 1.f;
+  if (distance2 > radius2)
+  {
+    float distance = std::sqrt(distance2);
+    float cosAngle = glm::dot(normal, offset) / distance;
+    float sinAngle = std::sqrt(1.f - (cosAngle < 1.f ? cosAngle * cosAngle : 1.f));
+    float sinHalf = std::sqrt(radius2 / distance2);
+    float cosHalf = std::sqrt(1.f - radius2 / distance2);
+    cosine = cosAngle > cosHalf ? 1.f : cosAngle * cosHalf + sinAngle * sinHalf;
+    cosine = cosine > 0.f ? cosine : 0.f;
+  }
+  float clamped = distance2 > radius2 ? distance2 : radius2;
+  clamped = clamped > 1e-8f ? clamped : 1e-8f;
+  return constantPower + power * cosine / clamped;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The children follow their parent in the node array, so the powers are summed bottom-up by
+// walking the nodes backwards
+void LightBvh::Build(const std::vector<LightDesc>& lights)
+{
+  uint32_t lightCount = static_cast<uint32_t>(lights.size());
+  m_lightPower.resize(lightCount);
+  m_lightConstantPower.resize(lightCount);
+  m_lightBounds.resize(lightCount);
+  for (uint32_t i = 0; i < lightCount; i++)
+  {
+    float power = GetLightPower(lights[i]);
+    m_lightPower[i] = lights[i].falloff ? power : 0.f;
+    m_lightConstantPower[i] = lights[i].falloff ? 0.f : power;
+    GetLightBounds(lights[i], m_lightBounds[i].min, m_lightBounds[i].max);
+  }
+  if (lightCount == 0)
+  {
+    m_bvh = Bvh();
+    m_nodePower.clear();
+    m_nodeConstantPower.clear();
+    return;
+  }
+
+  m_bvh.Build(m_lightBounds, 1);
+  const std::vector<BvhNode>& nodes = m_bvh.GetNodes();
+  const std::vector<uint32_t>& lightIndices = m_bvh.GetPrimitiveIndices();
+  m_nodePower.assign(nodes.size(), 0.f);
+  m_nodeConstantPower.assign(nodes.size(), 0.f);
+  for (size_t i = nodes.size(); i-- > 0;)
+  {
+    const BvhNode& node = nodes[i];
+    if (node.IsLeaf())
+    {
+      for (uint32_t j = node.index; j < node.index + node.primitiveCount; j++)
+      {
+        m_nodePower[i] += m_lightPower[lightIndices[j]];
+        m_nodeConstantPower[i] += m_lightConstantPower[lightIndices[j]];
+      }
+    }
+    else
+    {
+      m_nodePower[i] = m_nodePower[node.index] + m_nodePower[node.index + 1];
+      m_nodeConstantPower[i] = m_nodeConstantPower[node.index] +
+                               m_nodeConstantPower[node.index + 1];
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// u is rescaled after each choice to the interval of the chosen child, so that a single number
+// drives the whole descent. The lights of a leaf holding several, which happens only for
+// hierarchies deeper than Bvh::MaxDepth, are chosen the same way
+uint32_t LightBvh::Sample(const glm::vec3& position, const glm::vec3& normal, float u,
+                          float& probability) const
+{
+  probability = 1.f;
+  const std::vector<BvhNode>& nodes = m_bvh.GetNodes();
+  if (nodes.empty())
+  {
+    return InvalidHandle;
+  }
+  const BvhNode* node = &nodes[0];
+  while (!node->IsLeaf())
+  {
+    const BvhNode& left = nodes[node->index];
+    const BvhNode& right = nodes[node->index + 1];
+    float leftImportance = Importance(left.boundsMin, left.boundsMax, m_nodePower[node->index],
+                                      m_nodeConstantPower[node->index], position, normal);
+    float rightImportance =
+        Importance(right.boundsMin, right.boundsMax, m_nodePower[node->index + 1],
+                   m_nodeConstantPower[node->index + 1], position, normal);
+    float total = leftImportance + rightImportance;
+    if (!(total > 0.f))
+    {
+      return InvalidHandle;
+    }
+    float leftProbability = leftImportance / total;
+    if (u < leftProbability)
+    {
+      u /= leftProbability;
+      probability *= leftProbability;
+      node = &left;
+    }
+    else
+    {
+      u = (u - leftProbability) / (1.f - leftProbability);
+      probability *= 1.f - leftProbability;
+      node = &right;
+    }
+    u = u < 0.99999994f ? u : 0.99999994f;
+  }
+
+  const std::vector<uint32_t>& lightIndices = m_bvh.GetPrimitiveIndices();
+  float total = 0.f;
+  for (uint32_t i = node->index; i < node->index + node->primitiveCount; i++)
+  {
+    const Aabb& bounds = m_lightBounds[lightIndices[i]];
+    total += Importance(bounds.min, bounds.max, m_lightPower[lightIndices[i]],
+                        m_lightConstantPower[lightIndices[i]], position, normal);
+  }
+  if (!(total > 0.f))
+  {
+    return InvalidHandle;
+  }
+  float threshold = u * total;
+  uint32_t last = node->index + node->primitiveCount - 1;
+  for (uint32_t i = node->index; i <= last; i++)
+  {
+    const Aabb& bounds = m_lightBounds[lightIndices[i]];
+    float importance = Importance(bounds.min, bounds.max, m_lightPower[lightIndices[i]],
+                                  m_lightConstantPower[lightIndices[i]], position, normal);
+    if (threshold < importance || i == last)
+    {
+      probability *= importance / total;
+      return importance > 0.f ? lightIndices[i] : InvalidHandle;
+    }
+    threshold -= importance;
+  }
+  return InvalidHandle;
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,69 @@
+/*
+Light hierarchy of the CPU shaders, picking one light per shadow estimate
+among many lights in time logarithmic in their number, with a probability
+following the contribution the light can make to the shaded point (Conty
+Estevez and Kulla 2018, "Importance Sampling of Many Lights with Adaptive Tree
+Splitting").
+
+The hierarchy is a BVH over the bounds of the lights (see Bvh.h) with one
+light per leaf, each node also holding the power of its lights: the sum of the
+luminances of the lights with falloff, and of the ones without. The
+importance of a node for a point and its normal bounds the contribution of its
+lights:
+
+  constant power + power * cos(max(0, angle to the center - half angle)) / d^2
+
+where d is the distance to the center of the node bounds, clamped to the
+radius of their bounding sphere, and the half angle the one under which the
+point sees that sphere, so that a node entirely below the surface gets no
+importance. The lights emit in all directions, so only the orientation of the
+surface bounds the cosine. Sampling descends from the root, choosing a child
+with a probability proportional to its importance, the probability of the
+light being the product of the choices.
+
+Example:
+
+LightBvh hierarchy;
+hierarchy.Build(lights);
+float probability;
+uint32_t light = hierarchy.Sample(position, normal, u, probability);
+if (light != InvalidHandle) { ... } // Weigh its contribution by 1 / probability
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "Bvh.h"
+#include "../RenderDevice.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+class LightBvh
+{
+public:
+  void Build(const std::vector<LightDesc>& lights);
+
+  /// Pick a light for a point with a unit normal, u being uniform in [0, 1). Returns the index of
+  /// the light and its probability, or InvalidHandle if no light can contribute
+  uint32_t Sample(const glm::vec3& position, const glm::vec3& normal, float u,
+                  float& probability) const;
+
+  uint32_t GetLightCount() const { return static_cast<uint32_t>(m_lightPower.size()); }
+  uint32_t GetDepth() const { return m_bvh.GetDepth(); }
+
+private:
+  Bvh m_bvh;
+  /// Power of the lights with falloff and of the ones without, per node and per light
+  std::vector<float> m_nodePower;
+  std::vector<float> m_nodeConstantPower;
+  std::vector<float> m_lightPower;
+  std::vector<float> m_lightConstantPower;
+  std::vector<Aabb> m_lightBounds;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,67 @@
+#include "Lights.h"
+
+#include <cmath>
+
+#include "Sampling.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// The bounds of a sphere hold the whole sphere, even though only a disk of it is sampled
+void GetLightBounds(const LightDesc& light, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+  switch (light.shape)
+  {
+  case LightShape::Sphere:
+    boundsMin = light.position - light.radius;
+    boundsMax = light.position + light.radius;
+    break;
+  case LightShape::Rectangle:
+  {
+    glm::vec3 extent = 0.5f * (glm::abs(light.edge1) + glm::abs(light.edge2));
+    boundsMin = light.position - extent;
+    boundsMax = light.position + extent;
+    break;
+  }
+  default:
+    boundsMin = light.position;
+    boundsMax = light.position;
+    break;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The disk of a sphere is spanned by two unit axes orthogonal to the direction of its center
+glm::vec3 SampleLight(const LightDesc& light, const glm::vec3& from, const glm::vec2& u)
+{
+  switch (light.shape)
+  {
+  case LightShape::Sphere:
+  {
+    glm::vec3 axis = light.position - from;
+    float length = glm::length(axis);
+    if (!(length > 0.f))
+    {
+      return light.position;
+    }
+    axis /= length;
+    glm::vec3 tangent = std::fabs(axis.x) > 0.9f ? glm::vec3(0.f, 1.f, 0.f)
+                                                 : glm::vec3(1.f, 0.f, 0.f);
+    tangent = glm::normalize(glm::cross(axis, tangent));
+    glm::vec3 bitangent = glm::cross(axis, tangent);
+    glm::vec2 disk = light.radius * ConcentricDisk(u);
+    return light.position + disk.x * tangent + disk.y * bitangent;
+  }
+  case LightShape::Rectangle:
+    return light.position + (u.x - 0.5f) * light.edge1 + (u.y - 0.5f) * light.edge2;
+  default:
+    return light.position;
+  }
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,52 @@
+/*
+Sampling of the lights of the CPU shaders (see LightDesc in RenderDevice.h),
+whose extent makes the shadows soft.
+
+The shaders estimate the visible fraction of a light from a point with a
+number of shadow rays towards points of the light, the sample budget of the
+light, stratified over its surface (see Sampling.h). A point light is always
+sampled once. A sphere is sampled over the disk through its center facing
+the shaded point, which is its silhouette for the points far from it, and a
+rectangle over its area. The lights emit in all directions.
+
+Example:
+
+LightDesc light;
+light.shape = LightShape::Sphere;
+light.position = glm::vec3(2.f, 2.f, -2.f);
+light.radius = 0.25f;
+light.sampleCount = 16;
+glm::vec3 target = SampleLight(light, position, StratifiedSample(i, 16, jitter));
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "../RenderDevice.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+/// Shadow rays per shaded point of a light
+inline uint32_t GetSampleCount(const LightDesc& light)
+{
+  return light.shape == LightShape::Point || light.sampleCount == 0 ? 1 : light.sampleCount;
+}
+
+/// Luminance of the color of a light, the power with which the light hierarchy weighs it
+inline float GetLightPower(const LightDesc& light)
+{
+  return glm::dot(light.color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+/// Bounds of the points of a light
+void GetLightBounds(const LightDesc& light, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+/// Point of a light seen from a position, for a point u of the unit square
+glm::vec3 SampleLight(const LightDesc& light, const glm::vec3& from, const glm::vec2& u);
+} // namespace cpu
+} // namespace rhi
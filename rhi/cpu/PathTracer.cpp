@@ -0,0 +1,147 @@
+#include "PathTracer.h"
+
+#include "Sampling.h"
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// Pixels whose primary ray missed have no path, their color being the one of the miss shader
+void PathTracer::AddPath(uint32_t pixel, const glm::uvec2& launchIndex, const HitSurface& surface)
+{
+  if (surface.hit)
+  {
+    m_paths.push_back({surface, glm::vec3(1.f), pixel, launchIndex});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The surfaces of the bounces are asked from the closest hit shaders of the records of the
+// primary rays of the sample, with no ray contribution nor geometry multiplier. Their invocations
+// are one level below the primary hits, so that they write no guide of the denoiser. The
+// surviving paths are moved to the front of the array, in their order
+void PathTracer::Trace(const DispatchState& dispatch, ShadowBatch& batch, glm::vec4* colors)
+{
+  if (m_paths.empty())
+  {
+    return;
+  }
+  tools::ProfileZone zone("Paths");
+  ShaderInvocation caller;
+  caller.dispatch = &dispatch;
+  caller.recursionDepth = 1;
+  for (uint32_t bounce = 0; !m_paths.empty(); bounce++)
+  {
+    size_t liveCount = 0;
+    for (Path& path : m_paths)
+    {
+      glm::uvec2 launchIndex = path.launchIndex;
+      uint32_t seed = Hash(Hash(launchIndex.y * dispatch.dimensions.x + launchIndex.x,
+                                dispatch.frameIndex),
+                           bounce);
+      batch.SetPixel(path.pixel);
+      QueueLightSample(dispatch, path, seed, batch);
+      if (bounce == m_settings.maxBounces)
+      {
+        continue;
+      }
+
+      path.throughput *= path.surface.albedo;
+      if (bounce >= m_settings.rouletteStart)
+      {
+        float survival = path.throughput.r > path.throughput.g ? path.throughput.r
+                                                               : path.throughput.g;
+        survival = survival > path.throughput.b ? survival : path.throughput.b;
+        survival = survival < 0.95f ? survival : 0.95f;
+        if (!(ToUnitFloat(Hash(seed, 3)) < survival))
+        {
+          continue;
+        }
+        path.throughput /= survival;
+      }
+
+      glm::vec3 tangent, bitangent;
+      OrthonormalBasis(path.surface.normal, tangent, bitangent);
+      glm::vec3 local = CosineHemisphere(RandomFloat2(Hash(seed, 2)));
+      Ray ray;
+      ray.origin = path.surface.position;
+      ray.direction = local.x * tangent + local.y * bitangent + local.z * path.surface.normal;
+      ray.tMin = 0.001f;
+      ray.tMax = 100000.f;
+      m_segmentCount++;
+      RayHit hit;
+      hit.t = ray.tMax;
+      if (!dispatch.scene->Intersect(ray, hit))
+      {
+        colors[path.pixel] += glm::vec4(path.throughput * m_settings.skyRadiance, 0.f);
+        continue;
+      }
+
+      // A surface without closest hit shader absorbs the path
+      path.surface.hit = false;
+      caller.launchIndex = launchIndex;
+      caller.surface = &path.surface;
+      InvokeClosestHit(caller, 0, 0, ray, hit, nullptr);
+      if (path.surface.hit)
+      {
+        m_paths[liveCount++] = path;
+      }
+    }
+    m_paths.resize(liveCount);
+    batch.Flush(*dispatch.scene, colors);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Without a hierarchy, the lights of the dispatch are picked uniformly
+void PathTracer::QueueLightSample(const DispatchState& dispatch, const Path& path, uint32_t seed,
+                                  ShadowBatch& batch) const
+{
+  const HitSurface& surface = path.surface;
+  const LightDesc* light = &m_settings.defaultLight;
+  float probability = 1.f;
+  if (dispatch.lightCount != 0)
+  {
+    float u = ToUnitFloat(Hash(seed, 0));
+    uint32_t lightIndex;
+    if (dispatch.lightBvh != nullptr)
+    {
+      lightIndex = dispatch.lightBvh->Sample(surface.position, surface.normal, u, probability);
+      if (lightIndex == InvalidHandle)
+      {
+        return;
+      }
+    }
+    else
+    {
+      lightIndex = static_cast<uint32_t>(u * static_cast<float>(dispatch.lightCount));
+      lightIndex = lightIndex < dispatch.lightCount ? lightIndex : dispatch.lightCount - 1;
+      probability = 1.f / static_cast<float>(dispatch.lightCount);
+    }
+    light = &dispatch.lights[lightIndex];
+  }
+
+  glm::vec3 offset =
+      SampleLight(*light, surface.position, RandomFloat2(Hash(seed, 1))) - surface.position;
+  float distance = glm::length(offset);
+  Ray ray;
+  ray.origin = surface.position;
+  ray.direction = offset / distance;
+  ray.tMin = 0.001f;
+  ray.tMax = distance;
+  float cosine = glm::dot(surface.normal, ray.direction);
+  if (!(cosine > 0.f))
+  {
+    return;
+  }
+  float factor = light->falloff ? cosine / (distance * distance) : 1.f;
+  batch.Add(ray, path.throughput * surface.albedo * light->color * (factor / probability));
+}
+} // namespace cpu
+} // namespace rhi
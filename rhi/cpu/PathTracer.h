@@ -0,0 +1,103 @@
+/*
+Iterative path tracer of the CPU backend, extending the primary hits of the
+ray generation shader into multi-bounce paths over diffuse surfaces, beyond
+the recursion depth of the pipeline.
+
+The paths of a tile are traced together, one bounce at a time, rather than
+one after the other by recursive TraceRay calls, so the stack does not grow
+with the number of bounces. At each bounce, every live path:
+
+- Estimates the direct light at its surface (next-event estimation): it picks
+  one light of the dispatch, with the light hierarchy if there is one, or the
+  default light of the settings if the dispatch has none, samples a point of
+  it and queues a shadow ray in the shadow batch of the thread (see
+  ShadowBatch.h), carrying the throughput of the path times the albedo and
+  the light reaching the surface, divided by the probability of the sample.
+- Continues in a cosine-weighted direction around its normal. The throughput
+  of a diffuse surface then only gets multiplied by its albedo.
+- Past rouletteStart bounces, survives with a probability following its
+  throughput (Russian roulette), its throughput being divided by it, so that
+  long paths end without bias.
+- Finds its next hit. The closest hit shader of the hit, asked for the
+  surface rather than its shading (see Shaders.h), gives its albedo and
+  normal. A path leaving the scene adds the sky radiance and ends.
+
+The live paths are compacted after each bounce, so that a bounce only loops
+over the paths still alive, and the shadow batch is traced once per bounce.
+The lights follow the conventions of LightDesc, but only light the side of
+the surfaces their normal faces, which is the side of the incoming ray.
+
+Example:
+
+PathTracer tracer;
+PathTracingSettings settings;
+settings.maxBounces = 8;
+tracer.SetSettings(settings);
+for (uint32_t i = 0; i < pixelCount; i++)
+{
+  // Trace the primary ray with the invocation asking for the surface
+  tracer.AddPath(i, launchIndex, surface);
+}
+tracer.Trace(dispatch, batch, colors);
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "Shaders.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct PathTracingSettings
+{
+  /// Bounces after the primary hit, 0 giving the direct light only
+  uint32_t maxBounces = 8;
+  /// Bounces after which Russian roulette may end the paths
+  uint32_t rouletteStart = 3;
+  /// Radiance of the sky, reached by the paths leaving the scene
+  glm::vec3 skyRadiance = glm::vec3(0.3f);
+  /// Light of the next-event estimation when the dispatch has none: the point light of the sample
+  LightDesc defaultLight = {LightShape::Point, glm::vec3(2.f, 2.f, -2.f)};
+};
+
+class PathTracer
+{
+public:
+  void SetSettings(const PathTracingSettings& settings) { m_settings = settings; }
+  const PathTracingSettings& GetSettings() const { return m_settings; }
+
+  /// Start a path from the surface of the primary hit of a pixel, if any. The pixel is an index in
+  /// the colors given to Trace
+  void AddPath(uint32_t pixel, const glm::uvec2& launchIndex, const HitSurface& surface);
+
+  /// Trace the paths added, add their light to the colors of their pixels, and forget them
+  void Trace(const DispatchState& dispatch, ShadowBatch& batch, glm::vec4* colors);
+
+  /// Path segments traced after the primary hits by all the Trace calls
+  uint64_t GetSegmentCount() const { return m_segmentCount; }
+
+private:
+  struct Path
+  {
+    HitSurface surface;
+    glm::vec3 throughput;
+    uint32_t pixel;
+    glm::uvec2 launchIndex;
+  };
+
+  /// Queue the shadow ray of the next-event estimation of a path
+  void QueueLightSample(const DispatchState& dispatch, const Path& path, uint32_t seed,
+                        ShadowBatch& batch) const;
+
+  PathTracingSettings m_settings;
+  /// Live paths, compacted after each bounce
+  std::vector<Path> m_paths;
+  uint64_t m_segmentCount = 0;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,429 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "Simd.h"
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// Vertices per chunk of the parallel transform
+const uint32_t VertexChunkSize = 4096;
+
+inline float Edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
+{
+  return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+/// Edge function of 4 points of a row, with the operations of the scalar version
+inline Float4 Edge(const glm::vec2& a, const glm::vec2& b, Float4 px, float py)
+{
+  return Float4(b.x - a.x) * Float4(py - a.y) - Float4(b.y - a.y) * (px - Float4(a.x));
+}
+
+/// Interpolation of a vertex value with barycentric coordinates
+inline Float4 Interpolate(Float4 w0, Float4 w1, Float4 w2, float a, float b, float c)
+{
+  return w0 * Float4(a) + w1 * Float4(b) + w2 * Float4(c);
+}
+
+inline uint8_t ToUnorm8(float value)
+{
+  value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+  return static_cast<uint8_t>(value * 255.f + 0.5f);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Rasterizer::Clear(Image& target, const glm::vec4& color)
+{
+  uint8_t rgba[4] = {ToUnorm8(color.r), ToUnorm8(color.g), ToUnorm8(color.b), ToUnorm8(color.a)};
+  size_t pixelCount = static_cast<size_t>(target.width) * target.height;
+  target.pixels.resize(4 * pixelCount);
+  for (size_t i = 0; i < pixelCount; i++)
+  {
+    std::copy(rgba, rgba + 4, &target.pixels[4 * i]);
+  }
+  m_depthStride = (target.width + 3) & ~3u;
+  m_depth.assign(static_cast<size_t>(m_depthStride) * target.height, 1.f);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Transform the vertices, clip and bin all the triangles, then rasterize the tiles of the image in
+// parallel
+void Rasterizer::Draw(Image& target, const glm::mat4& viewProjection, const Vertex* vertices,
+                      uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                      ThreadPool& pool)
+{
+  TransformVertices(viewProjection, vertices, vertexCount, pool);
+  m_triangles.clear();
+  SetupTriangles(vertices, vertexCount, indices, indexCount, target.width, target.height, 0,
+                 false);
+  m_colorTarget = &target;
+  m_gbuffer = nullptr;
+  RasterizeTiles(pool);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Rasterizer::BeginGBuffer(GBuffer& target, uint32_t width, uint32_t height)
+{
+  GBufferSample empty = {};
+  empty.instanceIndex = InvalidHandle;
+  target.width = width;
+  target.height = height;
+  target.samples.assign(static_cast<size_t>(width) * height, empty);
+  m_depthStride = (width + 3) & ~3u;
+  m_depth.assign(static_cast<size_t>(m_depthStride) * height, 1.f);
+
+  m_colorTarget = nullptr;
+  m_gbuffer = &target;
+  m_gbufferDraws.clear();
+  m_triangles.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The draws are set up as they come, and the queue is rasterized once it holds enough triangles to
+// keep the threads busy, bounding the memory of the set-up triangles
+void Rasterizer::DrawGBuffer(const glm::mat4& objectToClip, const GBufferDraw& draw,
+                             ThreadPool& pool)
+{
+  const size_t MaxQueuedTriangles = 1 << 18;
+  if (m_gbuffer == nullptr)
+  {
+    throw std::logic_error("DrawGBuffer requires BeginGBuffer");
+  }
+
+  // Skip the draw if all the corners of its bounds are outside the same plane of the frustum
+  if (!draw.bounds.IsEmpty())
+  {
+    int outside = 0x3f;
+    for (int corner = 0; corner < 8 && outside != 0; corner++)
+    {
+      glm::vec3 p((corner & 1) != 0 ? draw.bounds.max.x : draw.bounds.min.x,
+                  (corner & 2) != 0 ? draw.bounds.max.y : draw.bounds.min.y,
+                  (corner & 4) != 0 ? draw.bounds.max.z : draw.bounds.min.z);
+      glm::vec4 clip = objectToClip * glm::vec4(p, 1.f);
+      outside &= (clip.x < -clip.w ? 1 : 0) | (clip.x > clip.w ? 2 : 0) |
+                 (clip.y < -clip.w ? 4 : 0) | (clip.y > clip.w ? 8 : 0) |
+                 (clip.z < 0.f ? 16 : 0) | (clip.z > clip.w ? 32 : 0);
+    }
+    if (outside != 0)
+    {
+      return;
+    }
+  }
+
+  TransformVertices(objectToClip, draw.vertices, draw.vertexCount, pool);
+  SetupTriangles(draw.vertices, draw.vertexCount, draw.indices, draw.indexCount, m_gbuffer->width,
+                 m_gbuffer->height, static_cast<uint32_t>(m_gbufferDraws.size()), true);
+  m_gbufferDraws.push_back(draw);
+  if (m_triangles.size() >= MaxQueuedTriangles)
+  {
+    EndGBuffer(pool);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Rasterizer::EndGBuffer(ThreadPool& pool)
+{
+  if (m_gbuffer == nullptr)
+  {
+    throw std::logic_error("EndGBuffer requires BeginGBuffer");
+  }
+  RasterizeTiles(pool);
+  m_gbufferDraws.clear();
+  m_triangles.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The columns of the matrix are scaled by the coordinates and summed in the order of glm, so that
+// the positions are the ones of viewProjection * vec4(position, 1)
+void Rasterizer::TransformVertices(const glm::mat4& viewProjection, const Vertex* vertices,
+                                   uint32_t vertexCount, ThreadPool& pool)
+{
+  tools::ProfileZone zone("Raster transform");
+  m_clipPositions.resize(vertexCount);
+  Float4 columns[4];
+  for (int c = 0; c < 4; c++)
+  {
+    columns[c] = Float4::Load(&viewProjection[c][0]);
+  }
+
+  uint32_t chunkCount = (vertexCount + VertexChunkSize - 1) / VertexChunkSize;
+  pool.ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t /*thread*/) {
+    uint32_t end = (chunk + 1) * VertexChunkSize < vertexCount ? (chunk + 1) * VertexChunkSize
+                                                               : vertexCount;
+    for (uint32_t i = chunk * VertexChunkSize; i < end; i++)
+    {
+      const glm::vec3& p = vertices[i].position;
+      Float4 position = (columns[0] * Float4(p.x) + columns[1] * Float4(p.y)) +
+                        (columns[2] * Float4(p.z) + columns[3] * Float4(1.f));
+      position.Store(&m_clipPositions[i][0]);
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The triangles are appended to the ones already set up
+void Rasterizer::SetupTriangles(const Vertex* vertices, uint32_t vertexCount,
+                                const uint32_t* indices, uint32_t indexCount, uint32_t width,
+                                uint32_t height, uint32_t drawIndex, bool barycentricColors)
+{
+  tools::ProfileZone zone("Raster setup");
+  const glm::vec4 unitVectors[3] = {glm::vec4(1.f, 0.f, 0.f, 0.f), glm::vec4(0.f, 1.f, 0.f, 0.f),
+                                    glm::vec4(0.f, 0.f, 1.f, 0.f)};
+  uint32_t triangleCount = (indices != nullptr ? indexCount : vertexCount) / 3;
+  for (uint32_t t = 0; t < triangleCount; t++)
+  {
+    ClipVertex triangle[3];
+    bool valid = true;
+    for (uint32_t k = 0; k < 3; k++)
+    {
+      uint32_t index = indices != nullptr ? indices[3 * t + k] : 3 * t + k;
+      if (index >= vertexCount)
+      {
+        valid = false;
+        break;
+      }
+      triangle[k].position = m_clipPositions[index];
+      triangle[k].color = barycentricColors ? unitVectors[k] : vertices[index].color;
+    }
+    if (!valid)
+    {
+      continue;
+    }
+
+    // Clip against the near plane z = 0 of the D3D clip space. A triangle has at most one more
+    // vertex once clipped by a single plane
+    ClipVertex polygon[4];
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < 3; k++)
+    {
+      const ClipVertex& a = triangle[k];
+      const ClipVertex& b = triangle[(k + 1) % 3];
+      bool aInside = a.position.z >= 0.f;
+      bool bInside = b.position.z >= 0.f;
+      if (aInside)
+      {
+        polygon[count++] = a;
+      }
+      if (aInside != bInside)
+      {
+        float s = a.position.z / (a.position.z - b.position.z);
+        polygon[count].position = a.position + s * (b.position - a.position);
+        polygon[count].color = a.color + s * (b.color - a.color);
+        count++;
+      }
+    }
+    if (count >= 3)
+    {
+      SetupClipped(polygon, count, width, height, t, drawIndex);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Project the clipped polygon, and store it as a fan of triangles
+void Rasterizer::SetupClipped(const ClipVertex* polygon, uint32_t count, uint32_t width,
+                              uint32_t height, uint32_t primitiveIndex, uint32_t drawIndex)
+{
+  for (uint32_t i = 1; i + 1 < count; i++)
+  {
+    const ClipVertex* fan[3] = {&polygon[0], &polygon[i], &polygon[i + 1]};
+    SetupTriangle triangle;
+    glm::vec2 minScreen(3.4e38f);
+    glm::vec2 maxScreen(-3.4e38f);
+    for (uint32_t k = 0; k < 3; k++)
+    {
+      const glm::vec4& position = fan[k]->position;
+      if (position.w <= 0.f)
+      {
+        return;
+      }
+      float inverseW = 1.f / position.w;
+      triangle.screen[k] = glm::vec2((position.x * inverseW * 0.5f + 0.5f) * width,
+                                     (0.5f - position.y * inverseW * 0.5f) * height);
+      triangle.depth[k] = position.z * inverseW;
+      triangle.inverseW[k] = inverseW;
+      triangle.colorOverW[k] = fan[k]->color * inverseW;
+      minScreen = glm::min(minScreen, triangle.screen[k]);
+      maxScreen = glm::max(maxScreen, triangle.screen[k]);
+    }
+
+    float area = Edge(triangle.screen[0], triangle.screen[1], triangle.screen[2]);
+    if (area == 0.f || maxScreen.x < 0.f || minScreen.x >= static_cast<float>(width) ||
+        maxScreen.y < 0.f || minScreen.y >= static_cast<float>(height))
+    {
+      continue;
+    }
+    triangle.inverseArea = 1.f / area;
+    triangle.primitiveIndex = primitiveIndex;
+    triangle.drawIndex = drawIndex;
+    triangle.minX = std::max(0, static_cast<int>(std::floor(minScreen.x - 0.5f)));
+    triangle.maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(maxScreen.x)));
+    triangle.minY = std::max(0, static_cast<int>(std::floor(minScreen.y - 0.5f)));
+    triangle.maxY =
+        std::min(static_cast<int>(height) - 1, static_cast<int>(std::ceil(maxScreen.y)));
+    m_triangles.push_back(triangle);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The bins keep their storage from one draw to the next
+void Rasterizer::BinTriangles(uint32_t width, uint32_t height)
+{
+  m_tilesX = (width + TileSize - 1) / TileSize;
+  uint32_t tilesY = (height + TileSize - 1) / TileSize;
+  m_bins.resize(static_cast<size_t>(m_tilesX) * tilesY);
+  for (std::vector<uint32_t>& bin : m_bins)
+  {
+    bin.clear();
+  }
+
+  for (uint32_t t = 0; t < m_triangles.size(); t++)
+  {
+    const SetupTriangle& triangle = m_triangles[t];
+    for (int ty = triangle.minY / TileSize; ty <= triangle.maxY / static_cast<int>(TileSize); ty++)
+    {
+      for (int tx = triangle.minX / TileSize; tx <= triangle.maxX / static_cast<int>(TileSize);
+           tx++)
+      {
+        m_bins[ty * m_tilesX + tx].push_back(t);
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Bin the set-up triangles, and rasterize the tiles in parallel
+void Rasterizer::RasterizeTiles(ThreadPool& pool)
+{
+  tools::ProfileZone zone("Raster tiles");
+  if (m_colorTarget != nullptr)
+  {
+    BinTriangles(m_colorTarget->width, m_colorTarget->height);
+  }
+  else
+  {
+    BinTriangles(m_gbuffer->width, m_gbuffer->height);
+  }
+  pool.ParallelFor(static_cast<uint32_t>(m_bins.size()),
+                   [&](uint32_t tile, uint32_t /*thread*/) { RasterizeTile(tile); });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Test the pixel centers of the tile against the triangles of its bin, in groups of 4 aligned on
+// the tile. Lanes outside the bounds of the triangle are masked, as the scalar rasterizer never
+// tested them
+void Rasterizer::RasterizeTile(uint32_t tile)
+{
+  const int tileX = static_cast<int>((tile % m_tilesX) * TileSize);
+  const int tileY = static_cast<int>((tile / m_tilesX) * TileSize);
+  const Float4 laneOffsets(0.f, 1.f, 2.f, 3.f);
+  const Float4 zero(0.f);
+  const Float4 one(1.f);
+
+  for (uint32_t t : m_bins[tile])
+  {
+    const SetupTriangle& triangle = m_triangles[t];
+    int x0 = std::max(triangle.minX, tileX);
+    int x1 = std::min(triangle.maxX, tileX + static_cast<int>(TileSize) - 1);
+    int y0 = std::max(triangle.minY, tileY);
+    int y1 = std::min(triangle.maxY, tileY + static_cast<int>(TileSize) - 1);
+    const glm::vec2* p = triangle.screen;
+    Float4 inverseArea(triangle.inverseArea);
+
+    for (int y = y0; y <= y1; y++)
+    {
+      float centerY = y + 0.5f;
+      for (int x = x0 & ~3; x <= x1; x += 4)
+      {
+        Float4 laneX = Float4(static_cast<float>(x)) + laneOffsets;
+        Float4 inBounds = (laneX >= Float4(static_cast<float>(x0))) &
+                          (laneX <= Float4(static_cast<float>(x1)));
+        Float4 centerX = laneX + Float4(0.5f);
+        Float4 w0 = Edge(p[1], p[2], centerX, centerY) * inverseArea;
+        Float4 w1 = Edge(p[2], p[0], centerX, centerY) * inverseArea;
+        Float4 w2 = Edge(p[0], p[1], centerX, centerY) * inverseArea;
+        Float4 covered = inBounds & (w0 >= zero) & (w1 >= zero) & (w2 >= zero);
+        if (Mask(covered) == 0)
+        {
+          continue;
+        }
+
+        // Early depth test, before any color is interpolated. Each pixel of the depth buffer is
+        // only written by the tile owning it
+        float* depthRow = &m_depth[static_cast<size_t>(y) * m_depthStride + x];
+        Float4 stored = Float4::Load(depthRow);
+        Float4 depth = Interpolate(w0, w1, w2, triangle.depth[0], triangle.depth[1],
+                                   triangle.depth[2]);
+        Float4 passed = covered & (depth >= zero) & (depth <= one) & (depth < stored);
+        int mask = Mask(passed);
+        if (mask == 0)
+        {
+          continue;
+        }
+        Select(passed, depth, stored).Store(depthRow);
+
+        Float4 inverseW = Interpolate(w0, w1, w2, triangle.inverseW[0], triangle.inverseW[1],
+                                      triangle.inverseW[2]);
+        float channels[4][4];
+        for (int c = 0; c < 4; c++)
+        {
+          Float4 value = Interpolate(w0, w1, w2, triangle.colorOverW[0][c],
+                                     triangle.colorOverW[1][c], triangle.colorOverW[2][c]) /
+                         inverseW;
+          value.Store(channels[c]);
+        }
+        for (; mask != 0; mask &= mask - 1)
+        {
+          int lane = FirstLane(mask);
+          if (m_colorTarget != nullptr)
+          {
+            size_t pixel = static_cast<size_t>(y) * m_colorTarget->width + x + lane;
+            uint8_t* out = &m_colorTarget->pixels[4 * pixel];
+            for (int c = 0; c < 4; c++)
+            {
+              out[c] = ToUnorm8(channels[c][lane]);
+            }
+          }
+          else
+          {
+            // The colors are the weights of the vertices 0, 1 and 2, the barycentrics of a hit
+            // being the weights of the vertices 1 and 2
+            const GBufferDraw& draw = m_gbufferDraws[triangle.drawIndex];
+            GBufferSample& sample =
+                m_gbuffer->samples[static_cast<size_t>(y) * m_gbuffer->width + x + lane];
+            sample.instanceIndex = draw.instanceIndex;
+            sample.geometryIndex = draw.geometryIndex;
+            sample.primitiveIndex = triangle.primitiveIndex;
+            sample.barycentrics = glm::vec2(channels[1][lane], channels[2][lane]);
+          }
+        }
+      }
+    }
+  }
+}
+} // namespace cpu
+} // namespace rhi
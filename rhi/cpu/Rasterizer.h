@@ -0,0 +1,162 @@
+/*
+Triangle rasterizer of the CPU backend, reproducing the raster pipeline of the
+sample: vertices transformed by the view and projection matrices, no culling,
+a less-than depth test on a 32-bit float depth buffer, and perspective-correct
+interpolation of the vertex colors.
+
+The vertices are transformed once per draw, in parallel chunks, as 4-wide
+sums of the matrix columns. The triangles are then clipped against the near
+plane, projected, set up once, and binned to the screen tiles overlapped by
+their bounds. The tiles are rasterized in parallel, each testing the triangles
+of its bin in submission order, so that no two threads write the same pixel.
+Pixels are processed 4 at a time: the half-space edge functions and the depth
+are evaluated on the lanes of a Float4, and the depth test runs before the
+colors are interpolated, only for the covered lanes passing it. The lanes
+compute exactly the operations of a pixel at a time, so the images do not
+depend on the SIMD width.
+
+The rasterizer also renders the primary visibility of the hybrid mode to a
+G-buffer, which stores at each pixel the instance, geometry and triangle
+visible at its center, and the barycentrics a ray hit would report there. The
+barycentrics are interpolated like colors, the vertices of each triangle
+carrying the unit vectors, so that they stay relative to the original triangle
+when it is clipped. The draws of the instances are queued and rasterized in
+batches, and draws whose bounds are outside the view frustum are skipped.
+
+Example:
+
+Rasterizer rasterizer;
+rasterizer.Clear(image, clearColor);
+rasterizer.Draw(image, viewProjection, vertices, vertexCount, indices, indexCount, pool);
+
+rasterizer.BeginGBuffer(gbuffer, width, height);
+rasterizer.DrawGBuffer(viewProjection * transform, {vertices, vertexCount, indices, indexCount,
+                                                    instance, geometry, bounds}, pool);
+rasterizer.EndGBuffer(pool);
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "../RenderDevice.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+/// Surface visible at a pixel, as a ray hit through its center would report it. Pixels where no
+/// surface is visible have an instance index of InvalidHandle
+struct GBufferSample
+{
+  uint32_t instanceIndex;
+  uint32_t geometryIndex;
+  uint32_t primitiveIndex;
+  glm::vec2 barycentrics;
+  /// World-space position of the surface, left to the owner of the geometry
+  glm::vec3 position;
+};
+
+struct GBuffer
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  /// Rows stored top to bottom
+  std::vector<GBufferSample> samples;
+};
+
+/// Geometry of an instance drawn to a G-buffer
+struct GBufferDraw
+{
+  const Vertex* vertices;
+  uint32_t vertexCount;
+  const uint32_t* indices;
+  uint32_t indexCount;
+  uint32_t instanceIndex;
+  uint32_t geometryIndex;
+  /// Object-space bounds of the geometry, for the frustum test. An empty box is always drawn
+  Aabb bounds;
+};
+
+class Rasterizer
+{
+public:
+  /// Fill the color image and reset the depth buffer, resized to the image if needed
+  void Clear(Image& target, const glm::vec4& color);
+
+  /// Draw indexed triangles, or consecutive vertex triplets if indices is null
+  void Draw(Image& target, const glm::mat4& viewProjection, const Vertex* vertices,
+            uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, ThreadPool& pool);
+
+  /// Start drawing the visible surfaces to a G-buffer of width x height, and reset the depth
+  void BeginGBuffer(GBuffer& target, uint32_t width, uint32_t height);
+
+  /// Queue a draw to the G-buffer, transformed by objectToClip, the view-projection matrix
+  /// multiplied by the transform of the instance. The queued draws may be rasterized by any call
+  void DrawGBuffer(const glm::mat4& objectToClip, const GBufferDraw& draw, ThreadPool& pool);
+
+  /// Rasterize the remaining queued draws
+  void EndGBuffer(ThreadPool& pool);
+
+  /// Side of the square tiles of pixels to which the triangles are binned, a multiple of 4
+  static const uint32_t TileSize = 32;
+
+private:
+  /// Projected triangle, with the attributes divided by w
+  struct SetupTriangle
+  {
+    glm::vec2 screen[3];
+    float depth[3];
+    float inverseW[3];
+    glm::vec4 colorOverW[3];
+    float inverseArea;
+    /// Triangle of the draw, and index of the draw in the queue of the G-buffer
+    uint32_t primitiveIndex;
+    uint32_t drawIndex;
+    /// Pixel bounds, clamped to the image
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+  };
+
+  struct ClipVertex
+  {
+    glm::vec4 position;
+    glm::vec4 color;
+  };
+
+  void TransformVertices(const glm::mat4& viewProjection, const Vertex* vertices,
+                         uint32_t vertexCount, ThreadPool& pool);
+  /// Clip and set up the triangles, with the vertex colors, or the unit barycentric vectors if
+  /// barycentricColors is true
+  void SetupTriangles(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices,
+                      uint32_t indexCount, uint32_t width, uint32_t height, uint32_t drawIndex,
+                      bool barycentricColors);
+  void SetupClipped(const ClipVertex* polygon, uint32_t count, uint32_t width, uint32_t height,
+                    uint32_t primitiveIndex, uint32_t drawIndex);
+  void BinTriangles(uint32_t width, uint32_t height);
+  void RasterizeTiles(ThreadPool& pool);
+  void RasterizeTile(uint32_t tile);
+
+  /// Depth of the pixels, with rows padded to a multiple of 4 pixels
+  std::vector<float> m_depth;
+  uint32_t m_depthStride = 0;
+  /// Clip-space positions of the vertices of the current draw
+  std::vector<glm::vec4> m_clipPositions;
+  std::vector<SetupTriangle> m_triangles;
+  /// Indices of the triangles overlapping each tile, in submission order
+  std::vector<std::vector<uint32_t>> m_bins;
+  uint32_t m_tilesX = 0;
+
+  /// Target of the tiles: the color image, or the G-buffer and the ids of its queued draws
+  Image* m_colorTarget = nullptr;
+  GBuffer* m_gbuffer = nullptr;
+  std::vector<GBufferDraw> m_gbufferDraws;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,316 @@
+#include "ReprojectionCache.h"
+
+#include <cstring>
+#include <limits>
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+const uint64_t NoSplat = ~0ull;
+const uint32_t NoSource = ~0u;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Position in pixels and view-space depth of a primary record seen by a camera, the background
+// being behind all the surfaces. Returns false if it is outside of the view
+bool Project(const glm::mat4& viewProjection, const glm::vec3& point, PrimaryKind kind,
+             uint32_t width, uint32_t height, glm::vec2& screen, float& depth)
+{
+  glm::vec4 clip = viewProjection * glm::vec4(point, kind == PrimaryKind::Hit ? 1.f : 0.f);
+  if (!(clip.w > 0.f))
+  {
+    return false;
+  }
+  screen = glm::vec2((0.5f + 0.5f * clip.x / clip.w) * static_cast<float>(width),
+                     (0.5f - 0.5f * clip.y / clip.w) * static_cast<float>(height));
+  depth = kind == PrimaryKind::Hit ? clip.w : std::numeric_limits<float>::max();
+  return screen.x >= 0.f && screen.x < static_cast<float>(width) && screen.y >= 0.f &&
+         screen.y < static_cast<float>(height);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Non-negative floats compare as their bits
+uint64_t PackSplat(float depth, uint32_t source)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(bits));
+  return (static_cast<uint64_t>(bits) << 32) | source;
+}
+
+float UnpackDepth(uint64_t splat)
+{
+  uint32_t bits = static_cast<uint32_t>(splat >> 32);
+  float depth;
+  std::memcpy(&depth, &bits, sizeof(depth));
+  return depth;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The history is scattered in parallel rows, the nearest surface of each pixel being kept by an
+// atomic minimum on the packed depth and index. The pixels are then sorted in parallel rows, and
+// gathered in the lists of pixels to shade
+void ReprojectionCache::Reproject(const glm::mat4& viewProjection, Image& output,
+                                  ThreadPool& pool)
+{
+  uint32_t width = output.width;
+  uint32_t height = output.height;
+  size_t count = static_cast<size_t>(width) * height;
+  m_next.resize(count);
+  m_sources.resize(count);
+  m_records.resize(count);
+  uint32_t maxAge = m_settings.maxAge > 0 ? m_settings.maxAge : 1;
+  float ageStep = 1.f / static_cast<float>(maxAge);
+
+  if (!m_valid || width != m_width || height != m_height)
+  {
+    pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t i = y * width; i < (y + 1) * width; i++)
+      {
+        m_sources[i] = Source::Trace;
+        // Spread the first refreshes over maxAge frames
+        m_next[i].confidence = static_cast<float>(1 + ((i * 2654435761u) >> 16) % maxAge) * ageStep;
+      }
+    });
+  }
+  else
+  {
+    if (m_splats.size() != count)
+    {
+      m_splats = std::vector<std::atomic<uint64_t>>(count);
+    }
+    pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t i = y * width; i < (y + 1) * width; i++)
+      {
+        m_splats[i].store(NoSplat, std::memory_order_relaxed);
+      }
+    });
+
+    pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t i = y * width; i < (y + 1) * width; i++)
+      {
+        const HistoryPixel& pixel = m_history[i];
+        glm::vec2 screen;
+        float depth;
+        if (pixel.kind == PrimaryKind::None ||
+            !Project(viewProjection, pixel.point, pixel.kind, width, height, screen, depth))
+        {
+          continue;
+        }
+        std::atomic<uint64_t>& splat =
+            m_splats[static_cast<uint32_t>(screen.y) * width + static_cast<uint32_t>(screen.x)];
+        uint64_t packed = PackSplat(depth, i);
+        uint64_t current = splat.load(std::memory_order_relaxed);
+        while (packed < current &&
+               !splat.compare_exchange_weak(current, packed, std::memory_order_relaxed))
+        {
+        }
+      }
+    });
+
+    pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+      for (uint32_t x = 0; x < width; x++)
+      {
+        uint32_t i = y * width + x;
+        uint32_t sourceIndex = FindSource(viewProjection, x, y, width, height);
+        HistoryPixel& next = m_next[i];
+        if (sourceIndex != NoSource)
+        {
+          const HistoryPixel& source = m_history[sourceIndex];
+          float confidence = source.confidence - ageStep;
+          if (source.kind == PrimaryKind::Hit)
+          {
+            glm::vec2 screen;
+            float depth;
+            Project(viewProjection, source.point, source.kind, width, height, screen, depth);
+            confidence -= m_settings.offsetPenalty *
+                          glm::length(screen - (glm::vec2(float(x), float(y)) + 0.5f));
+            confidence -= source.edge ? m_settings.edgePenalty : 0.f;
+          }
+          if (confidence > 0.f)
+          {
+            next = source;
+            next.confidence = confidence;
+            if (source.kind == PrimaryKind::Hit)
+            {
+              m_sources[i] = Source::Reuse;
+              std::memcpy(&output.pixels[4 * static_cast<size_t>(i)], source.color, 4);
+            }
+            else
+            {
+              m_sources[i] = Source::Miss;
+            }
+            continue;
+          }
+        }
+        m_sources[i] = Source::Trace;
+        next.confidence = 1.f;
+      }
+    });
+  }
+
+  m_tracedPixels.clear();
+  m_missPixels.clear();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (m_sources[i] == Source::Trace)
+    {
+      m_tracedPixels.push_back(i);
+    }
+    else if (m_sources[i] == Source::Miss)
+    {
+      m_missPixels.push_back(i);
+    }
+    if (m_sources[i] != Source::Reuse)
+    {
+      m_records[i].kind = PrimaryKind::None;
+    }
+  }
+  m_stats.traced = static_cast<uint32_t>(m_tracedPixels.size());
+  m_stats.missed = static_cast<uint32_t>(m_missPixels.size());
+  m_stats.reused = static_cast<uint32_t>(count) - m_stats.traced - m_stats.missed;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Scattering to the nearest pixels leaves gaps where the surfaces are stretched, or just sampled
+// differently by the new pixels, in which the farther surfaces or the background show through. A
+// pixel is taken as a gap if no surface lands in it, or if two of its opposite neighbors are in
+// front of its surface. It then takes the nearest of the neighbor surfaces in front, rather than
+// being traced as a disocclusion, unless one of them is on a discontinuity or they are not all of
+// the same kind
+uint32_t ReprojectionCache::FindSource(const glm::mat4& viewProjection, uint32_t x, uint32_t y,
+                                       uint32_t width, uint32_t height) const
+{
+  uint64_t splats[3][3];
+  for (int32_t dy = -1; dy <= 1; dy++)
+  {
+    for (int32_t dx = -1; dx <= 1; dx++)
+    {
+      int32_t nx = static_cast<int32_t>(x) + dx;
+      int32_t ny = static_cast<int32_t>(y) + dy;
+      bool inside = nx >= 0 && ny >= 0 && nx < static_cast<int32_t>(width) &&
+                    ny < static_cast<int32_t>(height);
+      splats[1 + dy][1 + dx] =
+          inside ? m_splats[static_cast<uint32_t>(ny) * width + nx].load(std::memory_order_relaxed)
+                 : NoSplat;
+    }
+  }
+
+  uint64_t center = splats[1][1];
+  float limit = std::numeric_limits<float>::infinity();
+  if (center != NoSplat)
+  {
+    limit = UnpackDepth(center) * (1.f - m_settings.edgeThreshold);
+    bool gap = false;
+    const int32_t pairs[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    for (const int32_t* pair : pairs)
+    {
+      uint64_t a = splats[1 + pair[1]][1 + pair[0]];
+      uint64_t b = splats[1 - pair[1]][1 - pair[0]];
+      gap = gap || (a != NoSplat && b != NoSplat && UnpackDepth(a) < limit &&
+                    UnpackDepth(b) < limit);
+    }
+    if (!gap)
+    {
+      return static_cast<uint32_t>(center);
+    }
+  }
+
+  uint32_t best = NoSource;
+  float bestDistance = std::numeric_limits<float>::max();
+  PrimaryKind kind = PrimaryKind::None;
+  const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for (const int32_t* offset : offsets)
+  {
+    uint64_t packed = splats[1 + offset[1]][1 + offset[0]];
+    if (packed == NoSplat || !(UnpackDepth(packed) < limit))
+    {
+      continue;
+    }
+    const HistoryPixel& candidate = m_history[static_cast<uint32_t>(packed)];
+    if (candidate.edge || (kind != PrimaryKind::None && candidate.kind != kind))
+    {
+      return NoSource;
+    }
+    kind = candidate.kind;
+    float distance = 0.f;
+    glm::vec2 screen;
+    float depth;
+    if (kind == PrimaryKind::Hit &&
+        Project(viewProjection, candidate.point, kind, width, height, screen, depth))
+    {
+      distance = glm::length(screen - (glm::vec2(float(x), float(y)) + 0.5f));
+    }
+    if (distance < bestDistance)
+    {
+      best = static_cast<uint32_t>(packed);
+      bestDistance = distance;
+    }
+  }
+  return best;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The discontinuities are found once all the pixels of the frame are known, comparing the
+// distances to the eye of the 4 neighbors
+void ReprojectionCache::Store(const Image& output, const glm::vec3& eye, ThreadPool& pool)
+{
+  uint32_t width = output.width;
+  uint32_t height = output.height;
+  pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (uint32_t i = y * width; i < (y + 1) * width; i++)
+    {
+      HistoryPixel& next = m_next[i];
+      if (m_sources[i] != Source::Reuse)
+      {
+        next.point = m_records[i].point;
+        next.kind = m_records[i].kind;
+      }
+      std::memcpy(next.color, &output.pixels[4 * static_cast<size_t>(i)], 4);
+    }
+  });
+
+  pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread*/) {
+    for (uint32_t x = 0; x < width; x++)
+    {
+      HistoryPixel& pixel = m_next[y * width + x];
+      pixel.edge = false;
+      float distance = glm::length(pixel.point - eye);
+      const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+      for (const int32_t* offset : offsets)
+      {
+        int32_t nx = static_cast<int32_t>(x) + offset[0];
+        int32_t ny = static_cast<int32_t>(y) + offset[1];
+        if (nx < 0 || ny < 0 || nx >= static_cast<int32_t>(width) ||
+            ny >= static_cast<int32_t>(height))
+        {
+          continue;
+        }
+        const HistoryPixel& neighbor = m_next[static_cast<uint32_t>(ny) * width + nx];
+        if (neighbor.kind != pixel.kind ||
+            (pixel.kind == PrimaryKind::Hit &&
+             glm::abs(glm::length(neighbor.point - eye) - distance) >
+                 m_settings.edgeThreshold * distance))
+        {
+          pixel.edge = true;
+          break;
+        }
+      }
+    }
+  });
+
+  m_history.swap(m_next);
+  m_width = width;
+  m_height = height;
+  m_valid = true;
+}
+} // namespace cpu
+} // namespace rhi
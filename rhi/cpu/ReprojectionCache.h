@@ -0,0 +1,147 @@
+/*
+Temporal reprojection cache of the CPU backend, reusing the pixels of the
+previous frames while only the camera moves. The scene, the shaders and the
+light of the sample being static, a surface keeps the color it was shaded
+with from any viewpoint, so a pixel can take the color of the surface the
+previous frame saw there instead of tracing its rays.
+
+Each pixel of the history keeps the world-space position of its primary hit,
+or the direction of its ray if it missed, its color, and a confidence. A frame
+starts by scattering the history to the pixels of the new camera, the nearest
+surface winning in each pixel and the background being behind all of them.
+Each pixel is then:
+- traced, if no surface lands in it, the surface having been occluded or out
+  of the view, or if the confidence of its surface runs out
+- reused, taking the color of the surface
+- shaded by the miss shader without traversal, if the history saw the
+  background there, the miss color depending on the pixel
+
+Scattering to the nearest pixels leaves gaps where the surfaces stretch, in
+which farther surfaces show through. A pixel is taken as such a gap if no
+surface lands in it, or if opposite neighbors are in front of its surface, and
+then takes the surface of its nearest neighbor in front, unless the
+neighborhood is on a discontinuity.
+
+The confidence starts at 1 when a pixel is traced, and decreases each time the
+pixel is reused: by 1/maxAge per frame, so that no pixel is older than maxAge
+frames, by the distance in pixels between the reprojected surface and the
+center of its new pixel, as the surface is not exactly the one the pixel
+center sees, and more on the depth discontinuities, where a wrong surface is
+the most likely. The confidences of the first frame are spread over the
+range, so that the refreshes are staggered rather than all in the same frame.
+
+The cache is meant for the ray generation shader of the sample, which traces
+one camera ray through each pixel center. It must be invalidated when the
+scene or the shaders change.
+
+Example:
+
+cache.Reproject(camera.projection * camera.view, image, pool);
+dispatch.primaryRecords = cache.GetRecords().data();
+// Invoke the ray generation shader on cache.GetTracedPixels(), then with dispatch.primaryMiss on
+// cache.GetMissPixels()
+cache.Store(image, eye, pool);
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "../RenderDevice.h"
+#include "Shaders.h"
+#include "ThreadPool.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct ReprojectionSettings
+{
+  /// Frames a pixel can be reused for at most
+  uint32_t maxAge = 32;
+  /// Confidence lost per pixel of distance between a reprojected surface and its pixel center
+  float offsetPenalty = 0.1f;
+  /// Confidence lost per frame by the surfaces on a depth discontinuity
+  float edgePenalty = 0.25f;
+  /// Relative difference of the distances to the eye of neighbor surfaces making a discontinuity
+  float edgeThreshold = 0.02f;
+};
+
+/// Pixels of a frame by origin of their color
+struct ReprojectionStats
+{
+  uint32_t traced = 0;
+  uint32_t reused = 0;
+  uint32_t missed = 0;
+};
+
+class ReprojectionCache
+{
+public:
+  void SetSettings(const ReprojectionSettings& settings) { m_settings = settings; }
+  const ReprojectionSettings& GetSettings() const { return m_settings; }
+
+  /// Forget the history, after a change of the scene or of the shaders
+  void Invalidate() { m_valid = false; }
+
+  /// Sort the pixels of the output image for a camera, writing the colors of the reused ones.
+  /// Without a history of the same size, all the pixels are traced
+  void Reproject(const glm::mat4& viewProjection, Image& output, ThreadPool& pool);
+
+  /// Pixel indices, in rows of the output width, to invoke the ray generation shader on normally
+  /// and with the primary rays missing
+  const std::vector<uint32_t>& GetTracedPixels() const { return m_tracedPixels; }
+  const std::vector<uint32_t>& GetMissPixels() const { return m_missPixels; }
+  /// Primary records of the pixels, to be filled by the dispatch of the traced and miss pixels
+  std::vector<PrimaryRecord>& GetRecords() { return m_records; }
+
+  /// Make the frame the history of the next one, eye being the camera position
+  void Store(const Image& output, const glm::vec3& eye, ThreadPool& pool);
+
+  const ReprojectionStats& GetStats() const { return m_stats; }
+
+private:
+  enum class Source : uint8_t
+  {
+    Trace,
+    Reuse,
+    Miss
+  };
+
+  struct HistoryPixel
+  {
+    /// Primary record of the pixel
+    glm::vec3 point;
+    PrimaryKind kind;
+    float confidence;
+    uint8_t color[4];
+    /// Whether the surface is on a depth discontinuity
+    bool edge;
+  };
+
+  /// History index of the surface to reuse at a pixel, once the history is scattered, or ~0 if
+  /// the pixel must be traced
+  uint32_t FindSource(const glm::mat4& viewProjection, uint32_t x, uint32_t y, uint32_t width,
+                      uint32_t height) const;
+
+  ReprojectionSettings m_settings;
+  bool m_valid = false;
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  std::vector<HistoryPixel> m_history;
+  /// History of the frame being rendered
+  std::vector<HistoryPixel> m_next;
+  std::vector<Source> m_sources;
+  std::vector<PrimaryRecord> m_records;
+  /// Depth and history index of the nearest surface landing in each pixel, packed to be
+  /// compared at once
+  std::vector<std::atomic<uint64_t>> m_splats;
+  std::vector<uint32_t> m_tracedPixels;
+  std::vector<uint32_t> m_missPixels;
+  ReprojectionStats m_stats;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,362 @@
+// C++ versions of the HLSL shaders of the sample. Any change to the HLSL files
+// has to be mirrored here for both backends to render the same image.
+
+#include "Shaders.h"
+
+#include "Sampling.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// Common.hlsl
+struct HitInfo
+{
+  glm::vec4 colorAndDistance;
+};
+
+/// ShadowRay.hlsl
+struct ShadowHitInfo
+{
+  bool isHit;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// World-space geometric normal of the triangle hit, facing the ray. Not part of the HLSL shaders
+glm::vec3 WorldNormal(const ShaderInvocation& invocation, const Vertex* vertices,
+                      const uint32_t* indices)
+{
+  uint32_t vertId = 3 * invocation.PrimitiveIndex();
+  glm::vec3 v0 = vertices[indices[vertId + 0]].position;
+  glm::vec3 v1 = vertices[indices[vertId + 1]].position;
+  glm::vec3 v2 = vertices[indices[vertId + 2]].position;
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(invocation.ObjectToWorld())));
+  glm::vec3 normal = glm::normalize(normalMatrix * glm::cross(v1 - v0, v2 - v0));
+  return glm::dot(normal, invocation.WorldRayDirection()) > 0.f ? -normal : normal;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Guide of the denoiser at the pixel of a primary ray hit. Not part of the HLSL shaders, the D3D12
+// backend having no denoiser
+void WriteDenoiseGuide(const ShaderInvocation& invocation, const Vertex* vertices,
+                       const uint32_t* indices, const glm::vec3& albedo)
+{
+  DenoiseGuide* guides = invocation.dispatch->guides;
+  if (guides == nullptr || invocation.recursionDepth != 1)
+  {
+    return;
+  }
+  glm::vec3 normal = WorldNormal(invocation, vertices, indices);
+
+  glm::uvec2 pixel = invocation.DispatchRaysIndex();
+  DenoiseGuide& guide =
+      guides[static_cast<size_t>(pixel.y) * invocation.DispatchRaysDimensions().x + pixel.x];
+  guide.position =
+      invocation.WorldRayOrigin() + invocation.RayTCurrent() * invocation.WorldRayDirection();
+  guide.normal = normal;
+  guide.albedo = albedo;
+  guide.instanceIndex = invocation.InstanceIndex();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue the stratified shadow rays of a light from a point of a surface, each carrying the share
+// of the diffuse color of its light sample, divided by the probability of the light
+void QueueLightSamples(const ShaderInvocation& invocation, const LightDesc& light,
+                       const glm::vec3& position, const glm::vec3& normal,
+                       const glm::vec3& diffuse, float probability, uint32_t seed)
+{
+  uint32_t sampleCount = GetSampleCount(light);
+  glm::vec3 contribution =
+      diffuse * light.color / (static_cast<float>(sampleCount) * probability);
+  for (uint32_t i = 0; i < sampleCount; i++)
+  {
+    glm::vec2 u = StratifiedSample(i, sampleCount, RandomFloat2(Hash(seed, i)));
+    glm::vec3 offset = SampleLight(light, position, u) - position;
+    float distance = glm::length(offset);
+    Ray ray;
+    ray.origin = position;
+    ray.direction = offset / distance;
+    ray.tMin = 0.01f;
+    ray.tMax = distance;
+    if (!light.falloff)
+    {
+      invocation.shadowBatch->Add(ray, contribution);
+      continue;
+    }
+    float cosine = glm::dot(normal, ray.direction);
+    if (cosine > 0.f)
+    {
+      invocation.shadowBatch->Add(ray, contribution * (cosine / (distance * distance)));
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue the shadow rays of the lights of the dispatch, of all of them, or of lightsPerPoint lights
+// picked by the hierarchy with stratified numbers. The seed depends on the pixel and on the frame,
+// so that successive frames sample other lights and other points of the lights. Not part of the
+// HLSL shaders
+void QueueLightSamples(const ShaderInvocation& invocation, const glm::vec3& position,
+                       const glm::vec3& normal, const glm::vec3& diffuse)
+{
+  const DispatchState& dispatch = *invocation.dispatch;
+  glm::uvec2 pixel = invocation.DispatchRaysIndex();
+  uint32_t seed = Hash(pixel.y * dispatch.dimensions.x + pixel.x, dispatch.frameIndex);
+  if (dispatch.lightBvh == nullptr)
+  {
+    for (uint32_t lightIndex = 0; lightIndex < dispatch.lightCount; lightIndex++)
+    {
+      QueueLightSamples(invocation, dispatch.lights[lightIndex], position, normal, diffuse, 1.f,
+                        Hash(seed, lightIndex));
+    }
+    return;
+  }
+
+  float pickCount = static_cast<float>(dispatch.lightsPerPoint);
+  float jitter = RandomFloat2(seed).x;
+  for (uint32_t pick = 0; pick < dispatch.lightsPerPoint; pick++)
+  {
+    float probability;
+    uint32_t lightIndex = dispatch.lightBvh->Sample(
+        position, normal, (static_cast<float>(pick) + jitter) / pickCount, probability);
+    if (lightIndex != InvalidHandle)
+    {
+      QueueLightSamples(invocation, dispatch.lights[lightIndex], position, normal, diffuse,
+                        probability * pickCount, Hash(seed, pick + 1));
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Fill the surface record of the path tracer if it asks for it, instead of shading the hit, the
+// payload being left black. Returns false to shade the hit. Not part of the HLSL shaders
+bool WriteSurface(const ShaderInvocation& invocation, const glm::vec3& albedo)
+{
+  HitSurface* surface = invocation.surface;
+  if (surface == nullptr)
+  {
+    return false;
+  }
+  const Vertex* vertices = invocation.GetBuffer<Vertex>(0);
+  const uint32_t* indices = invocation.GetBuffer<uint32_t>(1);
+  surface->position =
+      invocation.WorldRayOrigin() + invocation.RayTCurrent() * invocation.WorldRayDirection();
+  surface->normal = WorldNormal(invocation, vertices, indices);
+  surface->albedo = albedo;
+  surface->hit = true;
+  WriteDenoiseGuide(invocation, vertices, indices, albedo);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue the ambient occlusion rays of a hit if the dispatch asks for them, stratified over the
+// hemisphere of the normal, and return black, the escaping rays adding their share of white.
+// Returns false to shade the hit normally. Not part of the HLSL shaders
+bool ShadeAmbientOcclusion(const ShaderInvocation& invocation, void* payload)
+{
+  const DispatchState& dispatch = *invocation.dispatch;
+  const AmbientOcclusionSettings* settings = dispatch.ambientOcclusion;
+  if (settings == nullptr || invocation.shadowBatch == nullptr)
+  {
+    return false;
+  }
+  const Vertex* vertices = invocation.GetBuffer<Vertex>(0);
+  const uint32_t* indices = invocation.GetBuffer<uint32_t>(1);
+  glm::vec3 normal = WorldNormal(invocation, vertices, indices);
+  glm::vec3 tangent, bitangent;
+  OrthonormalBasis(normal, tangent, bitangent);
+
+  glm::uvec2 pixel = invocation.DispatchRaysIndex();
+  uint32_t seed = Hash(pixel.y * dispatch.dimensions.x + pixel.x, dispatch.frameIndex);
+  glm::vec3 contribution(1.f / static_cast<float>(settings->sampleCount));
+  Ray ray;
+  ray.origin =
+      invocation.WorldRayOrigin() + invocation.RayTCurrent() * invocation.WorldRayDirection();
+  ray.tMin = 0.001f;
+  ray.tMax = settings->maxDistance;
+  for (uint32_t i = 0; i < settings->sampleCount; i++)
+  {
+    glm::vec3 local = CosineHemisphere(
+        StratifiedSample(i, settings->sampleCount, RandomFloat2(Hash(seed, i))));
+    ray.direction = local.x * tangent + local.y * bitangent + local.z * normal;
+    invocation.shadowBatch->Add(ray, contribution);
+  }
+
+  static_cast<HitInfo*>(payload)->colorAndDistance =
+      glm::vec4(0.f, 0.f, 0.f, invocation.RayTCurrent());
+  WriteDenoiseGuide(invocation, vertices, indices, glm::vec3(1.f));
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// RayGen.hlsl: one primary ray per pixel through the camera
+glm::vec4 RayGen(const ShaderInvocation& invocation)
+{
+  HitInfo payload;
+  payload.colorAndDistance = glm::vec4(0.f);
+
+  glm::vec2 dims = glm::vec2(invocation.DispatchRaysDimensions());
+  glm::vec2 d = ((glm::vec2(invocation.DispatchRaysIndex()) + 0.5f) / dims) * 2.f - 1.f;
+
+  const DispatchState& dispatch = *invocation.dispatch;
+  Ray ray;
+  ray.origin = glm::vec3(dispatch.viewInverse * glm::vec4(0.f, 0.f, 0.f, 1.f));
+  glm::vec4 target = dispatch.projectionInverse * glm::vec4(d.x, -d.y, 1.f, 1.f);
+  ray.direction = glm::vec3(dispatch.viewInverse * glm::vec4(glm::vec3(target), 0.f));
+  ray.tMin = 0.f;
+  ray.tMax = 100000.f;
+
+  TraceRay(invocation, RayFlagNone, 0, 0, 0, ray, &payload);
+
+  return glm::vec4(glm::vec3(payload.colorAndDistance), 1.f);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Miss.hlsl: vertical gradient
+void Miss(const ShaderInvocation& invocation, void* payload)
+{
+  float ramp = static_cast<float>(invocation.DispatchRaysIndex().y) /
+               static_cast<float>(invocation.DispatchRaysDimensions().y);
+  static_cast<HitInfo*>(payload)->colorAndDistance =
+      glm::vec4(0.f, 0.2f, 0.7f - 0.3f * ramp, -1.f);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Hit.hlsl: interpolated vertex colors
+void ClosestHit(const ShaderInvocation& invocation, const glm::vec2& bary, void* payload)
+{
+  if (ShadeAmbientOcclusion(invocation, payload))
+  {
+    return;
+  }
+  const Vertex* vertices = invocation.GetBuffer<Vertex>(0);
+  const uint32_t* indices = invocation.GetBuffer<uint32_t>(1);
+
+  glm::vec3 barycentrics(1.f - bary.x - bary.y, bary.x, bary.y);
+  uint32_t vertId = 3 * invocation.PrimitiveIndex();
+  glm::vec3 hitColor = glm::vec3(vertices[indices[vertId + 0]].color) * barycentrics.x +
+                       glm::vec3(vertices[indices[vertId + 1]].color) * barycentrics.y +
+                       glm::vec3(vertices[indices[vertId + 2]].color) * barycentrics.z;
+  if (WriteSurface(invocation, hitColor))
+  {
+    return;
+  }
+
+  static_cast<HitInfo*>(payload)->colorAndDistance = glm::vec4(hitColor, invocation.RayTCurrent());
+  WriteDenoiseGuide(invocation, vertices, indices, hitColor);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Hit.hlsl: plane darkened where a shadow ray towards the light is blocked. With a visibility
+// cache, the shadow ray is only traced for the cells not computed yet, from their center. With
+// the lights of the dispatch, the shadow rays are queued in the batch, their unoccluded samples
+// adding the lit part of the color
+void PlaneClosestHit(const ShaderInvocation& invocation, const glm::vec2& /*bary*/, void* payload)
+{
+  if (ShadeAmbientOcclusion(invocation, payload))
+  {
+    return;
+  }
+  glm::vec3 lightPos(2.f, 2.f, -2.f);
+
+  glm::vec3 worldOrigin =
+      invocation.WorldRayOrigin() + invocation.RayTCurrent() * invocation.WorldRayDirection();
+  glm::vec3 albedo(0.7f, 0.7f, 0.3f);
+  if (WriteSurface(invocation, albedo))
+  {
+    return;
+  }
+  if (invocation.dispatch->lightCount != 0 && invocation.shadowBatch != nullptr)
+  {
+    const Vertex* vertices = invocation.GetBuffer<Vertex>(0);
+    const uint32_t* indices = invocation.GetBuffer<uint32_t>(1);
+    QueueLightSamples(invocation, worldOrigin, WorldNormal(invocation, vertices, indices),
+                      albedo * 0.7f);
+    static_cast<HitInfo*>(payload)->colorAndDistance =
+        glm::vec4(albedo * 0.3f, invocation.RayTCurrent());
+    WriteDenoiseGuide(invocation, vertices, indices, albedo);
+    return;
+  }
+
+  Ray ray;
+  ray.origin = worldOrigin;
+  ray.tMin = 0.01f;
+  ray.tMax = 100000.f;
+
+  ShadowHitInfo shadowPayload;
+  shadowPayload.isHit = false;
+
+  VisibilityCache* cache = invocation.dispatch->visibilityCache;
+  VisibilityCache::Query query = {};
+  if (cache != nullptr)
+  {
+    query = cache->Find(lightPos, worldOrigin);
+    ray.origin = query.origin;
+    ray.tMin += query.margin;
+    shadowPayload.isHit = !query.visible;
+  }
+  ray.direction = glm::normalize(lightPos - ray.origin);
+
+  if (!query.found)
+  {
+    // Shadow hit groups are the second of each instance, and the shadow miss shader the second
+    // one
+    TraceRay(invocation, RayFlagNone, 1, 0, 1, ray, &shadowPayload);
+    if (cache != nullptr)
+    {
+      cache->Insert(query, !shadowPayload.isHit);
+    }
+  }
+
+  float factor = shadowPayload.isHit ? 0.3f : 1.f;
+  static_cast<HitInfo*>(payload)->colorAndDistance =
+      glm::vec4(albedo * factor, invocation.RayTCurrent());
+  WriteDenoiseGuide(invocation, invocation.GetBuffer<Vertex>(0), invocation.GetBuffer<uint32_t>(1),
+                    albedo);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// ShadowRay.hlsl
+void ShadowClosestHit(const ShaderInvocation& /*invocation*/, const glm::vec2& /*bary*/,
+                      void* payload)
+{
+  static_cast<ShadowHitInfo*>(payload)->isHit = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// ShadowRay.hlsl
+void ShadowMiss(const ShaderInvocation& /*invocation*/, void* payload)
+{
+  static_cast<ShadowHitInfo*>(payload)->isHit = false;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void RegisterSampleShaders(ShaderRegistry& registry)
+{
+  registry.RegisterRayGen(L"RayGen", RayGen);
+  registry.RegisterMiss(L"Miss", Miss);
+  registry.RegisterMiss(L"ShadowMiss", ShadowMiss);
+  registry.RegisterClosestHit(L"ClosestHit", ClosestHit);
+  registry.RegisterClosestHit(L"PlaneClosestHit", PlaneClosestHit);
+  registry.RegisterClosestHit(L"ShadowClosestHit", ShadowClosestHit);
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,127 @@
+/*
+Random numbers and sample patterns of the CPU shaders. The random numbers are
+hashes of the pixel, of the frame and of the sample, rather than the states of
+per-thread generators, so that an image does not depend on the threads which
+shaded its pixels.
+
+A set of samples of the unit square is stratified: the square is divided in a
+grid of cells, as close to square as the sample count allows, and each sample
+is jittered within its own cell, which keeps the noise of the estimates lower
+than with independent samples. The directions of a hemisphere are mapped from
+the square through the disk, so that the strata stay compact.
+
+Example:
+
+uint32_t seed = Hash(pixelIndex, frameIndex);
+for (uint32_t i = 0; i < count; i++)
+{
+  glm::vec2 u = StratifiedSample(i, count, RandomFloat2(Hash(seed, i)));
+  ...
+}
+
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace rhi
+{
+namespace cpu
+{
+
+/// Output permutation of the PCG generator, a cheap hash with good avalanche
+inline uint32_t Hash(uint32_t value)
+{
+  uint32_t state = value * 747796405u + 2891336453u;
+  uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+inline uint32_t Hash(uint32_t a, uint32_t b)
+{
+  return Hash(a ^ Hash(b));
+}
+
+/// Float in [0, 1) from the high 24 bits of a hash
+inline float ToUnitFloat(uint32_t bits)
+{
+  return static_cast<float>(bits >> 8) * (1.f / 16777216.f);
+}
+
+inline glm::vec2 RandomFloat2(uint32_t seed)
+{
+  uint32_t first = Hash(seed);
+  return glm::vec2(ToUnitFloat(first), ToUnitFloat(Hash(first)));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Sample index of count in the unit square, jitter being its position in [0, 1)^2 within its cell.
+// The grid has ceil(sqrt(count)) columns, the cells of an incomplete last row being widened to
+// cover it
+inline glm::vec2 StratifiedSample(uint32_t index, uint32_t count, const glm::vec2& jitter)
+{
+  uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+  uint32_t rows = (count + columns - 1) / columns;
+  uint32_t row = index / columns;
+  uint32_t rowColumns = row + 1 < rows ? columns : count - row * columns;
+  return glm::vec2((static_cast<float>(index - row * columns) + jitter.x) /
+                       static_cast<float>(rowColumns),
+                   (static_cast<float>(row) + jitter.y) / static_cast<float>(rows));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Uniform point of the unit disk, by the concentric mapping of Shirley and Chiu, which maps the
+// cells of a stratified set to compact regions of the disk
+inline glm::vec2 ConcentricDisk(const glm::vec2& u)
+{
+  glm::vec2 offset = 2.f * u - 1.f;
+  if (offset.x == 0.f && offset.y == 0.f)
+  {
+    return glm::vec2(0.f);
+  }
+  const float quarterPi = 0.78539816f;
+  float radius, angle;
+  if (std::fabs(offset.x) > std::fabs(offset.y))
+  {
+    radius = offset.x;
+    angle = quarterPi * (offset.y / offset.x);
+  }
+  else
+  {
+    radius = offset.y;
+    angle = 2.f * quarterPi - quarterPi * (offset.x / offset.y);
+  }
+  return radius * glm::vec2(std::cos(angle), std::sin(angle));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Direction of the hemisphere around z with a density proportional to its cosine, by projecting a
+// point of the unit disk up to the hemisphere (Malley's method)
+inline glm::vec3 CosineHemisphere(const glm::vec2& u)
+{
+  glm::vec2 disk = ConcentricDisk(u);
+  float z2 = 1.f - glm::dot(disk, disk);
+  return glm::vec3(disk, std::sqrt(z2 > 0.f ? z2 : 0.f));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Two unit vectors completing a unit normal to an orthonormal basis, without branches on the
+// normal but its sign (Duff et al. 2017)
+inline void OrthonormalBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+{
+  float sign = std::copysign(1.f, normal.z);
+  float a = -1.f / (sign + normal.z);
+  float b = normal.x * normal.y * a;
+  tangent = glm::vec3(1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+  bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+} // namespace cpu
+} // namespace rhi
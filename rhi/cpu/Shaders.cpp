@@ -0,0 +1,218 @@
+#include "Shaders.h"
+
+#include <stdexcept>
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// Convert a shader name for error messages
+std::string Narrow(const std::wstring& name)
+{
+  return std::string(name.begin(), name.end());
+}
+
+template <typename Shader>
+Shader Find(const std::map<std::wstring, Shader>& shaders, const std::wstring& name)
+{
+  auto it = shaders.find(name);
+  if (it == shaders.end())
+  {
+    throw std::logic_error("No CPU shader registered as " + Narrow(name));
+  }
+  return it->second;
+}
+
+/// Hit of a ray of the ray generation shader, read from the G-buffer. The position is projected on
+/// the ray, which may not pass exactly through it, to get the hit distance
+bool FindPrimaryHit(const GBuffer& gbuffer, const glm::uvec2& launchIndex, const Ray& ray,
+                    RayHit& hit)
+{
+  if (launchIndex.x >= gbuffer.width || launchIndex.y >= gbuffer.height)
+  {
+    return false;
+  }
+  const GBufferSample& sample =
+      gbuffer.samples[static_cast<size_t>(launchIndex.y) * gbuffer.width + launchIndex.x];
+  if (sample.instanceIndex == InvalidHandle)
+  {
+    return false;
+  }
+  float t = glm::dot(sample.position - ray.origin, ray.direction) /
+            glm::dot(ray.direction, ray.direction);
+  if (!(t >= ray.tMin && t < ray.tMax))
+  {
+    return false;
+  }
+  hit.t = t;
+  hit.barycentrics = sample.barycentrics;
+  hit.primitiveIndex = sample.primitiveIndex;
+  hit.geometryIndex = sample.geometryIndex;
+  hit.instanceIndex = sample.instanceIndex;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Invocation of the shaders of a ray traced by the caller, one level deeper
+ShaderInvocation MakeInvocation(const ShaderInvocation& caller, const Ray& ray)
+{
+  ShaderInvocation invocation;
+  invocation.dispatch = caller.dispatch;
+  invocation.launchIndex = caller.launchIndex;
+  invocation.recursionDepth = caller.recursionDepth + 1;
+  invocation.shadowBatch = caller.shadowBatch;
+  invocation.surface = caller.surface;
+  invocation.ray = ray;
+  return invocation;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Find the closest hit, or any hit if requested, and invoke the closest hit shader of the selected
+// hit group record, or the miss shader. The hits of the ray generation shader of a hybrid dispatch
+// come from the G-buffer, and are recorded if the dispatch asks for it
+void TraceRay(const ShaderInvocation& caller, uint32_t rayFlags, uint32_t rayContribution,
+              uint32_t geometryMultiplier, uint32_t missIndex, const Ray& ray, void* payload)
+{
+  const DispatchState& dispatch = *caller.dispatch;
+  if (caller.recursionDepth >= dispatch.maxRecursionDepth)
+  {
+    return;
+  }
+
+  RayHit hit;
+  hit.t = ray.tMax;
+  bool found;
+  if (caller.recursionDepth == 0 && dispatch.primaryMiss)
+  {
+    found = false;
+  }
+  else if (caller.recursionDepth == 0 && dispatch.primaryHits != nullptr)
+  {
+    found = FindPrimaryHit(*dispatch.primaryHits, caller.launchIndex, ray, hit);
+  }
+  else if ((rayFlags & RayFlagAcceptFirstHitAndEndSearch) != 0)
+  {
+    // The hit attributes are not reported by the any-hit traversal, so the closest hit shader
+    // can only be skipped
+    found = dispatch.scene->Occluded(ray);
+    if (found && (rayFlags & RayFlagSkipClosestHitShader) == 0)
+    {
+      found = dispatch.scene->Intersect(ray, hit);
+    }
+    else if (found)
+    {
+      return;
+    }
+  }
+  else
+  {
+    found = dispatch.scene->Intersect(ray, hit);
+  }
+
+  if (caller.recursionDepth == 0 && dispatch.primaryRecords != nullptr)
+  {
+    PrimaryRecord& record =
+        dispatch.primaryRecords[static_cast<size_t>(caller.launchIndex.y) *
+                                    dispatch.dimensions.x +
+                                caller.launchIndex.x];
+    record.point = found ? ray.origin + hit.t * ray.direction : ray.direction;
+    record.kind = found ? PrimaryKind::Hit : PrimaryKind::Miss;
+  }
+
+  if (!found)
+  {
+    if (missIndex < dispatch.missShaders.size() && dispatch.missShaders[missIndex] != nullptr)
+    {
+      ShaderInvocation invocation = MakeInvocation(caller, ray);
+      dispatch.missShaders[missIndex](invocation, payload);
+    }
+    return;
+  }
+
+  if ((rayFlags & RayFlagSkipClosestHitShader) == 0)
+  {
+    InvokeClosestHit(caller, rayContribution, geometryMultiplier, ray, hit, payload);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool InvokeClosestHit(const ShaderInvocation& caller, uint32_t rayContribution,
+                      uint32_t geometryMultiplier, const Ray& ray, const RayHit& hit,
+                      void* payload)
+{
+  const DispatchState& dispatch = *caller.dispatch;
+  uint32_t recordIndex = dispatch.scene->GetInstance(hit.instanceIndex).hitGroupIndex +
+                         rayContribution + geometryMultiplier * hit.geometryIndex;
+  if (recordIndex >= dispatch.hitGroups.size() ||
+      dispatch.hitGroups[recordIndex].closestHit == nullptr)
+  {
+    return false;
+  }
+
+  ShaderInvocation invocation = MakeInvocation(caller, ray);
+  invocation.tCurrent = hit.t;
+  invocation.primitiveIndex = hit.primitiveIndex;
+  invocation.instanceIndex = hit.instanceIndex;
+  invocation.geometryIndex = hit.geometryIndex;
+  invocation.record = &dispatch.hitGroups[recordIndex];
+  invocation.record->closestHit(invocation, hit.barycentrics, payload);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ShaderRegistry::RegisterRayGen(const std::wstring& name, RayGenShader shader)
+{
+  m_rayGen[name] = shader;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ShaderRegistry::RegisterMiss(const std::wstring& name, MissShader shader)
+{
+  m_miss[name] = shader;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ShaderRegistry::RegisterClosestHit(const std::wstring& name, ClosestHitShader shader)
+{
+  m_closestHit[name] = shader;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RayGenShader ShaderRegistry::FindRayGen(const std::wstring& name) const
+{
+  return Find(m_rayGen, name);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+MissShader ShaderRegistry::FindMiss(const std::wstring& name) const
+{
+  return Find(m_miss, name);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ClosestHitShader ShaderRegistry::FindClosestHit(const std::wstring& name) const
+{
+  return Find(m_closestHit, name);
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,269 @@
+/*
+C++ shaders of the CPU backend. Each HLSL shader used by a pipeline has a C++
+equivalent registered under the same export name, so that a pipeline
+description and a shader binding table are valid on both backends.
+
+Shaders are plain functions receiving a ShaderInvocation, which provides the
+equivalents of the HLSL system values (DispatchRaysIndex, WorldRayOrigin,
+RayTCurrent, PrimitiveIndex...) and the buffers bound in the shader record.
+TraceRay follows the DXR rules to select the hit group record: the hit group
+index of the instance, plus the ray contribution, plus the geometry index
+times the geometry multiplier.
+
+In the hybrid mode, the primary visibility is rasterized to a G-buffer, and
+the rays traced by the ray generation shader take the surface of the G-buffer
+at the launch index instead of traversing the scene. Their hit distance is the
+one of the G-buffer position along the ray, which assumes that the ray
+generation shader traces the camera ray through the pixel center, as the one
+of the sample does. Only the rays traced by the hit and miss shaders, such as
+the shadow rays, traverse the acceleration structures.
+
+A dispatch can also record the primary hit of each pixel, which is the hit of
+the last ray traced by the ray generation shader: the world-space position of
+the hit, or the direction of the ray if it missed. The reprojection cache uses
+them to reuse the pixels in the next frames, and has the rays of the pixels it
+knows to see the background miss without traversal.
+
+The closest hit shaders of the primary rays also write the guides of the
+denoiser, when the dispatch asks for them: the world-space position and normal
+of the surface, its albedo, and the instance index.
+
+The hit shaders tracing shadow rays towards a point light can look up its
+visibility in the world-space cache of the dispatch, if any, and only trace
+the shadow rays of the cells not computed yet.
+
+A dispatch can replace the point light of the sample by a list of lights with
+an extent (see Lights.h). The hit shaders then queue stratified shadow rays
+towards each light, or towards a few lights picked by the light hierarchy of
+the dispatch (see LightBvh.h), in the shadow batch of the invocation (see
+ShadowBatch.h), each with the contribution of its light sample, and return
+the color of the surface without the lights. The batch is traced after the
+ray generation shader of all the pixels of the tile, and the contributions of
+the unoccluded rays are added to the pixel of the launch index, which assumes
+that the color of the hit shader is the one of the pixel, as in the sample.
+
+With ambient occlusion enabled in the dispatch, the closest hit shaders of the
+sample replace their shading by the unoccluded share of the hemisphere around
+the primary hit: they queue cosine-weighted rays of limited length in the
+shadow batch, each adding its share of white if it escapes, and the batch
+sorts them before tracing (see ShadowBatch.h).
+
+When path tracing, the closest hit shaders do not shade the hit: they fill the
+surface record of the invocation with its position, normal and albedo, and
+the path tracer of the device (see PathTracer.h) continues the path from it.
+The primary rays are still traced by the ray generation shader, which returns
+the color of the miss shader for the pixels seeing the background.
+
+Example:
+
+void Miss(const ShaderInvocation& invocation, void* payload)
+{
+  static_cast<HitInfo*>(payload)->colorAndDistance = glm::vec4(0.f, 0.2f, 0.7f, -1.f);
+}
+...
+registry.RegisterMiss(L"Miss", Miss);
+
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AccelerationStructure.h"
+#include "LightBvh.h"
+#include "Lights.h"
+#include "Rasterizer.h"
+#include "ShadowBatch.h"
+#include "VisibilityCache.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct ShaderInvocation;
+
+/// Returns the color of the pixel at the launch index
+using RayGenShader = glm::vec4 (*)(const ShaderInvocation& invocation);
+using MissShader = void (*)(const ShaderInvocation& invocation, void* payload);
+using ClosestHitShader = void (*)(const ShaderInvocation& invocation,
+                                  const glm::vec2& barycentrics, void* payload);
+
+/// Hit group of the shader binding table, with the CPU addresses of its buffers
+struct HitGroupRecord
+{
+  ClosestHitShader closestHit = nullptr;
+  std::vector<const uint8_t*> buffers;
+};
+
+enum class PrimaryKind : uint32_t
+{
+  /// No ray traced by the ray generation shader
+  None,
+  Hit,
+  Miss
+};
+
+/// Primary hit of a pixel
+struct PrimaryRecord
+{
+  /// World-space position of the hit, or direction of the ray for a miss
+  glm::vec3 point;
+  PrimaryKind kind;
+};
+
+/// Surface seen by the primary ray of a pixel, guiding the denoiser. Background pixels have an
+/// instance index of InvalidHandle
+struct DenoiseGuide
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  /// Color of the surface before lighting, which the denoiser divides out of the pixel
+  glm::vec3 albedo;
+  uint32_t instanceIndex;
+};
+
+/// Surface of a hit, for the path tracer (see PathTracer.h)
+struct HitSurface
+{
+  glm::vec3 position;
+  /// Unit geometric normal, facing the ray
+  glm::vec3 normal;
+  /// Diffuse reflectance
+  glm::vec3 albedo;
+  /// Whether a closest hit shader filled the surface
+  bool hit = false;
+};
+
+/// Ambient occlusion replacing the shading of the sample hit shaders
+struct AmbientOcclusionSettings
+{
+  /// Cosine-weighted rays per shaded point
+  uint32_t sampleCount = 16;
+  /// Length of the rays, the farther occluders being ignored
+  float maxDistance = 0.5f;
+  /// Edge length of the cells of the ray origins by which the batches are sorted, 0 to trace the
+  /// rays in their order
+  float sortCellSize = 0.25f;
+};
+
+/// State shared by all the invocations of a dispatch
+struct DispatchState
+{
+  const TopLevelAS* scene = nullptr;
+  RayGenShader rayGen = nullptr;
+  std::vector<MissShader> missShaders;
+  std::vector<HitGroupRecord> hitGroups;
+  glm::mat4 viewInverse;
+  glm::mat4 projectionInverse;
+  glm::uvec2 dimensions;
+  uint32_t maxRecursionDepth = 1;
+  /// Surfaces hit by the rays of the ray generation shader in the hybrid mode, or null to trace
+  /// them
+  const GBuffer* primaryHits = nullptr;
+  /// Records of the primary hits, one per pixel in rows of dimensions.x, or null
+  PrimaryRecord* primaryRecords = nullptr;
+  /// Whether the rays of the ray generation shader miss without traversal
+  bool primaryMiss = false;
+  /// Cache of the light visibility for the shadow rays of the hit shaders, or null to trace them
+  VisibilityCache* visibilityCache = nullptr;
+  /// Guides of the denoiser, one per pixel in rows of dimensions.x, or null
+  DenoiseGuide* guides = nullptr;
+  /// Lights replacing the point light of the sample, if any
+  const LightDesc* lights = nullptr;
+  uint32_t lightCount = 0;
+  /// Hierarchy picking lightsPerPoint lights per shaded point, or null to sample all the lights
+  const LightBvh* lightBvh = nullptr;
+  uint32_t lightsPerPoint = 0;
+  /// Ambient occlusion replacing the shading of the sample, or null
+  const AmbientOcclusionSettings* ambientOcclusion = nullptr;
+  /// Index of the dispatch, seeding the random numbers of the shaders
+  uint32_t frameIndex = 0;
+};
+
+enum RayFlags : uint32_t
+{
+  RayFlagNone = 0,
+  RayFlagAcceptFirstHitAndEndSearch = 0x4,
+  RayFlagSkipClosestHitShader = 0x8
+};
+
+/// State of one shader invocation
+struct ShaderInvocation
+{
+  const DispatchState* dispatch;
+  glm::uvec2 launchIndex;
+  /// Number of TraceRay calls on the stack
+  uint32_t recursionDepth = 0;
+
+  /// Ray and hit of the hit and miss shaders
+  Ray ray = {};
+  float tCurrent = 0.f;
+  uint32_t primitiveIndex = 0;
+  uint32_t instanceIndex = 0;
+  uint32_t geometryIndex = 0;
+  const HitGroupRecord* record = nullptr;
+  /// Batch of the shadow rays of the lights, set by the device when the dispatch has lights or
+  /// ambient occlusion
+  ShadowBatch* shadowBatch = nullptr;
+  /// Surface the closest hit shaders fill instead of shading the hit, set by the device when
+  /// path tracing
+  HitSurface* surface = nullptr;
+
+  glm::uvec2 DispatchRaysIndex() const { return launchIndex; }
+  glm::uvec2 DispatchRaysDimensions() const { return dispatch->dimensions; }
+  glm::vec3 WorldRayOrigin() const { return ray.origin; }
+  glm::vec3 WorldRayDirection() const { return ray.direction; }
+  float RayTCurrent() const { return tCurrent; }
+  uint32_t PrimitiveIndex() const { return primitiveIndex; }
+  uint32_t InstanceIndex() const { return instanceIndex; }
+  const glm::mat4& ObjectToWorld() const
+  {
+    return dispatch->scene->GetInstance(instanceIndex).transform;
+  }
+
+  /// Buffer bound to root parameter slot of the hit group record, or nullptr
+  template <typename T>
+  const T* GetBuffer(uint32_t slot) const
+  {
+    return slot < record->buffers.size() ? reinterpret_cast<const T*>(record->buffers[slot])
+                                         : nullptr;
+  }
+};
+
+/// Trace a ray from a shader. Rays exceeding the recursion depth of the pipeline are dropped
+/// without invoking any shader
+void TraceRay(const ShaderInvocation& caller, uint32_t rayFlags, uint32_t rayContribution,
+              uint32_t geometryMultiplier, uint32_t missIndex, const Ray& ray, void* payload);
+
+/// Invoke the closest hit shader of the hit group record selected for a hit found by the caller,
+/// as TraceRay does. Returns false if the record has no closest hit shader
+bool InvokeClosestHit(const ShaderInvocation& caller, uint32_t rayContribution,
+                      uint32_t geometryMultiplier, const Ray& ray, const RayHit& hit,
+                      void* payload);
+
+/// C++ shaders by export name
+class ShaderRegistry
+{
+public:
+  void RegisterRayGen(const std::wstring& name, RayGenShader shader);
+  void RegisterMiss(const std::wstring& name, MissShader shader);
+  void RegisterClosestHit(const std::wstring& name, ClosestHitShader shader);
+
+  /// Find a shader, throwing if it has not been registered
+  RayGenShader FindRayGen(const std::wstring& name) const;
+  MissShader FindMiss(const std::wstring& name) const;
+  ClosestHitShader FindClosestHit(const std::wstring& name) const;
+
+private:
+  std::map<std::wstring, RayGenShader> m_rayGen;
+  std::map<std::wstring, MissShader> m_miss;
+  std::map<std::wstring, ClosestHitShader> m_closestHit;
+};
+
+/// Register the equivalents of RayGen.hlsl, Miss.hlsl, Hit.hlsl and ShadowRay.hlsl
+void RegisterSampleShaders(ShaderRegistry& registry);
+} // namespace cpu
+} // namespace rhi
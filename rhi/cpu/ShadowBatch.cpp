@@ -0,0 +1,129 @@
+#include "ShadowBatch.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+const uint32_t RadixBits = 6;
+const uint32_t BucketCount = 1 << RadixBits;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Low 3 bits of a value spread to every third bit, to interleave three of them
+uint32_t SpreadBits(uint32_t value)
+{
+  return (value & 1) | ((value & 2) << 2) | ((value & 4) << 4);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ShadowBatch::Add(const Ray& ray, const glm::vec3& contribution)
+{
+  m_rays.push_back(ray);
+  m_pixels.push_back(m_pixel);
+  m_contributions.push_back(contribution);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The 12-bit key is the Morton code of the cell, whose coordinates wrap around every 8 cells, then
+// the octant, above the index of the ray. The rays of a batch come from a tile, which spans a few
+// cells, so the wrapping only rarely brings far cells together. The keys are sorted by a stable
+// radix sort of 2 passes of 6 bits, which keeps the rays with the same key in their order
+void ShadowBatch::SortRays()
+{
+  uint32_t count = static_cast<uint32_t>(m_rays.size());
+  float scale = 1.f / m_sortCellSize;
+  m_keys.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const Ray& ray = m_rays[i];
+    uint32_t octant = (ray.direction.x < 0.f ? 1 : 0) | (ray.direction.y < 0.f ? 2 : 0) |
+                      (ray.direction.z < 0.f ? 4 : 0);
+    uint32_t morton = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      auto cell = static_cast<int32_t>(std::floor(ray.origin[axis] * scale));
+      morton |= SpreadBits(static_cast<uint32_t>(cell)) << axis;
+    }
+    m_keys[i] = (static_cast<uint64_t>((morton << 3) | octant) << 32) | i;
+  }
+
+  m_sortedKeys.resize(count);
+  for (uint32_t shift = 32; shift < 32 + 2 * RadixBits; shift += RadixBits)
+  {
+    uint32_t buckets[BucketCount] = {};
+    for (uint64_t key : m_keys)
+    {
+      buckets[(key >> shift) & (BucketCount - 1)]++;
+    }
+    uint32_t offset = 0;
+    for (uint32_t& bucket : buckets)
+    {
+      uint32_t size = bucket;
+      bucket = offset;
+      offset += size;
+    }
+    for (uint64_t key : m_keys)
+    {
+      m_sortedKeys[buckets[(key >> shift) & (BucketCount - 1)]++] = key;
+    }
+    m_keys.swap(m_sortedKeys);
+  }
+
+  m_order.resize(count);
+  m_sortedRays.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    m_order[i] = static_cast<uint32_t>(m_keys[i]);
+    m_sortedRays[i] = m_rays[m_order[i]];
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The time includes the sort, part of the cost of tracing the rays in batches
+void ShadowBatch::Flush(const TopLevelAS& scene, glm::vec4* colors)
+{
+  if (m_rays.empty())
+  {
+    return;
+  }
+  tools::ProfileZone zone("Shadow batch");
+  auto start = std::chrono::steady_clock::now();
+  uint32_t count = static_cast<uint32_t>(m_rays.size());
+  bool sorted = m_sortCellSize > 0.f;
+  if (sorted)
+  {
+    SortRays();
+  }
+  m_occluded.resize(count);
+  scene.Occluded(sorted ? m_sortedRays.data() : m_rays.data(), m_occluded.data(), count,
+                 m_kernel);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t ray = sorted ? m_order[i] : i;
+    if (m_occluded[i] == 0)
+    {
+      colors[m_pixels[ray]] += glm::vec4(m_contributions[ray], 0.f);
+    }
+  }
+  m_tracedCount += count;
+  m_tracedSeconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  m_rays.clear();
+  m_pixels.clear();
+  m_contributions.clear();
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,92 @@
+/*
+Batch of the shadow rays of the pixels of a tile, traced together once the
+ray generation shader has run for all of them, instead of one recursive
+TraceRay each.
+
+Each ray carries the contribution of the light sample it points to, which is
+added to the color of its pixel if nothing occludes the ray. The shader of a
+point queues its rays one after the other, so that consecutive rays, which
+the traversal groups in packets of four, start from the same point towards
+nearby points of the same light. The whole batch then goes through the
+occlusion-only traversal of the top-level structure, instance by instance
+(see AccelerationStructure.h), so that the cost of soft shadows is the one of
+a predictable number of coherent rays.
+
+Incoherent rays, such as the ambient occlusion rays of a hemisphere, can be
+sorted before they are traced: by the cell of their origin along a Morton
+curve, then by the octant of their direction, so that consecutive rays start
+close to each other and visit the nodes in the same order. The contributions
+still go to the pixels of the rays. The time spent tracing is kept apart from
+the shading, to measure the throughput of the batched rays.
+
+The batch uses the packet kernel by default, which needs no 4-wide hierarchy
+and suits the rays of a point towards one light. Rays spread over the
+hemisphere rather trace faster one at a time with the scalar kernel.
+
+Example:
+
+ShadowBatch batch;
+for (uint32_t i = 0; i < pixelCount; i++)
+{
+  batch.SetPixel(i);
+  colors[i] = ...; // Shading calling batch.Add(ray, contribution)
+}
+batch.Flush(scene, colors);
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "AccelerationStructure.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+class ShadowBatch
+{
+public:
+  /// Select the pixel to which the next rays contribute, as an index in the colors given to Flush
+  void SetPixel(uint32_t pixel) { m_pixel = pixel; }
+  /// Queue a ray adding contribution to the color of the pixel if it reaches its tMax
+  void Add(const Ray& ray, const glm::vec3& contribution);
+
+  /// Sort the rays of each Flush by direction octant and by origin cell of edge cellSize, or trace
+  /// them in their order if 0
+  void SetSortCellSize(float cellSize) { m_sortCellSize = cellSize; }
+  /// Kernel tracing the rays through the bottom-level structures, Packet by default. The Simd
+  /// kernel requires their 4-wide hierarchy
+  void SetKernel(TraversalKernel kernel) { m_kernel = kernel; }
+
+  uint32_t GetSize() const { return static_cast<uint32_t>(m_rays.size()); }
+  /// Rays traced by all the Flush calls, and the time spent in them
+  uint64_t GetTracedCount() const { return m_tracedCount; }
+  double GetTracedSeconds() const { return m_tracedSeconds; }
+
+  /// Trace the queued rays, add the contributions of the unoccluded ones, and empty the batch
+  void Flush(const TopLevelAS& scene, glm::vec4* colors);
+
+private:
+  /// Fill m_order with the indices of the rays in sorted order, and m_sortedRays with the rays
+  void SortRays();
+
+  uint32_t m_pixel = 0;
+  float m_sortCellSize = 0.f;
+  TraversalKernel m_kernel = TraversalKernel::Packet;
+  std::vector<Ray> m_rays;
+  std::vector<uint32_t> m_pixels;
+  std::vector<glm::vec3> m_contributions;
+  std::vector<uint8_t> m_occluded;
+  /// Sort keys of the rays, and their order once sorted
+  std::vector<uint64_t> m_keys;
+  std::vector<uint64_t> m_sortedKeys;
+  std::vector<uint32_t> m_order;
+  std::vector<Ray> m_sortedRays;
+  uint64_t m_tracedCount = 0;
+  double m_tracedSeconds = 0.0;
+};
+} // namespace cpu
+} // namespace rhi
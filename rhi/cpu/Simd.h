@@ -0,0 +1,256 @@
+/*
+Four-wide float vectors for the SIMD and packet traversal kernels, mapped to
+SSE on x86-64 and to plain arrays elsewhere, so that the kernels compile on all
+platforms with the same results.
+
+Comparisons return masks, which are combined with &, | and AndNot, used by
+Select to blend two vectors, and converted by Mask to an integer with one bit
+per lane.
+
+Example:
+
+Float4 t0 = (Float4(boxMinX) - originX) * inverseDirectionX;
+Float4 hit = (entry <= exit) & (entry < tMax);
+if (Mask(hit) != 0) { ... }
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RHI_CPU_SSE 1
+#else
+#define RHI_CPU_SSE 0
+#endif
+
+namespace rhi
+{
+namespace cpu
+{
+
+#if RHI_CPU_SSE
+
+struct Float4
+{
+  __m128 v;
+
+  Float4() = default;
+  Float4(__m128 value) : v(value) {}
+  /// Broadcast value to all the lanes
+  Float4(float value) : v(_mm_set1_ps(value)) {}
+  Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+  static Float4 Load(const float* values) { return _mm_loadu_ps(values); }
+  void Store(float* values) const { _mm_storeu_ps(values, v); }
+  float operator[](int lane) const
+  {
+    float values[4];
+    Store(values);
+    return values[lane];
+  }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 Abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+
+inline Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+/// a & ~b
+inline Float4 AndNot(Float4 a, Float4 b) { return _mm_andnot_ps(b.v, a.v); }
+
+/// Lanes of a where mask is set, of b elsewhere
+inline Float4 Select(Float4 mask, Float4 a, Float4 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+/// One bit per lane, set where the mask is
+inline int Mask(Float4 mask) { return _mm_movemask_ps(mask.v); }
+
+/// Mask with the lanes of the bits of mask set
+inline Float4 MaskFromBits(int mask)
+{
+  return _mm_castsi128_ps(_mm_cmpgt_epi32(
+      _mm_and_si128(_mm_set1_epi32(mask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128()));
+}
+
+/// Transpose the 4x4 matrix whose rows are a, b, c and d
+inline void Transpose(Float4& a, Float4& b, Float4& c, Float4& d)
+{
+  _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+}
+
+#else
+
+struct Float4
+{
+  float v[4];
+
+  Float4() = default;
+  Float4(float value) : v{value, value, value, value} {}
+  Float4(float a, float b, float c, float d) : v{a, b, c, d} {}
+
+  static Float4 Load(const float* values)
+  {
+    return Float4(values[0], values[1], values[2], values[3]);
+  }
+  void Store(float* values) const { std::memcpy(values, v, sizeof(v)); }
+  float operator[](int lane) const { return v[lane]; }
+};
+
+namespace simd_detail
+{
+template <typename Operation> inline Float4 Apply(Float4 a, Float4 b, Operation operation)
+{
+  return Float4(operation(a.v[0], b.v[0]), operation(a.v[1], b.v[1]), operation(a.v[2], b.v[2]),
+                operation(a.v[3], b.v[3]));
+}
+
+/// Masks are stored as floats with all the bits set or cleared, as with SSE
+inline float FromBool(bool value)
+{
+  uint32_t bits = value ? 0xffffffffu : 0u;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline uint32_t Bits(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+} // namespace simd_detail
+
+inline Float4 operator+(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x + y; });
+}
+inline Float4 operator-(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x - y; });
+}
+inline Float4 operator*(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x * y; });
+}
+inline Float4 operator/(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x / y; });
+}
+/// Same operand order as minps and maxps: the second operand is returned for NaNs
+inline Float4 Min(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x < y ? x : y; });
+}
+inline Float4 Max(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return x > y ? x : y; });
+}
+inline Float4 Abs(Float4 a)
+{
+  return simd_detail::Apply(a, a, [](float x, float) { return x < 0.f ? -x : x; });
+}
+
+inline Float4 operator<(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return simd_detail::FromBool(x < y); });
+}
+inline Float4 operator<=(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return simd_detail::FromBool(x <= y); });
+}
+inline Float4 operator>(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return simd_detail::FromBool(x > y); });
+}
+inline Float4 operator>=(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) { return simd_detail::FromBool(x >= y); });
+}
+inline Float4 operator&(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) {
+    return simd_detail::FromBool((simd_detail::Bits(x) & simd_detail::Bits(y)) != 0);
+  });
+}
+inline Float4 operator|(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) {
+    return simd_detail::FromBool((simd_detail::Bits(x) | simd_detail::Bits(y)) != 0);
+  });
+}
+inline Float4 AndNot(Float4 a, Float4 b)
+{
+  return simd_detail::Apply(a, b, [](float x, float y) {
+    return simd_detail::FromBool((simd_detail::Bits(x) & ~simd_detail::Bits(y)) != 0);
+  });
+}
+
+inline Float4 Select(Float4 mask, Float4 a, Float4 b)
+{
+  return Float4(simd_detail::Bits(mask.v[0]) ? a.v[0] : b.v[0],
+                simd_detail::Bits(mask.v[1]) ? a.v[1] : b.v[1],
+                simd_detail::Bits(mask.v[2]) ? a.v[2] : b.v[2],
+                simd_detail::Bits(mask.v[3]) ? a.v[3] : b.v[3]);
+}
+
+inline int Mask(Float4 mask)
+{
+  int bits = 0;
+  for (int lane = 0; lane < 4; lane++)
+  {
+    bits |= simd_detail::Bits(mask.v[lane]) != 0 ? 1 << lane : 0;
+  }
+  return bits;
+}
+
+inline Float4 MaskFromBits(int mask)
+{
+  return Float4(simd_detail::FromBool((mask & 1) != 0), simd_detail::FromBool((mask & 2) != 0),
+                simd_detail::FromBool((mask & 4) != 0), simd_detail::FromBool((mask & 8) != 0));
+}
+
+inline void Transpose(Float4& a, Float4& b, Float4& c, Float4& d)
+{
+  Float4 rows[4] = {a, b, c, d};
+  a = Float4(rows[0].v[0], rows[1].v[0], rows[2].v[0], rows[3].v[0]);
+  b = Float4(rows[0].v[1], rows[1].v[1], rows[2].v[1], rows[3].v[1]);
+  c = Float4(rows[0].v[2], rows[1].v[2], rows[2].v[2], rows[3].v[2]);
+  d = Float4(rows[0].v[3], rows[1].v[3], rows[2].v[3], rows[3].v[3]);
+}
+
+#endif
+
+/// Index of the lowest set bit of a non-zero lane mask
+inline int FirstLane(int mask)
+{
+  int lane = 0;
+  while ((mask & (1 << lane)) == 0)
+  {
+    lane++;
+  }
+  return lane;
+}
+
+/// Number of set bits of a lane mask
+inline int LaneCount(int mask)
+{
+  return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+}
+} // namespace cpu
+} // namespace rhi
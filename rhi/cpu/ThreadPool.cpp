@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include "../../tools/Profiler.h"
+
+namespace rhi
+{
+namespace cpu
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ThreadPool::ThreadPool(uint32_t threadCount /*= 0*/)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::thread::hardware_concurrency();
+    threadCount = threadCount == 0 ? 1 : threadCount;
+  }
+  for (uint32_t thread = 1; thread < threadCount; thread++)
+  {
+    m_workers.emplace_back(&ThreadPool::WorkerLoop, this, thread);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wakeCondition.notify_all();
+  for (std::thread& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Publish the loop, take part in it, then wait for the workers to finish their last iteration
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  if (m_workers.empty() || count == 1)
+  {
+    for (uint32_t index = 0; index < count; index++)
+    {
+      task(index, 0);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    m_nextIndex.store(0, std::memory_order_relaxed);
+    m_activeWorkers = static_cast<uint32_t>(m_workers.size());
+    m_generation++;
+  }
+  m_wakeCondition.notify_all();
+
+  RunIterations(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_doneCondition.wait(lock, [this]() { return m_activeWorkers == 0; });
+  m_task = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ThreadPool::RunIterations(uint32_t thread)
+{
+  for (;;)
+  {
+    uint32_t index = m_nextIndex.fetch_add(1, std::memory_order_relaxed);
+    if (index >= m_count)
+    {
+      break;
+    }
+    (*m_task)(index, thread);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Sleep until a new loop is published, run iterations until the counter is exhausted, and signal
+// the end of the participation of the worker
+void ThreadPool::WorkerLoop(uint32_t thread)
+{
+  tools::Profiler::Get().SetThreadName("Worker " + std::to_string(thread));
+  uint64_t seenGeneration = 0;
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeCondition.wait(lock,
+                           [&]() { return m_stop || m_generation != seenGeneration; });
+      if (m_stop)
+      {
+        return;
+      }
+      seenGeneration = m_generation;
+    }
+
+    RunIterations(thread);
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      last = --m_activeWorkers == 0;
+    }
+    if (last)
+    {
+      m_doneCondition.notify_one();
+    }
+  }
+}
+} // namespace cpu
+} // namespace rhi
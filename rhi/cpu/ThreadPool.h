@@ -0,0 +1,66 @@
+/*
+Fixed set of worker threads executing parallel loops. The calling thread takes
+part in the loop, so a pool of N threads runs N-1 workers. Iterations are
+handed out one at a time through an atomic counter, which balances irregular
+work such as image tiles of varying complexity.
+
+Example:
+
+ThreadPool pool(8);
+pool.ParallelFor(tileCount, [&](uint32_t tile, uint32_t thread) { ... });
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rhi
+{
+namespace cpu
+{
+
+class ThreadPool
+{
+public:
+  /// Start threadCount - 1 workers. A count of 0 uses one thread per hardware thread
+  explicit ThreadPool(uint32_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Threads taking part in the loops, including the calling thread
+  uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+  /// Call task(index, thread) for each index in [0, count), and return once all the calls are
+  /// done. thread is in [0, GetThreadCount()), 0 being the calling thread, and can be used to
+  /// index per-thread storage
+  void ParallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task);
+
+private:
+  void WorkerLoop(uint32_t thread);
+  void RunIterations(uint32_t thread);
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeCondition;
+  std::condition_variable m_doneCondition;
+
+  /// Current loop, published under the mutex with a new generation number
+  const std::function<void(uint32_t, uint32_t)>* m_task = nullptr;
+  uint32_t m_count = 0;
+  uint64_t m_generation = 0;
+  std::atomic<uint32_t> m_nextIndex{0};
+  /// Workers still running iterations of the current loop
+  uint32_t m_activeWorkers = 0;
+  bool m_stop = false;
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,84 @@
+/*
+Counters of the work done by the traversal kernels of the acceleration
+structures, to find out where the BVHs cost time: nodes visited, bounding
+boxes and triangles tested, traversal stack depth, and any-hit traversals
+ended by their first hit.
+
+The counters are only compiled in when RHI_CPU_TRAVERSAL_STATS is defined to 1
+in the preprocessor definitions of the project. Otherwise RHI_CPU_STAT expands
+to nothing and the kernels are unchanged.
+
+The kernels count into the statistics of the calling thread, which the caller
+resets and reads around the work to measure. The CPU device does so around
+each ray generation shader invocation, giving statistics per pixel, which it
+sums per tile and per frame.
+
+Example:
+
+#if RHI_CPU_TRAVERSAL_STATS
+ThreadTraversalStats() = {};
+blas.Intersect(rays, hits, count, TraversalKernel::Scalar);
+uint64_t nodes = ThreadTraversalStats().nodesVisited;
+#endif
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef RHI_CPU_TRAVERSAL_STATS
+#define RHI_CPU_TRAVERSAL_STATS 0
+#endif
+
+#if RHI_CPU_TRAVERSAL_STATS
+#define RHI_CPU_STAT(statement) statement
+#else
+#define RHI_CPU_STAT(statement)
+#endif
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct TraversalStats
+{
+  /// Rays traced against the top-level structure, or passed to the batch functions
+  uint64_t rays = 0;
+  /// Nodes popped from the traversal stacks, of either level
+  uint64_t nodesVisited = 0;
+  uint64_t boxTests = 0;
+  uint64_t triangleTests = 0;
+  /// Largest number of entries on a traversal stack
+  uint64_t maxStackDepth = 0;
+  /// Any-hit traversals stopped at their first hit
+  uint64_t shadowEarlyExits = 0;
+
+  /// Sum the counters, except the stack depth of which the maximum is kept
+  void Add(const TraversalStats& other)
+  {
+    rays += other.rays;
+    nodesVisited += other.nodesVisited;
+    boxTests += other.boxTests;
+    triangleTests += other.triangleTests;
+    maxStackDepth = other.maxStackDepth > maxStackDepth ? other.maxStackDepth : maxStackDepth;
+    shadowEarlyExits += other.shadowEarlyExits;
+  }
+
+  void UpdateStackDepth(uint64_t depth)
+  {
+    maxStackDepth = depth > maxStackDepth ? depth : maxStackDepth;
+  }
+};
+
+#if RHI_CPU_TRAVERSAL_STATS
+/// Statistics of the calling thread
+inline TraversalStats& ThreadTraversalStats()
+{
+  static thread_local TraversalStats stats;
+  return stats;
+}
+#endif
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,128 @@
+#include "VisibilityCache.h"
+
+#include <cstring>
+
+namespace rhi
+{
+namespace cpu
+{
+
+namespace
+{
+/// Entries probed before giving up on a lookup or an insertion
+const uint32_t MaxProbes = 16;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Finalizer of MurmurHash3, spreading every input bit over the whole word
+uint64_t Mix(uint64_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t Combine(uint64_t hash, uint32_t value)
+{
+  return Mix(hash ^ value);
+}
+
+uint32_t FloatBits(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+VisibilityCache::VisibilityCache(const VisibilityCacheSettings& settings /*= {}*/)
+    : m_settings(settings), m_mask((1u << settings.capacityLog2) - 1),
+      m_entries(new std::atomic<uint64_t>[static_cast<size_t>(m_mask) + 1])
+{
+  Clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void VisibilityCache::Clear()
+{
+  for (uint32_t i = 0; i <= m_mask; i++)
+  {
+    m_entries[i].store(0, std::memory_order_relaxed);
+  }
+  m_size.store(0, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The key hashes the cell coordinates and the bits of the light position. Its low bits give the
+// first entry probed
+VisibilityCache::Query VisibilityCache::Find(const glm::vec3& light,
+                                             const glm::vec3& position) const
+{
+  Query query;
+  glm::vec3 cell = glm::floor(position / m_settings.cellSize);
+  uint64_t hash = 0;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    hash = Combine(hash, static_cast<uint32_t>(static_cast<int32_t>(cell[axis])));
+  }
+  for (int axis = 0; axis < 3; axis++)
+  {
+    hash = Combine(hash, FloatBits(light[axis]));
+  }
+  query.key = hash >> 2;
+  query.found = false;
+  query.visible = false;
+  query.origin = (cell + 0.5f) * m_settings.cellSize;
+  query.margin = 0.8660254f * m_settings.cellSize;
+
+  for (uint32_t probe = 0; probe < MaxProbes; probe++)
+  {
+    uint64_t entry = m_entries[(query.key + probe) & m_mask].load(std::memory_order_relaxed);
+    if (entry == 0)
+    {
+      break;
+    }
+    if ((entry >> 2) == query.key)
+    {
+      query.found = true;
+      query.visible = (entry & 3) == 1;
+      break;
+    }
+  }
+  return query;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The visibility is stored with the key in a single word, so an entry is never seen half written.
+// A failed compare-and-swap returns the entry written by another thread, which is checked again
+void VisibilityCache::Insert(const Query& query, bool visible)
+{
+  m_insertCount.fetch_add(1, std::memory_order_relaxed);
+  uint64_t value = (query.key << 2) | (visible ? 1 : 2);
+  for (uint32_t probe = 0; probe < MaxProbes; probe++)
+  {
+    std::atomic<uint64_t>& entry = m_entries[(query.key + probe) & m_mask];
+    uint64_t current = entry.load(std::memory_order_relaxed);
+    if (current == 0 && entry.compare_exchange_strong(current, value, std::memory_order_relaxed))
+    {
+      m_size.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if ((current >> 2) == query.key)
+    {
+      return;
+    }
+  }
+}
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,99 @@
+/*
+World-space cache of the visibility of point lights, for the shadow rays of
+the CPU backend. The visibility of a static light from a point of a static
+scene does not change from frame to frame, so the hit shaders can look it up
+instead of tracing a shadow ray every frame.
+
+Space is divided in cubic cells, and each cell holds the visibility of each
+light from its center, computed by a shadow ray the first time a hit shader
+asks for it. The shadows are hence quantized to the cells, which are meant to
+be about the size of a pixel. The shadow ray starts from the center of the
+cell, so that the visibility does not depend on which point of the cell is
+shaded first, and its minimum distance is extended by half the cell diagonal
+to skip the surface the point lies on.
+
+The cells live in a hash table of fixed size, with one 64-bit word per entry
+holding a fingerprint of the cell coordinates and of the light position, and
+the visibility. The entries are inserted lock-free by a compare-and-swap from
+all the threads, probing linearly from the hash of the key: two threads
+computing the same cell at once both trace it, and store the same result.
+Another light uses other entries, so the cache needs no invalidation when the
+light moves, only when the scene changes. When the probes of an insertion are
+exhausted, the visibility is used without being stored.
+
+Example:
+
+VisibilityCache::Query query = cache->Find(light, position);
+if (!query.found)
+{
+  // Trace a shadow ray from query.origin with a minimum distance increased by query.margin
+  cache->Insert(query, visible);
+}
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+namespace rhi
+{
+namespace cpu
+{
+
+struct VisibilityCacheSettings
+{
+  /// Edge length of the cells in world units
+  float cellSize = 1.f / 256.f;
+  /// Base 2 logarithm of the number of entries of the table, 8 bytes each
+  uint32_t capacityLog2 = 21;
+};
+
+class VisibilityCache
+{
+public:
+  /// Lookup of the visibility of a light from the cell of a point
+  struct Query
+  {
+    uint64_t key;
+    bool found;
+    bool visible;
+    /// Origin of the shadow ray computing the visibility, and increase of its minimum distance
+    glm::vec3 origin;
+    float margin;
+  };
+
+  explicit VisibilityCache(const VisibilityCacheSettings& settings = {});
+
+  VisibilityCache(const VisibilityCache&) = delete;
+  VisibilityCache& operator=(const VisibilityCache&) = delete;
+
+  /// Empty the cache, after the scene changed. Not thread-safe
+  void Clear();
+
+  /// Look up the visibility of light from the cell of position. Thread-safe
+  Query Find(const glm::vec3& light, const glm::vec3& position) const;
+  /// Store the visibility of a query which was not found. Thread-safe
+  void Insert(const Query& query, bool visible);
+
+  const VisibilityCacheSettings& GetSettings() const { return m_settings; }
+  /// Number of stored cells
+  uint32_t GetSize() const { return m_size.load(std::memory_order_relaxed); }
+  uint32_t GetCapacity() const { return m_mask + 1; }
+  /// Number of Insert calls since the cache was created, hence of shadow rays traced for it
+  uint64_t GetInsertCount() const { return m_insertCount.load(std::memory_order_relaxed); }
+
+private:
+  VisibilityCacheSettings m_settings;
+  uint32_t m_mask;
+  /// Entries made of the fingerprint of the key in the high 62 bits, and of the visibility in
+  /// the low 2 bits, 0 for an empty entry, 1 for a visible light, 2 for an occluded one
+  std::unique_ptr<std::atomic<uint64_t>[]> m_entries;
+  std::atomic<uint32_t> m_size{0};
+  std::atomic<uint64_t> m_insertCount{0};
+};
+} // namespace cpu
+} // namespace rhi
@@ -0,0 +1,281 @@
+/*
+Tests of the offset allocators of the placed-resource heaps: randomized
+allocations and releases on the buddy allocator, checked against a model of
+the live blocks after every operation, and the bump allocator of the frames.
+*/
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "../nv_helpers_dx12/BuddyAllocator.h"
+#include "../nv_helpers_dx12/LinearAllocator.h"
+
+using nv_helpers_dx12::BuddyAllocator;
+using nv_helpers_dx12::LinearAllocator;
+
+namespace
+{
+
+const uint64_t Capacity = 64ull << 20;
+const uint64_t MinBlockSize = 256;
+/// Alignment of the placed buffers and textures of D3D12
+const uint64_t PlacementAlignment = 64ull << 10;
+
+/// Live allocation of the model
+struct LiveBlock
+{
+  uint64_t size;
+  /// Power-of-two block holding the allocation
+  uint64_t blockSize;
+};
+
+uint64_t NextPowerOf2(uint64_t value)
+{
+  uint64_t power = 1;
+  while (power < value)
+  {
+    power <<= 1;
+  }
+  return power;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The statistics of the allocator must match the model of the live blocks
+void CheckStatistics(const BuddyAllocator& allocator, const std::map<uint64_t, LiveBlock>& live)
+{
+  uint64_t allocatedBytes = 0;
+  uint64_t requestedBytes = 0;
+  for (const auto& block : live)
+  {
+    allocatedBytes += block.second.blockSize;
+    requestedBytes += block.second.size;
+  }
+  BuddyAllocator::Statistics stats = allocator.GetStatistics();
+  CHECK_EQUAL(stats.capacity, Capacity);
+  CHECK_EQUAL(stats.allocationCount, live.size());
+  CHECK_EQUAL(stats.allocatedBytes, allocatedBytes);
+  CHECK_EQUAL(stats.requestedBytes, requestedBytes);
+  CHECK_EQUAL(stats.InternalWaste(), allocatedBytes - requestedBytes);
+  CHECK(stats.largestFreeBlock <= Capacity - allocatedBytes);
+  CHECK(allocatedBytes == Capacity || stats.freeBlockCount > 0);
+  // The free blocks are at least as many as needed to cover the free bytes
+  CHECK(stats.freeBlockCount * stats.largestFreeBlock >= Capacity - allocatedBytes);
+  double fragmentation = stats.Fragmentation();
+  CHECK(fragmentation >= 0.0 && fragmentation <= 1.0);
+  CHECK_EQUAL(allocator.IsEmpty(), live.empty());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// An allocation must be aligned, inside the range, and overlap no live block. The blocks are
+// compared rather than the requested ranges, the rounding being owned by the allocation
+void CheckPlacement(const std::map<uint64_t, LiveBlock>& live, uint64_t offset,
+                    const LiveBlock& block, uint64_t alignment)
+{
+  CHECK_EQUAL(offset % MinBlockSize, 0u);
+  CHECK(alignment == 0 || offset % alignment == 0);
+  CHECK(offset + block.blockSize <= Capacity);
+  auto next = live.lower_bound(offset);
+  CHECK(next == live.end() || offset + block.blockSize <= next->first);
+  if (next != live.begin())
+  {
+    auto previous = std::prev(next);
+    CHECK(previous->first + previous->second.blockSize <= offset);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random mix of small constant buffers, vertex buffers and large placed resources, with random
+// releases, then the release of everything in random order
+void RunBuddySequence(uint32_t seed)
+{
+  std::mt19937 random(seed);
+  BuddyAllocator allocator(Capacity, MinBlockSize);
+  std::map<uint64_t, LiveBlock> live;
+  const uint64_t alignments[] = {0, MinBlockSize, PlacementAlignment};
+
+  for (uint32_t step = 0; step < 20000; step++)
+  {
+    bool release = !live.empty() && random() % 100 < 45;
+    if (release)
+    {
+      auto it = live.begin();
+      std::advance(it, random() % live.size());
+      allocator.Free(it->first);
+      live.erase(it);
+    }
+    else
+    {
+      uint32_t kind = random() % 10;
+      uint64_t maxSize = kind < 6 ? 4096 : kind < 9 ? (1 << 20) : (8 << 20);
+      uint64_t size = 1 + random() % maxSize;
+      uint64_t alignment = alignments[random() % 3];
+      LiveBlock block = {size, NextPowerOf2(size > alignment ? size : alignment)};
+      block.blockSize = block.blockSize > MinBlockSize ? block.blockSize : MinBlockSize;
+
+      // The allocation must succeed exactly when a free block is large enough
+      uint64_t largestFreeBlock = allocator.GetStatistics().largestFreeBlock;
+      uint64_t offset = UINT64_MAX;
+      bool allocated = allocator.Allocate(size, alignment, &offset);
+      CHECK_EQUAL(allocated, block.blockSize <= largestFreeBlock);
+      if (allocated)
+      {
+        CheckPlacement(live, offset, block, alignment);
+        live[offset] = block;
+      }
+    }
+    CheckStatistics(allocator, live);
+  }
+
+  std::vector<uint64_t> offsets;
+  for (const auto& block : live)
+  {
+    offsets.push_back(block.first);
+  }
+  std::shuffle(offsets.begin(), offsets.end(), random);
+  for (uint64_t offset : offsets)
+  {
+    allocator.Free(offset);
+    live.erase(offset);
+    CheckStatistics(allocator, live);
+  }
+
+  // Everything merged back into the initial block
+  BuddyAllocator::Statistics stats = allocator.GetStatistics();
+  CHECK_EQUAL(stats.freeBlockCount, 1u);
+  CHECK_EQUAL(stats.largestFreeBlock, Capacity);
+  CHECK_EQUAL(stats.Fragmentation(), 0.0);
+  uint64_t offset = UINT64_MAX;
+  CHECK(allocator.Allocate(Capacity, 0, &offset));
+  CHECK_EQUAL(offset, 0u);
+}
+
+void TestBuddyRandomSequences()
+{
+  for (uint32_t seed = 1; seed <= 8; seed++)
+  {
+    RunBuddySequence(seed);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestBuddySplitAndMerge()
+{
+  BuddyAllocator allocator(Capacity, MinBlockSize);
+  uint64_t first, second, third;
+  CHECK(allocator.Allocate(1, 0, &first));
+  CHECK(allocator.Allocate(MinBlockSize, 0, &second));
+  CHECK(allocator.Allocate(MinBlockSize + 1, 0, &third));
+  CHECK_EQUAL(first, 0u);
+  CHECK_EQUAL(second, MinBlockSize);
+  CHECK_EQUAL(third, 2 * MinBlockSize);
+  CHECK_EQUAL(allocator.GetStatistics().InternalWaste(),
+              (MinBlockSize - 1) + (MinBlockSize - 1));
+
+  // The first block only merges once its buddy is free as well
+  allocator.Free(first);
+  CHECK_EQUAL(allocator.GetStatistics().largestFreeBlock, Capacity / 2);
+  allocator.Free(second);
+  allocator.Free(third);
+  CHECK_EQUAL(allocator.GetStatistics().freeBlockCount, 1u);
+  CHECK(allocator.IsEmpty());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestBuddyExhaustionAndReset()
+{
+  BuddyAllocator allocator(Capacity, MinBlockSize);
+  uint64_t offset;
+  CHECK(!allocator.Allocate(Capacity + 1, 0, &offset));
+  CHECK(!allocator.Allocate(1, 2 * Capacity, &offset));
+  for (uint64_t i = 0; i < Capacity / PlacementAlignment; i++)
+  {
+    CHECK(allocator.Allocate(1, PlacementAlignment, &offset));
+    CHECK_EQUAL(offset, i * PlacementAlignment);
+  }
+  CHECK(!allocator.Allocate(1, 0, &offset));
+  CHECK_EQUAL(allocator.GetStatistics().freeBlockCount, 0u);
+  CHECK_EQUAL(allocator.GetStatistics().Fragmentation(), 0.0);
+
+  allocator.Reset();
+  CHECK(allocator.IsEmpty());
+  CHECK(allocator.Allocate(Capacity, 0, &offset));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestBuddyErrors()
+{
+  CHECK_THROWS(BuddyAllocator(Capacity + 1, MinBlockSize));
+  CHECK_THROWS(BuddyAllocator(MinBlockSize, Capacity));
+  BuddyAllocator allocator(Capacity, MinBlockSize);
+  uint64_t offset;
+  CHECK_THROWS(allocator.Allocate(16, 3, &offset));
+  CHECK_THROWS(allocator.Free(0));
+  CHECK(allocator.Allocate(16, 0, &offset));
+  allocator.Free(offset);
+  CHECK_THROWS(allocator.Free(offset));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random allocations follow each other without overlap, aligned, until the arena is full
+void TestLinearRandomSequences()
+{
+  const uint64_t arenaCapacity = 4 << 20;
+  const uint64_t alignments[] = {0, 4, MinBlockSize, PlacementAlignment};
+  LinearAllocator arena(arenaCapacity);
+  std::mt19937 random(7);
+  uint64_t peak = 0;
+  for (uint32_t frame = 0; frame < 16; frame++)
+  {
+    uint64_t end = 0;
+    for (;;)
+    {
+      uint64_t size = 1 + random() % 20000;
+      uint64_t alignment = alignments[random() % 4];
+      uint64_t offset = UINT64_MAX;
+      uint64_t start = alignment == 0 ? end : (end + alignment - 1) / alignment * alignment;
+      bool allocated = arena.Allocate(size, alignment, &offset);
+      CHECK_EQUAL(allocated, start + size <= arenaCapacity);
+      if (!allocated)
+      {
+        break;
+      }
+      CHECK_EQUAL(offset, start);
+      end = offset + size;
+      CHECK_EQUAL(arena.GetUsedBytes(), end);
+    }
+    peak = end > peak ? end : peak;
+    CHECK_EQUAL(arena.GetPeakBytes(), peak);
+    arena.Reset();
+    CHECK_EQUAL(arena.GetUsedBytes(), 0u);
+    CHECK_EQUAL(arena.GetPeakBytes(), peak);
+  }
+
+  uint64_t offset;
+  CHECK(arena.Allocate(arenaCapacity, 0, &offset));
+  CHECK(!arena.Allocate(0, PlacementAlignment * 128, &offset));
+  CHECK_THROWS(arena.Allocate(16, 12, &offset));
+}
+} // namespace
+
+int main()
+{
+  return tests::Run({{"Buddy random sequences", TestBuddyRandomSequences},
+                     {"Buddy split and merge", TestBuddySplitAndMerge},
+                     {"Buddy exhaustion and reset", TestBuddyExhaustionAndReset},
+                     {"Buddy errors", TestBuddyErrors},
+                     {"Linear random sequences", TestLinearRandomSequences}});
+}
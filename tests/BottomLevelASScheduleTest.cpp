@@ -0,0 +1,206 @@
+/*
+Tests of the batching of the BLAS builds: first-fit decreasing packing of the
+scratch sizes within the budget, on fixed cases and on random sets checked
+against the properties of the packing, and the compaction figures reported
+once the builds are done.
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "../nv_helpers_dx12/BottomLevelASSchedule.h"
+
+using nv_helpers_dx12::BottomLevelASCompaction;
+using nv_helpers_dx12::BottomLevelASSchedule;
+using nv_helpers_dx12::ComputeBottomLevelASCompaction;
+using nv_helpers_dx12::ScheduleBottomLevelASBuilds;
+
+namespace
+{
+
+const uint64_t MB = 1024 * 1024;
+/// Scratch budget of the BLAS batcher
+const uint64_t ScratchBudget = 32 * MB;
+const uint64_t Alignment = 256;
+
+uint64_t AlignUp(uint64_t v)
+{
+  return (v + Alignment - 1) / Alignment * Alignment;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Every BLAS is built once, its aligned scratch slice is disjoint from the other slices of its
+// batch, and a batch only exceeds the budget when it holds a single BLAS. The batches are filled
+// in decreasing size order, each BLAS going to the first batch it fitted in when it was placed
+void CheckSchedule(const std::vector<uint64_t>& sizes, const BottomLevelASSchedule& schedule)
+{
+  CHECK_EQUAL(schedule.scratchOffsets.size(), sizes.size());
+  std::vector<uint32_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+  std::vector<uint32_t> rank(sizes.size());
+  for (uint32_t i = 0; i < order.size(); i++)
+  {
+    rank[order[i]] = i;
+  }
+
+  std::vector<uint32_t> buildCount(sizes.size(), 0);
+  uint64_t scratchSize = 0;
+  for (size_t b = 0; b < schedule.batches.size(); b++)
+  {
+    const std::vector<uint32_t>& batch = schedule.batches[b];
+    CHECK(!batch.empty());
+    uint64_t batchSize = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      uint32_t blas = batch[i];
+      CHECK(blas < sizes.size());
+      buildCount[blas]++;
+      // Slices are packed in placement order
+      CHECK_EQUAL(schedule.scratchOffsets[blas], batchSize);
+      CHECK(i == 0 || rank[batch[i - 1]] < rank[blas]);
+      batchSize += AlignUp(sizes[blas]);
+
+      // The BLAS did not fit in any earlier batch, given what it held then
+      for (size_t earlier = 0; earlier < b; earlier++)
+      {
+        uint64_t used = 0;
+        for (uint32_t other : schedule.batches[earlier])
+        {
+          used += rank[other] < rank[blas] ? AlignUp(sizes[other]) : 0;
+        }
+        CHECK(used + AlignUp(sizes[blas]) > ScratchBudget);
+      }
+    }
+    CHECK(batchSize <= ScratchBudget || batch.size() == 1);
+    scratchSize = batchSize > scratchSize ? batchSize : scratchSize;
+  }
+  for (uint32_t count : buildCount)
+  {
+    CHECK_EQUAL(count, 1u);
+  }
+  CHECK_EQUAL(schedule.scratchSize, scratchSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestFirstFitDecreasing()
+{
+  // Placed as 20, 12 | 10, 8, 6, 4
+  std::vector<uint64_t> sizes = {6 * MB, 20 * MB, 4 * MB, 12 * MB, 10 * MB, 8 * MB};
+  BottomLevelASSchedule schedule = ScheduleBottomLevelASBuilds(sizes, ScratchBudget);
+  CheckSchedule(sizes, schedule);
+  CHECK_EQUAL(schedule.batches.size(), 2u);
+  CHECK(schedule.batches[0] == std::vector<uint32_t>({1, 3}));
+  CHECK(schedule.batches[1] == std::vector<uint32_t>({4, 5, 0, 2}));
+  const uint64_t offsets[] = {18 * MB, 0, 24 * MB, 20 * MB, 0, 10 * MB};
+  for (size_t i = 0; i < sizes.size(); i++)
+  {
+    CHECK_EQUAL(schedule.scratchOffsets[i], offsets[i]);
+  }
+  CHECK_EQUAL(schedule.scratchSize, ScratchBudget);
+
+  // A smaller build goes back to the first batch with room left
+  sizes = {24 * MB, 16 * MB, 12 * MB, 8 * MB};
+  schedule = ScheduleBottomLevelASBuilds(sizes, ScratchBudget);
+  CheckSchedule(sizes, schedule);
+  CHECK(schedule.batches[0] == std::vector<uint32_t>({0, 3}));
+  CHECK(schedule.batches[1] == std::vector<uint32_t>({1, 2}));
+  CHECK_EQUAL(schedule.scratchOffsets[3], 24 * MB);
+  CHECK_EQUAL(schedule.scratchSize, 32 * MB);
+
+  // Builds of equal size keep their order, and slices are aligned
+  sizes = {1000, 1, 1000};
+  schedule = ScheduleBottomLevelASBuilds(sizes, ScratchBudget);
+  CHECK(schedule.batches == std::vector<std::vector<uint32_t>>({{0, 2, 1}}));
+  CHECK_EQUAL(schedule.scratchOffsets[2], 1024u);
+  CHECK_EQUAL(schedule.scratchOffsets[1], 2048u);
+  CHECK_EQUAL(schedule.scratchSize, 2048u + Alignment);
+
+  schedule = ScheduleBottomLevelASBuilds({}, ScratchBudget);
+  CHECK(schedule.batches.empty());
+  CHECK_EQUAL(schedule.scratchSize, 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// A BLAS needing more scratch than the budget gets a batch of its own, which sizes the region
+void TestOversizeBuild()
+{
+  std::vector<uint64_t> sizes = {10 * MB, 40 * MB, 30 * MB, 2 * MB};
+  BottomLevelASSchedule schedule = ScheduleBottomLevelASBuilds(sizes, ScratchBudget);
+  CheckSchedule(sizes, schedule);
+  CHECK(schedule.batches == std::vector<std::vector<uint32_t>>({{1}, {2, 3}, {0}}));
+  CHECK_EQUAL(schedule.scratchOffsets[1], 0u);
+  CHECK_EQUAL(schedule.scratchOffsets[3], 30 * MB);
+  CHECK_EQUAL(schedule.scratchSize, 40 * MB);
+
+  schedule = ScheduleBottomLevelASBuilds({ScratchBudget + 1}, ScratchBudget);
+  CHECK_EQUAL(schedule.batches.size(), 1u);
+  CHECK_EQUAL(schedule.scratchSize, ScratchBudget + Alignment);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Scenes from a few large builds to many small ones, some beyond the budget
+void TestRandomSchedules()
+{
+  std::mt19937 random(5);
+  for (uint32_t iteration = 0; iteration < 200; iteration++)
+  {
+    std::vector<uint64_t> sizes(1 + random() % 200);
+    uint64_t maxSize = iteration % 2 == 0 ? 48 * MB : MB;
+    for (uint64_t& size : sizes)
+    {
+      size = 1 + random() % maxSize;
+    }
+    CheckSchedule(sizes, ScheduleBottomLevelASBuilds(sizes, ScratchBudget));
+  }
+  CHECK_THROWS(ScheduleBottomLevelASBuilds({MB}, ScratchBudget, 0));
+  CHECK_THROWS(ScheduleBottomLevelASBuilds({MB}, ScratchBudget, 384));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Figures of the compaction report: the compacted size is aligned for storage, and nothing is
+// saved when the aligned compacted size does not shrink the BLAS
+void TestCompactionReport()
+{
+  BottomLevelASCompaction compaction = ComputeBottomLevelASCompaction(MB, 300001);
+  CHECK_EQUAL(compaction.originalSize, MB);
+  CHECK_EQUAL(compaction.compactedSize, 300032u);
+  CHECK_EQUAL(compaction.SavedBytes(), MB - 300032);
+
+  compaction = ComputeBottomLevelASCompaction(1000, 1000);
+  CHECK_EQUAL(compaction.compactedSize, 1024u);
+  CHECK_EQUAL(compaction.SavedBytes(), 0u);
+
+  compaction = ComputeBottomLevelASCompaction(65536, 40000, 65536);
+  CHECK_EQUAL(compaction.compactedSize, 65536u);
+  CHECK_EQUAL(compaction.SavedBytes(), 0u);
+
+  // Total of the scene, as printed after the builds
+  const uint64_t original[] = {4 * MB, 2 * MB, 512};
+  const uint64_t reported[] = {MB + 10, 2 * MB, 100};
+  uint64_t saved = 0;
+  for (size_t i = 0; i < 3; i++)
+  {
+    saved += ComputeBottomLevelASCompaction(original[i], reported[i]).SavedBytes();
+  }
+  CHECK_EQUAL(saved, (4 * MB - (MB + 256)) + (512 - 256));
+}
+} // namespace
+
+int main()
+{
+  return tests::Run({{"First-fit decreasing", TestFirstFitDecreasing},
+                     {"Oversize build", TestOversizeBuild},
+                     {"Random schedules", TestRandomSchedules},
+                     {"Compaction report", TestCompactionReport}});
+}
@@ -0,0 +1,99 @@
+/*
+Minimal support for the unit tests, each of which is a console program run by
+CTest (see CMakeLists.txt). A failed check throws, which ends the test case
+with the condition and its location; Run then goes on with the next case, and
+returns 1 if any failed.
+
+Example:
+
+void TestWrapAround()
+{
+  CHECK(ring.Allocate(256, 256, &offset));
+  CHECK_EQUAL(offset, 0u);
+}
+
+int main()
+{
+  return tests::Run({{"Wrap around", TestWrapAround}});
+}
+
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define CHECK(condition) tests::Check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected)                                                              \
+  tests::CheckEqual((actual), (expected), #actual, __FILE__, __LINE__)
+#define CHECK_THROWS(statement)                                                                    \
+  do                                                                                               \
+  {                                                                                                \
+    bool thrown = false;                                                                           \
+    try                                                                                            \
+    {                                                                                              \
+      statement;                                                                                   \
+    }                                                                                              \
+    catch (const std::logic_error&)                                                                \
+    {                                                                                              \
+      thrown = true;                                                                               \
+    }                                                                                              \
+    tests::Check(thrown, "throws: " #statement, __FILE__, __LINE__);                               \
+  } while (false)
+
+namespace tests
+{
+
+struct TestCase
+{
+  const char* name;
+  std::function<void()> function;
+};
+
+inline void Check(bool condition, const char* text, const char* file, int line)
+{
+  if (!condition)
+  {
+    throw std::runtime_error(std::string(file) + ":" + std::to_string(line) + ": " + text);
+  }
+}
+
+template <typename Actual, typename Expected>
+void CheckEqual(const Actual& actual, const Expected& expected, const char* text,
+                const char* file, int line)
+{
+  if (!(actual == expected))
+  {
+    std::ostringstream message;
+    message << file << ":" << line << ": " << text << " is " << actual << ", expected "
+            << expected;
+    throw std::runtime_error(message.str());
+  }
+}
+
+/// Run the test cases, printing the result of each. Returns the exit code of the test program
+inline int Run(const std::vector<TestCase>& testCases)
+{
+  int failureCount = 0;
+  for (const TestCase& testCase : testCases)
+  {
+    try
+    {
+      testCase.function();
+      std::printf("[ OK ] %s\n", testCase.name);
+    }
+    catch (const std::exception& e)
+    {
+      std::printf("[FAIL] %s: %s\n", testCase.name, e.what());
+      failureCount++;
+    }
+  }
+  std::printf("%d of %zu test cases failed\n", failureCount, testCases.size());
+  return failureCount == 0 ? 0 : 1;
+}
+} // namespace tests
@@ -0,0 +1,245 @@
+/*
+Tests of the allocators of the descriptor heap: the first-fit range allocator
+of the persistent descriptors, on fixed cases and on random sequences checked
+against a map of the slots, and the per-frame slices handed out linearly and
+reset when their frame comes back.
+*/
+
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "../nv_helpers_dx12/DescriptorSlotAllocator.h"
+#include "../nv_helpers_dx12/RangeAllocator.h"
+
+using nv_helpers_dx12::DescriptorSlotAllocator;
+using nv_helpers_dx12::RangeAllocator;
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocations are taken from the lowest free range large enough, even if a later one fits better
+void TestFirstFit()
+{
+  RangeAllocator ranges(100);
+  uint64_t start = UINT64_MAX;
+  const uint64_t counts[] = {10, 20, 30, 40};
+  uint64_t expected = 0;
+  for (uint64_t count : counts)
+  {
+    CHECK(ranges.Allocate(count, &start));
+    CHECK_EQUAL(start, expected);
+    expected += count;
+  }
+  CHECK_EQUAL(ranges.GetAllocatedCount(), 100u);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 0u);
+
+  ranges.Free(10, 20);
+  ranges.Free(60, 40);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 2u);
+  CHECK(ranges.Allocate(15, &start));
+  CHECK_EQUAL(start, 10u);
+  CHECK(ranges.Allocate(30, &start));
+  CHECK_EQUAL(start, 60u);
+  CHECK(ranges.Allocate(5, &start));
+  CHECK_EQUAL(start, 25u);
+  CHECK(ranges.Allocate(10, &start));
+  CHECK_EQUAL(start, 90u);
+  CHECK_EQUAL(ranges.GetAllocatedCount(), 100u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// A freed range merges with the free ranges directly before and after it
+void TestMergeNeighbors()
+{
+  RangeAllocator ranges(64);
+  uint64_t start;
+  for (uint64_t i = 0; i < 8; i++)
+  {
+    CHECK(ranges.Allocate(8, &start));
+  }
+  ranges.Free(8, 8);
+  ranges.Free(24, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 2u);
+  // Both neighbors
+  ranges.Free(16, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 1u);
+  // Next neighbor only
+  ranges.Free(0, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 1u);
+  CHECK(!ranges.Allocate(33, &start));
+  // Previous neighbor only, then at the end of the range
+  ranges.Free(56, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 2u);
+  ranges.Free(32, 8);
+  ranges.Free(40, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 2u);
+  ranges.Free(48, 8);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 1u);
+  CHECK_EQUAL(ranges.GetAllocatedCount(), 0u);
+  CHECK(ranges.Allocate(64, &start));
+  CHECK_EQUAL(start, 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Failed allocations and invalid releases leave the allocator unchanged
+void TestExhaustion()
+{
+  RangeAllocator ranges(16);
+  uint64_t start = UINT64_MAX;
+  CHECK(!ranges.Allocate(17, &start));
+  CHECK_EQUAL(start, UINT64_MAX);
+  CHECK(ranges.Allocate(6, &start));
+  CHECK(ranges.Allocate(10, &start));
+  CHECK(!ranges.Allocate(1, &start));
+  CHECK_THROWS(ranges.Allocate(0, &start));
+
+  ranges.Free(0, 6);
+  CHECK_THROWS(ranges.Free(0, 6));
+  CHECK_THROWS(ranges.Free(4, 4));
+  CHECK_THROWS(ranges.Free(10, 7));
+  CHECK_THROWS(ranges.Free(16, 0));
+  CHECK_EQUAL(ranges.GetAllocatedCount(), 10u);
+  CHECK_EQUAL(ranges.GetFreeRangeCount(), 1u);
+  CHECK(!ranges.Allocate(7, &start));
+
+  ranges.Reset();
+  CHECK_EQUAL(ranges.GetAllocatedCount(), 0u);
+  CHECK(ranges.Allocate(16, &start));
+  CHECK_EQUAL(start, 0u);
+
+  RangeAllocator empty(0);
+  CHECK(!empty.Allocate(1, &start));
+  CHECK_EQUAL(empty.GetFreeRangeCount(), 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random allocations and releases, checked against a map of the used slots: an allocation starts
+// at the first free run long enough, and the free ranges are exactly the maximal free runs, which
+// only holds if all the neighbors were merged
+void TestRandomSequences()
+{
+  const uint64_t capacity = 512;
+  std::mt19937 random(3);
+  RangeAllocator ranges(capacity);
+  std::vector<bool> used(capacity, false);
+  std::vector<std::pair<uint64_t, uint64_t>> live;
+
+  for (uint32_t step = 0; step < 20000; step++)
+  {
+    if (!live.empty() && random() % 100 < 45)
+    {
+      size_t index = random() % live.size();
+      ranges.Free(live[index].first, live[index].second);
+      for (uint64_t i = 0; i < live[index].second; i++)
+      {
+        used[live[index].first + i] = false;
+      }
+      live[index] = live.back();
+      live.pop_back();
+    }
+    else
+    {
+      uint64_t count = 1 + random() % (random() % 4 == 0 ? 64 : 8);
+      uint64_t expected = UINT64_MAX;
+      uint64_t run = 0;
+      for (uint64_t i = 0; i < capacity && expected == UINT64_MAX; i++)
+      {
+        run = used[i] ? 0 : run + 1;
+        // Extend the run to its end, as the free ranges are maximal
+        bool runEnd = i + 1 == capacity || used[i + 1];
+        expected = runEnd && run >= count ? i + 1 - run : UINT64_MAX;
+      }
+
+      uint64_t start = UINT64_MAX;
+      CHECK_EQUAL(ranges.Allocate(count, &start), expected != UINT64_MAX);
+      CHECK_EQUAL(start, expected);
+      if (expected != UINT64_MAX)
+      {
+        for (uint64_t i = 0; i < count; i++)
+        {
+          CHECK(!used[start + i]);
+          used[start + i] = true;
+        }
+        live.push_back({start, count});
+      }
+    }
+
+    uint64_t allocated = 0;
+    uint64_t runCount = 0;
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+      allocated += used[i] ? 1 : 0;
+      runCount += !used[i] && (i == 0 || used[i - 1]) ? 1 : 0;
+    }
+    CHECK_EQUAL(ranges.GetAllocatedCount(), allocated);
+    CHECK_EQUAL(ranges.GetFreeRangeCount(), runCount);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Each frame in flight hands out the slots of its own slice after the persistent ones, linearly,
+// and starts over when BeginFrame comes back to it
+void TestPerFrameReset()
+{
+  DescriptorSlotAllocator slots(100, 3, 10);
+  CHECK_EQUAL(slots.GetSlotCount(), 130u);
+  uint64_t start = UINT64_MAX;
+
+  slots.BeginFrame(0);
+  CHECK(slots.AllocateTransient(4, &start));
+  CHECK_EQUAL(start, 100u);
+  CHECK(slots.AllocateTransient(6, &start));
+  CHECK_EQUAL(start, 104u);
+  CHECK(!slots.AllocateTransient(1, &start));
+
+  slots.BeginFrame(1);
+  CHECK(slots.AllocateTransient(5, &start));
+  CHECK_EQUAL(start, 110u);
+  slots.BeginFrame(2);
+  CHECK(slots.AllocateTransient(10, &start));
+  CHECK_EQUAL(start, 120u);
+  CHECK(!slots.AllocateTransient(1, &start));
+
+  // The slice of frame 0 is reset when the frame comes back
+  slots.BeginFrame(0);
+  CHECK(slots.AllocateTransient(10, &start));
+  CHECK_EQUAL(start, 100u);
+  CHECK_THROWS(slots.BeginFrame(3));
+
+  // Persistent ranges are not affected by the frames
+  CHECK(slots.AllocatePersistent(60, &start));
+  CHECK_EQUAL(start, 0u);
+  CHECK(slots.AllocatePersistent(40, &start));
+  CHECK_EQUAL(start, 60u);
+  CHECK(!slots.AllocatePersistent(1, &start));
+  slots.BeginFrame(1);
+  CHECK_EQUAL(slots.GetPersistentUsage(), 100u);
+  slots.FreePersistent(0, 60);
+  CHECK_EQUAL(slots.GetPersistentUsage(), 40u);
+
+  slots.Reset();
+  CHECK_EQUAL(slots.GetPersistentUsage(), 0u);
+  CHECK(slots.AllocateTransient(10, &start));
+  CHECK_EQUAL(start, 100u);
+
+  DescriptorSlotAllocator released(0, 0, 0);
+  CHECK_THROWS(released.AllocateTransient(1, &start));
+  CHECK(!released.AllocatePersistent(1, &start));
+}
+} // namespace
+
+int main()
+{
+  return tests::Run({{"First fit", TestFirstFit},
+                     {"Merge neighbors", TestMergeNeighbors},
+                     {"Exhaustion", TestExhaustion},
+                     {"Random sequences", TestRandomSequences},
+                     {"Per-frame reset", TestPerFrameReset}});
+}
@@ -0,0 +1,390 @@
+/*
+Tests of the compile step of the render graph: the barriers emitted before each
+pass and at the end of the frame, compared with the expected batches written
+as text, and the placement of the transient resources in the aliased heap.
+*/
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "../nv_helpers_dx12/RenderGraph.h"
+
+using nv_helpers_dx12::CompiledRenderGraph;
+using nv_helpers_dx12::RenderGraph;
+using nv_helpers_dx12::RenderGraphBarrier;
+using nv_helpers_dx12::RenderGraphHandle;
+using nv_helpers_dx12::ResourceState;
+using nv_helpers_dx12::ResourceUse;
+
+namespace
+{
+
+const uint64_t MB = 1024 * 1024;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Name of a state, the flags of combined read-only states being separated by '|'
+std::string StateName(ResourceState state)
+{
+  static const char* names[] = {"VertexBuffer", "IndexBuffer",   "RenderTarget",
+                                "UAV",          "DepthWrite",    "DepthRead",
+                                "NonPixelSRV",  "PixelSRV",      "CopyDest",
+                                "CopySource",   "AccelStructure"};
+  uint32_t bits = static_cast<uint32_t>(state);
+  if (bits == 0)
+  {
+    return "Common";
+  }
+  std::string name;
+  for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+  {
+    if ((bits & (1u << i)) != 0)
+    {
+      name += (name.empty() ? "" : "|") + std::string(names[i]);
+    }
+  }
+  return name;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Barrier batch as text, for instance "Output: UAV>CopySource, UAV Output, Bloom aliases Depth"
+std::string Describe(const RenderGraph& graph, const std::vector<RenderGraphBarrier>& barriers)
+{
+  std::string text;
+  for (const RenderGraphBarrier& barrier : barriers)
+  {
+    text += text.empty() ? "" : ", ";
+    const std::string& name = graph.GetResourceName(barrier.resource);
+    switch (barrier.type)
+    {
+    case RenderGraphBarrier::Type::Transition:
+      text += name + ": " + StateName(barrier.before) + ">" + StateName(barrier.after);
+      break;
+    case RenderGraphBarrier::Type::UAV:
+      text += "UAV " + name;
+      break;
+    case RenderGraphBarrier::Type::Aliasing:
+      text += name + " aliases " + graph.GetResourceName(barrier.aliasedResource);
+      break;
+    }
+  }
+  return text;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The barrier batches of each pass, then the final batch, must match the expected text
+void CheckBarriers(const RenderGraph& graph, const CompiledRenderGraph& compiled,
+                   const std::vector<std::string>& expected)
+{
+  CHECK_EQUAL(compiled.passBarriers.size() + 1, expected.size());
+  for (size_t p = 0; p < compiled.passBarriers.size(); p++)
+  {
+    CHECK_EQUAL(Describe(graph, compiled.passBarriers[p]), expected[p]);
+  }
+  CHECK_EQUAL(Describe(graph, compiled.finalBarriers), expected.back());
+
+  uint32_t counts[3] = {};
+  for (size_t p = 0; p <= compiled.passBarriers.size(); p++)
+  {
+    const std::vector<RenderGraphBarrier>& barriers =
+        p < compiled.passBarriers.size() ? compiled.passBarriers[p] : compiled.finalBarriers;
+    for (const RenderGraphBarrier& barrier : barriers)
+    {
+      counts[static_cast<int>(barrier.type)]++;
+    }
+  }
+  CHECK_EQUAL(compiled.transitionCount, counts[0]);
+  CHECK_EQUAL(compiled.uavBarrierCount, counts[1]);
+  CHECK_EQUAL(compiled.aliasingBarrierCount, counts[2]);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// A resource read by several passes in a row is transitioned once to the combination of the read
+// states, and goes back to its final state at the end of the frame
+void TestTransitionsAndMergedReads()
+{
+  RenderGraph graph;
+  RenderGraphHandle output = graph.ImportResource("Output", ResourceState::UnorderedAccess,
+                                                  ResourceState::CopySource);
+  RenderGraphHandle backBuffer =
+      graph.ImportResource("BackBuffer", ResourceState::Present, ResourceState::Present);
+  graph.AddPass("Trace", {{output, ResourceState::UnorderedAccess}}, nullptr);
+  graph.AddPass("Denoise", {{output, ResourceState::NonPixelShaderResource}}, nullptr);
+  graph.AddPass("Composite", {{output, ResourceState::PixelShaderResource}}, nullptr);
+  graph.AddPass("Copy",
+                {{output, ResourceState::CopySource}, {backBuffer, ResourceState::CopyDest}},
+                nullptr);
+  graph.AddPass("Accumulate", {{output, ResourceState::UnorderedAccess}}, nullptr);
+
+  CompiledRenderGraph compiled = graph.Compile();
+  CheckBarriers(graph, compiled,
+                {"", "Output: UAV>NonPixelSRV|PixelSRV|CopySource", "",
+                 "BackBuffer: Common>CopyDest", "Output: NonPixelSRV|PixelSRV|CopySource>UAV",
+                 "Output: UAV>CopySource, BackBuffer: CopyDest>Common"});
+  CHECK_EQUAL(compiled.heapSize, 0u);
+  CHECK_EQUAL(compiled.heapOffsets[output], UINT64_MAX);
+
+  // A read following a write in the same state needs no transition, nor a read already covered
+  // by the current combined state
+  graph.Reset();
+  RenderGraphHandle texture = graph.ImportResource("Texture", ResourceState::CopyDest,
+                                                   ResourceState::PixelShaderResource);
+  graph.AddPass("Upload", {{texture, ResourceState::CopyDest}}, nullptr);
+  graph.AddPass("Sample", {{texture, ResourceState::PixelShaderResource}}, nullptr);
+  graph.AddPass("SampleAgain", {{texture, ResourceState::PixelShaderResource}}, nullptr);
+  CheckBarriers(graph, graph.Compile(), {"", "Texture: CopyDest>PixelSRV", "", ""});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Successive accesses in the unordered access or acceleration structure states are ordered by UAV
+// barriers when either of them writes, the first use of the frame excepted
+void TestUAVBarriers()
+{
+  RenderGraph graph;
+  RenderGraphHandle buffer = graph.ImportResource("Buffer", ResourceState::UnorderedAccess,
+                                                  ResourceState::UnorderedAccess);
+  RenderGraphHandle blas = graph.ImportResource("BLAS", ResourceState::AccelerationStructure,
+                                                ResourceState::AccelerationStructure);
+  RenderGraphHandle tlas = graph.ImportResource("TLAS", ResourceState::AccelerationStructure,
+                                                ResourceState::AccelerationStructure);
+  graph.AddPass("Clear", {{buffer, ResourceState::UnorderedAccess}}, nullptr);
+  graph.AddPass("BuildBLAS", {{blas, ResourceState::AccelerationStructure, true}}, nullptr);
+  graph.AddPass("BuildTLAS",
+                {{blas, ResourceState::AccelerationStructure},
+                 {tlas, ResourceState::AccelerationStructure, true}},
+                nullptr);
+  graph.AddPass("Trace",
+                {{tlas, ResourceState::AccelerationStructure},
+                 {blas, ResourceState::AccelerationStructure},
+                 {buffer, ResourceState::UnorderedAccess}},
+                nullptr);
+  graph.AddPass("TraceAgain",
+                {{tlas, ResourceState::AccelerationStructure},
+                 {buffer, ResourceState::UnorderedAccess}},
+                nullptr);
+
+  CompiledRenderGraph compiled = graph.Compile();
+  CheckBarriers(graph, compiled,
+                {"", "", "UAV BLAS", "UAV Buffer, UAV TLAS", "UAV Buffer", ""});
+  CHECK_EQUAL(compiled.transitionCount, 0u);
+  CHECK_EQUAL(compiled.uavBarrierCount, 4u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The acceleration structure state is read-only but cannot be combined with any other state, so
+// the reads on both sides of it are not merged
+void TestAccelerationStructureNotMerged()
+{
+  RenderGraph graph;
+  RenderGraphHandle buffer =
+      graph.ImportResource("Buffer", ResourceState::Common, ResourceState::Common);
+  graph.AddPass("Read", {{buffer, ResourceState::NonPixelShaderResource}}, nullptr);
+  graph.AddPass("Copy", {{buffer, ResourceState::CopySource}}, nullptr);
+  graph.AddPass("Trace", {{buffer, ResourceState::AccelerationStructure}}, nullptr);
+  graph.AddPass("TraceAgain", {{buffer, ResourceState::AccelerationStructure}}, nullptr);
+  graph.AddPass("ReadAgain", {{buffer, ResourceState::NonPixelShaderResource}}, nullptr);
+
+  CompiledRenderGraph compiled = graph.Compile();
+  CheckBarriers(graph, compiled,
+                {"Buffer: Common>NonPixelSRV|CopySource", "",
+                 "Buffer: NonPixelSRV|CopySource>AccelStructure", "",
+                 "Buffer: AccelStructure>NonPixelSRV", "Buffer: NonPixelSRV>Common"});
+  CHECK(nv_helpers_dx12::IsReadOnlyState(ResourceState::AccelerationStructure));
+  CHECK(!nv_helpers_dx12::IsReadOnlyState(ResourceState::Common));
+  CHECK(!nv_helpers_dx12::IsReadOnlyState(ResourceState::CopySource |
+                                          ResourceState::UnorderedAccess));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Imported resources end the frame in their final state, even when no pass uses them, and
+// transient ones in the common state. Execute records the batches around the passes
+void TestFinalStates()
+{
+  RenderGraph graph;
+  RenderGraphHandle unused =
+      graph.ImportResource("Unused", ResourceState::CopyDest, ResourceState::PixelShaderResource);
+  RenderGraphHandle idle = graph.ImportResource("Idle", ResourceState::CopySource,
+                                                ResourceState::CopySource);
+  RenderGraphHandle scratch = graph.CreateTransient("Scratch", MB);
+  RenderGraphHandle output =
+      graph.ImportResource("Output", ResourceState::Present, ResourceState::Present);
+  std::string log;
+  graph.AddPass("Build", {{scratch, ResourceState::UnorderedAccess}}, [&]() { log += "Build;"; });
+  graph.AddPass("Resolve",
+                {{scratch, ResourceState::CopySource}, {output, ResourceState::CopyDest}},
+                [&]() { log += "Resolve;"; });
+
+  CompiledRenderGraph compiled = graph.Compile();
+  CheckBarriers(graph, compiled,
+                {"Scratch: Common>UAV", "Scratch: UAV>CopySource, Output: Common>CopyDest",
+                 "Unused: CopyDest>PixelSRV, Scratch: CopySource>Common, Output: CopyDest>Common"});
+  CHECK_EQUAL(compiled.heapOffsets[unused], UINT64_MAX);
+  CHECK_EQUAL(compiled.heapOffsets[idle], UINT64_MAX);
+
+  graph.Execute(compiled, [&](const std::vector<RenderGraphBarrier>& barriers) {
+    log += "Barriers(" + std::to_string(barriers.size()) + ");";
+  });
+  CHECK_EQUAL(log, std::string("Barriers(1);Build;Barriers(2);Resolve;Barriers(3);"));
+
+  graph.AddPass("Extra", {}, nullptr);
+  CHECK_THROWS(graph.Execute(compiled, [](const std::vector<RenderGraphBarrier>&) {}));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Transient resources whose lifetimes are disjoint share memory, with an aliasing barrier naming
+// the resource which last used it. Overlapping lifetimes get disjoint memory
+void TestTransientPlacement()
+{
+  RenderGraph graph;
+  RenderGraphHandle a = graph.CreateTransient("A", 4 * MB);
+  RenderGraphHandle b = graph.CreateTransient("B", 2 * MB);
+  RenderGraphHandle c = graph.CreateTransient("C", 4 * MB);
+  RenderGraphHandle d = graph.CreateTransient("D", MB);
+  RenderGraphHandle unused = graph.CreateTransient("Unused", 8 * MB);
+  const ResourceState uav = ResourceState::UnorderedAccess;
+  const ResourceState srv = ResourceState::NonPixelShaderResource;
+  graph.AddPass("P0", {{a, uav}}, nullptr);
+  graph.AddPass("P1", {{a, srv}, {b, uav}}, nullptr);
+  graph.AddPass("P2", {{b, srv}, {c, uav}}, nullptr);
+  graph.AddPass("P3", {{c, srv}, {d, uav}}, nullptr);
+
+  CompiledRenderGraph compiled = graph.Compile();
+  // C takes over the memory of A, D the memory of B
+  CHECK_EQUAL(compiled.heapOffsets[a], 0u);
+  CHECK_EQUAL(compiled.heapOffsets[c], 0u);
+  CHECK_EQUAL(compiled.heapOffsets[b], 4 * MB);
+  CHECK_EQUAL(compiled.heapOffsets[d], 4 * MB);
+  CHECK_EQUAL(compiled.heapOffsets[unused], UINT64_MAX);
+  CHECK_EQUAL(compiled.heapSize, 6 * MB);
+  CHECK_EQUAL(compiled.unaliasedSize, 11 * MB);
+  CheckBarriers(graph, compiled,
+                {"A: Common>UAV", "A: UAV>NonPixelSRV, B: Common>UAV",
+                 "C aliases A, B: UAV>NonPixelSRV, C: Common>UAV",
+                 "D aliases B, C: UAV>NonPixelSRV, D: Common>UAV",
+                 "A: NonPixelSRV>Common, B: NonPixelSRV>Common, C: NonPixelSRV>Common, "
+                 "D: UAV>Common"});
+
+  // All alive in the same pass: no sharing, each offset aligned
+  graph.Reset();
+  RenderGraphHandle small = graph.CreateTransient("Small", 1000);
+  RenderGraphHandle large = graph.CreateTransient("Large", 100000);
+  RenderGraphHandle packed = graph.CreateTransient("Packed", 1000, 256);
+  graph.AddPass("All", {{small, uav}, {large, uav}, {packed, uav}}, nullptr);
+  compiled = graph.Compile();
+  CHECK_EQUAL(compiled.heapOffsets[large], 0u);
+  CHECK_EQUAL(compiled.heapOffsets[small], 131072u);
+  CHECK_EQUAL(compiled.heapOffsets[packed], 100096u);
+  CHECK_EQUAL(compiled.heapSize, 131072u + 1000u);
+  CHECK_EQUAL(compiled.aliasingBarrierCount, 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random frames: resources alive in the same pass never share memory, offsets are aligned, and
+// every resource reusing memory gets exactly one aliasing barrier, in its first pass
+void TestRandomPlacement()
+{
+  std::mt19937 random(11);
+  for (uint32_t iteration = 0; iteration < 100; iteration++)
+  {
+    RenderGraph graph;
+    const uint32_t passCount = 2 + random() % 30;
+    const uint32_t resourceCount = 1 + random() % 40;
+    std::vector<uint32_t> firstUse(resourceCount);
+    std::vector<uint32_t> lastUse(resourceCount);
+    for (uint32_t r = 0; r < resourceCount; r++)
+    {
+      uint64_t alignment = random() % 2 == 0 ? 65536 : 256;
+      graph.CreateTransient("R" + std::to_string(r), 1 + random() % (4 * MB), alignment);
+      firstUse[r] = random() % passCount;
+      lastUse[r] = firstUse[r] + random() % (passCount - firstUse[r]);
+    }
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+      std::vector<ResourceUse> uses;
+      for (uint32_t r = 0; r < resourceCount; r++)
+      {
+        if (p == firstUse[r] || p == lastUse[r] || (p > firstUse[r] && p < lastUse[r] &&
+                                                    random() % 2 == 0))
+        {
+          uses.push_back({r, random() % 2 == 0 ? ResourceState::UnorderedAccess
+                                               : ResourceState::PixelShaderResource});
+        }
+      }
+      graph.AddPass("P" + std::to_string(p), uses, nullptr);
+    }
+
+    CompiledRenderGraph compiled = graph.Compile();
+    std::vector<uint32_t> aliasingBarriers(resourceCount, 0);
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+      for (const RenderGraphBarrier& barrier : compiled.passBarriers[p])
+      {
+        if (barrier.type == RenderGraphBarrier::Type::Aliasing)
+        {
+          CHECK_EQUAL(p, firstUse[barrier.resource]);
+          CHECK(lastUse[barrier.aliasedResource] < p);
+          aliasingBarriers[barrier.resource]++;
+        }
+      }
+    }
+
+    uint64_t unaliasedSize = 0;
+    for (uint32_t r = 0; r < resourceCount; r++)
+    {
+      uint64_t begin = compiled.heapOffsets[r];
+      uint64_t end = begin + graph.GetTransientSize(r);
+      CHECK(end <= compiled.heapSize);
+      unaliasedSize += graph.GetTransientSize(r);
+      bool reusesMemory = false;
+      for (uint32_t other = 0; other < resourceCount; other++)
+      {
+        uint64_t otherBegin = compiled.heapOffsets[other];
+        uint64_t otherEnd = otherBegin + graph.GetTransientSize(other);
+        bool overlappingMemory = other != r && otherBegin < end && begin < otherEnd;
+        bool overlappingLifetimes = firstUse[r] <= lastUse[other] && firstUse[other] <= lastUse[r];
+        CHECK(!overlappingMemory || !overlappingLifetimes);
+        reusesMemory |= overlappingMemory && lastUse[other] < firstUse[r];
+      }
+      CHECK_EQUAL(aliasingBarriers[r], reusesMemory ? 1u : 0u);
+    }
+    CHECK_EQUAL(compiled.unaliasedSize, unaliasedSize);
+    CHECK(compiled.heapSize <= unaliasedSize + 65536 * resourceCount);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestErrors()
+{
+  RenderGraph graph;
+  RenderGraphHandle output =
+      graph.ImportResource("Output", ResourceState::Common, ResourceState::Common);
+  CHECK_THROWS(graph.CreateTransient("Empty", 0));
+  CHECK_THROWS(graph.AddPass("Unknown", {{output + 1, ResourceState::CopySource}}, nullptr));
+  CHECK_THROWS(graph.AddPass(
+      "Twice", {{output, ResourceState::CopySource}, {output, ResourceState::CopyDest}}, nullptr));
+  CHECK_EQUAL(graph.GetPassCount(), 0u);
+}
+} // namespace
+
+int main()
+{
+  return tests::Run({{"Transitions and merged reads", TestTransitionsAndMergedReads},
+                     {"UAV barriers", TestUAVBarriers},
+                     {"Acceleration structure not merged", TestAccelerationStructureNotMerged},
+                     {"Final states", TestFinalStates},
+                     {"Transient placement", TestTransientPlacement},
+                     {"Random placement", TestRandomPlacement},
+                     {"Errors", TestErrors}});
+}
@@ -0,0 +1,373 @@
+/*
+Tests of the staging uploader and of its ring allocator. The copies are issued
+on a fake queue recording the submissions and the fence waits, which executes
+the copies of a submission only once its fence value is reached, so that
+staging memory reused too early shows up as corrupted destination data.
+
+The D3D12 declarations come from the stand-in headers of tests/d3d12.
+*/
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "Check.h"
+#include "../nv_helpers_dx12/RingAllocator.h"
+#include "../nv_helpers_dx12/StagingUploader.h"
+
+using nv_helpers_dx12::BufferAllocation;
+using nv_helpers_dx12::CopyQueue;
+using nv_helpers_dx12::RingAllocator;
+using nv_helpers_dx12::StagingUploader;
+
+namespace
+{
+
+/// Buffer of the fake device, with its contents
+struct FakeBuffer
+{
+  ID3D12Resource resource;
+  std::vector<uint8_t> data;
+
+  explicit FakeBuffer(size_t size) : data(size) {}
+};
+
+/// Copy queue recording the submissions. The GPU only progresses when the
+/// test completes a fence value, or when the uploader waits on one
+class FakeCopyQueue : public CopyQueue
+{
+public:
+  struct Copy
+  {
+    ID3D12Resource* dest;
+    UINT64 destOffset;
+    ID3D12Resource* source;
+    UINT64 sourceOffset;
+    UINT64 size;
+  };
+
+  struct Submission
+  {
+    std::vector<Copy> copies;
+    UINT64 fenceValue;
+  };
+
+  void AddBuffer(FakeBuffer& buffer) { m_buffers[&buffer.resource] = &buffer; }
+
+  void CopyBufferRegion(ID3D12Resource* dest, UINT64 destOffset, ID3D12Resource* source,
+                        UINT64 sourceOffset, UINT64 size) override
+  {
+    m_recording.push_back({dest, destOffset, source, sourceOffset, size});
+  }
+
+  UINT64 Submit() override
+  {
+    if (m_recording.empty())
+    {
+      return m_fenceValue;
+    }
+    submissions.push_back({m_recording, ++m_fenceValue});
+    m_recording.clear();
+    return m_fenceValue;
+  }
+
+  UINT64 GetCompletedValue() override { return m_completedValue; }
+
+  void WaitForValue(UINT64 fenceValue) override
+  {
+    waits.push_back(fenceValue);
+    Complete(fenceValue);
+  }
+
+  /// Execute the copies of the submissions up to fenceValue
+  void Complete(UINT64 fenceValue)
+  {
+    CHECK(fenceValue <= m_fenceValue);
+    for (const Submission& submission : submissions)
+    {
+      if (submission.fenceValue <= m_completedValue || submission.fenceValue > fenceValue)
+      {
+        continue;
+      }
+      for (const Copy& copy : submission.copies)
+      {
+        std::vector<uint8_t>& dest = m_buffers.at(copy.dest)->data;
+        const std::vector<uint8_t>& source = m_buffers.at(copy.source)->data;
+        CHECK(copy.destOffset + copy.size <= dest.size());
+        CHECK(copy.sourceOffset + copy.size <= source.size());
+        std::memcpy(dest.data() + copy.destOffset, source.data() + copy.sourceOffset, copy.size);
+      }
+    }
+    m_completedValue = fenceValue > m_completedValue ? fenceValue : m_completedValue;
+  }
+
+  std::vector<Submission> submissions;
+  /// Fence values waited on by the uploader, in order
+  std::vector<UINT64> waits;
+
+private:
+  std::map<ID3D12Resource*, FakeBuffer*> m_buffers;
+  std::vector<Copy> m_recording;
+  UINT64 m_fenceValue = 0;
+  UINT64 m_completedValue = 0;
+};
+
+/// Upload heap holding the staging ring at a non-zero offset, as suballocated by the
+/// GpuMemoryAllocator
+const UINT64 RingOffset = 65536;
+
+BufferAllocation MakeRing(FakeBuffer& upload, UINT64 size)
+{
+  BufferAllocation ring;
+  ring.resource = &upload.resource;
+  ring.offset = RingOffset;
+  ring.size = size;
+  ring.cpuAddress = upload.data.data() + RingOffset;
+  return ring;
+}
+
+/// Data of a recognizable pattern, different for each seed
+std::vector<uint8_t> MakeData(size_t size, uint32_t seed)
+{
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++)
+  {
+    data[i] = static_cast<uint8_t>(i * 31 + seed * 97 + (i >> 8));
+  }
+  return data;
+}
+
+bool Contains(const FakeBuffer& buffer, UINT64 offset, const std::vector<uint8_t>& data)
+{
+  return offset + data.size() <= buffer.data.size() &&
+         std::memcmp(buffer.data.data() + offset, data.data(), data.size()) == 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocations past the end of the ring restart at its start once the oldest batch retires, the
+// skipped end of the ring being counted as used until the batch holding it retires
+void TestRingWrapAround()
+{
+  RingAllocator ring(1024);
+  uint64_t offset = UINT64_MAX;
+  CHECK(ring.Allocate(400, 0, &offset));
+  CHECK_EQUAL(offset, 0u);
+  CHECK(ring.Allocate(400, 0, &offset));
+  CHECK_EQUAL(offset, 400u);
+  ring.CloseBatch(1);
+  CHECK(ring.Allocate(100, 0, &offset));
+  CHECK_EQUAL(offset, 800u);
+  ring.CloseBatch(2);
+  CHECK(!ring.Allocate(300, 0, &offset));
+  CHECK_EQUAL(ring.GetOldestFenceValue(), 1u);
+
+  ring.Retire(1);
+  CHECK_EQUAL(ring.GetUsedBytes(), 100u);
+  CHECK(ring.Allocate(300, 0, &offset));
+  CHECK_EQUAL(offset, 0u);
+  CHECK_EQUAL(ring.GetUsedBytes(), 100u + 124u + 300u);
+
+  // Wrapped: the free space lies between the head and the tail
+  CHECK(!ring.Allocate(600, 0, &offset));
+  CHECK(ring.Allocate(500, 0, &offset));
+  CHECK_EQUAL(offset, 300u);
+  CHECK(!ring.Allocate(1, 0, &offset));
+  ring.CloseBatch(3);
+
+  ring.Retire(2);
+  CHECK_EQUAL(ring.GetUsedBytes(), 124u + 300u + 500u);
+  CHECK(ring.Allocate(64, 64, &offset));
+  CHECK_EQUAL(offset, 832u);
+  ring.CloseBatch(4);
+  ring.Retire(4);
+  CHECK(!ring.HasPendingBatches());
+  CHECK_EQUAL(ring.GetUsedBytes(), 0u);
+
+  // Everything retired, the ring restarts from the beginning
+  CHECK(ring.Allocate(1024, 0, &offset));
+  CHECK_EQUAL(offset, 0u);
+  CHECK(!ring.Allocate(1025, 0, &offset));
+  CHECK_THROWS(ring.Allocate(16, 24, &offset));
+  CHECK_THROWS(RingAllocator(16).GetOldestFenceValue());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Uploads to contiguous ranges of a destination become a single copy, and all the copies of a
+// flush a single submission
+void TestCoalescedUploads()
+{
+  FakeCopyQueue queue;
+  FakeBuffer upload(RingOffset + 65536);
+  FakeBuffer vertices(4096);
+  FakeBuffer indices(4096);
+  queue.AddBuffer(upload);
+  queue.AddBuffer(vertices);
+  queue.AddBuffer(indices);
+  StagingUploader uploader;
+  uploader.Init(&queue, MakeRing(upload, 65536));
+
+  std::vector<uint8_t> data[4] = {MakeData(256, 0), MakeData(512, 1), MakeData(256, 2),
+                                  MakeData(100, 3)};
+  uploader.Upload(&vertices.resource, 0, data[0].data(), data[0].size());
+  uploader.Upload(&vertices.resource, 256, data[1].data(), data[1].size());
+  uploader.Upload(&vertices.resource, 768, data[2].data(), data[2].size());
+  uploader.Upload(&indices.resource, 1000, data[3].data(), data[3].size());
+  CHECK(queue.submissions.empty());
+
+  UINT64 fenceValue = uploader.Flush();
+  CHECK_EQUAL(fenceValue, 1u);
+  CHECK_EQUAL(queue.submissions.size(), 1u);
+  const std::vector<FakeCopyQueue::Copy>& copies = queue.submissions[0].copies;
+  CHECK_EQUAL(copies.size(), 2u);
+  CHECK(copies[0].dest == &vertices.resource && copies[0].source == &upload.resource);
+  CHECK_EQUAL(copies[0].destOffset, 0u);
+  CHECK_EQUAL(copies[0].sourceOffset, RingOffset);
+  CHECK_EQUAL(copies[0].size, 1024u);
+  CHECK(copies[1].dest == &indices.resource);
+  CHECK_EQUAL(copies[1].destOffset, 1000u);
+  CHECK_EQUAL(copies[1].sourceOffset, RingOffset + 1024);
+  CHECK_EQUAL(copies[1].size, 100u);
+
+  // Nothing pending: no submission, and the fence value of the last one
+  CHECK_EQUAL(uploader.Flush(), 1u);
+  CHECK_EQUAL(queue.submissions.size(), 1u);
+
+  // The copies only land once the queue gets there
+  CHECK(!Contains(vertices, 0, data[0]));
+  uploader.WaitIdle();
+  CHECK(Contains(vertices, 0, data[0]));
+  CHECK(Contains(vertices, 256, data[1]));
+  CHECK(Contains(vertices, 768, data[2]));
+  CHECK(Contains(indices, 1000, data[3]));
+  CHECK(queue.waits == std::vector<UINT64>({1}));
+
+  const StagingUploader::Statistics& stats = uploader.GetStatistics();
+  CHECK_EQUAL(stats.uploadCount, 4u);
+  CHECK_EQUAL(stats.uploadedBytes, 256u + 512u + 256u + 100u);
+  CHECK_EQUAL(stats.copyCount, 2u);
+  CHECK_EQUAL(stats.submissionCount, 1u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// With the ring full the uploader submits its pending copies, then waits for the oldest
+// submission, and only for it. Space retired by the queue on its own is reused without waiting
+void TestWaitWhenRingFull()
+{
+  const UINT64 ringSize = 4096;
+  FakeCopyQueue queue;
+  FakeBuffer upload(RingOffset + ringSize);
+  FakeBuffer dest(16384);
+  queue.AddBuffer(upload);
+  queue.AddBuffer(dest);
+  StagingUploader uploader;
+  uploader.Init(&queue, MakeRing(upload, ringSize));
+
+  std::vector<std::vector<uint8_t>> data;
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    data.push_back(MakeData(2048, i));
+  }
+
+  uploader.Upload(&dest.resource, 0, data[0].data(), 2048);
+  CHECK_EQUAL(uploader.Flush(), 1u);
+  uploader.Upload(&dest.resource, 2048, data[1].data(), 2048);
+  CHECK_EQUAL(uploader.Flush(), 2u);
+  CHECK(queue.waits.empty());
+
+  // The ring is full and nothing is pending: wait for the first submission
+  uploader.Upload(&dest.resource, 4096, data[2].data(), 2048);
+  CHECK(queue.waits == std::vector<UINT64>({1}));
+  CHECK_EQUAL(queue.submissions.size(), 2u);
+
+  // The ring is full again: the pending copy is submitted before waiting
+  uploader.Upload(&dest.resource, 6144, data[3].data(), 2048);
+  CHECK(queue.waits == std::vector<UINT64>({1, 2}));
+  CHECK_EQUAL(queue.submissions.size(), 3u);
+  CHECK_EQUAL(queue.submissions[2].copies.size(), 1u);
+  CHECK_EQUAL(queue.submissions[2].copies[0].destOffset, 4096u);
+  CHECK_EQUAL(queue.submissions[2].copies[0].sourceOffset, RingOffset);
+
+  // The queue completed the third submission by itself, the next upload goes without waiting
+  CHECK_EQUAL(uploader.Flush(), 4u);
+  queue.Complete(3);
+  uploader.Upload(&dest.resource, 8192, data[4].data(), 2048);
+  CHECK_EQUAL(queue.waits.size(), 2u);
+  CHECK_EQUAL(queue.submissions.size(), 4u);
+
+  uploader.Upload(&dest.resource, 10240, data[5].data(), 2048);
+  uploader.WaitIdle();
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    CHECK(Contains(dest, 2048 * i, data[i]));
+  }
+  CHECK_EQUAL(queue.waits.back(), queue.submissions.back().fenceValue);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// An upload larger than the ring is split in chunks of half the ring. Chunks following each other
+// in the ring merge into one copy, until the ring is full and the copy is submitted
+void TestOversizeUpload()
+{
+  const UINT64 ringSize = 4096;
+  FakeCopyQueue queue;
+  FakeBuffer upload(RingOffset + ringSize);
+  FakeBuffer dest(16384);
+  queue.AddBuffer(upload);
+  queue.AddBuffer(dest);
+  StagingUploader uploader;
+  uploader.Init(&queue, MakeRing(upload, ringSize));
+
+  std::vector<uint8_t> data = MakeData(10240, 7);
+  uploader.Upload(&dest.resource, 1024, data.data(), data.size());
+  CHECK_EQUAL(queue.submissions.size(), 2u);
+  CHECK(queue.waits == std::vector<UINT64>({1, 2}));
+  uploader.WaitIdle();
+
+  CHECK_EQUAL(queue.submissions.size(), 3u);
+  const UINT64 destOffsets[] = {1024, 5120, 9216};
+  const UINT64 sizes[] = {4096, 4096, 2048};
+  for (size_t i = 0; i < 3; i++)
+  {
+    CHECK_EQUAL(queue.submissions[i].copies.size(), 1u);
+    const FakeCopyQueue::Copy& copy = queue.submissions[i].copies[0];
+    CHECK_EQUAL(copy.destOffset, destOffsets[i]);
+    CHECK_EQUAL(copy.sourceOffset, RingOffset);
+    CHECK_EQUAL(copy.size, sizes[i]);
+  }
+  CHECK(Contains(dest, 1024, data));
+
+  const StagingUploader::Statistics& stats = uploader.GetStatistics();
+  CHECK_EQUAL(stats.uploadCount, 1u);
+  CHECK_EQUAL(stats.uploadedBytes, 10240u);
+  CHECK_EQUAL(stats.copyCount, 3u);
+  CHECK_EQUAL(stats.submissionCount, 3u);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void TestUploaderErrors()
+{
+  FakeCopyQueue queue;
+  FakeBuffer upload(RingOffset + 4096);
+  uint8_t data[16] = {};
+  StagingUploader uploader;
+  CHECK_THROWS(uploader.Upload(&upload.resource, 0, data, sizeof(data)));
+  BufferAllocation unmapped = MakeRing(upload, 4096);
+  unmapped.cpuAddress = nullptr;
+  CHECK_THROWS(uploader.Init(&queue, unmapped));
+}
+} // namespace
+
+int main()
+{
+  return tests::Run({{"Ring wrap around", TestRingWrapAround},
+                     {"Coalesced uploads", TestCoalescedUploads},
+                     {"Wait when the ring is full", TestWaitWhenRingFull},
+                     {"Oversize upload", TestOversizeUpload},
+                     {"Uploader errors", TestUploaderErrors}});
+}
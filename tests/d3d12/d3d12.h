@@ -0,0 +1,25 @@
+/*
+Stand-in for the few Direct3D 12 declarations used by the headers of the
+device-agnostic helpers of nv_helpers_dx12, so that their tests build without
+the Windows SDK. The interfaces are empty: the tests only compare and pass
+their addresses around, and never call into a device.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+typedef uint32_t UINT;
+typedef uint64_t UINT64;
+typedef void* HANDLE;
+typedef uint64_t D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct ID3D12Device
+{
+};
+struct ID3D12Heap
+{
+};
+struct ID3D12Resource
+{
+};
@@ -0,0 +1,25 @@
+/*
+Stand-in for the COM smart pointer of the Windows SDK, see ../d3d12.h. It only
+holds the pointer, without reference counting.
+*/
+
+#pragma once
+
+namespace Microsoft
+{
+namespace WRL
+{
+
+template <typename T>
+class ComPtr
+{
+public:
+  T* Get() const { return m_pointer; }
+  void Reset() { m_pointer = nullptr; }
+  explicit operator bool() const { return m_pointer != nullptr; }
+
+private:
+  T* m_pointer = nullptr;
+};
+} // namespace WRL
+} // namespace Microsoft
@@ -0,0 +1,225 @@
+/*
+Benchmark of the offset allocators of the placed-resource heaps (see
+nv_helpers_dx12/BuddyAllocator.h and LinearAllocator.h), which only manage
+offsets and hence run without a device.
+
+Usage:
+
+AllocatorBenchmark [options]
+  -operations <n>           Allocations and releases of the buddy allocator, 10000000 by default
+  -capacity <MB>            Size of the heap, 256 by default
+  -live <n>                 Allocations kept live by the buddy allocator, 4096 by default
+  -seed <n>                 Seed of the pseudo-random sizes, 1 by default
+
+The buddy allocator keeps a fixed number of live allocations: each operation
+releases a random one and allocates a new one, with the size and alignment
+mix of a scene upload (mostly small constant and vertex buffers aligned on
+256 bytes, some placed resources aligned on 64 KB). The time per operation
+and the fragmentation of the heap at the end are printed. The linear
+allocator fills a frame arena of the same capacity with small aligned
+allocations, and is reset at each frame.
+
+Example:
+
+AllocatorBenchmark -operations 1000000 -live 16384
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../nv_helpers_dx12/BuddyAllocator.h"
+#include "../nv_helpers_dx12/LinearAllocator.h"
+
+namespace
+{
+
+struct Options
+{
+  uint32_t operationCount = 10000000;
+  uint32_t capacityMB = 256;
+  uint32_t liveCount = 4096;
+  uint32_t seed = 1;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t ParseUnsigned(const char* option, const std::string& value, uint32_t minimum)
+{
+  char* end = nullptr;
+  unsigned long result = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || result < minimum ||
+      result > UINT32_MAX)
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return static_cast<uint32_t>(result);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Value of the option at index, which is advanced past it
+const char* NextValue(int argc, char** argv, int& index)
+{
+  if (index + 1 >= argc)
+  {
+    throw std::logic_error(std::string("Missing value for ") + argv[index]);
+  }
+  return argv[++index];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The capacity must be a power of two, as required by the buddy allocator
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* option = argv[i];
+    if (std::strcmp(option, "-operations") == 0)
+    {
+      options.operationCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-capacity") == 0)
+    {
+      options.capacityMB = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-live") == 0)
+    {
+      options.liveCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-seed") == 0)
+    {
+      options.seed = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else
+    {
+      throw std::logic_error(std::string("Unknown option ") + option);
+    }
+  }
+  return options;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// Size and alignment of a random allocation of a scene upload
+struct Request
+{
+  uint64_t size;
+  uint64_t alignment;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// The requests are drawn before timing, so that only the allocator is measured
+std::vector<Request> MakeRequests(uint32_t count, uint32_t seed)
+{
+  std::mt19937 random(seed);
+  std::vector<Request> requests(count);
+  for (Request& request : requests)
+  {
+    uint32_t kind = random() % 16;
+    request.size = 1 + random() % (kind < 12 ? 4096 : kind < 15 ? (256 << 10) : (4 << 20));
+    request.alignment = kind < 15 ? 256 : (64 << 10);
+  }
+  return requests;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Each operation replaces a random live allocation by a new one. A failed allocation leaves its
+// slot empty until it is drawn again
+void BenchmarkBuddy(const Options& options)
+{
+  uint64_t capacity = static_cast<uint64_t>(options.capacityMB) << 20;
+  nv_helpers_dx12::BuddyAllocator allocator(capacity, 256);
+  std::vector<Request> requests = MakeRequests(options.operationCount, options.seed);
+  std::vector<uint32_t> slots(options.operationCount);
+  std::mt19937 random(options.seed + 1);
+  for (uint32_t& slot : slots)
+  {
+    slot = random() % options.liveCount;
+  }
+
+  std::vector<uint64_t> live(options.liveCount, UINT64_MAX);
+  uint32_t failureCount = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < options.operationCount; i++)
+  {
+    uint64_t& offset = live[slots[i]];
+    if (offset != UINT64_MAX)
+    {
+      allocator.Free(offset);
+    }
+    if (!allocator.Allocate(requests[i].size, requests[i].alignment, &offset))
+    {
+      offset = UINT64_MAX;
+      failureCount++;
+    }
+  }
+  double milliseconds = Milliseconds(start);
+
+  nv_helpers_dx12::BuddyAllocator::Statistics stats = allocator.GetStatistics();
+  std::printf("Buddy: %u operations in %.1f ms, %.1f ns per release and allocation, %u failed\n",
+              options.operationCount, milliseconds, 1e6 * milliseconds / options.operationCount,
+              failureCount);
+  std::printf("Buddy heap: %.1f%% used, %.1f%% lost to rounding, %llu free blocks, "
+              "fragmentation %.3f\n",
+              100.0 * stats.allocatedBytes / stats.capacity,
+              100.0 * stats.InternalWaste() / stats.capacity,
+              static_cast<unsigned long long>(stats.freeBlockCount), stats.Fragmentation());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void BenchmarkLinear(const Options& options)
+{
+  uint64_t capacity = static_cast<uint64_t>(options.capacityMB) << 20;
+  nv_helpers_dx12::LinearAllocator arena(capacity);
+  std::vector<Request> requests = MakeRequests(options.operationCount, options.seed);
+  uint32_t frameCount = 1;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < options.operationCount; i++)
+  {
+    uint64_t offset;
+    if (!arena.Allocate(requests[i].size, 256, &offset))
+    {
+      arena.Reset();
+      frameCount++;
+    }
+  }
+  double milliseconds = Milliseconds(start);
+  std::printf("Linear: %u allocations over %u frames in %.1f ms, %.2f ns per allocation\n",
+              options.operationCount, frameCount, milliseconds,
+              1e6 * milliseconds / options.operationCount);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    Options options = ParseOptions(argc, argv);
+    BenchmarkBuddy(options);
+    BenchmarkLinear(options);
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "AllocatorBenchmark: %s\n", e.what());
+    return 1;
+  }
+}
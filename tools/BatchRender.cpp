@@ -0,0 +1,754 @@
+/*
+Headless batch renderer: renders the sample scene along a camera path with the
+CPU backend, and writes every frame to a numbered PPM file. No window nor GPU
+is needed, so offline renders can run on any machine.
+
+Usage:
+
+BatchRender [options]
+  -width <n>, -height <n>   Image resolution, 1280x720 by default
+  -spp <n>                  Samples per pixel, 1 by default
+  -threads <n>              Rendering threads, 0 (default) using all the hardware threads
+  -menger <level>           Recursion level of the Menger sponge, 3 by default
+  -probability <p>          Subdivision probability of the sponge, 0.75 by default
+  -mesh <file>              OBJ or PLY mesh replacing the sponge, see MeshImporter.h
+  -scene <file>             Scene description replacing the sponge and the plane, see
+                            SceneDescription.h
+  -instances <n>            Stress scene of n scattered sponge instances replacing the sponge
+                            and the plane, see SampleScene.h. The average times of the stages
+                            of the top-level structure build are printed at the end
+  -cache <file>             Scene cache, see SceneCache.h, loaded if it matches the meshes of
+                            the scene, and created otherwise
+  -bake <n>                 Bake the ambient occlusion, with n rays per vertex side, and the
+                            direct light of the static meshes into their vertex colors, see
+                            LightBaker.h, printing the duration of the bake
+  -bakedistance <d>         Length of the ambient occlusion rays of the bake, 0.5 by default
+  -path <file>              Camera path, see CameraPath.h. Defaults to the camera of the sample
+  -input <file>             Input log recorded by the sample, see InputLog.h, replacing the path
+  -frames <n>               Frames spread evenly over the path, one per keyframe by default. With
+                            an input log, number of recorded frames to render, all by default
+  -output <prefix>          Prefix of the image files, frame by default
+  -raster                   Rasterize instead of raytracing
+  -hybrid                   Raytrace with the primary visibility rasterized to a G-buffer, only
+                            the shadow rays being traced
+  -reproject                Reuse the pixels of the previous frames while only the camera moves,
+                            see ReprojectionCache.h, printing the share of the pixels traced
+                            for each frame and on average. Requires raytracing with 1 spp
+  -shadowcache              Cache the visibility of the light in world space, see
+                            VisibilityCache.h, printing the shadow rays traced for each frame
+  -light <shape>            Replace the point light of the sample by a light of the same position
+                            and shape point, sphere or rectangle, see Lights.h, with batched
+                            shadow rays, printing their number for each frame
+  -shadowsamples <n>        Shadow rays per shaded point of the sphere and rectangle lights, 16
+                            by default
+  -lights <n>               Replace the point light of the sample by n small scattered spheres,
+                            see SampleScene.h, printing the batched shadow rays of each frame
+  -lightsamples <k>         Sample k lights per shaded point from the light hierarchy, see
+                            LightBvh.h, rather than all the lights
+  -ao <n>                   Render the ambient occlusion of the primary hits with n
+                            cosine-weighted rays per pixel, traced in sorted batches, printing
+                            the throughput of the primary and of the occlusion rays for each
+                            frame and on average
+  -aodistance <d>           Length of the ambient occlusion rays, 0.5 by default
+  -aocell <size>            Edge of the origin cells sorting the ambient occlusion rays, 0.25 by
+                            default, 0 tracing them in the order of their pixels
+  -pathtrace <bounces>      Path trace the frames with up to the given number of bounces, see
+                            PathTracer.h, printing the path segments of each frame and the
+                            throughput of all the rays on average
+  -roulette <n>             Bounces after which Russian roulette may end the paths, 3 by
+                            default
+  -denoise <preset>         Denoise the frames, see Denoiser.h, with the preset fast, balanced
+                            or quality, printing the time of the denoiser for each frame and on
+                            average. Requires 1 spp
+  -heatmap <counter>        Also write a heatmap of a traversal counter per pixel, among nodes,
+                            boxes, triangles and stack, to <prefix>_heat files, and print the
+                            summary table of the counters of each frame. Requires a build with
+                            RHI_CPU_TRAVERSAL_STATS=1
+  -trace <file>             Write a Chrome trace of the frames, see Profiler.h, with the camera
+                            update, render and tile zones of every thread and the frame times
+
+With several samples per pixel, each sample is rendered with the projection
+offset by a subpixel amount following the Halton (2, 3) sequence, and the
+samples are averaged. An input log is replayed through the manipulator one
+recorded frame after the other, from the initial camera of the sample, so the
+frames match the ones of the recorded session. The frame loop is pipelined:
+the camera of each frame is set up through the manipulator while the previous
+frames are still being written by a background thread. With several samples
+per pixel, the traversal statistics are the ones of the last sample.
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CameraPath.h"
+#include "ImageWriter.h"
+#include "InputLog.h"
+#include "Profiler.h"
+#include "TraversalHeatmap.h"
+#include "../Manipulator.h"
+#include "../rhi/CpuRenderDevice.h"
+#include "../rhi/SampleScene.h"
+
+namespace
+{
+
+struct Options
+{
+  uint32_t width = 1280;
+  uint32_t height = 720;
+  uint32_t samplesPerPixel = 1;
+  uint32_t threadCount = 0;
+  rhi::SceneParameters scene;
+  std::string cameraPath;
+  std::string inputLog;
+  uint32_t frameCount = 0;
+  std::string outputPrefix = "frame";
+  rhi::RenderMode mode = rhi::RenderMode::RayTraced;
+  bool reproject = false;
+  bool shadowCache = false;
+  bool light = false;
+  rhi::LightShape lightShape = rhi::LightShape::Point;
+  uint32_t shadowSamples = 16;
+  uint32_t lightsPerPoint = 0;
+  bool ambientOcclusion = false;
+  rhi::cpu::AmbientOcclusionSettings ambientOcclusionSettings;
+  bool pathTracing = false;
+  rhi::cpu::PathTracingSettings pathTracingSettings;
+  bool denoise = false;
+  rhi::cpu::DenoisePreset denoisePreset = rhi::cpu::DenoisePreset::Balanced;
+  bool heatmap = false;
+  tools::StatsCounter heatmapCounter = tools::StatsCounter::NodesVisited;
+  std::string traceFile;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t ParseUnsigned(const char* option, const char* value, uint32_t minimum)
+{
+  char* end = nullptr;
+  unsigned long result = std::strtoul(value, &end, 10);
+  if (*value == '-' || *end != '\0' || result < minimum || result > UINT32_MAX)
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return static_cast<uint32_t>(result);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+float ParseFloat(const char* option, const char* value, float minimum)
+{
+  char* end = nullptr;
+  float result = std::strtof(value, &end);
+  if (end == value || *end != '\0' || !(result >= minimum))
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+rhi::LightShape ParseLightShape(const char* value)
+{
+  if (std::strcmp(value, "point") == 0)
+  {
+    return rhi::LightShape::Point;
+  }
+  if (std::strcmp(value, "sphere") == 0)
+  {
+    return rhi::LightShape::Sphere;
+  }
+  if (std::strcmp(value, "rectangle") == 0)
+  {
+    return rhi::LightShape::Rectangle;
+  }
+  throw std::logic_error(std::string("Invalid light shape ") + value);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Light at the position of the point light of the sample shaders
+rhi::LightDesc MakeLight(rhi::LightShape shape, uint32_t sampleCount)
+{
+  rhi::LightDesc light;
+  light.shape = shape;
+  light.position = glm::vec3(2.f, 2.f, -2.f);
+  light.radius = 0.3f;
+  light.edge1 = glm::vec3(0.6f, 0.f, 0.f);
+  light.edge2 = glm::vec3(0.f, 0.f, 0.6f);
+  light.sampleCount = sampleCount;
+  return light;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+rhi::cpu::DenoisePreset ParseDenoisePreset(const char* value)
+{
+  if (std::strcmp(value, "fast") == 0)
+  {
+    return rhi::cpu::DenoisePreset::Fast;
+  }
+  if (std::strcmp(value, "balanced") == 0)
+  {
+    return rhi::cpu::DenoisePreset::Balanced;
+  }
+  if (std::strcmp(value, "quality") == 0)
+  {
+    return rhi::cpu::DenoisePreset::Quality;
+  }
+  throw std::logic_error(std::string("Invalid denoiser preset ") + value);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Value of the option at index, which is advanced past it
+const char* NextValue(int argc, char** argv, int& index)
+{
+  if (index + 1 >= argc)
+  {
+    throw std::logic_error(std::string("Missing value for ") + argv[index]);
+  }
+  return argv[++index];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* option = argv[i];
+    if (std::strcmp(option, "-raster") == 0)
+    {
+      options.mode = rhi::RenderMode::Raster;
+      continue;
+    }
+    if (std::strcmp(option, "-hybrid") == 0)
+    {
+      options.mode = rhi::RenderMode::Hybrid;
+      continue;
+    }
+    if (std::strcmp(option, "-reproject") == 0)
+    {
+      options.reproject = true;
+      continue;
+    }
+    if (std::strcmp(option, "-shadowcache") == 0)
+    {
+      options.shadowCache = true;
+      continue;
+    }
+    if (std::strcmp(option, "-width") == 0)
+    {
+      options.width = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-height") == 0)
+    {
+      options.height = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-spp") == 0)
+    {
+      options.samplesPerPixel = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-threads") == 0)
+    {
+      options.threadCount = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else if (std::strcmp(option, "-menger") == 0)
+    {
+      options.scene.mengerLevel =
+          static_cast<int32_t>(ParseUnsigned(option, NextValue(argc, argv, i), 0));
+    }
+    else if (std::strcmp(option, "-probability") == 0)
+    {
+      options.scene.mengerProbability = static_cast<float>(std::atof(NextValue(argc, argv, i)));
+    }
+    else if (std::strcmp(option, "-mesh") == 0)
+    {
+      options.scene.meshFile = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-scene") == 0)
+    {
+      options.scene.sceneFile = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-instances") == 0)
+    {
+      options.scene.stressInstanceCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-cache") == 0)
+    {
+      options.scene.cacheFile = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-bake") == 0)
+    {
+      options.scene.bakeLighting = true;
+      options.scene.bakeSettings.occlusionSamples =
+          ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-bakedistance") == 0)
+    {
+      options.scene.bakeSettings.occlusionDistance =
+          ParseFloat(option, NextValue(argc, argv, i), 0.f);
+    }
+    else if (std::strcmp(option, "-path") == 0)
+    {
+      options.cameraPath = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-input") == 0)
+    {
+      options.inputLog = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-frames") == 0)
+    {
+      options.frameCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-output") == 0)
+    {
+      options.outputPrefix = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-light") == 0)
+    {
+      options.light = true;
+      options.lightShape = ParseLightShape(NextValue(argc, argv, i));
+    }
+    else if (std::strcmp(option, "-shadowsamples") == 0)
+    {
+      options.shadowSamples = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-lights") == 0)
+    {
+      options.scene.stressLightCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-lightsamples") == 0)
+    {
+      options.lightsPerPoint = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-ao") == 0)
+    {
+      options.ambientOcclusion = true;
+      options.ambientOcclusionSettings.sampleCount =
+          ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-aodistance") == 0)
+    {
+      options.ambientOcclusionSettings.maxDistance =
+          ParseFloat(option, NextValue(argc, argv, i), 0.f);
+    }
+    else if (std::strcmp(option, "-aocell") == 0)
+    {
+      options.ambientOcclusionSettings.sortCellSize =
+          ParseFloat(option, NextValue(argc, argv, i), 0.f);
+    }
+    else if (std::strcmp(option, "-pathtrace") == 0)
+    {
+      options.pathTracing = true;
+      options.pathTracingSettings.maxBounces = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else if (std::strcmp(option, "-roulette") == 0)
+    {
+      options.pathTracingSettings.rouletteStart =
+          ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else if (std::strcmp(option, "-denoise") == 0)
+    {
+      options.denoise = true;
+      options.denoisePreset = ParseDenoisePreset(NextValue(argc, argv, i));
+    }
+    else if (std::strcmp(option, "-heatmap") == 0)
+    {
+      options.heatmap = true;
+      options.heatmapCounter = tools::ParseStatsCounter(NextValue(argc, argv, i));
+    }
+    else if (std::strcmp(option, "-trace") == 0)
+    {
+      options.traceFile = NextValue(argc, argv, i);
+    }
+    else
+    {
+      throw std::logic_error(std::string("Unknown option ") + option);
+    }
+  }
+
+  if (options.heatmap && options.mode == rhi::RenderMode::Raster)
+  {
+    throw std::logic_error("Traversal heatmaps require raytracing");
+  }
+  // The samples of a pixel would reuse each other
+  if (options.reproject &&
+      (options.mode != rhi::RenderMode::RayTraced || options.samplesPerPixel != 1))
+  {
+    throw std::logic_error("Reprojection requires raytracing with 1 sample per pixel");
+  }
+  // The jittered samples of a pixel would be taken as successive frames
+  if (options.denoise && options.samplesPerPixel != 1)
+  {
+    throw std::logic_error("Denoising requires 1 sample per pixel");
+  }
+  if (options.heatmap && !RHI_CPU_TRAVERSAL_STATS)
+  {
+    throw std::logic_error("Traversal heatmaps require a build with RHI_CPU_TRAVERSAL_STATS=1");
+  }
+  return options;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+float Halton(uint32_t index, uint32_t base)
+{
+  float result = 0.f;
+  float fraction = 1.f / base;
+  for (; index > 0; index /= base)
+  {
+    result += fraction * (index % base);
+    fraction /= base;
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Render the samples of a frame and average them. A single sample goes through the pixel centers,
+// as in the interactive sample
+void RenderFrame(rhi::RenderDevice& device, const rhi::SampleScene& scene,
+                 const rhi::Camera& camera, const Options& options, rhi::Image& sample,
+                 std::vector<uint32_t>& accumulation, rhi::Image& output)
+{
+  if (options.samplesPerPixel == 1)
+  {
+    scene.Render(device, camera, options.mode, &output);
+    return;
+  }
+
+  accumulation.assign(4 * static_cast<size_t>(options.width) * options.height, 0);
+  for (uint32_t s = 0; s < options.samplesPerPixel; s++)
+  {
+    // Offset in pixels, converted to clip space where y points up
+    float offsetX = Halton(s + 1, 2) - 0.5f;
+    float offsetY = Halton(s + 1, 3) - 0.5f;
+    rhi::Camera jittered = camera;
+    jittered.projection =
+        glm::translate(glm::mat4(1.f), glm::vec3(2.f * offsetX / options.width,
+                                                 -2.f * offsetY / options.height, 0.f)) *
+        camera.projection;
+    scene.Render(device, jittered, options.mode, &sample);
+    for (size_t i = 0; i < accumulation.size(); i++)
+    {
+      accumulation[i] += sample.pixels[i];
+    }
+  }
+
+  output.width = options.width;
+  output.height = options.height;
+  output.pixels.resize(accumulation.size());
+  uint32_t half = options.samplesPerPixel / 2;
+  for (size_t i = 0; i < accumulation.size(); i++)
+  {
+    output.pixels[i] = static_cast<uint8_t>((accumulation[i] + half) / options.samplesPerPixel);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+double MegaRaysPerSecond(uint64_t rays, double milliseconds)
+{
+  return milliseconds > 0.0 ? static_cast<double>(rays) / (1000.0 * milliseconds) : 0.0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+int Run(const Options& options)
+{
+  tools::CameraPath path;
+  if (options.cameraPath.empty())
+  {
+    path.AddKeyframe({0.f, glm::vec3(1.5f, 1.5f, 1.5f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)});
+  }
+  else
+  {
+    path.Load(options.cameraPath);
+  }
+  uint32_t frameCount =
+      options.frameCount != 0 ? options.frameCount : static_cast<uint32_t>(path.GetKeyframeCount());
+
+  tools::InputLog inputLog;
+  if (!options.inputLog.empty())
+  {
+    std::ifstream file(options.inputLog, std::ios::binary);
+    if (!file)
+    {
+      throw std::logic_error("Cannot open input log " + options.inputLog);
+    }
+    inputLog.Load(file);
+    frameCount = options.frameCount != 0 && options.frameCount < inputLog.GetFrameCount()
+                     ? options.frameCount
+                     : inputLog.GetFrameCount();
+  }
+  tools::InputPlayer player(inputLog, false);
+
+  rhi::CpuRenderDevice device(options.width, options.height, options.threadCount);
+  device.SetReprojection(options.reproject);
+  device.SetVisibilityCache(options.shadowCache);
+  if (options.light)
+  {
+    device.SetLights({MakeLight(options.lightShape, options.shadowSamples)});
+  }
+  device.SetLightSampling(options.lightsPerPoint);
+  device.SetAmbientOcclusion(options.ambientOcclusion, options.ambientOcclusionSettings);
+  device.SetPathTracing(options.pathTracing, options.pathTracingSettings);
+  rhi::cpu::DenoiseSettings denoiseSettings;
+  denoiseSettings.preset = options.denoisePreset;
+  device.SetDenoiser(options.denoise, denoiseSettings);
+  rhi::SampleScene scene;
+  auto createStart = std::chrono::steady_clock::now();
+  scene.Create(device, options.scene);
+  double createTime = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - createStart)
+                          .count();
+  std::printf("Scene %s in %.1f ms\n", scene.IsFromCache() ? "loaded from the cache" : "created",
+              createTime);
+  const tools::LightBakeStats& bake = scene.GetBakeStats();
+  if (bake.vertexCount != 0)
+  {
+    std::printf("Lighting of %u vertices baked in %.1f ms, %.2f Mrays/s\n", bake.vertexCount,
+                bake.milliseconds, MegaRaysPerSecond(bake.rayCount, bake.milliseconds));
+  }
+  std::printf("Rendering %u frames of %ux%u, %u spp, %u threads, %u triangles in %u meshes, "
+              "%u instances\n",
+              frameCount, options.width, options.height, options.samplesPerPixel,
+              device.GetThreadCount(), scene.GetTriangleCount(), scene.GetMeshCount(),
+              scene.GetInstanceCount());
+
+  nv_helpers_dx12::CameraManip.setWindowSize(static_cast<int>(options.width),
+                                             static_cast<int>(options.height));
+  nv_helpers_dx12::CameraManip.setLookat(glm::vec3(1.5f, 1.5f, 1.5f), glm::vec3(0.f),
+                                         glm::vec3(0.f, 1.f, 0.f));
+  float aspectRatio = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+  tools::Profiler& profiler = tools::Profiler::Get();
+  if (!options.traceFile.empty())
+  {
+    profiler.SetThreadName("Main");
+    profiler.Start();
+  }
+
+  tools::ImageWriter writer(2);
+  rhi::CpuRenderDevice::TopLevelTimings topLevelTotals;
+  rhi::cpu::ReprojectionStats reprojectionTotals;
+  rhi::cpu::DenoiseTimings denoiseTotals;
+  rhi::CpuRenderDevice::RayThroughput throughputTotals;
+  uint64_t pathSegmentTotal = 0;
+  rhi::Image sample;
+  std::vector<uint32_t> accumulation;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < frameCount; frame++)
+  {
+    profiler.MarkFrame(frame);
+    rhi::Camera camera;
+    {
+      tools::ProfileZone zone("Camera update");
+      if (!options.inputLog.empty())
+      {
+        player.NextFrame(nv_helpers_dx12::CameraManip);
+      }
+      else
+      {
+        float time = path.GetStartTime();
+        if (frameCount > 1)
+        {
+          time += (path.GetEndTime() - path.GetStartTime()) * frame / (frameCount - 1);
+        }
+        glm::vec3 eye, center, up;
+        path.Evaluate(time, eye, center, up);
+        nv_helpers_dx12::CameraManip.setLookat(eye, center, up);
+      }
+      camera =
+          rhi::SampleScene::MakeCamera(nv_helpers_dx12::CameraManip.getMatrix(), aspectRatio);
+    }
+
+    auto frameStart = std::chrono::steady_clock::now();
+    rhi::Image image;
+    {
+      tools::ProfileZone zone("Render");
+      RenderFrame(device, scene, camera, options, sample, accumulation, image);
+    }
+    double frameTime = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - frameStart)
+                           .count();
+    profiler.RecordCounter("Frame ms", frameTime);
+    const rhi::CpuRenderDevice::TopLevelTimings& topLevel = device.GetTopLevelTimings();
+    topLevelTotals.fillMs += topLevel.fillMs;
+    topLevelTotals.transformMs += topLevel.transformMs;
+    topLevelTotals.bvhMs += topLevel.bvhMs;
+
+    std::string fileName = tools::MakeFrameFileName(options.outputPrefix, frame);
+    char details[192] = "";
+    if (options.reproject)
+    {
+      const rhi::cpu::ReprojectionStats& reprojection = device.GetReprojectionStats();
+      reprojectionTotals.traced += reprojection.traced;
+      reprojectionTotals.reused += reprojection.reused;
+      reprojectionTotals.missed += reprojection.missed;
+      double pixelCount = static_cast<double>(options.width) * options.height;
+      std::snprintf(details, sizeof(details), ", %.1f%% of the pixels traced",
+                    100.0 * reprojection.traced / pixelCount);
+    }
+    if (options.shadowCache)
+    {
+      rhi::CpuRenderDevice::VisibilityCacheStats visibility = device.GetVisibilityCacheStats();
+      size_t length = std::strlen(details);
+      std::snprintf(details + length, sizeof(details) - length,
+                    ", %llu shadow rays traced, %u cells cached",
+                    static_cast<unsigned long long>(visibility.shadowRays), visibility.cells);
+    }
+    if (options.light || options.scene.stressLightCount != 0)
+    {
+      size_t length = std::strlen(details);
+      std::snprintf(details + length, sizeof(details) - length, ", %llu batched shadow rays",
+                    static_cast<unsigned long long>(device.GetShadowBatchRayCount()));
+    }
+    if (options.ambientOcclusion || options.pathTracing)
+    {
+      rhi::CpuRenderDevice::RayThroughput throughput = device.GetRayThroughput();
+      throughputTotals.primaryRays += throughput.primaryRays;
+      throughputTotals.primaryMs += throughput.primaryMs;
+      throughputTotals.batchedRays += throughput.batchedRays;
+      throughputTotals.batchedMs += throughput.batchedMs;
+    }
+    if (options.pathTracing)
+    {
+      uint64_t segmentCount = device.GetPathSegmentCount();
+      pathSegmentTotal += segmentCount;
+      size_t length = std::strlen(details);
+      std::snprintf(details + length, sizeof(details) - length, ", %llu path segments",
+                    static_cast<unsigned long long>(segmentCount));
+    }
+    else if (options.ambientOcclusion)
+    {
+      rhi::CpuRenderDevice::RayThroughput throughput = device.GetRayThroughput();
+      size_t length = std::strlen(details);
+      std::snprintf(details + length, sizeof(details) - length,
+                    ", primary %.2f Mrays/s, occlusion %.2f Mrays/s",
+                    MegaRaysPerSecond(throughput.primaryRays, throughput.primaryMs),
+                    MegaRaysPerSecond(throughput.batchedRays, throughput.batchedMs));
+    }
+    if (options.denoise)
+    {
+      const rhi::cpu::DenoiseTimings& denoise = device.GetDenoiseTimings();
+      denoiseTotals.temporalMs += denoise.temporalMs;
+      denoiseTotals.filterMs += denoise.filterMs;
+      size_t length = std::strlen(details);
+      std::snprintf(details + length, sizeof(details) - length,
+                    ", denoised in %.1f ms (temporal %.1f ms, filter %.1f ms)",
+                    denoise.temporalMs + denoise.filterMs, denoise.temporalMs, denoise.filterMs);
+    }
+    std::printf("%s: %.1f ms%s\n", fileName.c_str(), frameTime, details);
+    writer.Write(fileName, std::move(image));
+
+    if (options.heatmap)
+    {
+      writer.Write(tools::MakeFrameFileName(options.outputPrefix + "_heat", frame),
+                   tools::MakeHeatmap(device.GetPixelStats(), options.width, options.height,
+                                      options.heatmapCounter));
+      tools::WriteStatsSummary(std::cout, device.GetFrameStats(), device.GetTileStats(),
+                               device.GetPixelStats());
+    }
+    profiler.Collect();
+  }
+  writer.Finish();
+
+  if (!options.traceFile.empty())
+  {
+    profiler.Stop();
+    std::ofstream file(options.traceFile);
+    if (!file)
+    {
+      throw std::logic_error("Cannot create trace file " + options.traceFile);
+    }
+    profiler.WriteChromeTrace(file);
+    std::printf("Trace written to %s, %llu events dropped\n", options.traceFile.c_str(),
+                static_cast<unsigned long long>(profiler.GetDroppedEventCount()));
+  }
+
+  double totalTime =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("%u frames in %.2f s, %.2f frames per second\n", frameCount, totalTime,
+              totalTime > 0.0 ? frameCount / totalTime : 0.0);
+  if (options.scene.stressInstanceCount != 0 && options.mode != rhi::RenderMode::Raster &&
+      frameCount != 0)
+  {
+    // With several samples per pixel, the times are the ones of the last sample of each frame
+    std::printf("TLAS build of %u instances: fill %.2f ms, transforms %.2f ms, BVH %.2f ms\n",
+                scene.GetInstanceCount(), topLevelTotals.fillMs / frameCount,
+                topLevelTotals.transformMs / frameCount, topLevelTotals.bvhMs / frameCount);
+  }
+  if (options.reproject && frameCount != 0)
+  {
+    double pixelCount = static_cast<double>(options.width) * options.height * frameCount;
+    std::printf("Reprojection: %.1f%% of the pixels traced, %.1f%% reused, %.1f%% shaded as "
+                "background\n",
+                100.0 * reprojectionTotals.traced / pixelCount,
+                100.0 * reprojectionTotals.reused / pixelCount,
+                100.0 * reprojectionTotals.missed / pixelCount);
+  }
+  if (options.pathTracing && frameCount != 0)
+  {
+    // The segments are traced along with the primary rays, so all the rays share the time
+    uint64_t rayCount =
+        throughputTotals.primaryRays + pathSegmentTotal + throughputTotals.batchedRays;
+    double rayMs = throughputTotals.primaryMs + throughputTotals.batchedMs;
+    std::printf("Path tracing: %.2f path segments per primary ray, %.2f Mrays/s in %.2f ms\n",
+                throughputTotals.primaryRays != 0
+                    ? static_cast<double>(pathSegmentTotal) / throughputTotals.primaryRays
+                    : 0.0,
+                MegaRaysPerSecond(rayCount, rayMs), rayMs / frameCount);
+  }
+  else if (options.ambientOcclusion && frameCount != 0)
+  {
+    // With several samples per pixel, the rays are the ones of the last sample of each frame
+    std::printf("Ambient occlusion: primary rays %.2f Mrays/s in %.2f ms, occlusion rays %.2f "
+                "Mrays/s in %.2f ms\n",
+                MegaRaysPerSecond(throughputTotals.primaryRays, throughputTotals.primaryMs),
+                throughputTotals.primaryMs / frameCount,
+                MegaRaysPerSecond(throughputTotals.batchedRays, throughputTotals.batchedMs),
+                throughputTotals.batchedMs / frameCount);
+  }
+  if (options.denoise && frameCount != 0)
+  {
+    std::printf("Denoiser: temporal accumulation %.2f ms, filter %.2f ms\n",
+                denoiseTotals.temporalMs / frameCount, denoiseTotals.filterMs / frameCount);
+  }
+  return 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    return Run(ParseOptions(argc, argv));
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "BatchRender: %s\n", e.what());
+    return 1;
+  }
+}
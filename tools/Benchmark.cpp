@@ -0,0 +1,755 @@
+/*
+Raytracing benchmark of the CPU backend: traces the primary and shadow rays of
+the sample scene with every combination of sponge level, resolution, thread
+count, BVH builder and traversal kernel, and reports the build time, memory
+and ray throughput of each, with frame time percentiles.
+
+Usage:
+
+Benchmark [options]
+  -levels <list>            Menger sponge levels, 0,1,2,3,4,5,6 by default
+  -probability <p>          Subdivision probability of the sponge, 0.75 by default
+  -maxtriangles <n>         Skip the levels expected to exceed n triangles, 20000000 by default
+  -resolutions <list>       Image resolutions, 1280x720 by default
+  -threads <list>           Thread counts, 0 (default) using all the hardware threads
+  -builders <list>          BVH builders among sah and median, both by default
+  -kernels <list>           Traversal kernels among scalar, simd and packet, all by default
+  -frames <n>               Frames per configuration, 16 by default
+  -output <prefix>          Prefix of the result files, benchmark by default
+  -baseline <file>          Results of a previous run, as written to <prefix>.csv
+  -tolerance <fraction>     Relative slowdown reported as a regression, 0.1 by default
+
+Lists are comma-separated. The scene is the sponge and the plane of the
+sample in a single bottom-level structure, traced directly without shaders so
+that only the traversal is measured. Each frame orbits the camera around the
+sponge; the image is traced in 16x16 pixel tiles spread over the threads, the
+rays of a tile being ordered by 2x2 pixel quads so that the packet kernel gets
+coherent rays. Every primary hit then traces a shadow ray towards the light.
+
+The results are written to <prefix>.json and <prefix>.csv. With a baseline,
+each configuration found in it is compared: lower ray throughputs, or higher
+build and frame times, by more than the tolerance are reported as regressions,
+and the exit code is 2 if there is any. A baseline lacking some of the result
+columns is rejected, and the exit code is 3 if none of the configurations
+measured is in the baseline, as nothing was compared. Hit counts are also
+reported, so that the kernels can be checked to agree.
+
+Example:
+
+Benchmark -levels 2,3,4 -kernels scalar,packet -output before
+Benchmark -levels 2,3,4 -kernels scalar,packet -output after -baseline before.csv
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../rhi/SampleScene.h"
+#include "../rhi/cpu/AccelerationStructure.h"
+#include "../rhi/cpu/ThreadPool.h"
+
+namespace
+{
+
+const uint32_t TileSize = 16;
+
+struct Resolution
+{
+  uint32_t width;
+  uint32_t height;
+};
+
+struct Options
+{
+  std::vector<uint32_t> levels = {0, 1, 2, 3, 4, 5, 6};
+  float probability = 0.75f;
+  double maxTriangles = 20000000.0;
+  std::vector<Resolution> resolutions = {{1280, 720}};
+  std::vector<uint32_t> threadCounts = {0};
+  std::vector<rhi::cpu::BvhBuilder> builders = {rhi::cpu::BvhBuilder::BinnedSah,
+                                                rhi::cpu::BvhBuilder::Median};
+  std::vector<rhi::cpu::TraversalKernel> kernels = {rhi::cpu::TraversalKernel::Scalar,
+                                                    rhi::cpu::TraversalKernel::Simd,
+                                                    rhi::cpu::TraversalKernel::Packet};
+  uint32_t frameCount = 16;
+  std::string outputPrefix = "benchmark";
+  std::string baseline;
+  double tolerance = 0.1;
+};
+
+/// Measurements of one configuration
+struct Result
+{
+  uint32_t level;
+  uint32_t triangleCount;
+  uint32_t width;
+  uint32_t height;
+  uint32_t threadCount;
+  std::string builder;
+  std::string kernel;
+  double buildMs;
+  double wideBuildMs;
+  uint64_t memoryBytes;
+  double primaryRaysPerSecond;
+  double shadowRaysPerSecond;
+  double frameMsP50;
+  double frameMsP90;
+  double frameMsP99;
+  uint64_t primaryHits;
+  uint64_t shadowOccluded;
+  std::vector<std::string> regressions;
+};
+
+const char* BuilderName(rhi::cpu::BvhBuilder builder)
+{
+  return builder == rhi::cpu::BvhBuilder::BinnedSah ? "sah" : "median";
+}
+
+const char* KernelName(rhi::cpu::TraversalKernel kernel)
+{
+  switch (kernel)
+  {
+  case rhi::cpu::TraversalKernel::Scalar:
+    return "scalar";
+  case rhi::cpu::TraversalKernel::Simd:
+    return "simd";
+  default:
+    return "packet";
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t ParseUnsigned(const char* option, const std::string& value, uint32_t minimum)
+{
+  char* end = nullptr;
+  unsigned long result = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || result < minimum ||
+      result > UINT32_MAX)
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return static_cast<uint32_t>(result);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+double ParseDouble(const char* option, const std::string& value)
+{
+  char* end = nullptr;
+  double result = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end != '\0' || result < 0.0)
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::vector<std::string> SplitList(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+  return items;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Value of the option at index, which is advanced past it
+const char* NextValue(int argc, char** argv, int& index)
+{
+  if (index + 1 >= argc)
+  {
+    throw std::logic_error(std::string("Missing value for ") + argv[index]);
+  }
+  return argv[++index];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* option = argv[i];
+    if (std::strcmp(option, "-levels") == 0)
+    {
+      options.levels.clear();
+      for (const std::string& item : SplitList(NextValue(argc, argv, i)))
+      {
+        options.levels.push_back(ParseUnsigned(option, item, 0));
+      }
+    }
+    else if (std::strcmp(option, "-probability") == 0)
+    {
+      options.probability = static_cast<float>(ParseDouble(option, NextValue(argc, argv, i)));
+    }
+    else if (std::strcmp(option, "-maxtriangles") == 0)
+    {
+      options.maxTriangles = ParseDouble(option, NextValue(argc, argv, i));
+    }
+    else if (std::strcmp(option, "-resolutions") == 0)
+    {
+      options.resolutions.clear();
+      for (const std::string& item : SplitList(NextValue(argc, argv, i)))
+      {
+        size_t separator = item.find('x');
+        if (separator == std::string::npos)
+        {
+          throw std::logic_error(std::string("Invalid value for ") + option + ": " + item);
+        }
+        options.resolutions.push_back({ParseUnsigned(option, item.substr(0, separator), 1),
+                                       ParseUnsigned(option, item.substr(separator + 1), 1)});
+      }
+    }
+    else if (std::strcmp(option, "-threads") == 0)
+    {
+      options.threadCounts.clear();
+      for (const std::string& item : SplitList(NextValue(argc, argv, i)))
+      {
+        options.threadCounts.push_back(ParseUnsigned(option, item, 0));
+      }
+    }
+    else if (std::strcmp(option, "-builders") == 0)
+    {
+      options.builders.clear();
+      for (const std::string& item : SplitList(NextValue(argc, argv, i)))
+      {
+        if (item != "sah" && item != "median")
+        {
+          throw std::logic_error(std::string("Invalid value for ") + option + ": " + item);
+        }
+        options.builders.push_back(item == "sah" ? rhi::cpu::BvhBuilder::BinnedSah
+                                                 : rhi::cpu::BvhBuilder::Median);
+      }
+    }
+    else if (std::strcmp(option, "-kernels") == 0)
+    {
+      options.kernels.clear();
+      for (const std::string& item : SplitList(NextValue(argc, argv, i)))
+      {
+        if (item == "scalar")
+        {
+          options.kernels.push_back(rhi::cpu::TraversalKernel::Scalar);
+        }
+        else if (item == "simd")
+        {
+          options.kernels.push_back(rhi::cpu::TraversalKernel::Simd);
+        }
+        else if (item == "packet")
+        {
+          options.kernels.push_back(rhi::cpu::TraversalKernel::Packet);
+        }
+        else
+        {
+          throw std::logic_error(std::string("Invalid value for ") + option + ": " + item);
+        }
+      }
+    }
+    else if (std::strcmp(option, "-frames") == 0)
+    {
+      options.frameCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-output") == 0)
+    {
+      options.outputPrefix = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-baseline") == 0)
+    {
+      options.baseline = NextValue(argc, argv, i);
+    }
+    else if (std::strcmp(option, "-tolerance") == 0)
+    {
+      options.tolerance = ParseDouble(option, NextValue(argc, argv, i));
+    }
+    else
+    {
+      throw std::logic_error(std::string("Unknown option ") + option);
+    }
+  }
+  return options;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Nearest-rank percentile of sorted values
+double Percentile(const std::vector<double>& sorted, double percentile)
+{
+  size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// Frame-wide ray storage, the rays of each tile being contiguous
+struct FrameRays
+{
+  std::vector<rhi::cpu::Ray> primaryRays;
+  std::vector<rhi::cpu::RayHit> primaryHits;
+  std::vector<rhi::cpu::Ray> shadowRays;
+  std::vector<uint8_t> occluded;
+  /// Number of rays of each tile
+  std::vector<uint32_t> primaryCounts;
+  std::vector<uint32_t> shadowCounts;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Trace the primary rays of all the tiles, then the shadow rays of their hits, and accumulate the
+// timings and hit counts into result
+void TraceFrame(const rhi::cpu::BottomLevelAS& blas, rhi::cpu::ThreadPool& pool,
+                rhi::cpu::TraversalKernel kernel, const rhi::Camera& camera, uint32_t width,
+                uint32_t height, FrameRays& frame, double& primaryMs, double& shadowMs,
+                Result& result)
+{
+  uint32_t tilesX = (width + TileSize - 1) / TileSize;
+  uint32_t tilesY = (height + TileSize - 1) / TileSize;
+  uint32_t tileCount = tilesX * tilesY;
+  const uint32_t tileRays = TileSize * TileSize;
+  frame.primaryRays.resize(tileCount * tileRays);
+  frame.primaryHits.resize(tileCount * tileRays);
+  frame.shadowRays.resize(tileCount * tileRays);
+  frame.occluded.resize(tileCount * tileRays);
+  frame.primaryCounts.assign(tileCount, 0);
+  frame.shadowCounts.assign(tileCount, 0);
+
+  glm::mat4 viewInverse = glm::inverse(camera.view);
+  glm::mat4 projectionInverse = glm::inverse(camera.projection);
+  glm::vec3 origin = glm::vec3(viewInverse * glm::vec4(0.f, 0.f, 0.f, 1.f));
+  const glm::vec3 lightPosition(2.f, 2.f, -2.f);
+
+  // Same rays as the ray generation shader of the sample
+  auto start = std::chrono::steady_clock::now();
+  pool.ParallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+    uint32_t x0 = (tile % tilesX) * TileSize;
+    uint32_t y0 = (tile / tilesX) * TileSize;
+    rhi::cpu::Ray* rays = &frame.primaryRays[tile * tileRays];
+    uint32_t count = 0;
+    for (uint32_t quad = 0; quad < tileRays / 4; quad++)
+    {
+      for (uint32_t corner = 0; corner < 4; corner++)
+      {
+        uint32_t x = x0 + 2 * (quad % (TileSize / 2)) + (corner & 1);
+        uint32_t y = y0 + 2 * (quad / (TileSize / 2)) + (corner >> 1);
+        if (x >= width || y >= height)
+        {
+          continue;
+        }
+        glm::vec2 d =
+            (glm::vec2(float(x), float(y)) + 0.5f) / glm::vec2(float(width), float(height)) * 2.f -
+            1.f;
+        glm::vec4 target = projectionInverse * glm::vec4(d.x, -d.y, 1.f, 1.f);
+        rhi::cpu::Ray& ray = rays[count++];
+        ray.origin = origin;
+        ray.direction = glm::vec3(viewInverse * glm::vec4(glm::vec3(target), 0.f));
+        ray.tMin = 0.f;
+        ray.tMax = 100000.f;
+      }
+    }
+    frame.primaryCounts[tile] = count;
+    blas.Intersect(rays, &frame.primaryHits[tile * tileRays], count, kernel);
+  });
+  primaryMs += Milliseconds(start);
+
+  start = std::chrono::steady_clock::now();
+  pool.ParallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+    const rhi::cpu::Ray* rays = &frame.primaryRays[tile * tileRays];
+    const rhi::cpu::RayHit* hits = &frame.primaryHits[tile * tileRays];
+    rhi::cpu::Ray* shadowRays = &frame.shadowRays[tile * tileRays];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < frame.primaryCounts[tile]; i++)
+    {
+      if (hits[i].t >= rays[i].tMax)
+      {
+        continue;
+      }
+      glm::vec3 position = rays[i].origin + hits[i].t * rays[i].direction;
+      glm::vec3 toLight = lightPosition - position;
+      float distance = glm::length(toLight);
+      rhi::cpu::Ray& ray = shadowRays[count++];
+      ray.origin = position;
+      ray.direction = toLight / distance;
+      ray.tMin = 0.01f;
+      ray.tMax = distance;
+    }
+    frame.shadowCounts[tile] = count;
+    blas.Occluded(shadowRays, &frame.occluded[tile * tileRays], count, kernel);
+  });
+  shadowMs += Milliseconds(start);
+
+  for (uint32_t tile = 0; tile < tileCount; tile++)
+  {
+    result.primaryHits += frame.shadowCounts[tile];
+    for (uint32_t i = 0; i < frame.shadowCounts[tile]; i++)
+    {
+      result.shadowOccluded += frame.occluded[tile * tileRays + i];
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Run the frames of a configuration, the camera making one turn around the sponge
+void RunFrames(const rhi::cpu::BottomLevelAS& blas, rhi::cpu::ThreadPool& pool,
+               rhi::cpu::TraversalKernel kernel, const Resolution& resolution,
+               uint32_t frameCount, Result& result)
+{
+  FrameRays frame;
+  std::vector<double> frameTimes;
+  double primaryMs = 0.0;
+  double shadowMs = 0.0;
+  uint64_t shadowRayCount = 0;
+  float aspectRatio = static_cast<float>(resolution.width) / static_cast<float>(resolution.height);
+  for (uint32_t f = 0; f < frameCount; f++)
+  {
+    float angle = 6.2831853f * f / frameCount;
+    glm::vec3 eye(2.1213203f * std::cos(angle + 0.7853982f), 1.5f,
+                  2.1213203f * std::sin(angle + 0.7853982f));
+    rhi::Camera camera = rhi::SampleScene::MakeCamera(
+        glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)), aspectRatio);
+
+    double frameStart = primaryMs + shadowMs;
+    uint64_t hitsBefore = result.primaryHits;
+    TraceFrame(blas, pool, kernel, camera, resolution.width, resolution.height, frame, primaryMs,
+               shadowMs, result);
+    shadowRayCount += result.primaryHits - hitsBefore;
+    frameTimes.push_back(primaryMs + shadowMs - frameStart);
+  }
+
+  uint64_t primaryRayCount =
+      static_cast<uint64_t>(resolution.width) * resolution.height * frameCount;
+  result.primaryRaysPerSecond = primaryMs > 0.0 ? primaryRayCount / (primaryMs * 1e-3) : 0.0;
+  result.shadowRaysPerSecond = shadowMs > 0.0 ? shadowRayCount / (shadowMs * 1e-3) : 0.0;
+  std::sort(frameTimes.begin(), frameTimes.end());
+  result.frameMsP50 = Percentile(frameTimes, 50.0);
+  result.frameMsP90 = Percentile(frameTimes, 90.0);
+  result.frameMsP99 = Percentile(frameTimes, 99.0);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::string MakeKey(const Result& result)
+{
+  std::ostringstream key;
+  key << result.level << ',' << result.width << 'x' << result.height << ',' << result.threadCount
+      << ',' << result.builder << ',' << result.kernel;
+  return key.str();
+}
+
+const char* CsvHeader = "level,triangles,width,height,threads,builder,kernel,buildMs,wideBuildMs,"
+                        "memoryBytes,primaryRaysPerSecond,shadowRaysPerSecond,frameMsP50,"
+                        "frameMsP90,frameMsP99,primaryHits,shadowOccluded,regressions";
+
+//--------------------------------------------------------------------------------------------------
+//
+// Results of a previous run indexed by configuration, the columns being looked up by name. The
+// header must hold all the columns written by WriteResults, and each row as many fields
+std::map<std::string, std::map<std::string, double>> LoadBaseline(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file)
+  {
+    throw std::logic_error("Cannot open baseline " + fileName);
+  }
+  // Files edited on Windows keep a carriage return at the end of each line
+  auto readLine = [&file](std::string& line) {
+    if (!std::getline(file, line))
+    {
+      return false;
+    }
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    return true;
+  };
+
+  std::string line;
+  readLine(line);
+  std::vector<std::string> columns = SplitList(line);
+  for (const std::string& expected : SplitList(CsvHeader))
+  {
+    if (std::find(columns.begin(), columns.end(), expected) == columns.end())
+    {
+      throw std::logic_error("Baseline " + fileName + " has no " + expected +
+                             " column, it is not a result file of this benchmark");
+    }
+  }
+
+  std::map<std::string, std::map<std::string, double>> baseline;
+  for (uint32_t lineNumber = 2; readLine(line); lineNumber++)
+  {
+    if (line.empty())
+    {
+      continue;
+    }
+    std::vector<std::string> fields = SplitList(line);
+    // The regressions column is left empty, and dropped by SplitList, when there are none
+    if (fields.size() + 1 < columns.size() || fields.size() > columns.size())
+    {
+      throw std::logic_error("Baseline " + fileName + " line " + std::to_string(lineNumber) +
+                             " has " + std::to_string(fields.size()) + " fields, expected " +
+                             std::to_string(columns.size()));
+    }
+    std::map<std::string, std::string> row;
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+      row[columns[i]] = fields[i];
+    }
+    std::string key = row["level"] + ',' + row["width"] + 'x' + row["height"] + ',' +
+                      row["threads"] + ',' + row["builder"] + ',' + row["kernel"];
+    for (const auto& field : row)
+    {
+      baseline[key][field.first] = std::atof(field.second.c_str());
+    }
+  }
+  return baseline;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Flag the measurements worse than the baseline by more than the tolerance. Returns the number of
+// regressions, and the number of configurations found in the baseline in comparedCount
+uint32_t CompareToBaseline(std::vector<Result>& results,
+                           const std::map<std::string, std::map<std::string, double>>& baseline,
+                           double tolerance, uint32_t* comparedCount)
+{
+  uint32_t regressionCount = 0;
+  *comparedCount = 0;
+  for (Result& result : results)
+  {
+    auto row = baseline.find(MakeKey(result));
+    if (row == baseline.end())
+    {
+      std::printf("No baseline for %s\n", MakeKey(result).c_str());
+      continue;
+    }
+    (*comparedCount)++;
+    auto check = [&](const char* name, double value, bool higherIsBetter) {
+      auto reference = row->second.find(name);
+      if (reference == row->second.end() || reference->second <= 0.0)
+      {
+        return;
+      }
+      double ratio = value / reference->second;
+      if (higherIsBetter ? ratio < 1.0 - tolerance : ratio > 1.0 + tolerance)
+      {
+        result.regressions.push_back(name);
+        std::printf("Regression in %s: %s %.4g, baseline %.4g\n", MakeKey(result).c_str(), name,
+                    value, reference->second);
+        regressionCount++;
+      }
+    };
+    check("buildMs", result.buildMs, false);
+    check("primaryRaysPerSecond", result.primaryRaysPerSecond, true);
+    check("shadowRaysPerSecond", result.shadowRaysPerSecond, true);
+    check("frameMsP50", result.frameMsP50, false);
+    check("frameMsP99", result.frameMsP99, false);
+  }
+  return regressionCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void WriteResults(const std::string& prefix, const std::vector<Result>& results)
+{
+  std::ofstream csv(prefix + ".csv");
+  std::ofstream json(prefix + ".json");
+  if (!csv || !json)
+  {
+    throw std::logic_error("Cannot write results to " + prefix);
+  }
+
+  csv << CsvHeader << '\n';
+  json << "{\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& r = results[i];
+    std::string regressions;
+    std::string jsonRegressions;
+    for (const std::string& name : r.regressions)
+    {
+      regressions += (regressions.empty() ? "" : " ") + name;
+      jsonRegressions += (jsonRegressions.empty() ? "\"" : ", \"") + name + "\"";
+    }
+
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "%u,%u,%u,%u,%u,%s,%s,%.3f,%.3f,%llu,%.0f,%.0f,%.3f,%.3f,%.3f,%llu,%llu,%s",
+                  r.level, r.triangleCount, r.width, r.height, r.threadCount, r.builder.c_str(),
+                  r.kernel.c_str(), r.buildMs, r.wideBuildMs,
+                  static_cast<unsigned long long>(r.memoryBytes), r.primaryRaysPerSecond,
+                  r.shadowRaysPerSecond, r.frameMsP50, r.frameMsP90, r.frameMsP99,
+                  static_cast<unsigned long long>(r.primaryHits),
+                  static_cast<unsigned long long>(r.shadowOccluded), regressions.c_str());
+    csv << line << '\n';
+
+    std::snprintf(line, sizeof(line),
+                  "%s\n    {\"level\": %u, \"triangles\": %u, \"width\": %u, \"height\": %u, "
+                  "\"threads\": %u, \"builder\": \"%s\", \"kernel\": \"%s\",\n"
+                  "     \"buildMs\": %.3f, \"wideBuildMs\": %.3f, \"memoryBytes\": %llu,\n",
+                  i == 0 ? "" : ",", r.level, r.triangleCount, r.width, r.height, r.threadCount,
+                  r.builder.c_str(), r.kernel.c_str(), r.buildMs, r.wideBuildMs,
+                  static_cast<unsigned long long>(r.memoryBytes));
+    json << line;
+    std::snprintf(line, sizeof(line),
+                  "     \"primaryRaysPerSecond\": %.0f, \"shadowRaysPerSecond\": %.0f,\n"
+                  "     \"frameMs\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f},\n"
+                  "     \"primaryHits\": %llu, \"shadowOccluded\": %llu, \"regressions\": [",
+                  r.primaryRaysPerSecond, r.shadowRaysPerSecond, r.frameMsP50, r.frameMsP90,
+                  r.frameMsP99, static_cast<unsigned long long>(r.primaryHits),
+                  static_cast<unsigned long long>(r.shadowOccluded));
+    json << line << jsonRegressions << "]}";
+  }
+  json << "\n  ]\n}\n";
+
+  if (!csv || !json)
+  {
+    throw std::logic_error("Cannot write results to " + prefix);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+int Run(const Options& options)
+{
+  std::map<std::string, std::map<std::string, double>> baseline;
+  if (!options.baseline.empty())
+  {
+    baseline = LoadBaseline(options.baseline);
+  }
+
+  // Plane of the sample, in the same structure as the sponge
+  const glm::vec4 white(1.f);
+  std::vector<rhi::Vertex> planeVertices = {
+      {{-1.5f, -.8f, 1.5f}, white},  {{-1.5f, -.8f, -1.5f}, white}, {{1.5f, -.8f, 1.5f}, white},
+      {{1.5f, -.8f, 1.5f}, white},   {{-1.5f, -.8f, -1.5f}, white}, {{1.5f, -.8f, -1.5f}, white}};
+
+  std::vector<Result> results;
+  for (uint32_t level : options.levels)
+  {
+    // Each level multiplies the expected number of cubes, of 12 triangles each
+    double expectedTriangles =
+        12.0 * std::pow(1.0 - options.probability + 20.0 * options.probability, level);
+    if (expectedTriangles > options.maxTriangles)
+    {
+      std::printf("Skipping level %u, about %.0f triangles\n", level, expectedTriangles);
+      continue;
+    }
+
+    std::vector<rhi::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    rhi::GenerateMengerSponge(static_cast<int32_t>(level), options.probability, vertices,
+                              indices);
+    std::vector<rhi::cpu::TriangleGeometry> geometry = {
+        {vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(),
+         static_cast<uint32_t>(indices.size())},
+        {planeVertices.data(), static_cast<uint32_t>(planeVertices.size()), nullptr, 0}};
+
+    for (rhi::cpu::BvhBuilder builder : options.builders)
+    {
+      rhi::cpu::BottomLevelAS blas;
+      auto start = std::chrono::steady_clock::now();
+      blas.Build(geometry, builder);
+      double buildMs = Milliseconds(start);
+      start = std::chrono::steady_clock::now();
+      blas.BuildWide();
+      double wideBuildMs = Milliseconds(start);
+
+      for (const Resolution& resolution : options.resolutions)
+      {
+        for (uint32_t threadCount : options.threadCounts)
+        {
+          rhi::cpu::ThreadPool pool(threadCount);
+          for (rhi::cpu::TraversalKernel kernel : options.kernels)
+          {
+            Result result = {};
+            result.level = level;
+            result.triangleCount = blas.GetTriangleCount();
+            result.width = resolution.width;
+            result.height = resolution.height;
+            result.threadCount = pool.GetThreadCount();
+            result.builder = BuilderName(builder);
+            result.kernel = KernelName(kernel);
+            result.buildMs = buildMs;
+            result.wideBuildMs = wideBuildMs;
+            result.memoryBytes = blas.GetMemorySize();
+            RunFrames(blas, pool, kernel, resolution, options.frameCount, result);
+
+            std::printf("level %u, %ux%u, %u threads, %s, %s: build %.1f ms, %.2f Mrays/s "
+                        "primary, %.2f Mrays/s shadow, frame p50 %.2f ms\n",
+                        level, resolution.width, resolution.height, result.threadCount,
+                        result.builder.c_str(), result.kernel.c_str(), buildMs,
+                        result.primaryRaysPerSecond * 1e-6, result.shadowRaysPerSecond * 1e-6,
+                        result.frameMsP50);
+            results.push_back(result);
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t regressionCount = 0;
+  uint32_t comparedCount = 0;
+  if (!options.baseline.empty())
+  {
+    regressionCount = CompareToBaseline(results, baseline, options.tolerance, &comparedCount);
+  }
+  WriteResults(options.outputPrefix, results);
+  if (!options.baseline.empty() && comparedCount == 0)
+  {
+    std::fprintf(stderr, "Benchmark: none of the configurations measured is in the baseline %s\n",
+                 options.baseline.c_str());
+    return 3;
+  }
+  if (regressionCount > 0)
+  {
+    std::printf("%u regressions beyond %.0f%%\n", regressionCount, 100.0 * options.tolerance);
+    return 2;
+  }
+  return 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    return Run(ParseOptions(argc, argv));
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "Benchmark: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,107 @@
+#include "CameraPath.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace tools
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CameraPath::Load(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file)
+  {
+    throw std::logic_error("Cannot open camera path file " + fileName);
+  }
+
+  m_keyframes.clear();
+  std::string line;
+  while (std::getline(file, line))
+  {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+    {
+      continue;
+    }
+    std::istringstream stream(line);
+    CameraKeyframe keyframe;
+    stream >> keyframe.time >> keyframe.eye.x >> keyframe.eye.y >> keyframe.eye.z >>
+        keyframe.center.x >> keyframe.center.y >> keyframe.center.z >> keyframe.up.x >>
+        keyframe.up.y >> keyframe.up.z;
+    if (stream.fail())
+    {
+      throw std::logic_error("Invalid keyframe in camera path file " + fileName + ": " + line);
+    }
+    AddKeyframe(keyframe);
+  }
+
+  if (m_keyframes.empty())
+  {
+    throw std::logic_error("Camera path file " + fileName + " has no keyframes");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+{
+  if (!m_keyframes.empty() && keyframe.time < m_keyframes.back().time)
+  {
+    throw std::logic_error("Camera keyframes must be sorted by time");
+  }
+  m_keyframes.push_back(keyframe);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Keyframes sharing the same time make a cut: the later one is used from that time on
+void CameraPath::Evaluate(float time, glm::vec3& eye, glm::vec3& center, glm::vec3& up) const
+{
+  if (m_keyframes.empty())
+  {
+    throw std::logic_error("Evaluating an empty camera path");
+  }
+
+  size_t next = 0;
+  while (next < m_keyframes.size() && m_keyframes[next].time <= time)
+  {
+    next++;
+  }
+  if (next == 0 || next == m_keyframes.size())
+  {
+    const CameraKeyframe& keyframe = m_keyframes[next == 0 ? 0 : next - 1];
+    eye = keyframe.eye;
+    center = keyframe.center;
+    up = keyframe.up;
+    return;
+  }
+
+  const CameraKeyframe& a = m_keyframes[next - 1];
+  const CameraKeyframe& b = m_keyframes[next];
+  float s = (time - a.time) / (b.time - a.time);
+  eye = glm::mix(a.eye, b.eye, s);
+  center = glm::mix(a.center, b.center, s);
+  up = glm::mix(a.up, b.up, s);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+float CameraPath::GetStartTime() const
+{
+  return m_keyframes.empty() ? 0.f : m_keyframes.front().time;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+float CameraPath::GetEndTime() const
+{
+  return m_keyframes.empty() ? 0.f : m_keyframes.back().time;
+}
+} // namespace tools
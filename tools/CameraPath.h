@@ -0,0 +1,61 @@
+/*
+Camera path made of timed keyframes, each giving the eye, center of interest
+and up vector passed to Manipulator::setLookat. The path is evaluated at any
+time by interpolating linearly between the two surrounding keyframes, and is
+clamped to the first and last keyframes outside of their time range.
+
+Paths are loaded from text files with one keyframe per line, blank lines and
+lines starting with # being ignored:
+
+# time  eye.x eye.y eye.z  center.x center.y center.z  up.x up.y up.z
+0       1.5   1.5   1.5    0        0        0         0    1    0
+2.5     -1.5  1.0   1.5    0        0        0         0    1    0
+
+Example:
+
+CameraPath path;
+path.Load("flythrough.txt");
+glm::vec3 eye, center, up;
+path.Evaluate(time, eye, center, up);
+CameraManip.setLookat(eye, center, up);
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace tools
+{
+
+struct CameraKeyframe
+{
+  float time;
+  glm::vec3 eye;
+  glm::vec3 center;
+  glm::vec3 up;
+};
+
+class CameraPath
+{
+public:
+  /// Replace the keyframes by the ones of a path file
+  void Load(const std::string& fileName);
+
+  /// Add a keyframe, which must not be earlier than the last one
+  void AddKeyframe(const CameraKeyframe& keyframe);
+
+  /// Interpolate the look-at parameters at time
+  void Evaluate(float time, glm::vec3& eye, glm::vec3& center, glm::vec3& up) const;
+
+  float GetStartTime() const;
+  float GetEndTime() const;
+  size_t GetKeyframeCount() const { return m_keyframes.size(); }
+
+private:
+  std::vector<CameraKeyframe> m_keyframes;
+};
+} // namespace tools
@@ -0,0 +1,149 @@
+#include "ImageWriter.h"
+
+#include "Profiler.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace tools
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pixels are converted to RGB in memory, so that the file is written in a single call
+void WritePpm(const std::string& fileName, const rhi::Image& image)
+{
+  size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+  if (image.pixels.size() < 4 * pixelCount)
+  {
+    throw std::logic_error("Image has fewer pixels than its dimensions");
+  }
+  std::vector<uint8_t> rgb(3 * pixelCount);
+  for (size_t i = 0; i < pixelCount; i++)
+  {
+    rgb[3 * i + 0] = image.pixels[4 * i + 0];
+    rgb[3 * i + 1] = image.pixels[4 * i + 1];
+    rgb[3 * i + 2] = image.pixels[4 * i + 2];
+  }
+
+  FILE* file = std::fopen(fileName.c_str(), "wb");
+  if (file == nullptr)
+  {
+    throw std::logic_error("Cannot create image file " + fileName);
+  }
+  std::fprintf(file, "P6\n%u %u\n255\n", image.width, image.height);
+  size_t written = std::fwrite(rgb.data(), 1, rgb.size(), file);
+  if (std::fclose(file) != 0 || written != rgb.size())
+  {
+    throw std::logic_error("Cannot write image file " + fileName);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+std::string MakeFrameFileName(const std::string& prefix, uint32_t frame)
+{
+  char number[16];
+  std::snprintf(number, sizeof(number), "_%04u.ppm", frame);
+  return prefix + number;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+ImageWriter::ImageWriter(size_t queueDepth /*= 2*/)
+    : m_queueDepth(queueDepth == 0 ? 1 : queueDepth), m_thread(&ImageWriter::WriterLoop, this)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Pending images are still written, but their errors are lost
+ImageWriter::~ImageWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_queuedCondition.notify_all();
+  m_thread.join();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ImageWriter::Write(const std::string& fileName, rhi::Image image)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_writtenCondition.wait(lock, [this] { return m_queue.size() < m_queueDepth; });
+    RethrowError();
+    m_queue.emplace_back(fileName, std::move(image));
+  }
+  m_queuedCondition.notify_one();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ImageWriter::Finish()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_writtenCondition.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+  RethrowError();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The images are written outside of the lock, so that the renderer can queue the next one
+void ImageWriter::WriterLoop()
+{
+  Profiler::Get().SetThreadName("Image writer");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;)
+  {
+    m_queuedCondition.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+    if (m_queue.empty())
+    {
+      return;
+    }
+
+    std::pair<std::string, rhi::Image> item = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_writing = true;
+    lock.unlock();
+    std::string error;
+    try
+    {
+      ProfileZone zone("Write image");
+      WritePpm(item.first, item.second);
+    }
+    catch (const std::exception& e)
+    {
+      error = e.what();
+    }
+    lock.lock();
+    m_writing = false;
+    if (m_error.empty())
+    {
+      m_error = error;
+    }
+    m_writtenCondition.notify_all();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Called with the lock held. The error is reported once
+void ImageWriter::RethrowError()
+{
+  if (!m_error.empty())
+  {
+    std::string error;
+    error.swap(m_error);
+    throw std::logic_error(error);
+  }
+}
+} // namespace tools
@@ -0,0 +1,76 @@
+/*
+Writing of rendered images to binary PPM files, either directly or from a
+background thread so that encoding and disk I/O overlap with the rendering of
+the next frames.
+
+The writer holds a bounded queue of images: Write returns as soon as the image
+is queued, and only blocks when the renderer is more than queueDepth images
+ahead of the disk. The alpha channel is not written.
+
+Example:
+
+ImageWriter writer(2);
+for (uint32_t frame = 0; frame < frameCount; frame++)
+{
+  rhi::Image image;
+  scene.Render(device, camera, false, &image);
+  writer.Write(MakeFrameFileName("out/frame", frame), std::move(image));
+}
+writer.Finish();
+
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "../rhi/RenderDevice.h"
+
+namespace tools
+{
+
+/// Write the RGB channels of image to a binary PPM file
+void WritePpm(const std::string& fileName, const rhi::Image& image);
+
+/// File name of a frame of a numbered sequence: prefix_0042.ppm
+std::string MakeFrameFileName(const std::string& prefix, uint32_t frame);
+
+class ImageWriter
+{
+public:
+  /// Start the writing thread, with at most queueDepth images waiting to be written
+  explicit ImageWriter(size_t queueDepth = 2);
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+
+  /// Queue an image, waiting for room in the queue if needed. Rethrows the error of a previous
+  /// write if any
+  void Write(const std::string& fileName, rhi::Image image);
+
+  /// Wait for all the queued images to be written, and rethrow the first write error if any
+  void Finish();
+
+private:
+  void WriterLoop();
+  void RethrowError();
+
+  size_t m_queueDepth;
+  std::deque<std::pair<std::string, rhi::Image>> m_queue;
+  std::mutex m_mutex;
+  /// Signaled when an image is queued, or when the writer has to stop
+  std::condition_variable m_queuedCondition;
+  /// Signaled when an image has been written
+  std::condition_variable m_writtenCondition;
+  bool m_writing = false;
+  bool m_stop = false;
+  std::string m_error;
+  std::thread m_thread;
+};
+} // namespace tools
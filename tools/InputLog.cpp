@@ -0,0 +1,319 @@
+#include "InputLog.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tools
+{
+
+namespace
+{
+const char LogTag[4] = {'M', 'L', 'O', 'G'};
+const uint32_t LogVersion = 1;
+
+// Bits of the buttons and modifiers in the first byte of an event
+const uint8_t LeftButtonBit = 1 << 2;
+const uint8_t MiddleButtonBit = 1 << 3;
+const uint8_t RightButtonBit = 1 << 4;
+const uint8_t ShiftBit = 1 << 5;
+const uint8_t CtrlBit = 1 << 6;
+const uint8_t AltBit = 1 << 7;
+
+void WriteVarint(std::ostream& stream, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    stream.put(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  stream.put(static_cast<char>(value));
+}
+
+uint64_t ReadVarint(std::istream& stream)
+{
+  uint64_t value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7)
+  {
+    int byte = stream.get();
+    if (byte == std::char_traits<char>::eof())
+    {
+      throw std::logic_error("Truncated input log");
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return value;
+    }
+  }
+  throw std::logic_error("Invalid integer in input log");
+}
+
+/// Map signed values to unsigned ones, small magnitudes giving small values
+void WriteSigned(std::ostream& stream, int64_t value)
+{
+  WriteVarint(stream, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+int64_t ReadSigned(std::istream& stream)
+{
+  uint64_t value = ReadVarint(stream);
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputLog::Add(const InputEvent& event)
+{
+  if (!m_events.empty() && event.time < m_events.back().time)
+  {
+    throw std::logic_error("Input events must be sorted by time");
+  }
+  m_events.push_back(event);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t InputLog::GetFrameCount() const
+{
+  uint32_t count = 0;
+  for (const InputEvent& event : m_events)
+  {
+    count += event.type == InputEventType::Frame ? 1 : 0;
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputLog::Save(std::ostream& stream) const
+{
+  stream.write(LogTag, sizeof(LogTag));
+  for (uint32_t byte = 0; byte < 4; byte++)
+  {
+    stream.put(static_cast<char>((LogVersion >> (8 * byte)) & 0xff));
+  }
+
+  uint64_t previousTime = 0;
+  int64_t previousX = 0;
+  int64_t previousY = 0;
+  for (const InputEvent& event : m_events)
+  {
+    uint8_t header = static_cast<uint8_t>(event.type);
+    if (event.type == InputEventType::MouseMove)
+    {
+      header |= (event.inputs.lmb ? LeftButtonBit : 0) | (event.inputs.mmb ? MiddleButtonBit : 0) |
+                (event.inputs.rmb ? RightButtonBit : 0) | (event.inputs.shift ? ShiftBit : 0) |
+                (event.inputs.ctrl ? CtrlBit : 0) | (event.inputs.alt ? AltBit : 0);
+    }
+    stream.put(static_cast<char>(header));
+    WriteVarint(stream, event.time - previousTime);
+    previousTime = event.time;
+
+    if (event.type == InputEventType::ButtonDown || event.type == InputEventType::MouseMove)
+    {
+      WriteSigned(stream, event.x - previousX);
+      WriteSigned(stream, event.y - previousY);
+      previousX = event.x;
+      previousY = event.y;
+    }
+    else if (event.type == InputEventType::WindowSize)
+    {
+      WriteSigned(stream, event.x);
+      WriteSigned(stream, event.y);
+    }
+  }
+
+  if (!stream)
+  {
+    throw std::logic_error("Cannot write input log");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputLog::Load(std::istream& stream)
+{
+  char tag[sizeof(LogTag)];
+  unsigned char version[4];
+  stream.read(tag, sizeof(tag));
+  stream.read(reinterpret_cast<char*>(version), sizeof(version));
+  if (!stream || !std::equal(tag, tag + sizeof(tag), LogTag))
+  {
+    throw std::logic_error("Not an input log");
+  }
+  if (static_cast<uint32_t>(version[0] | version[1] << 8 | version[2] << 16 | version[3] << 24) !=
+      LogVersion)
+  {
+    throw std::logic_error("Unsupported input log version");
+  }
+
+  m_events.clear();
+  uint64_t time = 0;
+  int64_t x = 0;
+  int64_t y = 0;
+  for (int header = stream.get(); header != std::char_traits<char>::eof(); header = stream.get())
+  {
+    InputEvent event = {};
+    event.type = static_cast<InputEventType>(header & 3);
+    time += ReadVarint(stream);
+    event.time = time;
+
+    if (event.type == InputEventType::ButtonDown || event.type == InputEventType::MouseMove)
+    {
+      x += ReadSigned(stream);
+      y += ReadSigned(stream);
+      event.x = static_cast<int32_t>(x);
+      event.y = static_cast<int32_t>(y);
+    }
+    else if (event.type == InputEventType::WindowSize)
+    {
+      event.x = static_cast<int32_t>(ReadSigned(stream));
+      event.y = static_cast<int32_t>(ReadSigned(stream));
+    }
+    event.inputs.lmb = (header & LeftButtonBit) != 0;
+    event.inputs.mmb = (header & MiddleButtonBit) != 0;
+    event.inputs.rmb = (header & RightButtonBit) != 0;
+    event.inputs.shift = (header & ShiftBit) != 0;
+    event.inputs.ctrl = (header & CtrlBit) != 0;
+    event.inputs.alt = (header & AltBit) != 0;
+    m_events.push_back(event);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+InputRecorder::InputRecorder() : m_start(std::chrono::steady_clock::now()) {}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputRecorder::RecordFrame()
+{
+  Record(InputEventType::Frame, 0, 0, {});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputRecorder::RecordButtonDown(int x, int y)
+{
+  Record(InputEventType::ButtonDown, x, y, {});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputRecorder::RecordMouseMove(int x, int y,
+                                    const nv_helpers_dx12::Manipulator::Inputs& inputs)
+{
+  Record(InputEventType::MouseMove, x, y, inputs);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputRecorder::RecordWindowSize(int width, int height)
+{
+  Record(InputEventType::WindowSize, width, height, {});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void InputRecorder::Record(InputEventType type, int x, int y,
+                           const nv_helpers_dx12::Manipulator::Inputs& inputs)
+{
+  InputEvent event;
+  event.type = type;
+  event.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - m_start)
+                   .count();
+  event.x = x;
+  event.y = y;
+  event.inputs = inputs;
+  m_log.Add(event);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+InputPlayer::InputPlayer(const InputLog& log, bool realTime) : m_log(log), m_realTime(realTime)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// In real time, the clock of the replay starts at the first frame marker, the events preceding it
+// being applied before the first frame
+bool InputPlayer::NextFrame(nv_helpers_dx12::Manipulator& manipulator)
+{
+  const std::vector<InputEvent>& events = m_log.GetEvents();
+  if (m_next >= events.size())
+  {
+    return false;
+  }
+
+  if (!m_realTime)
+  {
+    while (m_next < events.size())
+    {
+      const InputEvent& event = events[m_next++];
+      if (event.type == InputEventType::Frame)
+      {
+        break;
+      }
+      Apply(event, manipulator);
+    }
+    return true;
+  }
+
+  if (!m_started)
+  {
+    m_started = true;
+    m_start = std::chrono::steady_clock::now();
+    for (const InputEvent& event : events)
+    {
+      if (event.type == InputEventType::Frame)
+      {
+        m_start -= std::chrono::microseconds(event.time);
+        break;
+      }
+    }
+  }
+  uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - m_start)
+                      .count();
+  while (m_next < events.size() && events[m_next].time <= time)
+  {
+    Apply(events[m_next++], manipulator);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same calls as the sample makes on input
+void InputPlayer::Apply(const InputEvent& event, nv_helpers_dx12::Manipulator& manipulator)
+{
+  switch (event.type)
+  {
+  case InputEventType::Frame:
+    break;
+  case InputEventType::ButtonDown:
+    manipulator.setMousePosition(event.x, event.y);
+    break;
+  case InputEventType::MouseMove:
+    manipulator.mouseMove(event.x, event.y, event.inputs);
+    break;
+  case InputEventType::WindowSize:
+    manipulator.setWindowSize(event.x, event.y);
+    break;
+  }
+}
+} // namespace tools
@@ -0,0 +1,143 @@
+/*
+Recording and replay of the inputs driving the camera manipulator, so that
+interactive sessions can be reproduced exactly: the same camera motion frame
+after frame, for flythrough benchmarks and frame time comparisons across
+builds.
+
+The log holds the window size, the mouse button presses and the mouse moves
+with their buttons and keyboard modifiers, as passed to the manipulator, plus
+a marker at the start of each frame. All events are timestamped in
+microseconds since the start of the recording.
+
+Binary format: the 4-byte tag MLOG and a 32-bit little-endian version,
+followed by the events. Each event starts with one byte holding the event
+type in the 2 low bits and the buttons and modifiers in the 6 high bits, then
+the time elapsed since the previous event as a variable-length integer (7 bits
+per byte, low bits first). Button presses and mouse moves store the position
+relative to the previous one, and window sizes store the size, all as
+zigzag-encoded variable-length integers. A typical mouse move takes 4 bytes.
+
+The replay either follows the recorded timing, or runs at maximum speed,
+applying exactly the events recorded between two frames before each frame.
+
+Example:
+
+InputRecorder recorder;
+recorder.RecordWindowSize(width, height);
+... at each frame:
+recorder.RecordFrame();
+... on mouse move:
+recorder.RecordMouseMove(x, y, inputs);
+CameraManip.mouseMove(x, y, inputs);
+...
+std::ofstream file("session.mlog", std::ios::binary);
+recorder.GetLog().Save(file);
+
+std::ifstream input("session.mlog", std::ios::binary);
+InputLog log;
+log.Load(input);
+InputPlayer player(log, false);
+while (player.NextFrame(CameraManip))
+{
+  Render();
+}
+
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "../Manipulator.h"
+
+namespace tools
+{
+
+enum class InputEventType : uint8_t
+{
+  Frame,
+  ButtonDown,
+  MouseMove,
+  WindowSize
+};
+
+struct InputEvent
+{
+  InputEventType type;
+  /// Microseconds since the start of the recording
+  uint64_t time;
+  /// Mouse position, or window size
+  int32_t x;
+  int32_t y;
+  /// Buttons and modifiers of mouse moves
+  nv_helpers_dx12::Manipulator::Inputs inputs;
+};
+
+class InputLog
+{
+public:
+  void Clear() { m_events.clear(); }
+
+  /// Append an event, which must not be earlier than the last one
+  void Add(const InputEvent& event);
+
+  const std::vector<InputEvent>& GetEvents() const { return m_events; }
+
+  uint32_t GetFrameCount() const;
+
+  void Save(std::ostream& stream) const;
+
+  /// Replace the events by the ones of a log written by Save
+  void Load(std::istream& stream);
+
+private:
+  std::vector<InputEvent> m_events;
+};
+
+/// Timestamps the events with the time elapsed since its creation
+class InputRecorder
+{
+public:
+  InputRecorder();
+
+  void RecordFrame();
+  void RecordButtonDown(int x, int y);
+  void RecordMouseMove(int x, int y, const nv_helpers_dx12::Manipulator::Inputs& inputs);
+  void RecordWindowSize(int width, int height);
+
+  const InputLog& GetLog() const { return m_log; }
+
+private:
+  void Record(InputEventType type, int x, int y,
+              const nv_helpers_dx12::Manipulator::Inputs& inputs);
+
+  std::chrono::steady_clock::time_point m_start;
+  InputLog m_log;
+};
+
+/// Feeds the events of a log to a manipulator, frame by frame
+class InputPlayer
+{
+public:
+  /// With realTime, the events are applied when the time elapsed since the first frame reaches
+  /// their timestamp. Otherwise each frame gets the events recorded before it
+  InputPlayer(const InputLog& log, bool realTime);
+
+  /// Apply the events of the next frame to manipulator. Returns false once all the events of the
+  /// log have been applied
+  bool NextFrame(nv_helpers_dx12::Manipulator& manipulator);
+
+private:
+  void Apply(const InputEvent& event, nv_helpers_dx12::Manipulator& manipulator);
+
+  const InputLog& m_log;
+  bool m_realTime;
+  size_t m_next = 0;
+  bool m_started = false;
+  std::chrono::steady_clock::time_point m_start;
+};
+} // namespace tools
@@ -0,0 +1,285 @@
+#include "LightBaker.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "../rhi/SceneCache.h"
+#include "../rhi/cpu/AccelerationStructure.h"
+#include "../rhi/cpu/Lights.h"
+#include "../rhi/cpu/Sampling.h"
+#include "../rhi/cpu/ThreadPool.h"
+
+namespace tools
+{
+
+namespace
+{
+/// Vertices baked by one task
+const uint32_t ChunkSize = 256;
+/// Offset of the ray origins along the normal, keeping the rays off the surface of the vertex
+const float SurfaceOffset = 1e-4f;
+
+/// Vertex of a baked mesh, in world space
+struct BakeVertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+};
+
+/// Rays of a task and their occlusion, reused from vertex to vertex
+struct ThreadRays
+{
+  std::vector<rhi::cpu::Ray> rays;
+  std::vector<uint8_t> occluded;
+  uint64_t count = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Fraction of the stratified cosine-weighted rays around each side of the normal which escape the
+// scene. The rays of both sides start from the same point, and are traced together as packets
+glm::vec2 TraceOcclusion(const rhi::cpu::TopLevelAS& scene, const glm::vec3& position,
+                         const glm::vec3& normal, const LightBakeSettings& settings,
+                         uint32_t seed, ThreadRays& threadRays)
+{
+  uint32_t sampleCount = settings.occlusionSamples;
+  threadRays.rays.resize(2 * static_cast<size_t>(sampleCount));
+  threadRays.occluded.resize(threadRays.rays.size());
+  glm::vec3 tangent, bitangent;
+  rhi::cpu::OrthonormalBasis(normal, tangent, bitangent);
+  for (uint32_t i = 0; i < sampleCount; i++)
+  {
+    glm::vec2 u = rhi::cpu::StratifiedSample(i, sampleCount,
+                                             rhi::cpu::RandomFloat2(rhi::cpu::Hash(seed, i)));
+    glm::vec3 local = rhi::cpu::CosineHemisphere(u);
+    glm::vec3 direction = local.x * tangent + local.y * bitangent + local.z * normal;
+    for (uint32_t side = 0; side < 2; side++)
+    {
+      rhi::cpu::Ray& ray = threadRays.rays[side * sampleCount + i];
+      float sign = side == 0 ? 1.f : -1.f;
+      ray.origin = position + (sign * SurfaceOffset) * normal;
+      ray.direction = sign * direction;
+      ray.tMin = 0.f;
+      ray.tMax = settings.occlusionDistance;
+    }
+  }
+  scene.Occluded(threadRays.rays.data(), threadRays.occluded.data(), 2 * sampleCount,
+                 rhi::cpu::TraversalKernel::Packet);
+  threadRays.count += 2 * sampleCount;
+
+  glm::vec2 openCount(0.f);
+  for (uint32_t i = 0; i < 2 * sampleCount; i++)
+  {
+    openCount[i / sampleCount] += threadRays.occluded[i] != 0 ? 0.f : 1.f;
+  }
+  return openCount / static_cast<float>(sampleCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Light reaching the side of normal, with the shadow rays of each light. A light without falloff
+// lights all the points facing it alike
+glm::vec3 TraceDirectLight(const rhi::cpu::TopLevelAS& scene,
+                           const std::vector<rhi::LightDesc>& lights, const glm::vec3& position,
+                           const glm::vec3& normal, uint32_t seed, uint64_t& rayCount)
+{
+  glm::vec3 light(0.f);
+  rhi::cpu::Ray ray;
+  ray.origin = position + SurfaceOffset * normal;
+  ray.tMin = 0.f;
+  for (uint32_t lightIndex = 0; lightIndex < lights.size(); lightIndex++)
+  {
+    const rhi::LightDesc& desc = lights[lightIndex];
+    uint32_t sampleCount = rhi::cpu::GetSampleCount(desc);
+    uint32_t lightSeed = rhi::cpu::Hash(seed, lightIndex);
+    glm::vec3 sum(0.f);
+    for (uint32_t i = 0; i < sampleCount; i++)
+    {
+      glm::vec2 u = rhi::cpu::StratifiedSample(
+          i, sampleCount, rhi::cpu::RandomFloat2(rhi::cpu::Hash(lightSeed, i)));
+      glm::vec3 offset = rhi::cpu::SampleLight(desc, position, u) - ray.origin;
+      float distance = glm::length(offset);
+      ray.direction = offset / distance;
+      ray.tMax = distance;
+      float cosine = glm::dot(normal, ray.direction);
+      if (!(cosine > 0.f))
+      {
+        continue;
+      }
+      rayCount++;
+      if (!scene.Occluded(ray))
+      {
+        sum += desc.color * (desc.falloff ? cosine / (distance * distance) : 1.f);
+      }
+    }
+    light += sum / static_cast<float>(sampleCount);
+  }
+  return light;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// World-space positions and normals of the vertices of a mesh, the normals of the vertices of no
+// triangle being null
+std::vector<BakeVertex> TransformVertices(const std::vector<rhi::Vertex>& vertices,
+                                          const std::vector<uint32_t>& indices,
+                                          const glm::mat4& transform)
+{
+  std::vector<glm::vec3> normals(vertices.size(), glm::vec3(0.f));
+  for (size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    glm::vec3 v0 = vertices[indices[i + 0]].position;
+    glm::vec3 v1 = vertices[indices[i + 1]].position;
+    glm::vec3 v2 = vertices[indices[i + 2]].position;
+    glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+    for (size_t corner = 0; corner < 3; corner++)
+    {
+      normals[indices[i + corner]] += normal;
+    }
+  }
+
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+  std::vector<BakeVertex> result(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++)
+  {
+    result[i].position = glm::vec3(transform * glm::vec4(vertices[i].position, 1.f));
+    glm::vec3 normal = normalMatrix * normals[i];
+    float length = glm::length(normal);
+    result[i].normal = length > 0.f ? normal / length : glm::vec3(0.f);
+  }
+  return result;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The structures are built from copies of the vertices, so the colors can be written while
+// tracing. Each vertex is written by a single task
+LightBakeStats BakeVertexLighting(const rhi::SceneDescription& description,
+                                  std::vector<std::vector<rhi::Vertex>>& vertices,
+                                  const std::vector<std::vector<uint32_t>>& indices,
+                                  const LightBakeSettings& settings,
+                                  uint32_t threadCount /*= 0*/)
+{
+  auto start = std::chrono::steady_clock::now();
+  size_t meshCount = description.meshes.size();
+  if (vertices.size() != meshCount || indices.size() != meshCount)
+  {
+    throw std::logic_error("The light bake requires the geometry of each mesh");
+  }
+  if (settings.occlusionSamples == 0)
+  {
+    throw std::logic_error("The light bake requires at least one occlusion ray per vertex");
+  }
+
+  rhi::cpu::ThreadPool pool(threadCount);
+  std::vector<rhi::cpu::BottomLevelAS> meshBLAS(meshCount);
+  pool.ParallelFor(static_cast<uint32_t>(meshCount), [&](uint32_t mesh, uint32_t /*thread*/) {
+    meshBLAS[mesh].Build({{vertices[mesh].data(), static_cast<uint32_t>(vertices[mesh].size()),
+                           indices[mesh].data(), static_cast<uint32_t>(indices[mesh].size())}});
+  });
+
+  // A mesh is baked for its only instance
+  std::vector<rhi::cpu::TopLevelAS::Instance> instances;
+  std::vector<uint32_t> bakedInstance(meshCount, rhi::InvalidHandle);
+  std::vector<uint32_t> instanceCount(meshCount, 0);
+  for (uint32_t i = 0; i < description.instances.size(); i++)
+  {
+    const rhi::SceneInstance& instance = description.instances[i];
+    instances.push_back({&meshBLAS[instance.mesh], instance.transform, 0});
+    instanceCount[instance.mesh]++;
+    if (description.materials[instance.material].hitGroup == L"HitGroup")
+    {
+      bakedInstance[instance.mesh] = i;
+    }
+  }
+  rhi::cpu::TopLevelAS scene;
+  scene.Build(instances, &pool);
+
+  std::vector<rhi::LightDesc> lights = description.lights;
+  if (lights.empty())
+  {
+    lights.push_back({rhi::LightShape::Point, glm::vec3(2.f, 2.f, -2.f)});
+  }
+
+  LightBakeStats stats;
+  std::vector<ThreadRays> threadRays(pool.GetThreadCount());
+  for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+  {
+    if (bakedInstance[mesh] == rhi::InvalidHandle || instanceCount[mesh] != 1)
+    {
+      continue;
+    }
+    std::vector<BakeVertex> bakeVertices = TransformVertices(
+        vertices[mesh], indices[mesh], description.instances[bakedInstance[mesh]].transform);
+    uint32_t vertexCount = static_cast<uint32_t>(bakeVertices.size());
+    pool.ParallelFor((vertexCount + ChunkSize - 1) / ChunkSize, [&](uint32_t chunk,
+                                                                    uint32_t thread) {
+      uint32_t first = chunk * ChunkSize;
+      uint32_t end = first + ChunkSize < vertexCount ? first + ChunkSize : vertexCount;
+      for (uint32_t i = first; i < end; i++)
+      {
+        const BakeVertex& vertex = bakeVertices[i];
+        if (vertex.normal == glm::vec3(0.f))
+        {
+          continue;
+        }
+        uint32_t seed = rhi::cpu::Hash(i, mesh);
+        glm::vec2 open = TraceOcclusion(scene, vertex.position, vertex.normal, settings, seed,
+                                        threadRays[thread]);
+        glm::vec3 normal = open.x >= open.y ? vertex.normal : -vertex.normal;
+        glm::vec3 direct = TraceDirectLight(scene, lights, vertex.position, normal,
+                                            rhi::cpu::Hash(seed, 1), threadRays[thread].count);
+        glm::vec3 light = settings.ambient * (open.x >= open.y ? open.x : open.y) +
+                          (1.f - settings.ambient) * direct;
+        glm::vec4& color = vertices[mesh][i].color;
+        color = glm::vec4(glm::vec3(color) * light, color.a);
+      }
+    });
+    stats.vertexCount += vertexCount;
+  }
+
+  for (const ThreadRays& rays : threadRays)
+  {
+    stats.rayCount += rays.count;
+  }
+  stats.milliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The members are hashed one by one, the padding of the structures being undefined
+uint64_t HashLightBake(const rhi::SceneDescription& description, const LightBakeSettings& settings,
+                       uint64_t hash)
+{
+  hash = rhi::HashBytes(&settings.occlusionSamples, sizeof(settings.occlusionSamples), hash);
+  hash = rhi::HashBytes(&settings.occlusionDistance, sizeof(settings.occlusionDistance), hash);
+  hash = rhi::HashBytes(&settings.ambient, sizeof(settings.ambient), hash);
+  for (const rhi::SceneInstance& instance : description.instances)
+  {
+    hash = rhi::HashBytes(&instance.mesh, sizeof(instance.mesh), hash);
+    hash = rhi::HashBytes(&instance.material, sizeof(instance.material), hash);
+    hash = rhi::HashBytes(&instance.transform, sizeof(instance.transform), hash);
+  }
+  for (const rhi::SceneMaterial& material : description.materials)
+  {
+    uint64_t length = material.hitGroup.size();
+    hash = rhi::HashBytes(&length, sizeof(length), hash);
+    hash = rhi::HashBytes(material.hitGroup.data(), length * sizeof(wchar_t), hash);
+  }
+  for (const rhi::LightDesc& light : description.lights)
+  {
+    hash = rhi::HashBytes(&light.shape, sizeof(light.shape), hash);
+    hash = rhi::HashBytes(&light.position, sizeof(light.position), hash);
+    hash = rhi::HashBytes(&light.radius, sizeof(light.radius), hash);
+    hash = rhi::HashBytes(&light.edge1, sizeof(light.edge1), hash);
+    hash = rhi::HashBytes(&light.edge2, sizeof(light.edge2), hash);
+    hash = rhi::HashBytes(&light.color, sizeof(light.color), hash);
+    hash = rhi::HashBytes(&light.sampleCount, sizeof(light.sampleCount), hash);
+    hash = rhi::HashBytes(&light.falloff, sizeof(light.falloff), hash);
+  }
+  return hash;
+}
+} // namespace tools
@@ -0,0 +1,77 @@
+/*
+Offline bake of the lighting of the static meshes of a scene description into
+their vertex colors, traced with the acceleration structures of the CPU
+backend. The closest hit shader of the vertex colors interpolates them, so the
+baked meshes are then shaded by a lookup on all the backends.
+
+The light of a vertex mixes two terms, weighted by the ambient share of the
+settings:
+
+- Ambient occlusion: the fraction of the cosine-weighted rays of limited
+  length, stratified over the hemisphere, which escape the scene.
+- Direct light: the lights of the description, or the point light of the
+  sample if it has none, each sampled with its shadow rays (see
+  rhi/cpu/Lights.h). The samples of the lights with falloff are weighted by
+  the cosine to the normal and the inverse square of the distance; the other
+  lights only light the side of the vertex facing them.
+
+The normal of a vertex is the area-weighted sum of the normals of its
+triangles. The meshes being drawn two-sided, with no consistent winding, both
+sides of a vertex are tested for occlusion and the more open side is lit, the
+other one facing the inside of a solid or a nearby wall.
+
+Only the meshes with a single instance, whose material uses the hit group of
+the vertex colors, are baked; the other meshes, such as the plane with its
+own shading, only occlude. The vertices are processed in chunks by the
+threads of a pool.
+
+Example:
+
+SceneDescription description = MakeSceneDescription(parameters);
+// Generate the vertices and indices of each mesh of the description
+LightBakeStats stats = BakeVertexLighting(description, vertices, indices, {});
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "../rhi/SceneDescription.h"
+
+namespace tools
+{
+
+struct LightBakeSettings
+{
+  /// Ambient occlusion rays per side of a vertex
+  uint32_t occlusionSamples = 64;
+  /// Length of the ambient occlusion rays
+  float occlusionDistance = 0.5f;
+  /// Share of the ambient occlusion in the light of a vertex, the direct light having the rest
+  float ambient = 0.5f;
+};
+
+struct LightBakeStats
+{
+  /// Vertices whose color was baked
+  uint32_t vertexCount = 0;
+  /// Occlusion and shadow rays traced
+  uint64_t rayCount = 0;
+  /// Duration of the bake, including the build of the acceleration structures
+  double milliseconds = 0.0;
+};
+
+/// Multiply the colors of the vertices of the baked meshes by their light. vertices and indices
+/// hold the geometry of each mesh of the description. threadCount threads trace the rays, 0 using
+/// one per hardware thread
+LightBakeStats BakeVertexLighting(const rhi::SceneDescription& description,
+                                  std::vector<std::vector<rhi::Vertex>>& vertices,
+                                  const std::vector<std::vector<uint32_t>>& indices,
+                                  const LightBakeSettings& settings, uint32_t threadCount = 0);
+
+/// Hash of the inputs of a bake besides the geometry of the meshes: the settings, the instances,
+/// the materials and the lights, chained to hash
+uint64_t HashLightBake(const rhi::SceneDescription& description, const LightBakeSettings& settings,
+                       uint64_t hash);
+} // namespace tools
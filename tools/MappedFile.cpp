@@ -0,0 +1,140 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tools
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_open(other.m_open)
+{
+  other.m_data = nullptr;
+  other.m_size = 0;
+  other.m_open = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    Close();
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_open = other.m_open;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_open = false;
+  }
+  return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The view keeps the mapping alive, so the file handles are closed as soon as it is created
+bool MappedFile::Open(const std::string& fileName)
+{
+  Close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  if (size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    m_open = true;
+    return true;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr)
+  {
+    return false;
+  }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr)
+  {
+    return false;
+  }
+  m_data = static_cast<const uint8_t*>(view);
+  m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+  int descriptor = open(fileName.c_str(), O_RDONLY);
+  if (descriptor < 0)
+  {
+    return false;
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0)
+  {
+    close(descriptor);
+    return false;
+  }
+  if (status.st_size == 0)
+  {
+    close(descriptor);
+    m_open = true;
+    return true;
+  }
+  void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE,
+                    descriptor, 0);
+  close(descriptor);
+  if (view == MAP_FAILED)
+  {
+    return false;
+  }
+  m_data = static_cast<const uint8_t*>(view);
+  m_size = static_cast<uint64_t>(status.st_size);
+#endif
+
+  m_open = true;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void MappedFile::Close()
+{
+  if (m_data != nullptr)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+#endif
+  }
+  m_data = nullptr;
+  m_size = 0;
+  m_open = false;
+}
+} // namespace tools
@@ -0,0 +1,54 @@
+/*
+Read-only memory mapping of a whole file, so that binary data can be used in
+place, without reading nor parsing it: the pages are loaded by the operating
+system when first accessed, and shared with the file cache.
+
+The mapping starts at a page boundary, so data stored at aligned offsets of
+the file is aligned in memory as well. It stays valid until the object is
+closed or destroyed; the file must not be modified meanwhile.
+
+Example:
+
+MappedFile file;
+if (file.Open("scene.cache"))
+{
+  const uint8_t* data = file.GetData();
+  ...
+}
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace tools
+{
+
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /// Map the file, closing the previous one. Returns false if the file cannot be opened or
+  /// mapped. An empty file is open with null data
+  bool Open(const std::string& fileName);
+  void Close();
+
+  bool IsOpen() const { return m_open; }
+  const uint8_t* GetData() const { return m_data; }
+  uint64_t GetSize() const { return m_size; }
+
+private:
+  const uint8_t* m_data = nullptr;
+  uint64_t m_size = 0;
+  bool m_open = false;
+};
+} // namespace tools
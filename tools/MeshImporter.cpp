@@ -0,0 +1,900 @@
+#include "MeshImporter.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "MappedFile.h"
+#include "../rhi/cpu/ThreadPool.h"
+
+namespace tools
+{
+
+namespace
+{
+/// Bytes of OBJ text parsed by one task
+const uint64_t ObjChunkSize = 1 << 20;
+/// Vertices and faces of a PLY file decoded by one task
+const uint64_t PlyChunkSize = 1 << 16;
+
+const glm::vec4 DefaultColor(1.f, 1.f, 1.f, 1.f);
+
+/// Part of a file parsed by one task. The counts are filled by the first pass, and the first
+/// vertex and triangle of the chunk are their sums over the previous chunks
+struct Chunk
+{
+  const char* begin;
+  const char* end;
+  uint64_t vertexCount = 0;
+  uint64_t triangleCount = 0;
+  uint64_t lineCount = 0;
+  uint64_t firstVertex = 0;
+  uint64_t firstTriangle = 0;
+  uint64_t firstLine = 0;
+  /// Error found by the task, thrown once all the tasks are done
+  std::string error;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Sum the counts of the chunks into the offsets of each chunk, and size the output arrays
+void AllocateOutput(std::vector<Chunk>& chunks, std::vector<rhi::Vertex>& vertices,
+                    std::vector<uint32_t>& indices)
+{
+  uint64_t vertexCount = 0;
+  uint64_t triangleCount = 0;
+  uint64_t lineCount = 0;
+  for (Chunk& chunk : chunks)
+  {
+    chunk.firstVertex = vertexCount;
+    chunk.firstTriangle = triangleCount;
+    chunk.firstLine = lineCount;
+    vertexCount += chunk.vertexCount;
+    triangleCount += chunk.triangleCount;
+    lineCount += chunk.lineCount;
+  }
+  if (vertexCount > UINT32_MAX || 3 * triangleCount > UINT32_MAX)
+  {
+    throw std::logic_error("Mesh too large for 32-bit indices");
+  }
+  vertices.resize(static_cast<size_t>(vertexCount));
+  indices.resize(static_cast<size_t>(3 * triangleCount));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Throw the error of the first chunk which failed
+void ThrowChunkErrors(const std::vector<Chunk>& chunks)
+{
+  for (const Chunk& chunk : chunks)
+  {
+    if (!chunk.error.empty())
+    {
+      throw std::logic_error(chunk.error);
+    }
+  }
+}
+
+inline bool IsSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* SkipSpaces(const char* p, const char* end)
+{
+  while (p < end && IsSpace(*p))
+  {
+    p++;
+  }
+  return p;
+}
+
+inline const char* SkipToken(const char* p, const char* end)
+{
+  while (p < end && !IsSpace(*p))
+  {
+    p++;
+  }
+  return p;
+}
+
+inline const char* FindLineEnd(const char* p, const char* end)
+{
+  const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+  return newline != nullptr ? newline : end;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse a decimal integer at p, advancing p past it
+bool ParseInteger(const char*& p, const char* end, int64_t& value)
+{
+  const char* start = p;
+  bool negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    p++;
+  }
+  const char* digits = p;
+  value = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    value = 10 * value + (*p - '0');
+  }
+  if (p == digits)
+  {
+    p = start;
+    return false;
+  }
+  value = negative ? -value : value;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse a decimal floating-point number at p, advancing p past it. The digits are accumulated in
+// an integer, up to the precision of a double, and scaled once by the power of ten
+bool ParseFloat(const char*& p, const char* end, float& value)
+{
+  static const double PowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                       1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                       1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* start = p;
+  bool negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int64_t exponent = 0;
+  bool hasDigits = false;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    hasDigits = true;
+    if (mantissa < 100000000000000000ull)
+    {
+      mantissa = 10 * mantissa + (*p - '0');
+    }
+    else
+    {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.')
+  {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+      hasDigits = true;
+      if (mantissa < 100000000000000000ull)
+      {
+        mantissa = 10 * mantissa + (*p - '0');
+        exponent--;
+      }
+    }
+  }
+  if (!hasDigits)
+  {
+    p = start;
+    return false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* mark = p++;
+    int64_t explicitExponent;
+    if (ParseInteger(p, end, explicitExponent))
+    {
+      exponent += explicitExponent;
+    }
+    else
+    {
+      p = mark;
+    }
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (exponent >= -22 && exponent <= 22)
+  {
+    result = exponent >= 0 ? result * PowersOfTen[exponent] : result / PowersOfTen[-exponent];
+  }
+  else
+  {
+    result *= std::pow(10.0, static_cast<double>(exponent));
+  }
+  value = static_cast<float>(negative ? -result : result);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// First pass over an OBJ chunk: count the vertices, the triangles of the faces, and the lines
+void CountObjChunk(Chunk& chunk)
+{
+  for (const char* line = chunk.begin; line < chunk.end;)
+  {
+    const char* lineEnd = FindLineEnd(line, chunk.end);
+    const char* p = SkipSpaces(line, lineEnd);
+    if (lineEnd - p >= 2 && IsSpace(p[1]))
+    {
+      if (p[0] == 'v')
+      {
+        chunk.vertexCount++;
+      }
+      else if (p[0] == 'f')
+      {
+        uint64_t cornerCount = 0;
+        for (p = SkipSpaces(p + 1, lineEnd); p < lineEnd;
+             p = SkipSpaces(SkipToken(p, lineEnd), lineEnd))
+        {
+          cornerCount++;
+        }
+        chunk.triangleCount += cornerCount >= 3 ? cornerCount - 2 : 0;
+      }
+    }
+    chunk.lineCount++;
+    line = lineEnd + 1;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Second pass over an OBJ chunk, writing its vertices and triangles at the offsets of the chunk.
+// Relative indices count back from the last vertex read, whose index is known from the vertices
+// of the previous chunks
+void ParseObjChunk(Chunk& chunk, const std::string& fileName, rhi::Vertex* vertices,
+                   uint32_t* indices, uint64_t totalVertexCount)
+{
+  rhi::Vertex* vertex = vertices + chunk.firstVertex;
+  uint32_t* index = indices + 3 * chunk.firstTriangle;
+  uint64_t lineNumber = chunk.firstLine;
+  const char* lineEnd = chunk.begin;
+  for (const char* line = chunk.begin; line < chunk.end; line = lineEnd + 1)
+  {
+    lineNumber++;
+    lineEnd = FindLineEnd(line, chunk.end);
+    const char* p = SkipSpaces(line, lineEnd);
+    if (lineEnd - p < 2 || !IsSpace(p[1]) || (p[0] != 'v' && p[0] != 'f'))
+    {
+      continue;
+    }
+
+    if (p[0] == 'v')
+    {
+      float values[7];
+      uint32_t valueCount = 0;
+      for (p = SkipSpaces(p + 1, lineEnd); p < lineEnd && valueCount < 7;
+           p = SkipSpaces(p, lineEnd))
+      {
+        if (!ParseFloat(p, lineEnd, values[valueCount++]))
+        {
+          valueCount = 0;
+          break;
+        }
+      }
+      if (valueCount < 3)
+      {
+        chunk.error = "Invalid vertex in " + fileName + " line " + std::to_string(lineNumber);
+        return;
+      }
+      vertex->position = glm::vec3(values[0], values[1], values[2]);
+      vertex->color = valueCount >= 6 ? glm::vec4(values[3], values[4], values[5], 1.f)
+                                      : DefaultColor;
+      vertex++;
+      continue;
+    }
+
+    uint64_t vertexNumber = static_cast<uint64_t>(vertex - vertices);
+    uint32_t first = 0;
+    uint32_t previous = 0;
+    uint32_t cornerCount = 0;
+    for (p = SkipSpaces(p + 1, lineEnd); p < lineEnd;
+         p = SkipSpaces(SkipToken(p, lineEnd), lineEnd))
+    {
+      int64_t value;
+      int64_t resolved = -1;
+      if (ParseInteger(p, lineEnd, value) && value != 0)
+      {
+        resolved = value > 0 ? value - 1 : static_cast<int64_t>(vertexNumber) + value;
+      }
+      if (resolved < 0 || static_cast<uint64_t>(resolved) >= totalVertexCount)
+      {
+        chunk.error = "Invalid face index in " + fileName + " line " + std::to_string(lineNumber);
+        return;
+      }
+      uint32_t current = static_cast<uint32_t>(resolved);
+      if (cornerCount >= 2)
+      {
+        index[0] = first;
+        index[1] = previous;
+        index[2] = current;
+        index += 3;
+      }
+      first = cornerCount == 0 ? current : first;
+      previous = current;
+      cornerCount++;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Split the file at line boundaries, count, then parse the chunks
+void ImportObj(const MappedFile& file, const std::string& fileName, rhi::cpu::ThreadPool& pool,
+               std::vector<rhi::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  const char* data = reinterpret_cast<const char*>(file.GetData());
+  const char* end = data + file.GetSize();
+  std::vector<Chunk> chunks;
+  for (const char* begin = data; begin < end;)
+  {
+    const char* chunkEnd = end - begin > static_cast<int64_t>(ObjChunkSize)
+                               ? FindLineEnd(begin + ObjChunkSize, end)
+                               : end;
+    chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+    Chunk chunk;
+    chunk.begin = begin;
+    chunk.end = chunkEnd;
+    chunks.push_back(chunk);
+    begin = chunkEnd;
+  }
+
+  pool.ParallelFor(static_cast<uint32_t>(chunks.size()),
+                   [&](uint32_t c, uint32_t /*thread*/) { CountObjChunk(chunks[c]); });
+  AllocateOutput(chunks, vertices, indices);
+  uint64_t vertexCount = vertices.size();
+  pool.ParallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t c, uint32_t /*thread*/) {
+    ParseObjChunk(chunks[c], fileName, vertices.data(), indices.data(), vertexCount);
+  });
+  ThrowChunkErrors(chunks);
+}
+
+enum class PlyType
+{
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64
+};
+
+struct PlyProperty
+{
+  std::string name;
+  PlyType type;
+  /// Lists store their size as countType, followed by the elements of type
+  bool list = false;
+  PlyType countType = PlyType::UInt8;
+  /// Offset in the records of fixed size
+  uint32_t offset = 0;
+};
+
+struct PlyElement
+{
+  std::string name;
+  uint64_t count = 0;
+  std::vector<PlyProperty> properties;
+  /// Size of the records, if no property is a list
+  uint32_t stride = 0;
+  bool fixedSize = true;
+};
+
+uint32_t GetSize(PlyType type)
+{
+  static const uint32_t Sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+  return Sizes[static_cast<int>(type)];
+}
+
+PlyType ParsePlyType(const std::string& name, const std::string& fileName)
+{
+  static const struct
+  {
+    const char* name;
+    PlyType type;
+  } Types[] = {{"char", PlyType::Int8},      {"int8", PlyType::Int8},
+               {"uchar", PlyType::UInt8},     {"uint8", PlyType::UInt8},
+               {"short", PlyType::Int16},     {"int16", PlyType::Int16},
+               {"ushort", PlyType::UInt16},   {"uint16", PlyType::UInt16},
+               {"int", PlyType::Int32},       {"int32", PlyType::Int32},
+               {"uint", PlyType::UInt32},     {"uint32", PlyType::UInt32},
+               {"float", PlyType::Float32},   {"float32", PlyType::Float32},
+               {"double", PlyType::Float64},  {"float64", PlyType::Float64}};
+  for (const auto& type : Types)
+  {
+    if (name == type.name)
+    {
+      return type.type;
+    }
+  }
+  throw std::logic_error("Unknown PLY type " + name + " in " + fileName);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Read a value of the given type, stored with the opposite byte order if swap is set
+double ReadPlyValue(const uint8_t* data, PlyType type, bool swap)
+{
+  uint8_t bytes[8];
+  uint32_t size = GetSize(type);
+  for (uint32_t i = 0; i < size; i++)
+  {
+    bytes[i] = data[swap ? size - 1 - i : i];
+  }
+  switch (type)
+  {
+  case PlyType::Int8:
+    return static_cast<int8_t>(bytes[0]);
+  case PlyType::UInt8:
+    return bytes[0];
+  case PlyType::Int16:
+  {
+    int16_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  case PlyType::UInt16:
+  {
+    uint16_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  case PlyType::Int32:
+  {
+    int32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  case PlyType::UInt32:
+  {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  case PlyType::Float32:
+  {
+    float value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  default:
+  {
+    double value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Position of a list property in the record of a variable-size element at data, which is known to
+// fit in the file
+const uint8_t* FindPlyList(const PlyElement& element, const PlyProperty& list, const uint8_t* data,
+                           bool swap)
+{
+  for (const PlyProperty& property : element.properties)
+  {
+    if (&property == &list)
+    {
+      break;
+    }
+    if (!property.list)
+    {
+      data += GetSize(property.type);
+      continue;
+    }
+    double count = ReadPlyValue(data, property.countType, swap);
+    data += GetSize(property.countType) +
+            static_cast<uint64_t>(count > 0.0 ? count : 0.0) * GetSize(property.type);
+  }
+  return data;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Size of the record of a variable-size element at data, or 0 if it does not fit before end
+uint64_t GetPlyRecordSize(const PlyElement& element, const uint8_t* data, const uint8_t* end,
+                          bool swap)
+{
+  uint64_t size = 0;
+  for (const PlyProperty& property : element.properties)
+  {
+    if (!property.list)
+    {
+      size += GetSize(property.type);
+      continue;
+    }
+    uint32_t countSize = GetSize(property.countType);
+    if (static_cast<uint64_t>(end - data) < size + countSize)
+    {
+      return 0;
+    }
+    double count = ReadPlyValue(data + size, property.countType, swap);
+    size += countSize + static_cast<uint64_t>(count > 0.0 ? count : 0.0) * GetSize(property.type);
+  }
+  return static_cast<uint64_t>(end - data) >= size ? size : 0;
+}
+
+/// Header of a PLY file, and the position of the data of its elements
+struct PlyHeader
+{
+  std::vector<PlyElement> elements;
+  bool swap = false;
+  const uint8_t* data = nullptr;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse the text header, which ends with the end_header line
+PlyHeader ParsePlyHeader(const MappedFile& file, const std::string& fileName)
+{
+  const char* text = reinterpret_cast<const char*>(file.GetData());
+  const char* end = text + file.GetSize();
+  const char* marker = "end_header";
+  const char* headerEnd = nullptr;
+  for (const char* line = text; line < end; line = FindLineEnd(line, end) + 1)
+  {
+    if (FindLineEnd(line, end) - line >= 10 && std::memcmp(line, marker, 10) == 0)
+    {
+      headerEnd = FindLineEnd(line, end);
+      break;
+    }
+  }
+  if (file.GetSize() < 4 || std::memcmp(text, "ply", 3) != 0 || headerEnd == nullptr ||
+      headerEnd == end)
+  {
+    throw std::logic_error("Invalid PLY header in " + fileName);
+  }
+
+  PlyHeader header;
+  header.data = file.GetData() + (headerEnd + 1 - text);
+  std::istringstream lines(std::string(text, headerEnd));
+  std::string line;
+  bool binary = false;
+  while (std::getline(lines, line))
+  {
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "format")
+    {
+      std::string format;
+      tokens >> format;
+      uint16_t probe = 1;
+      bool littleEndianHost = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+      binary = format == "binary_little_endian" || format == "binary_big_endian";
+      header.swap = (format == "binary_big_endian") == littleEndianHost;
+      if (!binary)
+      {
+        throw std::logic_error("Only binary PLY files are supported, " + fileName + " is " +
+                               format);
+      }
+    }
+    else if (keyword == "element")
+    {
+      PlyElement element;
+      tokens >> element.name >> element.count;
+      header.elements.push_back(element);
+    }
+    else if (keyword == "property")
+    {
+      if (header.elements.empty())
+      {
+        throw std::logic_error("PLY property outside of an element in " + fileName);
+      }
+      PlyElement& element = header.elements.back();
+      PlyProperty property;
+      std::string type;
+      tokens >> type;
+      if (type == "list")
+      {
+        std::string countType;
+        tokens >> countType >> type;
+        property.list = true;
+        property.countType = ParsePlyType(countType, fileName);
+        element.fixedSize = false;
+      }
+      property.type = ParsePlyType(type, fileName);
+      tokens >> property.name;
+      property.offset = element.stride;
+      element.stride += property.list ? 0 : GetSize(property.type);
+      element.properties.push_back(property);
+    }
+  }
+  if (!binary)
+  {
+    throw std::logic_error("Missing PLY format in " + fileName);
+  }
+  return header;
+}
+
+const PlyProperty* FindPlyProperty(const PlyElement& element, const char* name)
+{
+  for (const PlyProperty& property : element.properties)
+  {
+    if (property.name == name)
+    {
+      return &property;
+    }
+  }
+  return nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The vertex records must have a fixed size, holding at least the floating-point positions, before
+// their size is used to locate them
+void CheckPlyVertexElement(const PlyElement& element, const std::string& fileName)
+{
+  const char* axes[3] = {"x", "y", "z"};
+  bool valid = element.fixedSize;
+  for (const char* axis : axes)
+  {
+    const PlyProperty* property = FindPlyProperty(element, axis);
+    valid = valid && property != nullptr && !property->list &&
+            (property->type == PlyType::Float32 || property->type == PlyType::Float64);
+  }
+  if (!valid)
+  {
+    throw std::runtime_error("PLY vertices need float x, y and z properties in " + fileName);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Decode the vertices in parallel ranges, their records having a fixed size
+void DecodePlyVertices(const PlyElement& element, const uint8_t* data, bool swap,
+                       rhi::cpu::ThreadPool& pool, std::vector<rhi::Vertex>& vertices)
+{
+  const PlyProperty* position[3] = {FindPlyProperty(element, "x"), FindPlyProperty(element, "y"),
+                                    FindPlyProperty(element, "z")};
+  const PlyProperty* color[4] = {
+      FindPlyProperty(element, "red"), FindPlyProperty(element, "green"),
+      FindPlyProperty(element, "blue"), FindPlyProperty(element, "alpha")};
+  bool hasColor = color[0] != nullptr && color[1] != nullptr && color[2] != nullptr;
+
+  vertices.resize(static_cast<size_t>(element.count));
+  uint32_t chunkCount = static_cast<uint32_t>((element.count + PlyChunkSize - 1) / PlyChunkSize);
+  pool.ParallelFor(chunkCount, [&](uint32_t c, uint32_t /*thread*/) {
+    uint64_t first = c * PlyChunkSize;
+    uint64_t last = first + PlyChunkSize < element.count ? first + PlyChunkSize : element.count;
+    for (uint64_t v = first; v < last; v++)
+    {
+      const uint8_t* record = data + v * element.stride;
+      rhi::Vertex& vertex = vertices[static_cast<size_t>(v)];
+      for (int axis = 0; axis < 3; axis++)
+      {
+        vertex.position[axis] = static_cast<float>(
+            ReadPlyValue(record + position[axis]->offset, position[axis]->type, swap));
+      }
+      vertex.color = DefaultColor;
+      for (int channel = 0; hasColor && channel < 4; channel++)
+      {
+        if (color[channel] == nullptr)
+        {
+          continue;
+        }
+        float value = static_cast<float>(
+            ReadPlyValue(record + color[channel]->offset, color[channel]->type, swap));
+        bool normalized = color[channel]->type == PlyType::Float32 ||
+                          color[channel]->type == PlyType::Float64;
+        vertex.color[channel] = normalized ? value : value / 255.f;
+      }
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Locate the start of every chunk of faces and count their triangles with a sequential scan of the
+// list sizes, then triangulate the chunks in parallel
+void DecodePlyFaces(const PlyElement& element, const uint8_t* data, const uint8_t* end, bool swap,
+                    uint64_t vertexCount, const std::string& fileName, rhi::cpu::ThreadPool& pool,
+                    std::vector<uint32_t>& indices)
+{
+  const PlyProperty* list = FindPlyProperty(element, "vertex_indices");
+  list = list != nullptr ? list : FindPlyProperty(element, "vertex_index");
+  if (list == nullptr || !list->list)
+  {
+    throw std::logic_error("PLY faces need a vertex_indices list in " + fileName);
+  }
+
+  std::vector<Chunk> chunks;
+  const uint8_t* record = data;
+  for (uint64_t f = 0; f < element.count; f++)
+  {
+    if (f % PlyChunkSize == 0)
+    {
+      Chunk chunk;
+      chunk.begin = reinterpret_cast<const char*>(record);
+      chunks.push_back(chunk);
+    }
+    // The record size includes the list, so a list running past the end of the file is truncated
+    uint64_t size = GetPlyRecordSize(element, record, end, swap);
+    if (size == 0)
+    {
+      throw std::logic_error("Truncated PLY faces in " + fileName + " face " + std::to_string(f));
+    }
+    // Signed count types may hold negative sizes
+    double count = ReadPlyValue(FindPlyList(element, *list, record, swap), list->countType, swap);
+    if (!(count >= 0.0))
+    {
+      throw std::logic_error("Invalid PLY list size in " + fileName + " face " +
+                             std::to_string(f));
+    }
+    chunks.back().triangleCount += count >= 3.0 ? static_cast<uint64_t>(count) - 2 : 0;
+    record += size;
+  }
+  uint64_t triangleCount = 0;
+  for (Chunk& chunk : chunks)
+  {
+    chunk.firstTriangle = triangleCount;
+    triangleCount += chunk.triangleCount;
+  }
+  if (3 * triangleCount > UINT32_MAX)
+  {
+    throw std::logic_error("Mesh too large for 32-bit indices");
+  }
+  indices.resize(static_cast<size_t>(3 * triangleCount));
+
+  uint32_t countSize = GetSize(list->countType);
+  uint32_t indexSize = GetSize(list->type);
+  pool.ParallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t c, uint32_t /*thread*/) {
+    Chunk& chunk = chunks[c];
+    const uint8_t* face = reinterpret_cast<const uint8_t*>(chunk.begin);
+    uint64_t firstFace = c * PlyChunkSize;
+    uint64_t lastFace = firstFace + PlyChunkSize < element.count ? firstFace + PlyChunkSize
+                                                                 : element.count;
+    uint32_t* index = indices.data() + 3 * chunk.firstTriangle;
+    for (uint64_t f = firstFace; f < lastFace; f++)
+    {
+      const uint8_t* listData = FindPlyList(element, *list, face, swap);
+      // Checked to be non-negative and within the file by the scan
+      uint64_t cornerCount = static_cast<uint64_t>(ReadPlyValue(listData, list->countType, swap));
+      uint32_t first = 0;
+      uint32_t previous = 0;
+      for (uint64_t k = 0; k < cornerCount; k++)
+      {
+        double value = ReadPlyValue(listData + countSize + k * indexSize, list->type, swap);
+        if (!(value >= 0.0 && value < static_cast<double>(vertexCount)))
+        {
+          chunk.error = "Invalid face index in " + fileName + " face " + std::to_string(f);
+          return;
+        }
+        uint32_t current = static_cast<uint32_t>(value);
+        if (k >= 2)
+        {
+          index[0] = first;
+          index[1] = previous;
+          index[2] = current;
+          index += 3;
+        }
+        first = k == 0 ? current : first;
+        previous = current;
+      }
+      face += GetPlyRecordSize(element, face, end, swap);
+    }
+  });
+  ThrowChunkErrors(chunks);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Walk the elements in file order, skipping the ones other than the vertices and the faces
+void ImportPly(const MappedFile& file, const std::string& fileName, rhi::cpu::ThreadPool& pool,
+               std::vector<rhi::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  PlyHeader header = ParsePlyHeader(file, fileName);
+  const uint8_t* end = file.GetData() + file.GetSize();
+  const uint8_t* data = header.data;
+  const PlyElement* faces = nullptr;
+  const uint8_t* faceData = nullptr;
+  vertices.clear();
+  indices.clear();
+  for (const PlyElement& element : header.elements)
+  {
+    if (element.name == "vertex")
+    {
+      CheckPlyVertexElement(element, fileName);
+      if (element.stride != 0 && static_cast<uint64_t>(end - data) / element.stride < element.count)
+      {
+        throw std::logic_error("Truncated PLY vertices in " + fileName);
+      }
+      DecodePlyVertices(element, data, header.swap, pool, vertices);
+    }
+    else if (element.name == "face")
+    {
+      faces = &element;
+      faceData = data;
+    }
+
+    if (element.fixedSize)
+    {
+      if (element.stride != 0 && static_cast<uint64_t>(end - data) / element.stride < element.count)
+      {
+        throw std::logic_error("Truncated PLY element " + element.name + " in " + fileName);
+      }
+      data += element.count * element.stride;
+      continue;
+    }
+    for (uint64_t i = 0; i < element.count; i++)
+    {
+      uint64_t size = GetPlyRecordSize(element, data, end, header.swap);
+      if (size == 0)
+      {
+        throw std::logic_error("Truncated PLY element " + element.name + " in " + fileName + " " +
+                               element.name + " " + std::to_string(i));
+      }
+      data += size;
+    }
+  }
+
+  if (vertices.size() > UINT32_MAX)
+  {
+    throw std::logic_error("Mesh too large for 32-bit indices");
+  }
+  if (faces != nullptr)
+  {
+    DecodePlyFaces(*faces, faceData, end, header.swap, vertices.size(), fileName, pool, indices);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool HasExtension(const std::string& fileName, const char* extension)
+{
+  size_t length = std::strlen(extension);
+  if (fileName.size() < length)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++)
+  {
+    char c = fileName[fileName.size() - length + i];
+    c = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    if (c != extension[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void ImportMesh(const std::string& fileName, std::vector<rhi::Vertex>& vertices,
+                std::vector<uint32_t>& indices, uint32_t threadCount /*= 0*/)
+{
+  bool obj = HasExtension(fileName, ".obj");
+  if (!obj && !HasExtension(fileName, ".ply"))
+  {
+    throw std::logic_error("Unknown mesh format of " + fileName + ", expected .obj or .ply");
+  }
+  MappedFile file;
+  if (!file.Open(fileName))
+  {
+    throw std::logic_error("Cannot open mesh " + fileName);
+  }
+
+  rhi::cpu::ThreadPool pool(threadCount);
+  if (obj)
+  {
+    ImportObj(file, fileName, pool, vertices, indices);
+  }
+  else
+  {
+    ImportPly(file, fileName, pool, vertices, indices);
+  }
+  // Geometry without indices would be traced as a triangle list of the vertices
+  if (indices.empty())
+  {
+    throw std::logic_error("No triangles in mesh " + fileName);
+  }
+}
+} // namespace tools
@@ -0,0 +1,51 @@
+/*
+Import of triangle meshes from Wavefront OBJ and binary PLY files, directly
+into the vertex and index layout of the render devices: rhi::Vertex, whose
+position is the float3 at the start of the stride, and 32-bit indices.
+
+The file is memory-mapped and parsed in chunks by the threads of a pool, in
+two passes: the first counts the vertices and triangles of each chunk, which
+gives the offset at which each chunk writes its results, and the second
+parses the chunks straight into the final arrays. Nothing is copied in
+between, so that large meshes load at the speed of the disk.
+
+OBJ files are split at line boundaries. Only the vertex positions (with the
+optional colors following them, a common extension) and the faces are read,
+polygons being triangulated as fans; negative indices are relative to the
+last vertex read, as in the format. PLY files must be binary, either little or
+big endian. The vertex element provides float or double x, y and z, and
+optionally red, green, blue and alpha; the face element provides a list of
+vertex indices named vertex_indices or vertex_index. Since the face lists vary
+in size, a quick sequential scan first locates the chunk boundaries. Vertices
+without a color are white.
+
+Errors, such as indices out of range, list sizes running past the end of the
+file or a mesh without triangles, are reported by throwing std::logic_error; a
+PLY vertex element without floating-point positions throws std::runtime_error.
+
+Example:
+
+std::vector<rhi::Vertex> vertices;
+std::vector<uint32_t> indices;
+ImportMesh("bunny.ply", vertices, indices);
+BufferHandle vb = device.CreateBuffer({BufferType::Vertex, vertices.size() * sizeof(rhi::Vertex),
+                                       vertices.data()});
+
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../rhi/RenderDevice.h"
+
+namespace tools
+{
+
+/// Replace the vertices and indices with the mesh of an OBJ or PLY file, the format being chosen
+/// by the extension of the file name. threadCount threads parse the file, 0 using one per hardware
+/// thread
+void ImportMesh(const std::string& fileName, std::vector<rhi::Vertex>& vertices,
+                std::vector<uint32_t>& indices, uint32_t threadCount = 0);
+} // namespace tools
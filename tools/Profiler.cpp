@@ -0,0 +1,252 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace tools
+{
+
+namespace
+{
+/// Write a string as a JSON string literal
+void WriteJsonString(std::ostream& stream, const std::string& text)
+{
+  stream << '"';
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      stream << '\\' << c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      stream << escaped;
+    }
+    else
+    {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+} // namespace
+
+thread_local Profiler::ThreadRing* Profiler::s_threadRing = nullptr;
+thread_local std::string Profiler::s_threadName;
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Profiler& Profiler::Get()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The rings stay registered, as their threads keep a pointer to them
+void Profiler::Start()
+{
+  std::lock_guard<std::mutex> lock(m_ringMutex);
+  for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+  {
+    ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+    ring->dropped.store(0, std::memory_order_relaxed);
+  }
+  m_collected.clear();
+  m_start = std::chrono::steady_clock::now();
+  m_enabled.store(true, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Profiler::SetThreadName(const std::string& name)
+{
+  s_threadName = name;
+  if (s_threadRing != nullptr)
+  {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    s_threadRing->name = name;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t Profiler::Now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                              m_start)
+      .count();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Profiler::RecordZone(const char* name, uint64_t start, uint64_t end)
+{
+  if (IsEnabled())
+  {
+    Record({name, start, end - start, 0.0, TraceEventType::Zone, 0});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Profiler::MarkFrame(uint64_t frame)
+{
+  if (IsEnabled())
+  {
+    Record({"Frame", Now(), 0, static_cast<double>(frame), TraceEventType::Frame, 0});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Profiler::RecordCounter(const char* name, double value)
+{
+  if (IsEnabled())
+  {
+    Record({name, Now(), 0, value, TraceEventType::Counter, 0});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The slot is written before the head is published, so the collector never reads a slot being
+// written
+void Profiler::Record(const TraceEvent& event)
+{
+  ThreadRing& ring = GetThreadRing();
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) >= RingCapacity)
+  {
+    ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    return;
+  }
+  TraceEvent& slot = ring.events[head & (RingCapacity - 1)];
+  slot = event;
+  slot.thread = ring.index;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Register a ring for the calling thread on its first event
+Profiler::ThreadRing& Profiler::GetThreadRing()
+{
+  if (s_threadRing == nullptr)
+  {
+    std::unique_ptr<ThreadRing> ring(new ThreadRing());
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    ring->index = static_cast<uint32_t>(m_rings.size());
+    ring->name = s_threadName.empty() ? "Thread " + std::to_string(ring->index) : s_threadName;
+    s_threadRing = ring.get();
+    m_rings.push_back(std::move(ring));
+  }
+  return *s_threadRing;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Profiler::Collect()
+{
+  std::lock_guard<std::mutex> lock(m_ringMutex);
+  for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+  {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail < head; tail++)
+    {
+      m_collected.push_back(ring->events[tail & (RingCapacity - 1)]);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t Profiler::GetDroppedEventCount() const
+{
+  uint64_t dropped = 0;
+  std::lock_guard<std::mutex> lock(m_ringMutex);
+  for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+  {
+    dropped += ring->dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Zones become complete events, frame markers global instant events, and counters counter events.
+// Times are in microseconds. Zones are recorded when they end, so the events are sorted by start
+// time, enclosing zones first, for the viewers to nest them correctly
+void Profiler::WriteChromeTrace(std::ostream& stream)
+{
+  Collect();
+  std::sort(m_collected.begin(), m_collected.end(), [](const TraceEvent& a, const TraceEvent& b) {
+    return a.start < b.start || (a.start == b.start && a.duration > b.duration);
+  });
+
+  stream << "{\"traceEvents\": [\n";
+  bool first = true;
+  {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+    {
+      stream << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+             << "\"tid\": " << ring->index << ", \"args\": {\"name\": ";
+      WriteJsonString(stream, ring->name);
+      stream << "}}";
+      first = false;
+    }
+  }
+
+  char line[256];
+  for (const TraceEvent& event : m_collected)
+  {
+    stream << (first ? "" : ",\n") << "{\"name\": ";
+    WriteJsonString(stream, event.name);
+    switch (event.type)
+    {
+    case TraceEventType::Zone:
+      std::snprintf(line, sizeof(line),
+                    ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    event.thread, event.start * 1e-3, event.duration * 1e-3);
+      break;
+    case TraceEventType::Frame:
+      std::snprintf(line, sizeof(line),
+                    ", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+                    "\"args\": {\"frame\": %.0f}}",
+                    event.thread, event.start * 1e-3, event.value);
+      break;
+    case TraceEventType::Counter:
+      std::snprintf(line, sizeof(line),
+                    ", \"ph\": \"C\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+                    "\"args\": {\"value\": %.17g}}",
+                    event.thread, event.start * 1e-3, event.value);
+      break;
+    }
+    stream << line;
+    first = false;
+  }
+  stream << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"droppedEvents\": "
+         << GetDroppedEventCount() << "}}\n";
+
+  if (!stream)
+  {
+    throw std::logic_error("Cannot write the trace");
+  }
+}
+} // namespace tools
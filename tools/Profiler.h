@@ -0,0 +1,166 @@
+/*
+Scoped-zone profiler recording how the frames split between their phases and
+threads, written as a Chrome trace-event file which chrome://tracing and
+Perfetto display with one lane per thread.
+
+Zones are timed by ProfileZone objects covering a scope. Frame markers and
+counters are recorded alongside. Each thread records into its own ring
+buffer, registered on its first event: the thread is the only writer of its
+ring and the collecting thread the only reader, so recording takes no lock.
+When a ring is full, its new events are dropped and counted; Collect, called
+regularly by one thread (typically once per frame), moves the recorded
+events out of the rings.
+
+When the profiler is not started, zones only test a flag. The names given to
+zones, markers and counters are not copied, and must be string literals or
+live as long as the profiler.
+
+Example:
+
+Profiler& profiler = Profiler::Get();
+profiler.SetThreadName("Main");
+profiler.Start();
+for (...)
+{
+  profiler.MarkFrame(frame);
+  {
+    ProfileZone zone("DispatchRays");
+    ...
+  }
+  profiler.RecordCounter("Rays", rayCount);
+  profiler.Collect();
+}
+std::ofstream file("frames.json");
+profiler.WriteChromeTrace(file);
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tools
+{
+
+enum class TraceEventType : uint8_t
+{
+  Zone,
+  Frame,
+  Counter
+};
+
+struct TraceEvent
+{
+  const char* name;
+  /// Nanoseconds since the start of the profiler
+  uint64_t start;
+  /// Duration of zones, in nanoseconds
+  uint64_t duration;
+  /// Frame index, or counter value
+  double value;
+  TraceEventType type;
+  /// Index of the recording thread, in registration order
+  uint32_t thread;
+};
+
+class Profiler
+{
+public:
+  /// Profiler shared by all the threads of the process
+  static Profiler& Get();
+
+  /// Discard the events recorded so far, restart the clock and enable recording. Must not be
+  /// called while other threads record events
+  void Start();
+  void Stop() { m_enabled.store(false, std::memory_order_relaxed); }
+  bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  /// Name of the lane of the calling thread, which can be given before the thread records events
+  void SetThreadName(const std::string& name);
+
+  /// Nanoseconds since Start
+  uint64_t Now() const;
+
+  void RecordZone(const char* name, uint64_t start, uint64_t end);
+  void MarkFrame(uint64_t frame);
+  void RecordCounter(const char* name, double value);
+
+  /// Move the events of all the rings to the collected events. Called by one thread at a time
+  void Collect();
+
+  /// Collect the remaining events and write all of them as a trace-event JSON file
+  void WriteChromeTrace(std::ostream& stream);
+
+  /// Events dropped because of full rings since Start
+  uint64_t GetDroppedEventCount() const;
+
+  /// Events held by each ring, a power of two
+  static const uint32_t RingCapacity = 1 << 16;
+
+private:
+  /// Single-producer single-consumer ring of a thread
+  struct ThreadRing
+  {
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(RingCapacity);
+    /// Written by the thread, read by the collector
+    std::atomic<uint64_t> head{0};
+    /// Written by the collector, read by the thread
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    uint32_t index = 0;
+    std::string name;
+  };
+
+  Profiler() = default;
+
+  /// Ring of the calling thread, created with its first event so that threads never recording
+  /// events take no memory
+  static thread_local ThreadRing* s_threadRing;
+  static thread_local std::string s_threadName;
+
+  void Record(const TraceEvent& event);
+  ThreadRing& GetThreadRing();
+
+  std::atomic<bool> m_enabled{false};
+  std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+  /// Protects the ring list and the thread names. Recording never locks it
+  mutable std::mutex m_ringMutex;
+  std::vector<std::unique_ptr<ThreadRing>> m_rings;
+
+  std::vector<TraceEvent> m_collected;
+};
+
+/// Zone covering the lifetime of the object
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name)
+      : m_name(name), m_start(Profiler::Get().IsEnabled() ? Profiler::Get().Now() : NotStarted)
+  {
+  }
+  ~ProfileZone()
+  {
+    if (m_start != NotStarted)
+    {
+      Profiler::Get().RecordZone(m_name, m_start, Profiler::Get().Now());
+    }
+  }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  static const uint64_t NotStarted = ~0ull;
+
+  const char* m_name;
+  uint64_t m_start;
+};
+} // namespace tools
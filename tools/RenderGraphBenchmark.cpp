@@ -0,0 +1,271 @@
+/*
+Benchmark of the compile step of the render graph (see
+nv_helpers_dx12/RenderGraph.h), which only manipulates handles and states and
+hence runs without a device.
+
+Usage:
+
+RenderGraphBenchmark [options]
+  -passes <n>               Passes of the frame, 500 by default
+  -transients <n>           Transient resources, 2000 by default
+  -imported <n>             Imported resources, 64 by default
+  -lifetime <n>             Longest lifetime of a transient resource in passes, 8 by default
+  -iterations <n>           Frames described and compiled, 20 by default
+  -seed <n>                 Seed of the pseudo-random frame, 1 by default
+
+The frame is pseudo-random: each transient resource is written by the first
+pass of its lifetime and read by some of the following ones, and each pass
+also reads or writes a few imported resources, in the states of a raytracing
+frame (acceleration structures, UAVs, shader resources, copies). As in the
+renderer the graph is described again for every frame; the time to describe
+it and the time to compile it are printed separately, along with the barrier
+counts and the memory saved by aliasing the transient resources.
+
+Example:
+
+RenderGraphBenchmark -passes 2000 -transients 10000 -iterations 5
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../nv_helpers_dx12/RenderGraph.h"
+
+using nv_helpers_dx12::CompiledRenderGraph;
+using nv_helpers_dx12::RenderGraph;
+using nv_helpers_dx12::RenderGraphHandle;
+using nv_helpers_dx12::ResourceState;
+using nv_helpers_dx12::ResourceUse;
+
+namespace
+{
+
+struct Options
+{
+  uint32_t passCount = 500;
+  uint32_t transientCount = 2000;
+  uint32_t importedCount = 64;
+  uint32_t maxLifetime = 8;
+  uint32_t iterationCount = 20;
+  uint32_t seed = 1;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t ParseUnsigned(const char* option, const std::string& value, uint32_t minimum)
+{
+  char* end = nullptr;
+  unsigned long result = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || result < minimum ||
+      result > UINT32_MAX)
+  {
+    throw std::logic_error(std::string("Invalid value for ") + option + ": " + value);
+  }
+  return static_cast<uint32_t>(result);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Value of the option at index, which is advanced past it
+const char* NextValue(int argc, char** argv, int& index)
+{
+  if (index + 1 >= argc)
+  {
+    throw std::logic_error(std::string("Missing value for ") + argv[index]);
+  }
+  return argv[++index];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* option = argv[i];
+    if (std::strcmp(option, "-passes") == 0)
+    {
+      options.passCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-transients") == 0)
+    {
+      options.transientCount = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else if (std::strcmp(option, "-imported") == 0)
+    {
+      options.importedCount = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else if (std::strcmp(option, "-lifetime") == 0)
+    {
+      options.maxLifetime = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-iterations") == 0)
+    {
+      options.iterationCount = ParseUnsigned(option, NextValue(argc, argv, i), 1);
+    }
+    else if (std::strcmp(option, "-seed") == 0)
+    {
+      options.seed = ParseUnsigned(option, NextValue(argc, argv, i), 0);
+    }
+    else
+    {
+      throw std::logic_error(std::string("Unknown option ") + option);
+    }
+  }
+  return options;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// Resource declarations of each pass of the frame, drawn once so that describing the graph only
+/// measures the graph
+struct Frame
+{
+  std::vector<uint64_t> transientSizes;
+  std::vector<std::vector<ResourceUse>> passUses;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Transient resources are written at the start of their lifetime and read afterwards. Imported
+// resources come first in the handles, followed by the transient ones
+Frame MakeFrame(const Options& options)
+{
+  std::mt19937 random(options.seed);
+  Frame frame;
+  frame.passUses.resize(options.passCount);
+
+  const ResourceState reads[] = {ResourceState::NonPixelShaderResource,
+                                 ResourceState::PixelShaderResource, ResourceState::CopySource,
+                                 ResourceState::NonPixelShaderResource |
+                                     ResourceState::PixelShaderResource};
+  for (uint32_t t = 0; t < options.transientCount; t++)
+  {
+    RenderGraphHandle handle = options.importedCount + t;
+    frame.transientSizes.push_back(4096 + random() % (8 << 20));
+    uint32_t first = random() % options.passCount;
+    uint32_t lifetime = 1 + random() % options.maxLifetime;
+    uint32_t last = first + lifetime < options.passCount ? first + lifetime : options.passCount;
+    frame.passUses[first].push_back({handle, ResourceState::UnorderedAccess, false});
+    for (uint32_t p = first + 1; p < last; p++)
+    {
+      if (random() % 2 == 0)
+      {
+        frame.passUses[p].push_back({handle, reads[random() % 4], false});
+      }
+    }
+  }
+
+  for (uint32_t p = 0; p < options.passCount && options.importedCount > 0; p++)
+  {
+    uint32_t useCount = random() % 4;
+    for (uint32_t u = 0; u < useCount; u++)
+    {
+      RenderGraphHandle handle = random() % options.importedCount;
+      bool used = false;
+      for (const ResourceUse& use : frame.passUses[p])
+      {
+        used |= use.resource == handle;
+      }
+      if (used)
+      {
+        continue;
+      }
+      uint32_t kind = random() % 8;
+      if (kind < 2)
+      {
+        frame.passUses[p].push_back({handle, ResourceState::AccelerationStructure, kind == 0});
+      }
+      else if (kind < 5)
+      {
+        frame.passUses[p].push_back({handle, ResourceState::UnorderedAccess, false});
+      }
+      else
+      {
+        frame.passUses[p].push_back({handle, reads[random() % 4], false});
+      }
+    }
+  }
+  return frame;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Describe(const Options& options, const Frame& frame, RenderGraph& graph)
+{
+  graph.Reset();
+  for (uint32_t i = 0; i < options.importedCount; i++)
+  {
+    graph.ImportResource("Imported" + std::to_string(i), ResourceState::Common,
+                         ResourceState::Common);
+  }
+  for (uint32_t t = 0; t < options.transientCount; t++)
+  {
+    graph.CreateTransient("Transient" + std::to_string(t), frame.transientSizes[t]);
+  }
+  for (uint32_t p = 0; p < options.passCount; p++)
+  {
+    graph.AddPass("Pass" + std::to_string(p), frame.passUses[p], nullptr);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Run(const Options& options)
+{
+  Frame frame = MakeFrame(options);
+  RenderGraph graph;
+  CompiledRenderGraph compiled;
+  double describeMilliseconds = 0.0;
+  double compileMilliseconds = 0.0;
+  for (uint32_t i = 0; i < options.iterationCount; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    Describe(options, frame, graph);
+    describeMilliseconds += Milliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    compiled = graph.Compile();
+    compileMilliseconds += Milliseconds(start);
+  }
+
+  std::printf("Graph: %u passes, %u transient and %u imported resources\n", graph.GetPassCount(),
+              options.transientCount, options.importedCount);
+  std::printf("Describe: %.3f ms per frame\n", describeMilliseconds / options.iterationCount);
+  std::printf("Compile: %.3f ms per frame\n", compileMilliseconds / options.iterationCount);
+  std::printf("Barriers: %u transitions, %u UAV, %u aliasing\n", compiled.transitionCount,
+              compiled.uavBarrierCount, compiled.aliasingBarrierCount);
+  std::printf("Transient heap: %.1f MB, %.1f MB without aliasing\n",
+              compiled.heapSize / (1024.0 * 1024.0), compiled.unaliasedSize / (1024.0 * 1024.0));
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    Run(ParseOptions(argc, argv));
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "RenderGraphBenchmark: %s\n", e.what());
+    return 1;
+  }
+}
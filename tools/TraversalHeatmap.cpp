@@ -0,0 +1,172 @@
+#include "TraversalHeatmap.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace tools
+{
+
+namespace
+{
+/// Counters of the summary table. The stack depth is a maximum, with no average per ray
+const struct
+{
+  const char* name;
+  uint64_t rhi::cpu::TraversalStats::*member;
+  bool summed;
+} SummaryCounters[] = {{"rays", &rhi::cpu::TraversalStats::rays, true},
+                       {"nodes visited", &rhi::cpu::TraversalStats::nodesVisited, true},
+                       {"box tests", &rhi::cpu::TraversalStats::boxTests, true},
+                       {"triangle tests", &rhi::cpu::TraversalStats::triangleTests, true},
+                       {"max stack depth", &rhi::cpu::TraversalStats::maxStackDepth, false},
+                       {"shadow early exits", &rhi::cpu::TraversalStats::shadowEarlyExits, true}};
+
+uint64_t GetCounter(const rhi::cpu::TraversalStats& stats, StatsCounter counter)
+{
+  switch (counter)
+  {
+  case StatsCounter::NodesVisited:
+    return stats.nodesVisited;
+  case StatsCounter::BoxTests:
+    return stats.boxTests;
+  case StatsCounter::TriangleTests:
+    return stats.triangleTests;
+  default:
+    return stats.maxStackDepth;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Piecewise linear ramp through black, blue, cyan, green, yellow and red, for value in [0, 1]
+void FalseColor(float value, uint8_t* rgb)
+{
+  static const float Ramp[6][3] = {{0.f, 0.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 1.f, 1.f},
+                                   {0.f, 1.f, 0.f}, {1.f, 1.f, 0.f}, {1.f, 0.f, 0.f}};
+  value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+  float position = value * 5.f;
+  int segment = position >= 5.f ? 4 : static_cast<int>(position);
+  float fraction = position - segment;
+  for (int c = 0; c < 3; c++)
+  {
+    float channel = Ramp[segment][c] + fraction * (Ramp[segment + 1][c] - Ramp[segment][c]);
+    rgb[c] = static_cast<uint8_t>(channel * 255.f + 0.5f);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Minimum, mean and maximum of a counter over a set of statistics
+void GetRange(const std::vector<rhi::cpu::TraversalStats>& stats,
+              uint64_t rhi::cpu::TraversalStats::*member, uint64_t& minimum, double& mean,
+              uint64_t& maximum)
+{
+  minimum = stats.empty() ? 0 : stats[0].*member;
+  maximum = minimum;
+  double sum = 0.0;
+  for (const rhi::cpu::TraversalStats& s : stats)
+  {
+    minimum = s.*member < minimum ? s.*member : minimum;
+    maximum = s.*member > maximum ? s.*member : maximum;
+    sum += static_cast<double>(s.*member);
+  }
+  mean = stats.empty() ? 0.0 : sum / stats.size();
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+StatsCounter ParseStatsCounter(const std::string& name)
+{
+  if (name == "nodes")
+  {
+    return StatsCounter::NodesVisited;
+  }
+  if (name == "boxes")
+  {
+    return StatsCounter::BoxTests;
+  }
+  if (name == "triangles")
+  {
+    return StatsCounter::TriangleTests;
+  }
+  if (name == "stack")
+  {
+    return StatsCounter::StackDepth;
+  }
+  throw std::logic_error("Unknown traversal counter " + name);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+rhi::Image MakeHeatmap(const std::vector<rhi::cpu::TraversalStats>& pixelStats, uint32_t width,
+                       uint32_t height, StatsCounter counter, uint64_t maxValue /*= 0*/)
+{
+  size_t pixelCount = static_cast<size_t>(width) * height;
+  if (pixelStats.size() < pixelCount)
+  {
+    throw std::logic_error("No traversal statistics for the heatmap, the counters may be "
+                           "compiled out");
+  }
+
+  if (maxValue == 0)
+  {
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+      uint64_t value = GetCounter(pixelStats[i], counter);
+      maxValue = value > maxValue ? value : maxValue;
+    }
+  }
+
+  rhi::Image image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(4 * pixelCount);
+  for (size_t i = 0; i < pixelCount; i++)
+  {
+    float value = maxValue > 0 ? static_cast<float>(GetCounter(pixelStats[i], counter)) /
+                                     static_cast<float>(maxValue)
+                               : 0.f;
+    FalseColor(value, &image.pixels[4 * i]);
+    image.pixels[4 * i + 3] = 255;
+  }
+  return image;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void WriteStatsSummary(std::ostream& stream, const rhi::cpu::TraversalStats& frameStats,
+                       const std::vector<rhi::cpu::TraversalStats>& tileStats,
+                       const std::vector<rhi::cpu::TraversalStats>& pixelStats)
+{
+  char line[256];
+  std::snprintf(line, sizeof(line), "%-20s %14s %10s %10s %12s %10s %10s %12s %10s\n", "counter",
+                "frame", "per ray", "tile min", "tile mean", "tile max", "pixel min",
+                "pixel mean", "pixel max");
+  stream << line;
+  for (const auto& counter : SummaryCounters)
+  {
+    uint64_t tileMin, tileMax, pixelMin, pixelMax;
+    double tileMean, pixelMean;
+    GetRange(tileStats, counter.member, tileMin, tileMean, tileMax);
+    GetRange(pixelStats, counter.member, pixelMin, pixelMean, pixelMax);
+    uint64_t total = frameStats.*counter.member;
+    char perRay[32] = "-";
+    if (counter.summed && frameStats.rays > 0)
+    {
+      std::snprintf(perRay, sizeof(perRay), "%.2f", static_cast<double>(total) / frameStats.rays);
+    }
+    std::snprintf(line, sizeof(line),
+                  "%-20s %14llu %10s %10llu %12.1f %10llu %10llu %12.2f %10llu\n", counter.name,
+                  static_cast<unsigned long long>(total), perRay,
+                  static_cast<unsigned long long>(tileMin), tileMean,
+                  static_cast<unsigned long long>(tileMax),
+                  static_cast<unsigned long long>(pixelMin), pixelMean,
+                  static_cast<unsigned long long>(pixelMax));
+    stream << line;
+  }
+}
+} // namespace tools
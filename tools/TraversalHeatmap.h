@@ -0,0 +1,53 @@
+/*
+Export of the traversal statistics recorded by the CPU device, see
+rhi/cpu/TraversalStats.h: a false-color heatmap of one counter per pixel, and
+a summary table of all the counters over the frame, the tiles and the pixels.
+
+The heatmap maps zero to black, then goes through blue, cyan, green and
+yellow up to red for the maximum value, which is by default the largest
+value of the frame.
+
+Example:
+
+rhi::Image heatmap = MakeHeatmap(device.GetPixelStats(), device.GetWidth(), device.GetHeight(),
+                                 StatsCounter::NodesVisited);
+WritePpm("nodes.ppm", heatmap);
+WriteStatsSummary(std::cout, device.GetFrameStats(), device.GetTileStats(),
+                  device.GetPixelStats());
+
+*/
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../rhi/RenderDevice.h"
+#include "../rhi/cpu/TraversalStats.h"
+
+namespace tools
+{
+
+enum class StatsCounter
+{
+  NodesVisited,
+  BoxTests,
+  TriangleTests,
+  StackDepth
+};
+
+/// Counter named nodes, boxes, triangles or stack
+StatsCounter ParseStatsCounter(const std::string& name);
+
+/// Image of the counter for each pixel, with width x height statistics stored row by row. A
+/// maxValue of 0 uses the largest value of the image
+rhi::Image MakeHeatmap(const std::vector<rhi::cpu::TraversalStats>& pixelStats, uint32_t width,
+                       uint32_t height, StatsCounter counter, uint64_t maxValue = 0);
+
+/// Write a table giving, for each counter, its frame total and average per ray, and its minimum,
+/// mean and maximum over the tiles and over the pixels
+void WriteStatsSummary(std::ostream& stream, const rhi::cpu::TraversalStats& frameStats,
+                       const std::vector<rhi::cpu::TraversalStats>& tileStats,
+                       const std::vector<rhi::cpu::TraversalStats>& pixelStats);
+} // namespace tools